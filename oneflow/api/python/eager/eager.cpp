@@ -14,8 +14,10 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
 #include "oneflow/api/python/of_api_registry.h"
 #include "oneflow/core/vm/vm_util.h"
+#include "oneflow/core/framework/local_op_kernel_infer_cache.h"
 
 ONEFLOW_API_PYBIND11_MODULE("eager.single_client", m) {
   using namespace oneflow;
@@ -23,4 +25,15 @@ ONEFLOW_API_PYBIND11_MODULE("eager.single_client", m) {
   m.def(
       "Sync", []() { vm::SingleClientSync().GetOrThrow(); },
       py::call_guard<py::gil_scoped_release>());
+  m.def(
+      "FlushDeferredInstructions", []() { vm::FlushDeferred().GetOrThrow(); },
+      py::call_guard<py::gil_scoped_release>());
+  m.def("SetInstructionBatchSize",
+        [](int64_t size) { vm::SetInstructionBatchSize(size).GetOrThrow(); });
+  m.def("DeferredInstructionAndBatchCnt",
+        []() { return vm::DeferredInstructionAndBatchCnt().GetOrThrow(); });
+  m.def("EagerInferCacheHitAndMissCnt", []() {
+    return std::make_pair(one::LocalOpKernelInferCache::TotalHitCnt(),
+                          one::LocalOpKernelInferCache::TotalMissCnt());
+  });
 }
@@ -0,0 +1,50 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <pybind11/pybind11.h>
+#include "oneflow/api/python/of_api_registry.h"
+#include "oneflow/core/vm/host_caching_allocator.h"
+
+namespace oneflow {
+namespace vm {
+
+namespace py = pybind11;
+
+ONEFLOW_API_PYBIND11_MODULE("vm", m) {
+  m.def("GetHostCachingAllocatorStats", []() {
+    py::dict stats_dict;
+    HostCachingAllocator* allocator = GetGlobalHostCachingAllocator();
+    if (allocator == nullptr) { return stats_dict; }
+    const HostCachingAllocatorStats stats = allocator->GetStats();
+    stats_dict["bytes_in_use"] = stats.bytes_in_use;
+    stats_dict["bytes_reserved"] = stats.bytes_reserved;
+    stats_dict["bytes_cached"] = stats.bytes_cached;
+    stats_dict["bytes_thread_cached"] = stats.bytes_thread_cached;
+    stats_dict["largest_free_piece_bytes"] = stats.largest_free_piece_bytes;
+    stats_dict["fragmentation"] = stats.fragmentation();
+    stats_dict["num_blocks"] = stats.num_blocks;
+    stats_dict["num_system_allocs"] = stats.num_system_allocs;
+    stats_dict["num_system_frees"] = stats.num_system_frees;
+    return stats_dict;
+  });
+
+  m.def("ReleaseHostCachingAllocatorCache", []() {
+    HostCachingAllocator* allocator = GetGlobalHostCachingAllocator();
+    if (allocator != nullptr) { allocator->ReleaseCachedMemory(); }
+  });
+}
+
+}  // namespace vm
+}  // namespace oneflow
@@ -14,6 +14,8 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <queue>
+#include <stack>
 #include "oneflow/core/autograd/autograd_engine.h"
 #include "oneflow/core/framework/tensor.h"
 #include "oneflow/core/framework/tensor_arg.h"
@@ -54,18 +56,20 @@ Maybe<void> CopyOrAccGrad(AutogradMeta* autograd_meta, bool autograd_mode) {
 
 }  // namespace
 
-StackFunctionNode::StackFunctionNode(
+FunctionNode::FunctionNode(
     const std::string& op_type_name,
     const std::shared_ptr<const std::function<Maybe<void>(const TensorTuple&, TensorTuple*, bool)>>&
         backward_fn,
     const TensorTuple& inputs, const TensorTuple& outputs)
-    : FunctionNode(op_type_name) {
+    : op_name_(op_type_name),
+      next_functions_(new std::vector<std::shared_ptr<FunctionNode>>{}),
+      backward_fn_(backward_fn) {
   input_meta_datas_.resize(inputs.size());
   next_functions_->reserve(inputs.size());
   for (int i = 0; i < inputs.size(); ++i) {
     input_meta_datas_.at(i) = inputs.at(i)->mut_autograd_meta();
     if (input_meta_datas_.at(i)->requires_grad()) {
-      next_functions_->emplace_back(inputs.at(i)->grad_fn_node());
+      next_functions_->emplace_back(inputs.at(i)->mut_grad_fn_node());
     }
   }
 
@@ -75,19 +79,16 @@ StackFunctionNode::StackFunctionNode(
     output_meta_datas_.at(i) = outputs.at(i)->mut_autograd_meta();
     output_tensor_infos_.emplace_back(TensorInfo(*outputs.at(i)));
   }
-
-  backward_fn_ = backward_fn;
-  is_in_stack_ = false;
 }
 
-Maybe<void> StackFunctionNode::AccGrad4RetainGradTensor() {
+Maybe<void> FunctionNode::AccGrad4RetainGradTensor() {
   for (const std::shared_ptr<AutogradMeta>& out : output_meta_datas_) {
     if (out->retain_grad()) { JUST(CopyOrAccGrad(out.get(), /*autograd_mode=*/false)); }
   }
   return Maybe<void>::Ok();
 }
 
-Maybe<void> StackFunctionNode::AccGrad4LeafTensor(bool create_graph) {
+Maybe<void> FunctionNode::AccGrad4LeafTensor(bool create_graph) {
   for (const std::shared_ptr<AutogradMeta>& out : output_meta_datas_) {
     if (out->is_leaf() && out->requires_grad()) {
       JUST(CopyOrAccGrad(out.get(), /*autograd_mode=*/false));
@@ -96,20 +97,13 @@ Maybe<void> StackFunctionNode::AccGrad4LeafTensor(bool create_graph) {
   return Maybe<void>::Ok();
 }
 
-void StackFunctionNode::ReleaseOutTensorArgs() {
+void FunctionNode::ReleaseOutTensorArgs() {
   for (const std::shared_ptr<AutogradMeta>& meta_data : output_meta_datas_) {
     meta_data->now_grad_arg()->Release();
   }
 }
 
-void StackFunctionNode::ReleaseData() {
-  // Releases backward function and makes useless tensors release as early as possible
-  if (!input_meta_datas_.empty()) { backward_fn_.reset(); }
-  next_functions_->clear();
-  is_in_stack_ = false;
-}
-
-Maybe<bool> StackFunctionNode::Apply(bool create_graph) {
+Maybe<bool> FunctionNode::Apply(bool create_graph) {
   CHECK_NOTNULL_OR_RETURN(backward_fn_.get())
       << "This FunctionNode with name `" << GetOpTypeName() << "` has been released.";
   if (!IsReadyToRun(output_meta_datas_)) { return false; }
@@ -131,6 +125,22 @@ Maybe<bool> StackFunctionNode::Apply(bool create_graph) {
   return true;
 }
 
+StackFunctionNode::StackFunctionNode(
+    const std::string& op_type_name,
+    const std::shared_ptr<const std::function<Maybe<void>(const TensorTuple&, TensorTuple*, bool)>>&
+        backward_fn,
+    const TensorTuple& inputs, const TensorTuple& outputs)
+    : FunctionNode(op_type_name, backward_fn, inputs, outputs) {
+  is_in_stack_ = false;
+}
+
+void StackFunctionNode::ReleaseData() {
+  // Releases backward function and makes useless tensors release as early as possible
+  if (!input_meta_datas_.empty()) { backward_fn_.reset(); }
+  next_functions_->clear();
+  is_in_stack_ = false;
+}
+
 void StackAutogradEngine::ClearEngine() {
   for (const auto& weak_func_node : node_list_) {
     const auto& func_node = weak_func_node.lock();
@@ -232,7 +242,211 @@ std::shared_ptr<FunctionNode> StackAutogradEngine::AddBackwardFuncPtr(
   return func_node;
 }
 
+GraphFunctionNode::GraphFunctionNode(
+    const std::string& op_type_name,
+    const std::shared_ptr<const std::function<Maybe<void>(const TensorTuple&, TensorTuple*, bool)>>&
+        backward_fn,
+    const TensorTuple& inputs, const TensorTuple& outputs)
+    : FunctionNode(op_type_name, backward_fn, inputs, outputs) {}
+
+void GraphFunctionNode::ReleaseData() {
+  // Accumulate nodes of leaf tensors have nothing saved and are reused by later graphs
+  if (!input_meta_datas_.empty()) { backward_fn_.reset(); }
+  next_functions_->clear();
+}
+
+GraphTask::GraphTask(const TensorTuple& outputs, bool retain_graph, bool create_graph)
+    : retain_graph_(retain_graph), create_graph_(create_graph), pruned_(false) {
+  HashSet<FunctionNode*> root_set;
+  roots_.reserve(outputs.size());
+  for (const auto& out_tensor : outputs) {
+    const std::shared_ptr<FunctionNode>& node = out_tensor->mut_grad_fn_node();
+    if (node && root_set.insert(node.get()).second) { roots_.push_back(node); }
+  }
+}
+
+Maybe<void> GraphTask::ComputeDependencies() {
+  pruned_ = false;
+  node2dependencies_.clear();
+  need_execute_.clear();
+  capture_only_.clear();
+  HashSet<FunctionNode*> seen;
+  std::stack<FunctionNode*> stack;
+  for (const auto& node : roots_) {
+    seen.insert(node.get());
+    stack.push(node.get());
+  }
+  while (!stack.empty()) {
+    FunctionNode* node = stack.top();
+    stack.pop();
+    for (const auto& next_node : *node->GetNextFunctions()) {
+      if (!next_node) { continue; }
+      node2dependencies_[next_node.get()] += 1;
+      if (seen.insert(next_node.get()).second) { stack.push(next_node.get()); }
+    }
+  }
+  return Maybe<void>::Ok();
+}
+
+Maybe<void> GraphTask::ComputeDependenciesAndPruneNode(const TensorTuple& inputs) {
+  pruned_ = true;
+  node2dependencies_.clear();
+  need_execute_.clear();
+  capture_only_.clear();
+  HashSet<FunctionNode*> captured;
+  for (const auto& in_tensor : inputs) {
+    const std::shared_ptr<FunctionNode>& node = in_tensor->mut_grad_fn_node();
+    if (node) { captured.insert(node.get()); }
+  }
+  // Post-order walk, a node is needed if it is captured or any of its next functions is
+  HashSet<FunctionNode*> seen;
+  std::stack<std::pair<FunctionNode*, bool>> stack;
+  for (const auto& node : roots_) {
+    seen.insert(node.get());
+    stack.push(std::make_pair(node.get(), false));
+  }
+  while (!stack.empty()) {
+    FunctionNode* node = stack.top().first;
+    const bool children_visited = stack.top().second;
+    stack.pop();
+    if (!children_visited) {
+      stack.push(std::make_pair(node, true));
+      for (const auto& next_node : *node->GetNextFunctions()) {
+        if (next_node && seen.insert(next_node.get()).second) {
+          stack.push(std::make_pair(next_node.get(), false));
+        }
+      }
+      continue;
+    }
+    bool any_next_needed = false;
+    for (const auto& next_node : *node->GetNextFunctions()) {
+      if (next_node && need_execute_.count(next_node.get()) > 0) { any_next_needed = true; }
+    }
+    if (any_next_needed || captured.count(node) > 0) { need_execute_.insert(node); }
+    if (!any_next_needed && captured.count(node) > 0) { capture_only_.insert(node); }
+  }
+  for (FunctionNode* node : need_execute_) {
+    for (const auto& next_node : *node->GetNextFunctions()) {
+      if (next_node && need_execute_.count(next_node.get()) > 0) {
+        node2dependencies_[next_node.get()] += 1;
+      }
+    }
+  }
+  return Maybe<void>::Ok();
+}
+
+Maybe<void> GraphTask::Apply(bool save_grad_for_leaf) {
+  const auto IsNeeded = [&](FunctionNode* node) {
+    return !pruned_ || need_execute_.count(node) > 0;
+  };
+  // Nodes are held here once ready, since running a node releases its next functions
+  std::queue<std::shared_ptr<FunctionNode>> ready_queue;
+  for (const auto& node : roots_) {
+    if (IsNeeded(node.get()) && node2dependencies_.count(node.get()) == 0) {
+      ready_queue.push(node);
+    }
+  }
+  while (!ready_queue.empty()) {
+    std::shared_ptr<FunctionNode> node = ready_queue.front();
+    ready_queue.pop();
+    // Backward ops are dispatched to the vm without waiting, so independent branches overlap there
+    const bool capture_only = capture_only_.count(node.get()) > 0;
+    if (capture_only || JUST(node->Apply(create_graph_))) {
+      if (save_grad_for_leaf) { JUST(node->AccGrad4LeafTensor(create_graph_)); }
+      JUST(node->AccGrad4RetainGradTensor());
+    }
+    node->ReleaseOutTensorArgs();
+    for (const auto& next_node : *node->GetNextFunctions()) {
+      if (!next_node) { continue; }
+      if (!IsNeeded(next_node.get())) {
+        // Grads pushed into pruned branches are never consumed
+        next_node->ReleaseOutTensorArgs();
+        continue;
+      }
+      int64_t* dependencies = &node2dependencies_.at(next_node.get());
+      *dependencies -= 1;
+      if (*dependencies == 0) { ready_queue.push(next_node); }
+    }
+    // Captured nodes did not run their backward, a later graph may still need it
+    if (!retain_graph_ && !capture_only) { node->ReleaseData(); }
+  }
+  return Maybe<void>::Ok();
+}
+
+Maybe<void> GraphAutogradEngine::RunBackwardAndSaveGrads4LeafTensor(const TensorTuple& outputs,
+                                                                    const TensorTuple& out_grads,
+                                                                    bool retain_graph,
+                                                                    bool create_graph) {
+  for (int i = 0; i < outputs.size(); ++i) {
+    JUST(outputs.at(i)->now_grad_arg()->PushPartialTensor(out_grads.at(i)));
+  }
+  GraphTask graph_task(outputs, retain_graph, create_graph);
+  JUST(graph_task.ComputeDependencies());
+  JUST(graph_task.Apply(/*save_grad_for_leaf=*/true));
+  return Maybe<void>::Ok();
+}
+
+Maybe<TensorTuple> GraphAutogradEngine::RunBackwardAndReturnInputsTensorGrad(
+    const TensorTuple& outputs, const TensorTuple& inputs, const TensorTuple& out_grads,
+    bool retain_graph, bool create_graph) {
+  std::shared_ptr<TensorTuple> input_now_grads = std::make_shared<TensorTuple>(inputs.size());
+  std::vector<bool> ori_retain_grad(inputs.size());
+  for (int i = 0; i < inputs.size(); ++i) {
+    ori_retain_grad.at(i) = inputs.at(i)->retain_grad();
+    inputs.at(i)->set_retain_grad(true);
+  }
+  for (int i = 0; i < outputs.size(); ++i) {
+    JUST(outputs.at(i)->now_grad_arg()->PushPartialTensor(out_grads.at(i)));
+  }
+  GraphTask graph_task(outputs, retain_graph, create_graph);
+  JUST(graph_task.ComputeDependenciesAndPruneNode(inputs));
+  JUST(graph_task.Apply(/*save_grad_for_leaf=*/false));
+  for (int i = 0; i < inputs.size(); ++i) {
+    input_now_grads->at(i) = inputs.at(i)->acc_grad();
+    if (!ori_retain_grad.at(i)) {
+      inputs.at(i)->mut_acc_grad().reset();
+      inputs.at(i)->set_retain_grad(false);
+    }
+  }
+  return input_now_grads;
+}
+
+std::shared_ptr<FunctionNode> GraphAutogradEngine::AddBackwardFuncPtr(
+    const std::string& op_type_name,
+    const std::shared_ptr<const std::function<Maybe<void>(const TensorTuple&, TensorTuple*, bool)>>&
+        backward_fn,
+    const TensorTuple& inputs, TensorTuple* outputs) {
+  // Leaf tensors get their accumulate node first so that it is in next_functions_
+  for (const std::shared_ptr<Tensor>& in_tensor : inputs) {
+    if (in_tensor->is_leaf() && in_tensor->requires_grad() && !in_tensor->grad_fn_node()) {
+      CHECK_JUST(AddAccumulateFunctionNode(in_tensor));
+    }
+  }
+  std::shared_ptr<GraphFunctionNode> func_node =
+      std::make_shared<GraphFunctionNode>(op_type_name, backward_fn, inputs, *outputs);
+  for (const std::shared_ptr<Tensor>& out_tensor : *outputs) {
+    out_tensor->set_grad_fn_node(func_node);
+  }
+  return func_node;
+}
+
+bool IsGraphAutogradEngineEnabled() {
+  static const bool enabled = []() {
+    const char* env_p = std::getenv("ONEFLOW_AUTOGRAD_ENGINE");
+    if (env_p == nullptr) { return false; }
+    const std::string engine(env_p);
+    CHECK(engine == "graph" || engine == "stack")
+        << "ONEFLOW_AUTOGRAD_ENGINE should be graph or stack, got " << engine;
+    return engine == "graph";
+  }();
+  return enabled;
+}
+
 AutogradEngine* GetThreadLocalAutogradEngine() {
+  if (IsGraphAutogradEngineEnabled()) {
+    thread_local static GraphAutogradEngine graph_autograd_engine;
+    return &graph_autograd_engine;
+  }
   thread_local static StackAutogradEngine autograd_engine;
   return &autograd_engine;
 }
@@ -242,8 +456,13 @@ Maybe<void> AddAccumulateFunctionNode(const std::shared_ptr<Tensor>& tensor) {
       std::make_shared<std::function<Maybe<void>(const TensorTuple&, TensorTuple*, bool)>>(
           [=](const TensorTuple& out_grads, TensorTuple* in_grads,
               bool create_graph) -> Maybe<void> { return Maybe<void>::Ok(); });
-  tensor->set_grad_fn_node(std::make_shared<StackFunctionNode>(
-      "accumulate_grad", backward_fn, TensorTuple(), TensorTuple({tensor})));
+  if (IsGraphAutogradEngineEnabled()) {
+    tensor->set_grad_fn_node(std::make_shared<GraphFunctionNode>(
+        "accumulate_grad", backward_fn, TensorTuple(), TensorTuple({tensor})));
+  } else {
+    tensor->set_grad_fn_node(std::make_shared<StackFunctionNode>(
+        "accumulate_grad", backward_fn, TensorTuple(), TensorTuple({tensor})));
+  }
   return Maybe<void>::Ok();
 }
 
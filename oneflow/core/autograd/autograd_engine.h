@@ -37,28 +37,36 @@ class FunctionNode {
  public:
   virtual ~FunctionNode() = default;
 
-  virtual Maybe<bool> Apply(bool create_graph) = 0;
-  virtual Maybe<void> AccGrad4LeafTensor(bool create_graph) = 0;
-  virtual Maybe<void> AccGrad4RetainGradTensor() = 0;
-  virtual void ReleaseOutTensorArgs() = 0;
+  Maybe<bool> Apply(bool create_graph);
+  Maybe<void> AccGrad4LeafTensor(bool create_graph);
+  Maybe<void> AccGrad4RetainGradTensor();
+  void ReleaseOutTensorArgs();
   // Releases the eventual c++ std::function for backward if retain_graph=False to avoid calling
   // `Apply` in second time
   virtual void ReleaseData() = 0;
 
   // Getters
-  const std::shared_ptr<std::vector<std::shared_ptr<const FunctionNode>>>& GetNextFunctions()
-      const {
+  const std::shared_ptr<std::vector<std::shared_ptr<FunctionNode>>>& GetNextFunctions() const {
     return next_functions_;
   }
   const std::string& GetOpTypeName() const { return op_name_; }
 
  protected:
-  explicit FunctionNode(const std::string& op_type_name)
-      : op_name_(op_type_name),
-        next_functions_(new std::vector<std::shared_ptr<const FunctionNode>>{}) {}
+  FunctionNode(
+      const std::string& op_type_name,
+      const std::shared_ptr<
+          const std::function<Maybe<void>(const TensorTuple&, TensorTuple*, bool)>>& backward_fn,
+      const TensorTuple& inputs, const TensorTuple& outputs);
 
   const std::string op_name_;
-  std::shared_ptr<std::vector<std::shared_ptr<const FunctionNode>>> next_functions_;
+  std::shared_ptr<std::vector<std::shared_ptr<FunctionNode>>> next_functions_;
+
+  std::vector<std::shared_ptr<AutogradMeta>> input_meta_datas_;
+  std::vector<std::shared_ptr<AutogradMeta>> output_meta_datas_;
+  std::vector<TensorInfo> output_tensor_infos_;
+  // Actual backward function builds in `AutogradInterpreter` to calculate one backward op
+  std::shared_ptr<const std::function<Maybe<void>(const TensorTuple&, TensorTuple*, bool)>>
+      backward_fn_;
 };
 
 class AutogradEngine {
@@ -97,21 +105,11 @@ class StackFunctionNode final : public FunctionNode {
   StackFunctionNode() = delete;
   ~StackFunctionNode() override = default;
 
-  Maybe<void> AccGrad4LeafTensor(bool create_graph) override;
-  Maybe<void> AccGrad4RetainGradTensor() override;
-  void ReleaseOutTensorArgs() override;
   void ReleaseData() override;
-  Maybe<bool> Apply(bool create_graph) override;
   bool is_in_stack() const { return is_in_stack_; }
   void set_is_in_stack(bool in_stack) { is_in_stack_ = in_stack; }
 
  private:
-  std::vector<std::shared_ptr<AutogradMeta>> input_meta_datas_;
-  std::vector<std::shared_ptr<AutogradMeta>> output_meta_datas_;
-  std::vector<TensorInfo> output_tensor_infos_;
-  // Actual backward function builds in `AutogradInterpreter` to calculate one backward op
-  std::shared_ptr<const std::function<Maybe<void>(const TensorTuple&, TensorTuple*, bool)>>
-      backward_fn_;
   bool is_in_stack_;
 };
 
@@ -143,6 +141,73 @@ class StackAutogradEngine final : public AutogradEngine {
   void ClearReleasedFunctionNodes();
 };
 
+// Graph Autograd Node and Engine
+class GraphFunctionNode final : public FunctionNode {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(GraphFunctionNode);
+  GraphFunctionNode(
+      const std::string& op_type_name,
+      const std::shared_ptr<
+          const std::function<Maybe<void>(const TensorTuple&, TensorTuple*, bool)>>& backward_fn,
+      const TensorTuple& inputs, const TensorTuple& outputs);
+  GraphFunctionNode() = delete;
+  ~GraphFunctionNode() override = default;
+
+  void ReleaseData() override;
+};
+
+// Runs the nodes reachable from the outputs in topological order. Each node runs once all the
+// nodes consuming its outputs have, and its grads and, unless the graph is retained, its saved
+// tensors are released right after.
+class GraphTask final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(GraphTask);
+  GraphTask(const TensorTuple& outputs, bool retain_graph, bool create_graph);
+  ~GraphTask() = default;
+
+  Maybe<void> ComputeDependencies();
+  // Only the nodes leading to the grad_fn_node of some input are run
+  Maybe<void> ComputeDependenciesAndPruneNode(const TensorTuple& inputs);
+  Maybe<void> Apply(bool save_grad_for_leaf);
+
+ private:
+  bool retain_graph_;
+  bool create_graph_;
+  std::vector<std::shared_ptr<FunctionNode>> roots_;
+  HashMap<FunctionNode*, int64_t> node2dependencies_;
+  // Only the nodes in need_execute_ are run when pruned
+  bool pruned_;
+  HashSet<FunctionNode*> need_execute_;
+  // Nodes whose output grads are wanted but whose backward is not
+  HashSet<FunctionNode*> capture_only_;
+};
+
+class GraphAutogradEngine final : public AutogradEngine {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(GraphAutogradEngine);
+  GraphAutogradEngine() = default;
+  ~GraphAutogradEngine() override = default;
+
+  Maybe<void> RunBackwardAndSaveGrads4LeafTensor(const TensorTuple& outputs,
+                                                 const TensorTuple& out_grads, bool retain_graph,
+                                                 bool create_graph) override;
+  Maybe<TensorTuple> RunBackwardAndReturnInputsTensorGrad(const TensorTuple& outputs,
+                                                          const TensorTuple& inputs,
+                                                          const TensorTuple& out_grads,
+                                                          bool retain_graph,
+                                                          bool create_graph) override;
+  // Nodes are owned by their tensors, there is nothing to clear
+  void ClearEngine() override {}
+  std::shared_ptr<FunctionNode> AddBackwardFuncPtr(
+      const std::string& op_type_name,
+      const std::shared_ptr<
+          const std::function<Maybe<void>(const TensorTuple&, TensorTuple*, bool)>>& backward_fn,
+      const TensorTuple& inputs, TensorTuple* outputs) override;
+};
+
+// ONEFLOW_AUTOGRAD_ENGINE, "stack" by default or "graph"
+bool IsGraphAutogradEngineEnabled();
+
 AutogradEngine* GetThreadLocalAutogradEngine();
 
 Maybe<void> AddAccumulateFunctionNode(const std::shared_ptr<Tensor>& tensor);
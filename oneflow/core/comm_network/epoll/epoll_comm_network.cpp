@@ -100,7 +100,7 @@ void EpollCommNet::SendActorMsg(int64_t dst_machine_id, const ActorMsg& actor_ms
   SocketMsg msg;
   msg.msg_type = SocketMsgType::kActor;
   msg.actor_msg = actor_msg;
-  GetSocketHelper(dst_machine_id)->AsyncWrite(msg);
+  GetSocketHelper(dst_machine_id, 0)->AsyncWrite(msg);
 }
 
 void EpollCommNet::SendTransportMsg(int64_t dst_machine_id, const TransportMsg& transport_msg) {
@@ -111,7 +111,15 @@ void EpollCommNet::SendTransportMsg(int64_t dst_machine_id, const TransportMsg&
 }
 
 void EpollCommNet::SendSocketMsg(int64_t dst_machine_id, const SocketMsg& msg) {
-  GetSocketHelper(dst_machine_id)->AsyncWrite(msg);
+  int32_t conn_id = 0;
+  if (msg.msg_type == SocketMsgType::kRequestRead) {
+    conn_id = msg.request_read_msg.stripe.conn_id;
+  }
+  GetSocketHelper(dst_machine_id, conn_id)->AsyncWrite(msg);
+}
+
+void EpollCommNet::ReadStripeDone(void* read_id, const SocketReadStripe& stripe) {
+  if (SocketReadStripeDone(stripe)) { ReadDone(read_id); }
 }
 
 SocketMemDesc* EpollCommNet::NewMemDesc(void* ptr, size_t byte_size) {
@@ -121,8 +129,14 @@ SocketMemDesc* EpollCommNet::NewMemDesc(void* ptr, size_t byte_size) {
   return mem_desc;
 }
 
-EpollCommNet::EpollCommNet() : CommNetIf() {
-  pollers_.resize(Global<ResourceDesc, ForSession>::Get()->CommNetWorkerNum(), nullptr);
+EpollCommNet::EpollCommNet() : CommNetIf(), next_data_conn_(0) {
+  conn_num_ = Global<ResourceDesc, ForSession>::Get()->epoll_conn_num_per_peer();
+  CHECK_GE(conn_num_, 1);
+  stripe_min_size_ = Global<ResourceDesc, ForSession>::Get()->epoll_stripe_min_byte();
+  // Enough pollers for the connections of a peer to be served by different threads
+  pollers_.resize(std::max<size_t>(Global<ResourceDesc, ForSession>::Get()->CommNetWorkerNum(),
+                                   conn_num_),
+                  nullptr);
   for (size_t i = 0; i < pollers_.size(); ++i) { pollers_[i] = new IOEventPoller; }
   InitSockets();
   for (IOEventPoller* poller : pollers_) { poller->Start(); }
@@ -132,13 +146,13 @@ void EpollCommNet::InitSockets() {
   int64_t this_machine_id = GlobalProcessCtx::Rank();
   auto this_machine = Global<ResourceDesc, ForSession>::Get()->machine(this_machine_id);
   int64_t total_machine_num = Global<ResourceDesc, ForSession>::Get()->process_ranks().size();
-  machine_id2sockfd_.assign(total_machine_num, -1);
+  machine_id2sockfds_.assign(total_machine_num, std::vector<int>(conn_num_, -1));
   sockfd2helper_.clear();
-  size_t poller_idx = 0;
-  auto NewSocketHelper = [&](int sockfd) {
-    IOEventPoller* poller = pollers_[poller_idx];
-    poller_idx = (poller_idx + 1) % pollers_.size();
-    return new SocketHelper(sockfd, poller);
+  const size_t zero_copy_min_size =
+      Global<ResourceDesc, ForSession>::Get()->epoll_zero_copy_min_byte();
+  auto NewSocketHelper = [&](int64_t peer_id, int32_t conn_id, int sockfd) {
+    IOEventPoller* poller = pollers_[(peer_id * conn_num_ + conn_id) % pollers_.size()];
+    return new SocketHelper(sockfd, poller, zero_copy_min_size);
   };
 
   // listen
@@ -151,7 +165,7 @@ void EpollCommNet::InitSockets() {
       this_listen_port = Global<EnvDesc>::Get()->data_port();
     }
   }
-  CHECK_EQ(SockListen(listen_sockfd, &this_listen_port, total_machine_num), 0);
+  CHECK_EQ(SockListen(listen_sockfd, &this_listen_port, total_machine_num * conn_num_), 0);
   CHECK_NE(this_listen_port, 0);
   PushPort(this_machine_id, this_listen_port);
   int32_t src_machine_count = 0;
@@ -165,53 +179,67 @@ void EpollCommNet::InitSockets() {
     uint16_t peer_port = PullPort(peer_id);
     auto peer_machine = Global<ResourceDesc, ForSession>::Get()->machine(peer_id);
     sockaddr_in peer_sockaddr = GetSockAddr(peer_machine.addr(), peer_port);
-    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    const int val = 1;
-    PCHECK(setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, (char*)&val, sizeof(int)) == 0);
-    PCHECK(connect(sockfd, reinterpret_cast<sockaddr*>(&peer_sockaddr), sizeof(peer_sockaddr))
-           == 0);
-    ssize_t n = write(sockfd, &this_machine_id, sizeof(int64_t));
-    PCHECK(n == sizeof(int64_t));
-    CHECK(sockfd2helper_.emplace(sockfd, NewSocketHelper(sockfd)).second);
-    machine_id2sockfd_[peer_id] = sockfd;
+    FOR_RANGE(int32_t, conn_id, 0, conn_num_) {
+      int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+      const int val = 1;
+      PCHECK(setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, (char*)&val, sizeof(int)) == 0);
+      PCHECK(connect(sockfd, reinterpret_cast<sockaddr*>(&peer_sockaddr), sizeof(peer_sockaddr))
+             == 0);
+      const int64_t conn_header[2] = {this_machine_id, conn_id};
+      ssize_t n = write(sockfd, conn_header, sizeof(conn_header));
+      PCHECK(n == sizeof(conn_header));
+      CHECK(sockfd2helper_.emplace(sockfd, NewSocketHelper(peer_id, conn_id, sockfd)).second);
+      machine_id2sockfds_[peer_id][conn_id] = sockfd;
+    }
   }
 
   // accept
-  HashSet<int64_t> processed_ranks;
-  FOR_RANGE(int32_t, idx, 0, src_machine_count) {
+  FOR_RANGE(int32_t, idx, 0, src_machine_count * conn_num_) {
     sockaddr_in peer_sockaddr;
     socklen_t len = sizeof(peer_sockaddr);
     int sockfd = accept(listen_sockfd, reinterpret_cast<sockaddr*>(&peer_sockaddr), &len);
     PCHECK(sockfd != -1);
-    int64_t peer_rank;
-    ssize_t n = read(sockfd, &peer_rank, sizeof(int64_t));
-    PCHECK(n == sizeof(int64_t));
-    CHECK(sockfd2helper_.emplace(sockfd, NewSocketHelper(sockfd)).second);
-    CHECK(processed_ranks.emplace(peer_rank).second);
-    machine_id2sockfd_[peer_rank] = sockfd;
+    int64_t conn_header[2];
+    ssize_t n = read(sockfd, conn_header, sizeof(conn_header));
+    PCHECK(n == sizeof(conn_header));
+    const int64_t peer_rank = conn_header[0];
+    const int32_t conn_id = conn_header[1];
+    CHECK(sockfd2helper_.emplace(sockfd, NewSocketHelper(peer_rank, conn_id, sockfd)).second);
+    CHECK_EQ(machine_id2sockfds_.at(peer_rank).at(conn_id), -1);
+    machine_id2sockfds_[peer_rank][conn_id] = sockfd;
   }
   PCHECK(close(listen_sockfd) == 0);
   ClearPort(this_machine_id);
 
   // useful log
   FOR_RANGE(int64_t, machine_id, 0, total_machine_num) {
-    LOG(INFO) << "machine " << machine_id << " sockfd " << machine_id2sockfd_[machine_id];
+    std::string sockfds;
+    for (int sockfd : machine_id2sockfds_[machine_id]) {
+      sockfds += (sockfds.empty() ? "" : ",") + std::to_string(sockfd);
+    }
+    LOG(INFO) << "machine " << machine_id << " sockfd " << sockfds;
   }
 }
 
-SocketHelper* EpollCommNet::GetSocketHelper(int64_t machine_id) {
-  int sockfd = machine_id2sockfd_.at(machine_id);
+SocketHelper* EpollCommNet::GetSocketHelper(int64_t machine_id, int32_t conn_id) {
+  int sockfd = machine_id2sockfds_.at(machine_id).at(conn_id);
   return sockfd2helper_.at(sockfd);
 }
 
 void EpollCommNet::DoRead(void* read_id, int64_t src_machine_id, void* src_token, void* dst_token) {
-  SocketMsg msg;
-  msg.msg_type = SocketMsgType::kRequestWrite;
-  msg.request_write_msg.src_token = src_token;
-  msg.request_write_msg.dst_machine_id = GlobalProcessCtx::Rank();
-  msg.request_write_msg.dst_token = dst_token;
-  msg.request_write_msg.read_id = read_id;
-  GetSocketHelper(src_machine_id)->AsyncWrite(msg);
+  const int64_t byte_size = static_cast<const SocketMemDesc*>(dst_token)->byte_size;
+  const int64_t first_conn = next_data_conn_.fetch_add(1, std::memory_order_relaxed);
+  for (const SocketReadStripe& stripe :
+       SplitSocketRead(byte_size, stripe_min_size_, conn_num_, first_conn)) {
+    SocketMsg msg;
+    msg.msg_type = SocketMsgType::kRequestWrite;
+    msg.request_write_msg.src_token = src_token;
+    msg.request_write_msg.dst_machine_id = GlobalProcessCtx::Rank();
+    msg.request_write_msg.dst_token = dst_token;
+    msg.request_write_msg.read_id = read_id;
+    msg.request_write_msg.stripe = stripe;
+    GetSocketHelper(src_machine_id, 0)->AsyncWrite(msg);
+  }
 }
 
 }  // namespace oneflow
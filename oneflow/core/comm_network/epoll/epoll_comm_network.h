@@ -34,6 +34,7 @@ class EpollCommNet final : public CommNetIf<SocketMemDesc> {
   void SendActorMsg(int64_t dst_machine_id, const ActorMsg& msg) override;
   void SendSocketMsg(int64_t dst_machine_id, const SocketMsg& msg);
   void SendTransportMsg(int64_t dst_machine_id, const TransportMsg& msg);
+  void ReadStripeDone(void* read_id, const SocketReadStripe& stripe);
 
  private:
   SocketMemDesc* NewMemDesc(void* ptr, size_t byte_size) override;
@@ -41,11 +42,16 @@ class EpollCommNet final : public CommNetIf<SocketMemDesc> {
   friend class Global<EpollCommNet>;
   EpollCommNet();
   void InitSockets();
-  SocketHelper* GetSocketHelper(int64_t machine_id);
+  SocketHelper* GetSocketHelper(int64_t machine_id, int32_t conn_id);
   void DoRead(void* read_id, int64_t src_machine_id, void* src_token, void* dst_token) override;
 
   std::vector<IOEventPoller*> pollers_;
-  std::vector<int> machine_id2sockfd_;
+  // With more than one connection per peer, the first one carries the control messages and the
+  // others the bodies of reads, so that actor messages never wait behind bulk transfers
+  int32_t conn_num_;
+  int64_t stripe_min_size_;
+  std::atomic<int64_t> next_data_conn_;
+  std::vector<std::vector<int>> machine_id2sockfds_;
   HashMap<int, SocketHelper*> sockfd2helper_;
 };
 
@@ -29,6 +29,9 @@ class IOEventPoller final {
   ~IOEventPoller();
 
   void AddFd(int fd, std::function<void()> read_handler, std::function<void()> write_handler);
+  // error_handler is called on EPOLLERR, e.g. when the error queue of a socket is readable
+  void AddFd(int fd, std::function<void()> read_handler, std::function<void()> write_handler,
+             std::function<void()> error_handler);
   void AddFdWithOnlyReadHandler(int fd, std::function<void()> read_handler);
 
   void Start();
@@ -43,10 +46,12 @@ class IOEventPoller final {
     }
     std::function<void()> read_handler;
     std::function<void()> write_handler;
+    std::function<void()> error_handler;
     int fd;
   };
 
-  void AddFd(int fd, std::function<void()>* read_handler, std::function<void()>* write_handler);
+  void AddFd(int fd, std::function<void()>* read_handler, std::function<void()>* write_handler,
+             std::function<void()>* error_handler);
 
   void EpollLoop();
   static const int max_event_num_;
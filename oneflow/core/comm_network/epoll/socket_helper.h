@@ -30,7 +30,7 @@ class SocketHelper final {
   SocketHelper() = delete;
   ~SocketHelper();
 
-  SocketHelper(int sockfd, IOEventPoller* poller);
+  SocketHelper(int sockfd, IOEventPoller* poller, size_t zero_copy_min_size);
 
   void AsyncWrite(const SocketMsg& msg);
 
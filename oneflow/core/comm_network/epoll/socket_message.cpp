@@ -0,0 +1,54 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/comm_network/epoll/socket_message.h"
+#include "oneflow/core/common/balanced_splitter.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+namespace oneflow {
+
+std::vector<SocketReadStripe> SplitSocketRead(int64_t byte_size, int64_t stripe_min_size,
+                                              int32_t conn_num, int64_t first_conn) {
+  // With more than one connection, the first one is left to the control messages
+  const int32_t data_conn_begin = conn_num > 1 ? 1 : 0;
+  const int32_t data_conn_num = conn_num - data_conn_begin;
+  int32_t stripe_num = 1;
+  if (byte_size >= stripe_min_size && byte_size >= data_conn_num) { stripe_num = data_conn_num; }
+  std::atomic<int64_t>* pending_stripe_num = nullptr;
+  if (stripe_num > 1) { pending_stripe_num = new std::atomic<int64_t>(stripe_num); }
+  BalancedSplitter bs(byte_size, stripe_num);
+  std::vector<SocketReadStripe> stripes(stripe_num);
+  FOR_RANGE(int32_t, stripe_id, 0, stripe_num) {
+    SocketReadStripe* stripe = &stripes.at(stripe_id);
+    stripe->offset = bs.At(stripe_id).begin();
+    stripe->byte_size = bs.At(stripe_id).size();
+    stripe->conn_id = data_conn_begin + (first_conn + stripe_id) % data_conn_num;
+    stripe->pending_stripe_num = pending_stripe_num;
+  }
+  return stripes;
+}
+
+bool SocketReadStripeDone(const SocketReadStripe& stripe) {
+  if (stripe.pending_stripe_num != nullptr) {
+    if (stripe.pending_stripe_num->fetch_sub(1) > 1) { return false; }
+    delete stripe.pending_stripe_num;
+  }
+  return true;
+}
+
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
@@ -47,17 +47,28 @@ enum class SocketMsgType {
 #undef MAKE_ENTRY
 };
 
+// A part of a read, the reads of large registers are striped over several connections
+struct SocketReadStripe {
+  int64_t offset;
+  int64_t byte_size;
+  int32_t conn_id;
+  // Stripes of the read not done yet, nullptr when the read is a single stripe
+  std::atomic<int64_t>* pending_stripe_num;
+};
+
 struct RequestWriteMsg {
   void* src_token;
   int64_t dst_machine_id;
   void* dst_token;
   void* read_id;
+  SocketReadStripe stripe;
 };
 
 struct RequestReadMsg {
   void* src_token;
   void* dst_token;
   void* read_id;
+  SocketReadStripe stripe;
 };
 
 struct SocketMsg {
@@ -69,6 +80,14 @@ struct SocketMsg {
   };
 };
 
+// Splits a read of byte_size bytes into one stripe per data connection when it is at least
+// stripe_min_size, the data connections of a stripe are taken round robin from first_conn
+std::vector<SocketReadStripe> SplitSocketRead(int64_t byte_size, int64_t stripe_min_size,
+                                              int32_t conn_num, int64_t first_conn);
+
+// Returns whether stripe is the last one of its read to arrive, i.e. the whole read is done
+bool SocketReadStripeDone(const SocketReadStripe& stripe);
+
 using CallBackList = std::list<std::function<void()>>;
 
 }  // namespace oneflow
@@ -21,15 +21,25 @@ limitations under the License.
 #include "oneflow/core/transport/transport.h"
 
 #include <netinet/tcp.h>
+#include <sys/uio.h>
 
 namespace oneflow {
 
+namespace {
+
+const size_t kReadBufSize = 64 * 1024;
+
+}  // namespace
+
 SocketReadHelper::~SocketReadHelper() {
   // do nothing
 }
 
 SocketReadHelper::SocketReadHelper(int sockfd) {
   sockfd_ = sockfd;
+  read_buf_.resize(kReadBufSize);
+  read_buf_begin_ = 0;
+  read_buf_end_ = 0;
   SwitchToMsgHeadReadHandle();
 }
 
@@ -54,21 +64,42 @@ bool SocketReadHelper::MsgBodyReadHandle() {
 }
 
 bool SocketReadHelper::DoCurRead(void (SocketReadHelper::*set_cur_read_done)()) {
-  ssize_t n = read(sockfd_, read_ptr_, read_size_);
+  if (read_buf_begin_ < read_buf_end_) {
+    size_t n = std::min(read_size_, read_buf_end_ - read_buf_begin_);
+    std::memcpy(read_ptr_, read_buf_.data() + read_buf_begin_, n);
+    read_buf_begin_ += n;
+    if (n == read_size_) {
+      (this->*set_cur_read_done)();
+    } else {
+      read_ptr_ += n;
+      read_size_ -= n;
+    }
+    return true;
+  }
+  // Reads the rest of the current part in place, and what follows it ahead into read_buf_, so
+  // that a run of small messages is read by one syscall
+  iovec iov[2];
+  iov[0].iov_base = read_ptr_;
+  iov[0].iov_len = read_size_;
+  iov[1].iov_base = read_buf_.data();
+  iov[1].iov_len = read_buf_.size();
+  ssize_t n = readv(sockfd_, iov, 2);
   const int val = 1;
   PCHECK(setsockopt(sockfd_, IPPROTO_TCP, TCP_QUICKACK, (char*)&val, sizeof(int)) == 0);
-  if (n == read_size_) {
+  if (n == -1) {
+    PCHECK(errno == EAGAIN || errno == EWOULDBLOCK);
+    return false;
+  }
+  CHECK_GE(n, 0);
+  if (static_cast<size_t>(n) >= read_size_) {
+    read_buf_begin_ = 0;
+    read_buf_end_ = n - read_size_;
     (this->*set_cur_read_done)();
-    return true;
-  } else if (n >= 0) {
+  } else {
     read_ptr_ += n;
     read_size_ -= n;
-    return true;
-  } else {
-    CHECK_EQ(n, -1);
-    PCHECK(errno == EAGAIN || errno == EWOULDBLOCK);
-    return false;
   }
+  return true;
 }
 
 void SocketReadHelper::SetStatusWhenMsgHeadDone() {
@@ -83,7 +114,8 @@ void SocketReadHelper::SetStatusWhenMsgHeadDone() {
 
 void SocketReadHelper::SetStatusWhenMsgBodyDone() {
   if (cur_msg_.msg_type == SocketMsgType::kRequestRead) {
-    Global<EpollCommNet>::Get()->ReadDone(cur_msg_.request_read_msg.read_id);
+    Global<EpollCommNet>::Get()->ReadStripeDone(cur_msg_.request_read_msg.read_id,
+                                                cur_msg_.request_read_msg.stripe);
   }
   SwitchToMsgHeadReadHandle();
 }
@@ -94,6 +126,7 @@ void SocketReadHelper::SetStatusWhenRequestWriteMsgHeadDone() {
   msg_to_send.request_read_msg.src_token = cur_msg_.request_write_msg.src_token;
   msg_to_send.request_read_msg.dst_token = cur_msg_.request_write_msg.dst_token;
   msg_to_send.request_read_msg.read_id = cur_msg_.request_write_msg.read_id;
+  msg_to_send.request_read_msg.stripe = cur_msg_.request_write_msg.stripe;
   Global<EpollCommNet>::Get()->SendSocketMsg(cur_msg_.request_write_msg.dst_machine_id,
                                              msg_to_send);
   SwitchToMsgHeadReadHandle();
@@ -101,8 +134,10 @@ void SocketReadHelper::SetStatusWhenRequestWriteMsgHeadDone() {
 
 void SocketReadHelper::SetStatusWhenRequestReadMsgHeadDone() {
   auto mem_desc = static_cast<const SocketMemDesc*>(cur_msg_.request_read_msg.dst_token);
-  read_ptr_ = reinterpret_cast<char*>(mem_desc->mem_ptr);
-  read_size_ = mem_desc->byte_size;
+  const SocketReadStripe& stripe = cur_msg_.request_read_msg.stripe;
+  CHECK_LE(static_cast<size_t>(stripe.offset + stripe.byte_size), mem_desc->byte_size);
+  read_ptr_ = reinterpret_cast<char*>(mem_desc->mem_ptr) + stripe.offset;
+  read_size_ = stripe.byte_size;
   cur_read_handle_ = &SocketReadHelper::MsgBodyReadHandle;
 }
 
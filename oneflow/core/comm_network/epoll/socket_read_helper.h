@@ -53,6 +53,11 @@ class SocketReadHelper final {
   bool (SocketReadHelper::*cur_read_handle_)();
   char* read_ptr_;
   size_t read_size_;
+
+  // Bytes read ahead of the current part, in [read_buf_begin_, read_buf_end_)
+  std::vector<char> read_buf_;
+  size_t read_buf_begin_;
+  size_t read_buf_end_;
 };
 
 }  // namespace oneflow
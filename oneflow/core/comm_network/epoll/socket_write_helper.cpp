@@ -18,10 +18,18 @@ limitations under the License.
 #include "oneflow/core/comm_network/epoll/socket_write_helper.h"
 #include "oneflow/core/comm_network/epoll/socket_memory_desc.h"
 
+#include <limits.h>
+#include <linux/errqueue.h>
 #include <sys/eventfd.h>
 
 namespace oneflow {
 
+namespace {
+
+const size_t kMaxBatchMsgNum = 256;
+
+}  // namespace
+
 SocketWriteHelper::~SocketWriteHelper() {
   delete cur_msg_queue_;
   cur_msg_queue_ = nullptr;
@@ -32,7 +40,8 @@ SocketWriteHelper::~SocketWriteHelper() {
   }
 }
 
-SocketWriteHelper::SocketWriteHelper(int sockfd, IOEventPoller* poller) {
+SocketWriteHelper::SocketWriteHelper(int sockfd, IOEventPoller* poller,
+                                     size_t zero_copy_min_size) {
   sockfd_ = sockfd;
   queue_not_empty_fd_ = eventfd(0, 0);
   PCHECK(queue_not_empty_fd_ != -1);
@@ -40,9 +49,22 @@ SocketWriteHelper::SocketWriteHelper(int sockfd, IOEventPoller* poller) {
                                    std::bind(&SocketWriteHelper::ProcessQueueNotEmptyEvent, this));
   cur_msg_queue_ = new std::queue<SocketMsg>;
   pending_msg_queue_ = new std::queue<SocketMsg>;
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
-  write_ptr_ = nullptr;
-  write_size_ = 0;
+  batch_msgs_.reserve(kMaxBatchMsgNum);
+  batch_iovs_.reserve(2 * kMaxBatchMsgNum);
+  batch_iov_idx_ = 0;
+  zero_copy_min_size_ = zero_copy_min_size;
+  if (zero_copy_min_size_ > 0) {
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+    const int val = 1;
+    if (setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY, &val, sizeof(val)) != 0) {
+      PLOG(WARNING) << "MSG_ZEROCOPY is not supported, fall back to copy";
+      zero_copy_min_size_ = 0;
+    }
+#else
+    LOG(WARNING) << "MSG_ZEROCOPY is not supported, fall back to copy";
+    zero_copy_min_size_ = 0;
+#endif
+  }
 }
 
 void SocketWriteHelper::AsyncWrite(const SocketMsg& msg) {
@@ -55,6 +77,34 @@ void SocketWriteHelper::AsyncWrite(const SocketMsg& msg) {
 
 void SocketWriteHelper::NotifyMeSocketWriteable() { WriteUntilMsgQueueEmptyOrSocketNotWriteable(); }
 
+void SocketWriteHelper::NotifyMeSocketError() {
+  int error = 0;
+  socklen_t len = sizeof(error);
+  PCHECK(getsockopt(sockfd_, SOL_SOCKET, SO_ERROR, &error, &len) == 0);
+  CHECK_EQ(error, 0) << "socket " << sockfd_ << " error: " << strerror(error);
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+  // Drain the completion notifications of MSG_ZEROCOPY. The bodies are register memory that the
+  // sender only reuses after the receiver has acked them, so the notifications are not waited on.
+  while (true) {
+    char control[CMSG_SPACE(sizeof(sock_extended_err))];
+    msghdr hdr{};
+    hdr.msg_control = control;
+    hdr.msg_controllen = sizeof(control);
+    if (recvmsg(sockfd_, &hdr, MSG_ERRQUEUE) == -1) {
+      PCHECK(errno == EAGAIN || errno == EWOULDBLOCK);
+      break;
+    }
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+      auto serr = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(cmsg));
+      if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) { continue; }
+      CHECK_EQ(serr->ee_errno, 0);
+      // The kernel copied the data anyway, e.g. on loopback, so zero copy only costs more here
+      if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) { zero_copy_min_size_ = 0; }
+    }
+  }
+#endif
+}
+
 void SocketWriteHelper::SendQueueNotEmptyEvent() {
   uint64_t event_num = 1;
   PCHECK(write(queue_not_empty_fd_, &event_num, 8) == 8);
@@ -67,10 +117,12 @@ void SocketWriteHelper::ProcessQueueNotEmptyEvent() {
 }
 
 void SocketWriteHelper::WriteUntilMsgQueueEmptyOrSocketNotWriteable() {
-  while ((this->*cur_write_handle_)()) {}
+  while (batch_iov_idx_ < batch_iovs_.size() || InitBatch()) {
+    if (!WriteBatch()) { return; }
+  }
 }
 
-bool SocketWriteHelper::InitMsgWriteHandle() {
+bool SocketWriteHelper::InitBatch() {
   if (cur_msg_queue_->empty()) {
     {
       std::unique_lock<std::mutex> lck(pending_msg_queue_mtx_);
@@ -78,70 +130,89 @@ bool SocketWriteHelper::InitMsgWriteHandle() {
     }
     if (cur_msg_queue_->empty()) { return false; }
   }
-  cur_msg_ = cur_msg_queue_->front();
-  cur_msg_queue_->pop();
-  write_ptr_ = reinterpret_cast<const char*>(&cur_msg_);
-  write_size_ = sizeof(cur_msg_);
-  cur_write_handle_ = &SocketWriteHelper::MsgHeadWriteHandle;
+  batch_msgs_.clear();
+  batch_iovs_.clear();
+  batch_iov_zero_copy_.clear();
+  batch_iov_idx_ = 0;
+  while (!cur_msg_queue_->empty() && batch_msgs_.size() < kMaxBatchMsgNum) {
+    AppendMsgToBatch(cur_msg_queue_->front());
+    cur_msg_queue_->pop();
+  }
   return true;
 }
 
-bool SocketWriteHelper::MsgHeadWriteHandle() {
-  return DoCurWrite(&SocketWriteHelper::SetStatusWhenMsgHeadDone);
-}
-
-bool SocketWriteHelper::MsgBodyWriteHandle() {
-  return DoCurWrite(&SocketWriteHelper::SetStatusWhenMsgBodyDone);
-}
-
-bool SocketWriteHelper::DoCurWrite(void (SocketWriteHelper::*set_cur_write_done)()) {
-  ssize_t n = write(sockfd_, write_ptr_, write_size_);
-  if (n == write_size_) {
-    (this->*set_cur_write_done)();
-    return true;
-  } else if (n >= 0) {
-    write_ptr_ += n;
-    write_size_ -= n;
-    return true;
-  } else {
-    CHECK_EQ(n, -1);
+bool SocketWriteHelper::WriteBatch() {
+  // A zero copy body goes alone, since the pages of the heads are reused by the next batch
+  const size_t iov_begin = batch_iov_idx_;
+  size_t iov_end = iov_begin + 1;
+  int flags = 0;
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+  if (batch_iov_zero_copy_.at(iov_begin) && zero_copy_min_size_ > 0) { flags |= MSG_ZEROCOPY; }
+#endif
+  if (flags == 0) {
+    while (iov_end < batch_iovs_.size() && iov_end - iov_begin < IOV_MAX
+           && !batch_iov_zero_copy_.at(iov_end)) {
+      iov_end += 1;
+    }
+  }
+  msghdr hdr{};
+  hdr.msg_iov = batch_iovs_.data() + iov_begin;
+  hdr.msg_iovlen = iov_end - iov_begin;
+  ssize_t n = sendmsg(sockfd_, &hdr, flags);
+  if (n == -1 && errno == ENOBUFS && flags != 0) {
+    // Out of the optmem to pin pages, send this one by copy
+    n = sendmsg(sockfd_, &hdr, 0);
+  }
+  if (n == -1) {
     PCHECK(errno == EAGAIN || errno == EWOULDBLOCK);
     return false;
   }
+  size_t remain = n;
+  while (batch_iov_idx_ < iov_end && remain >= batch_iovs_.at(batch_iov_idx_).iov_len) {
+    remain -= batch_iovs_.at(batch_iov_idx_).iov_len;
+    batch_iov_idx_ += 1;
+  }
+  if (remain > 0) {
+    iovec* iov = &batch_iovs_.at(batch_iov_idx_);
+    iov->iov_base = static_cast<char*>(iov->iov_base) + remain;
+    iov->iov_len -= remain;
+  }
+  return true;
 }
 
-void SocketWriteHelper::SetStatusWhenMsgHeadDone() {
-  switch (cur_msg_.msg_type) {
+void SocketWriteHelper::AppendMsgToBatch(const SocketMsg& msg) {
+  batch_msgs_.push_back(msg);
+  batch_iovs_.push_back(iovec{&batch_msgs_.back(), sizeof(SocketMsg)});
+  batch_iov_zero_copy_.push_back(false);
+  switch (msg.msg_type) {
 #define MAKE_ENTRY(x, y) \
-  case SocketMsgType::k##x: return SetStatusWhen##x##MsgHeadDone();
+  case SocketMsgType::k##x: return Append##x##MsgBodyToBatch(msg);
     OF_PP_FOR_EACH_TUPLE(MAKE_ENTRY, SOCKET_MSG_TYPE_SEQ);
 #undef MAKE_ENTRY
     default: UNIMPLEMENTED();
   }
 }
 
-void SocketWriteHelper::SetStatusWhenMsgBodyDone() {
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
-}
-
-void SocketWriteHelper::SetStatusWhenRequestWriteMsgHeadDone() {
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
+void SocketWriteHelper::AppendRequestWriteMsgBodyToBatch(const SocketMsg& msg) {
+  // no body
 }
 
-void SocketWriteHelper::SetStatusWhenRequestReadMsgHeadDone() {
-  const void* src_token = cur_msg_.request_read_msg.src_token;
-  auto src_mem_desc = static_cast<const SocketMemDesc*>(src_token);
-  write_ptr_ = reinterpret_cast<const char*>(src_mem_desc->mem_ptr);
-  write_size_ = src_mem_desc->byte_size;
-  cur_write_handle_ = &SocketWriteHelper::MsgBodyWriteHandle;
+void SocketWriteHelper::AppendRequestReadMsgBodyToBatch(const SocketMsg& msg) {
+  auto src_mem_desc = static_cast<const SocketMemDesc*>(msg.request_read_msg.src_token);
+  const SocketReadStripe& stripe = msg.request_read_msg.stripe;
+  CHECK_LE(static_cast<size_t>(stripe.offset + stripe.byte_size), src_mem_desc->byte_size);
+  const size_t byte_size = stripe.byte_size;
+  char* body_ptr = static_cast<char*>(src_mem_desc->mem_ptr) + stripe.offset;
+  batch_iovs_.push_back(iovec{body_ptr, byte_size});
+  batch_iov_zero_copy_.push_back(zero_copy_min_size_ > 0 && byte_size >= zero_copy_min_size_);
 }
 
-void SocketWriteHelper::SetStatusWhenActorMsgHeadDone() {
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
+void SocketWriteHelper::AppendActorMsgBodyToBatch(const SocketMsg& msg) {
+  // no body
 }
 
-void SocketWriteHelper::SetStatusWhenTransportMsgHeadDone() {
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
+void SocketWriteHelper::AppendTransportMsgBodyToBatch(const SocketMsg& msg) {
+  // no body
 }
 
 }  // namespace oneflow
@@ -21,34 +21,36 @@ limitations under the License.
 
 #ifdef OF_PLATFORM_POSIX
 
+#include <sys/uio.h>
+
 namespace oneflow {
 
+// Coalesces the queued messages into batches, and writes the heads and bodies of a batch with as
+// few sendmsg as the socket allows. Bodies of at least zero_copy_min_size bytes are sent with
+// MSG_ZEROCOPY when it is supported, zero_copy_min_size 0 disables it.
 class SocketWriteHelper final {
  public:
   OF_DISALLOW_COPY_AND_MOVE(SocketWriteHelper);
   SocketWriteHelper() = delete;
   ~SocketWriteHelper();
 
-  SocketWriteHelper(int sockfd, IOEventPoller* poller);
+  SocketWriteHelper(int sockfd, IOEventPoller* poller, size_t zero_copy_min_size);
 
   void AsyncWrite(const SocketMsg& msg);
 
   void NotifyMeSocketWriteable();
+  void NotifyMeSocketError();
 
  private:
   void SendQueueNotEmptyEvent();
   void ProcessQueueNotEmptyEvent();
 
   void WriteUntilMsgQueueEmptyOrSocketNotWriteable();
-  bool InitMsgWriteHandle();
-  bool MsgHeadWriteHandle();
-  bool MsgBodyWriteHandle();
-
-  bool DoCurWrite(void (SocketWriteHelper::*set_cur_write_done)());
-  void SetStatusWhenMsgHeadDone();
-  void SetStatusWhenMsgBodyDone();
+  bool InitBatch();
+  bool WriteBatch();
 
-#define MAKE_ENTRY(x, y) void SetStatusWhen##x##MsgHeadDone();
+  void AppendMsgToBatch(const SocketMsg& msg);
+#define MAKE_ENTRY(x, y) void Append##x##MsgBodyToBatch(const SocketMsg& msg);
   OF_PP_FOR_EACH_TUPLE(MAKE_ENTRY, SOCKET_MSG_TYPE_SEQ);
 #undef MAKE_ENTRY
 
@@ -60,10 +62,12 @@ class SocketWriteHelper final {
   std::mutex pending_msg_queue_mtx_;
   std::queue<SocketMsg>* pending_msg_queue_;
 
-  SocketMsg cur_msg_;
-  bool (SocketWriteHelper::*cur_write_handle_)();
-  const char* write_ptr_;
-  size_t write_size_;
+  // Heads of the batch, the iovecs refer to them so they are never reallocated
+  std::vector<SocketMsg> batch_msgs_;
+  std::vector<iovec> batch_iovs_;
+  std::vector<bool> batch_iov_zero_copy_;
+  size_t batch_iov_idx_;
+  size_t zero_copy_min_size_;
 };
 
 }  // namespace oneflow
@@ -0,0 +1,310 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include "oneflow/core/comm_network/epoll/socket_write_helper.h"
+#include "oneflow/core/comm_network/epoll/socket_memory_desc.h"
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <sys/wait.h>
+#include <array>
+#include <random>
+#include <set>
+#include <thread>
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+void ConnectLoopback(int* client_fd, int* server_fd) {
+  int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  PCHECK(listen_fd != -1);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  PCHECK(bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+  socklen_t len = sizeof(addr);
+  PCHECK(getsockname(listen_fd, reinterpret_cast<sockaddr*>(&addr), &len) == 0);
+  PCHECK(listen(listen_fd, 1) == 0);
+  *client_fd = socket(AF_INET, SOCK_STREAM, 0);
+  const int val = 1;
+  PCHECK(setsockopt(*client_fd, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(int)) == 0);
+  PCHECK(connect(*client_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+  *server_fd = accept(listen_fd, nullptr, nullptr);
+  PCHECK(*server_fd != -1);
+  PCHECK(close(listen_fd) == 0);
+}
+
+// Runs in the receiving process, parses msg_num messages whose bodies are body_size bytes of
+// their index, and returns the number of corrupted ones
+int64_t ReceiveMsgs(int fd, int64_t msg_num, size_t body_size) {
+  std::vector<char> buf(1 << 20);
+  std::vector<char> body(body_size);
+  SocketMsg msg;
+  size_t msg_filled = 0;
+  size_t body_filled = 0;
+  bool in_body = false;
+  int64_t received_num = 0;
+  int64_t corrupted_num = 0;
+  while (received_num < msg_num) {
+    ssize_t n = read(fd, buf.data(), buf.size());
+    PCHECK(n > 0);
+    for (size_t pos = 0; pos < static_cast<size_t>(n);) {
+      if (!in_body) {
+        const size_t len = std::min(sizeof(msg) - msg_filled, n - pos);
+        std::memcpy(reinterpret_cast<char*>(&msg) + msg_filled, buf.data() + pos, len);
+        pos += len;
+        msg_filled += len;
+        if (msg_filled < sizeof(msg)) { continue; }
+        msg_filled = 0;
+        if (msg.msg_type == SocketMsgType::kRequestRead) {
+          in_body = true;
+        } else {
+          if (msg.msg_type != SocketMsgType::kActor) { corrupted_num += 1; }
+          received_num += 1;
+        }
+      } else {
+        const size_t len = std::min(body_size - body_filled, n - pos);
+        std::memcpy(body.data() + body_filled, buf.data() + pos, len);
+        pos += len;
+        body_filled += len;
+        if (body_filled < body_size) { continue; }
+        body_filled = 0;
+        in_body = false;
+        const char expected = static_cast<char>(received_num);
+        if (body.front() != expected || body.back() != expected) { corrupted_num += 1; }
+        received_num += 1;
+      }
+    }
+  }
+  return corrupted_num;
+}
+
+void ReadFully(int fd, char* ptr, size_t size) {
+  while (size > 0) {
+    ssize_t n = read(fd, ptr, size);
+    PCHECK(n > 0);
+    ptr += n;
+    size -= n;
+  }
+}
+
+// Receives stripe_num request read messages on fd, and puts the body of each one at the offset
+// of its stripe into the buffer of its dst token, like SocketReadHelper. Returns the number of
+// reads the stripes completed.
+int64_t ReceiveStripes(int fd, int64_t stripe_num) {
+  int64_t done_read_num = 0;
+  FOR_RANGE(int64_t, i, 0, stripe_num) {
+    SocketMsg msg;
+    ReadFully(fd, reinterpret_cast<char*>(&msg), sizeof(msg));
+    CHECK(msg.msg_type == SocketMsgType::kRequestRead);
+    const SocketReadStripe& stripe = msg.request_read_msg.stripe;
+    auto dst_mem_desc = static_cast<const SocketMemDesc*>(msg.request_read_msg.dst_token);
+    CHECK_LE(static_cast<size_t>(stripe.offset + stripe.byte_size), dst_mem_desc->byte_size);
+    ReadFully(fd, static_cast<char*>(dst_mem_desc->mem_ptr) + stripe.offset, stripe.byte_size);
+    if (SocketReadStripeDone(stripe)) { done_read_num += 1; }
+  }
+  return done_read_num;
+}
+
+// Sends msg_num messages from this process to a forked one over loopback tcp, returns the
+// seconds until the receiver has parsed all of them
+double SendMsgs(int64_t msg_num, size_t body_size, size_t zero_copy_min_size) {
+  int client_fd = -1;
+  int server_fd = -1;
+  ConnectLoopback(&client_fd, &server_fd);
+  int done_pipe[2];
+  PCHECK(pipe(done_pipe) == 0);
+  pid_t pid = fork();
+  PCHECK(pid != -1);
+  if (pid == 0) {
+    close(client_fd);
+    int64_t corrupted_num = ReceiveMsgs(server_fd, msg_num, body_size);
+    PCHECK(write(done_pipe[1], &corrupted_num, sizeof(corrupted_num)) == sizeof(corrupted_num));
+    _exit(0);
+  }
+  PCHECK(close(server_fd) == 0);
+  // Bodies must stay untouched until received, like registers in flight
+  std::vector<std::vector<char>> bodies;
+  std::vector<SocketMemDesc> mem_descs;
+  if (body_size > 0) {
+    const int64_t body_num = std::min<int64_t>(msg_num, 256);
+    bodies.resize(body_num);
+    mem_descs.resize(body_num);
+    FOR_RANGE(int64_t, i, 0, body_num) {
+      bodies.at(i).assign(body_size, static_cast<char>(i));
+      mem_descs.at(i).mem_ptr = bodies.at(i).data();
+      mem_descs.at(i).byte_size = body_size;
+    }
+  }
+  double seconds = 0;
+  {
+    IOEventPoller poller;
+    SocketWriteHelper write_helper(client_fd, &poller, zero_copy_min_size);
+    poller.AddFd(
+        client_fd, []() {}, [&write_helper]() { write_helper.NotifyMeSocketWriteable(); },
+        [&write_helper]() { write_helper.NotifyMeSocketError(); });
+    poller.Start();
+    const auto start = std::chrono::steady_clock::now();
+    FOR_RANGE(int64_t, i, 0, msg_num) {
+      SocketMsg msg{};
+      if (body_size > 0) {
+        msg.msg_type = SocketMsgType::kRequestRead;
+        msg.request_read_msg.src_token = &mem_descs.at(i % mem_descs.size());
+        msg.request_read_msg.stripe.offset = 0;
+        msg.request_read_msg.stripe.byte_size = body_size;
+      } else {
+        msg.msg_type = SocketMsgType::kActor;
+      }
+      write_helper.AsyncWrite(msg);
+    }
+    int64_t corrupted_num = -1;
+    PCHECK(read(done_pipe[0], &corrupted_num, sizeof(corrupted_num)) == sizeof(corrupted_num));
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_EQ(corrupted_num, 0);
+    poller.Stop();
+  }
+  // The poller owns the fds added to it and closes client_fd on destruction
+  EXPECT_EQ(fcntl(client_fd, F_GETFD), -1);
+  EXPECT_EQ(errno, EBADF);
+  int status = 0;
+  PCHECK(waitpid(pid, &status, 0) == pid);
+  EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  PCHECK(close(done_pipe[0]) == 0);
+  PCHECK(close(done_pipe[1]) == 0);
+  return seconds;
+}
+
+}  // namespace
+
+TEST(SocketWriteHelper, loopback_small_msgs) { SendMsgs(4096, 0, 0); }
+
+TEST(SocketWriteHelper, loopback_large_bodies) {
+  // Bodies both below and above the zero copy threshold
+  for (size_t body_size : {size_t(1000), size_t(1 << 20)}) {
+    for (size_t zero_copy_min_size : {size_t(0), size_t(64 << 10)}) {
+      SendMsgs(16, body_size, zero_copy_min_size);
+    }
+  }
+}
+
+TEST(SocketWriteHelper, split_socket_read) {
+  // Small reads and single connections are not striped, a lone stripe still takes the next data
+  // connection
+  for (const auto& read : std::vector<std::array<int64_t, 3>>{{100, 4, 2}, {1 << 20, 1, 0}}) {
+    std::vector<SocketReadStripe> stripes = SplitSocketRead(read.at(0), 1024, read.at(1), 7);
+    ASSERT_EQ(stripes.size(), 1);
+    ASSERT_EQ(stripes.front().offset, 0);
+    ASSERT_EQ(stripes.front().byte_size, read.at(0));
+    ASSERT_EQ(stripes.front().conn_id, read.at(2));
+    ASSERT_TRUE(stripes.front().pending_stripe_num == nullptr);
+    ASSERT_TRUE(SocketReadStripeDone(stripes.front()));
+  }
+  // Large reads cover the buffer by one stripe on each data connection
+  std::vector<SocketReadStripe> stripes = SplitSocketRead(1001, 1024, 4, 7);
+  ASSERT_EQ(stripes.size(), 1);
+  stripes = SplitSocketRead(4001, 1024, 4, 7);
+  ASSERT_EQ(stripes.size(), 3);
+  std::set<int32_t> conn_ids;
+  int64_t offset = 0;
+  for (const SocketReadStripe& stripe : stripes) {
+    ASSERT_EQ(stripe.offset, offset);
+    offset += stripe.byte_size;
+    conn_ids.insert(stripe.conn_id);
+  }
+  ASSERT_EQ(offset, 4001);
+  ASSERT_EQ(conn_ids, (std::set<int32_t>{1, 2, 3}));
+  ASSERT_FALSE(SocketReadStripeDone(stripes.at(0)));
+  ASSERT_FALSE(SocketReadStripeDone(stripes.at(2)));
+  ASSERT_TRUE(SocketReadStripeDone(stripes.at(1)));
+}
+
+TEST(SocketWriteHelper, loopback_striped_read) {
+  const int32_t conn_num = 4;
+  const int64_t byte_size = (4 << 20) + 3;
+  std::vector<char> src(byte_size);
+  std::mt19937 gen(0);
+  for (char& c : src) { c = static_cast<char>(gen()); }
+  std::vector<char> dst(byte_size, 0);
+  SocketMemDesc src_mem_desc{src.data(), src.size()};
+  SocketMemDesc dst_mem_desc{dst.data(), dst.size()};
+  std::vector<SocketReadStripe> stripes = SplitSocketRead(byte_size, 64 << 10, conn_num, 2);
+  ASSERT_EQ(stripes.size(), conn_num - 1);
+  std::vector<int64_t> conn_stripe_num(conn_num, 0);
+  for (const SocketReadStripe& stripe : stripes) { conn_stripe_num.at(stripe.conn_id) += 1; }
+  std::vector<int> client_fds(conn_num, -1);
+  std::vector<int> server_fds(conn_num, -1);
+  FOR_RANGE(int32_t, conn_id, 0, conn_num) {
+    ConnectLoopback(&client_fds.at(conn_id), &server_fds.at(conn_id));
+  }
+  std::atomic<int64_t> done_read_num(0);
+  std::vector<std::thread> receivers;
+  FOR_RANGE(int32_t, conn_id, 0, conn_num) {
+    receivers.emplace_back([&, conn_id]() {
+      done_read_num += ReceiveStripes(server_fds.at(conn_id), conn_stripe_num.at(conn_id));
+    });
+  }
+  {
+    IOEventPoller poller;
+    std::vector<std::unique_ptr<SocketWriteHelper>> write_helpers;
+    for (int fd : client_fds) {
+      write_helpers.emplace_back(new SocketWriteHelper(fd, &poller, 0));
+      SocketWriteHelper* write_helper = write_helpers.back().get();
+      poller.AddFd(
+          fd, []() {}, [write_helper]() { write_helper->NotifyMeSocketWriteable(); },
+          [write_helper]() { write_helper->NotifyMeSocketError(); });
+    }
+    poller.Start();
+    for (const SocketReadStripe& stripe : stripes) {
+      SocketMsg msg{};
+      msg.msg_type = SocketMsgType::kRequestRead;
+      msg.request_read_msg.src_token = &src_mem_desc;
+      msg.request_read_msg.dst_token = &dst_mem_desc;
+      msg.request_read_msg.stripe = stripe;
+      write_helpers.at(stripe.conn_id)->AsyncWrite(msg);
+    }
+    for (std::thread& receiver : receivers) { receiver.join(); }
+    poller.Stop();
+  }
+  for (int fd : server_fds) { PCHECK(close(fd) == 0); }
+  ASSERT_EQ(done_read_num, 1);
+  ASSERT_TRUE(src == dst);
+}
+
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST(SocketWriteHelper, DISABLED_benchmark_loopback_throughput) {
+  const int64_t small_msg_num = 1 << 20;
+  LOG(INFO) << "actor msgs: " << small_msg_num / SendMsgs(small_msg_num, 0, 0) << " msgs/s";
+  const int64_t msg_num = 1024;
+  const size_t body_size = 4 << 20;
+  for (size_t zero_copy_min_size : {size_t(0), size_t(64 << 10)}) {
+    const double seconds = SendMsgs(msg_num, body_size, zero_copy_min_size);
+    LOG(INFO) << "bodies of " << body_size << " bytes" << (zero_copy_min_size ? " zero copy" : "")
+              << ": " << msg_num / seconds << " msgs/s, " << msg_num * body_size / seconds / 1e9
+              << " GB/s";
+  }
+}
+
+}  // namespace test
+
+}  // namespace oneflow
+
+#endif  // __linux__
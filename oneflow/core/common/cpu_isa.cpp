@@ -0,0 +1,49 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/common/cpu_isa.h"
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+namespace {
+
+CpuIsa DetectCpuIsa() {
+  CpuIsa isa = CpuIsa::kDefault;
+#ifdef OF_CPU_ISA_DISPATCH_ENABLED
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) { isa = CpuIsa::kAvx2; }
+  if (isa == CpuIsa::kAvx2 && __builtin_cpu_supports("avx512f")
+      && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl")) {
+    isa = CpuIsa::kAvx512;
+  }
+#endif
+  const char* env_isa = std::getenv("ONEFLOW_CPU_ISA");
+  if (env_isa == nullptr) { return isa; }
+  const std::string max_isa(env_isa);
+  if (max_isa == "default") { return CpuIsa::kDefault; }
+  if (max_isa == "avx2") { return std::min(isa, CpuIsa::kAvx2); }
+  CHECK(max_isa == "avx512") << "unknown ONEFLOW_CPU_ISA " << max_isa;
+  return isa;
+}
+
+}  // namespace
+
+CpuIsa GetCpuIsa() {
+  static const CpuIsa isa = DetectCpuIsa();
+  return isa;
+}
+
+}  // namespace oneflow
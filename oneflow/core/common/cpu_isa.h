@@ -0,0 +1,38 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_COMMON_CPU_ISA_H_
+#define ONEFLOW_CORE_COMMON_CPU_ISA_H_
+
+#include "oneflow/core/common/platform.h"
+
+namespace oneflow {
+
+enum class CpuIsa { kDefault = 0, kAvx2 = 1, kAvx512 = 2 };
+
+// Functions marked with OF_CPU_TARGET_* are compiled for that instruction set regardless of the
+// global compiler flags, so a CPU kernel can carry several variants and pick one by GetCpuIsa().
+#if defined(OF_PLATFORM_IS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define OF_CPU_ISA_DISPATCH_ENABLED
+#define OF_CPU_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define OF_CPU_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx512vl,avx2,fma")))
+#endif
+
+// The best instruction set of this CPU, capped by env ONEFLOW_CPU_ISA (default, avx2 or avx512)
+CpuIsa GetCpuIsa();
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_COMMON_CPU_ISA_H_
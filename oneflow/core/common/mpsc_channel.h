@@ -0,0 +1,247 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_COMMON_MPSC_CHANNEL_H_
+#define ONEFLOW_CORE_COMMON_MPSC_CHANNEL_H_
+
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/common/channel.h"
+
+namespace oneflow {
+
+namespace mpsc_channel {
+
+constexpr size_t kCacheLineSize = 64;
+
+inline size_t RoundUpToPowerOfTwo(size_t n) {
+  size_t ret = 1;
+  while (ret < n) { ret <<= 1; }
+  return ret;
+}
+
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
+
+}  // namespace mpsc_channel
+
+// Multi-producer single-consumer channel with the same interface as Channel<T>.
+//
+// Producers claim slots of a bounded ring buffer with a single CAS (Vyukov's bounded queue), so
+// Send never takes a lock on the fast path. When the ring is full, items spill into a mutex
+// guarded overflow queue instead of blocking the producer, which would deadlock actor threads that
+// message each other. The consumer spins for `spin_count` polls before parking on a condition
+// variable; producers only touch the mutex when the consumer is actually parked.
+template<typename T>
+class MpscChannel final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(MpscChannel);
+  MpscChannel(size_t capacity, int64_t spin_count);
+  ~MpscChannel() = default;
+
+  ChannelStatus Send(const T& item);
+  ChannelStatus Receive(T* item);
+  ChannelStatus ReceiveMany(std::queue<T>* items);
+  void Close();
+
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  bool TryPush(const T& item);
+  bool TryPop(T* item);
+  bool IsRingEmpty() const;
+  bool HasPendingItem() const;
+  void SendToOverflow(const T& item);
+  void DrainOverflow(std::queue<T>* items);
+  void NotifyIfParked();
+  // Waits until at least one item is visible or the channel is closed
+  void WaitForItem();
+
+  const size_t capacity_;
+  const size_t mask_;
+  const int64_t spin_count_;
+  std::unique_ptr<Cell[]> buffer_;
+
+  alignas(mpsc_channel::kCacheLineSize) std::atomic<size_t> enqueue_pos_;
+  alignas(mpsc_channel::kCacheLineSize) size_t dequeue_pos_;
+  alignas(mpsc_channel::kCacheLineSize) std::atomic<bool> has_overflow_;
+  std::atomic<bool> is_parked_;
+  std::atomic<bool> is_closed_;
+  std::queue<T> overflow_queue_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+};
+
+template<typename T>
+MpscChannel<T>::MpscChannel(size_t capacity, int64_t spin_count)
+    : capacity_(mpsc_channel::RoundUpToPowerOfTwo(std::max<size_t>(capacity, 2))),
+      mask_(capacity_ - 1),
+      spin_count_(spin_count),
+      buffer_(new Cell[capacity_]),
+      enqueue_pos_(0),
+      dequeue_pos_(0),
+      has_overflow_(false),
+      is_parked_(false),
+      is_closed_(false) {
+  FOR_RANGE(size_t, i, 0, capacity_) { buffer_[i].sequence.store(i, std::memory_order_relaxed); }
+}
+
+template<typename T>
+ChannelStatus MpscChannel<T>::Send(const T& item) {
+  if (is_closed_.load(std::memory_order_acquire)) { return kChannelStatusErrorClosed; }
+  if (has_overflow_.load(std::memory_order_acquire) || !TryPush(item)) { SendToOverflow(item); }
+  NotifyIfParked();
+  return kChannelStatusSuccess;
+}
+
+template<typename T>
+ChannelStatus MpscChannel<T>::Receive(T* item) {
+  while (true) {
+    if (TryPop(item)) { return kChannelStatusSuccess; }
+    if (has_overflow_.load(std::memory_order_acquire) && IsRingEmpty()) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (!overflow_queue_.empty()) {
+        *item = std::move(overflow_queue_.front());
+        overflow_queue_.pop();
+        if (overflow_queue_.empty()) { has_overflow_.store(false, std::memory_order_release); }
+        return kChannelStatusSuccess;
+      }
+    }
+    if (is_closed_.load(std::memory_order_acquire) && !HasPendingItem()) {
+      return kChannelStatusErrorClosed;
+    }
+    WaitForItem();
+  }
+}
+
+template<typename T>
+ChannelStatus MpscChannel<T>::ReceiveMany(std::queue<T>* items) {
+  const size_t origin_size = items->size();
+  while (true) {
+    T item;
+    while (TryPop(&item)) { items->push(std::move(item)); }
+    if (has_overflow_.load(std::memory_order_acquire) && IsRingEmpty()) { DrainOverflow(items); }
+    if (items->size() > origin_size) { return kChannelStatusSuccess; }
+    if (is_closed_.load(std::memory_order_acquire) && !HasPendingItem()) {
+      return kChannelStatusErrorClosed;
+    }
+    WaitForItem();
+  }
+}
+
+template<typename T>
+void MpscChannel<T>::Close() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  is_closed_.store(true, std::memory_order_release);
+  cond_.notify_all();
+}
+
+template<typename T>
+bool MpscChannel<T>::TryPush(const T& item) {
+  Cell* cell = nullptr;
+  size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+  while (true) {
+    cell = &buffer_[pos & mask_];
+    const size_t seq = cell->sequence.load(std::memory_order_acquire);
+    const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+    if (diff == 0) {
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+  cell->data = item;
+  cell->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+template<typename T>
+bool MpscChannel<T>::TryPop(T* item) {
+  Cell* cell = &buffer_[dequeue_pos_ & mask_];
+  if (cell->sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1) { return false; }
+  *item = std::move(cell->data);
+  cell->sequence.store(dequeue_pos_ + capacity_, std::memory_order_release);
+  ++dequeue_pos_;
+  return true;
+}
+
+template<typename T>
+bool MpscChannel<T>::IsRingEmpty() const {
+  // Slots that are claimed but not yet published also count as non-empty, so that overflow items
+  // are never handed out ahead of earlier ring items from the same producer
+  return enqueue_pos_.load(std::memory_order_acquire) == dequeue_pos_;
+}
+
+template<typename T>
+bool MpscChannel<T>::HasPendingItem() const {
+  return !IsRingEmpty() || has_overflow_.load(std::memory_order_acquire);
+}
+
+template<typename T>
+void MpscChannel<T>::SendToOverflow(const T& item) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // Once spilled, keep spilling until the consumer drains the overflow queue to preserve the
+  // per-producer FIFO order
+  if (!has_overflow_.load(std::memory_order_relaxed) && TryPush(item)) { return; }
+  overflow_queue_.push(item);
+  has_overflow_.store(true, std::memory_order_release);
+}
+
+template<typename T>
+void MpscChannel<T>::DrainOverflow(std::queue<T>* items) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!overflow_queue_.empty()) {
+    items->push(std::move(overflow_queue_.front()));
+    overflow_queue_.pop();
+  }
+  has_overflow_.store(false, std::memory_order_release);
+}
+
+template<typename T>
+void MpscChannel<T>::NotifyIfParked() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (is_parked_.load(std::memory_order_relaxed)) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.notify_one();
+  }
+}
+
+template<typename T>
+void MpscChannel<T>::WaitForItem() {
+  for (int64_t i = 0; i < spin_count_; ++i) {
+    if (HasPendingItem() || is_closed_.load(std::memory_order_relaxed)) { return; }
+    mpsc_channel::CpuRelax();
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  is_parked_.store(true, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  cond_.wait(lock, [this]() {
+    return HasPendingItem() || is_closed_.load(std::memory_order_relaxed);
+  });
+  is_parked_.store(false, std::memory_order_relaxed);
+}
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_COMMON_MPSC_CHANNEL_H_
@@ -0,0 +1,107 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/common/mpsc_channel.h"
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+struct TaggedItem {
+  int64_t sender_id;
+  int64_t seq;
+};
+
+template<typename ChannelT>
+void SendTaggedItems(ChannelT* channel, int64_t sender_id, int64_t item_num) {
+  FOR_RANGE(int64_t, i, 0, item_num) {
+    CHECK_EQ(channel->Send(TaggedItem{sender_id, i}), kChannelStatusSuccess);
+  }
+}
+
+template<typename ChannelT>
+double MeasureMsgsPerSecond(ChannelT* channel, int64_t sender_num, int64_t item_num_per_sender) {
+  std::vector<std::thread> senders;
+  const auto start = std::chrono::steady_clock::now();
+  FOR_RANGE(int64_t, i, 0, sender_num) {
+    senders.emplace_back(SendTaggedItems<ChannelT>, channel, i, item_num_per_sender);
+  }
+  int64_t received = 0;
+  std::queue<TaggedItem> items;
+  while (received < sender_num * item_num_per_sender) {
+    CHECK_EQ(channel->ReceiveMany(&items), kChannelStatusSuccess);
+    received += items.size();
+    while (!items.empty()) { items.pop(); }
+  }
+  const auto end = std::chrono::steady_clock::now();
+  for (std::thread& sender : senders) { sender.join(); }
+  const double seconds = std::chrono::duration<double>(end - start).count();
+  return received / seconds;
+}
+
+}  // namespace
+
+TEST(MpscChannel, fifo_per_sender_with_overflow) {
+  // A tiny ring forces most items through the overflow path
+  MpscChannel<TaggedItem> channel(4, 16);
+  const int64_t sender_num = 8;
+  const int64_t item_num = 20000;
+  std::vector<std::thread> senders;
+  FOR_RANGE(int64_t, i, 0, sender_num) {
+    senders.emplace_back(SendTaggedItems<MpscChannel<TaggedItem>>, &channel, i, item_num);
+  }
+  std::thread closer([&]() {
+    for (std::thread& sender : senders) { sender.join(); }
+    channel.Close();
+  });
+  std::vector<int64_t> next_seq(sender_num, 0);
+  TaggedItem item{};
+  while (channel.Receive(&item) == kChannelStatusSuccess) {
+    ASSERT_EQ(item.seq, next_seq.at(item.sender_id));
+    ++next_seq.at(item.sender_id);
+  }
+  closer.join();
+  for (int64_t seq : next_seq) { ASSERT_EQ(seq, item_num); }
+  ASSERT_EQ(channel.Send(TaggedItem{0, 0}), kChannelStatusErrorClosed);
+}
+
+TEST(MpscChannel, receive_many_after_close) {
+  MpscChannel<TaggedItem> channel(16, 0);
+  FOR_RANGE(int64_t, i, 0, 10) { ASSERT_EQ(channel.Send(TaggedItem{0, i}), kChannelStatusSuccess); }
+  channel.Close();
+  std::queue<TaggedItem> items;
+  ASSERT_EQ(channel.ReceiveMany(&items), kChannelStatusSuccess);
+  ASSERT_EQ(items.size(), 10);
+  ASSERT_EQ(channel.ReceiveMany(&items), kChannelStatusErrorClosed);
+}
+
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST(MpscChannel, DISABLED_throughput_vs_channel) {
+  const int64_t item_num_per_sender = 200000;
+  for (int64_t sender_num : {1, 2, 4, 8}) {
+    Channel<TaggedItem> channel;
+    MpscChannel<TaggedItem> mpsc_channel(65536, 2048);
+    const double channel_rate = MeasureMsgsPerSecond(&channel, sender_num, item_num_per_sender);
+    const double mpsc_rate = MeasureMsgsPerSecond(&mpsc_channel, sender_num, item_num_per_sender);
+    LOG(INFO) << "senders: " << sender_num << ", Channel: " << channel_rate
+              << " msgs/s, MpscChannel: " << mpsc_rate << " msgs/s";
+  }
+}
+
+}  // namespace test
+
+}  // namespace oneflow
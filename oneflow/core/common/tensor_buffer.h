@@ -31,7 +31,16 @@ inline void CheckTensorBufferDataType(DataType val) {
 class TensorBuffer {
  public:
   struct Deleter {
-    void operator()(void* ptr) { MemoryAllocatorImpl::DeallocateUnPinnedHostMem(ptr); }
+    size_t num_bytes = 0;
+    // set for views, which release the holder instead of the memory
+    std::shared_ptr<const void> holder;
+    void operator()(void* ptr) {
+      if (holder) {
+        holder.reset();
+      } else {
+        MemoryAllocatorImpl::DeallocateUnPinnedHostMem(ptr, num_bytes);
+      }
+    }
   };
   typedef std::unique_ptr<void, Deleter> BufferType;
 
@@ -76,10 +85,25 @@ class TensorBuffer {
     num_bytes_ = 0;
   }
 
+  // Makes the buffer a view of external memory which is kept alive by holder, without copying.
+  // The memory must not be written, and resizing a view detaches it into an owned buffer
+  void ResetAsView(const Shape& shape, DataType data_type, const void* ptr,
+                   std::shared_ptr<const void> holder) {
+    CheckTensorBufferDataType(data_type);
+    CHECK(holder);
+    data_ = BufferType(const_cast<void*>(ptr), Deleter{0, std::move(holder)});
+    num_bytes_ = shape.elem_cnt() * GetSizeOfDataType(data_type);
+    shape_ = shape;
+    data_type_ = data_type;
+  }
+
+  bool is_view() const { return static_cast<bool>(data_.get_deleter().holder); }
+
   void reserve(size_t new_num_bytes) {
-    if (new_num_bytes <= num_bytes_) { return; }
+    if (new_num_bytes <= num_bytes_ && !is_view()) { return; }
     data_.reset();
-    data_.reset(MemoryAllocatorImpl::AllocateUnPinnedHostMem(new_num_bytes));
+    data_ = BufferType(MemoryAllocatorImpl::AllocateUnPinnedHostMem(new_num_bytes),
+                       Deleter{new_num_bytes});
     num_bytes_ = new_num_bytes;
   }
 
@@ -95,6 +119,10 @@ class TensorBuffer {
     int64_t elem_cnt = new_shape.elem_cnt();
     if (new_type == DataType::kInvalidDataType || elem_cnt == 0) { return; }
     CheckTensorBufferDataType(new_type);
+    if (is_view()) {
+      data_.reset();
+      num_bytes_ = 0;
+    }
 
     data_type_ = new_type;
     shape_ = new_shape;
@@ -91,6 +91,19 @@ Maybe<void> EagerOneflow::RunPhysicalInstruction(vm::InstructionMsgList* instruc
   return vm::Run(instruction_list);
 }
 
+Maybe<void> EagerOneflow::DeferPhysicalInstruction(
+    vm::InstructionMsgList* instruction_list,
+    const vm::cfg::EagerSymbolList& cfg_eager_symbol_list) {
+  if (cfg_eager_symbol_list.eager_symbol_size() > 0) {
+    vm::EagerSymbolList eager_symbol_list;
+    cfg_eager_symbol_list.ToProto(&eager_symbol_list);
+    for (const auto& eager_symbol : eager_symbol_list.eager_symbol()) {
+      JUST(StorageAdd(eager_symbol));
+    }
+  }
+  return vm::DeferredRun(instruction_list);
+}
+
 Maybe<void> EagerOneflow::RunLogicalInstruction(vm::InstructionMsgList* instruction_list,
                                                 const vm::cfg::EagerSymbolList& eager_symbol_list) {
   ClusterInstructionProto cluster_instruction;
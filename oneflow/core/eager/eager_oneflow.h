@@ -45,6 +45,10 @@ class EagerOneflow final {
 
   Maybe<void> RunPhysicalInstruction(vm::InstructionMsgList* instruction_list,
                                      const vm::EagerSymbolList& eager_symbol_list);
+
+  // Symbols are added right away, the instructions may be batched with later ones
+  Maybe<void> DeferPhysicalInstruction(vm::InstructionMsgList* instruction_list,
+                                       const vm::cfg::EagerSymbolList& eager_symbol_list);
 };
 
 }  // namespace vm
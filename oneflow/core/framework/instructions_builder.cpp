@@ -1583,4 +1583,16 @@ Maybe<void> PhysicalRun(const std::function<void(InstructionsBuilder*)>& Build)
   return Maybe<void>::Ok();
 }
 
+Maybe<void> DeferredPhysicalRun(const std::function<Maybe<void>(InstructionsBuilder*)>& Build) {
+  vm::InstructionMsgList instruction_list;
+  vm::cfg::EagerSymbolList eager_symbol_list;
+  InstructionsBuilder instructions_builder(std::shared_ptr<vm::PhysicalIdGenerator>(),
+                                           &instruction_list, &eager_symbol_list,
+                                           _ReleasePhysicalObject);
+  JUST(Build(&instructions_builder));
+  JUST(Global<vm::EagerOneflow>::Get()->DeferPhysicalInstruction(
+      instructions_builder.mut_instruction_list(), instructions_builder.eager_symbol_list()));
+  return Maybe<void>::Ok();
+}
+
 }  // namespace oneflow
@@ -447,6 +447,9 @@ Maybe<void> LogicalRun(const std::function<void(InstructionsBuilder*)>& Build);
 
 Maybe<void> PhysicalRun(const std::function<void(InstructionsBuilder*)>& Build);
 
+// Dispatches through the vm instruction batch, see OneflowVM::DeferReceive
+Maybe<void> DeferredPhysicalRun(const std::function<Maybe<void>(InstructionsBuilder*)>& Build);
+
 }  // namespace oneflow
 
 #endif  // ONEFLOW_CORE_FRAMEWORK_INSTRUCTIONS_BUILDER_H_
@@ -0,0 +1,109 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/local_op_kernel_infer_cache.h"
+#include "oneflow/core/eager/eager_blob_object.h"
+
+namespace oneflow {
+
+namespace one {
+
+namespace {
+
+std::atomic<int64_t> total_hit_cnt(0);
+std::atomic<int64_t> total_miss_cnt(0);
+
+}  // namespace
+
+/* static */ int64_t LocalOpKernelInferCache::TotalHitCnt() { return total_hit_cnt; }
+
+/* static */ int64_t LocalOpKernelInferCache::TotalMissCnt() { return total_miss_cnt; }
+
+/* static */ size_t LocalOpKernelInferCache::DefaultMaxSize() {
+  static const size_t max_size = []() -> size_t {
+    const char* env_p = std::getenv("ONEFLOW_EAGER_INFER_CACHE_SIZE");
+    if (env_p == nullptr) { return 128; }
+    const int64_t size = std::stoll(env_p);
+    CHECK_GE(size, 0);
+    return size;
+  }();
+  return max_size;
+}
+
+void LocalOpKernelInferCache::UpdateCacheKey(const AttrMap& attrs,
+                                             const EagerBlobObjectList& inputs) {
+  const size_t input_num = inputs.size();
+  cache_key_.attrs = attrs;
+  // Shapes are assigned in place to reuse their storage across calls
+  cache_key_.input_shapes.resize(input_num);
+  cache_key_.input_data_types.resize(input_num);
+  cache_key_.input_is_dynamics.resize(input_num);
+  size_t hash_value = attrs.hash_value();
+  FOR_RANGE(size_t, i, 0, input_num) {
+    const BlobDesc& blob_desc = inputs.at(i)->blob_desc();
+    const Shape& shape = blob_desc.shape();
+    cache_key_.input_shapes.at(i) = shape;
+    cache_key_.input_data_types.at(i) = blob_desc.data_type();
+    cache_key_.input_is_dynamics.at(i) = blob_desc.is_dynamic();
+    HashCombine(&hash_value, shape.NumAxes());
+    FOR_RANGE(int64_t, axis, 0, shape.NumAxes()) {
+      HashCombine(&hash_value, std::hash<int64_t>()(shape.At(axis)));
+    }
+    HashCombine(&hash_value, static_cast<size_t>(blob_desc.data_type()));
+    HashCombine(&hash_value, static_cast<size_t>(blob_desc.is_dynamic()));
+  }
+  cache_key_.hash_value = hash_value;
+}
+
+bool LocalOpKernelInferCache::TryRestoreOutputs(const EagerBlobObjectList& outputs) {
+  const auto it = cached_key2value_.find(cache_key_);
+  if (it == cached_key2value_.end()) {
+    miss_cnt_ += 1;
+    total_miss_cnt += 1;
+    return false;
+  }
+  const ValueType& value = it->second;
+  CHECK_EQ(value.output_shapes.size(), outputs.size());
+  FOR_RANGE(size_t, i, 0, outputs.size()) {
+    BlobDesc* blob_desc = outputs.at(i)->mut_blob_desc();
+    blob_desc->set_shape(value.output_shapes.at(i));
+    blob_desc->set_data_type(value.output_data_types.at(i));
+    blob_desc->set_is_dynamic(value.output_is_dynamics.at(i));
+  }
+  hit_cnt_ += 1;
+  total_hit_cnt += 1;
+  return true;
+}
+
+void LocalOpKernelInferCache::UpdateCacheValue(const EagerBlobObjectList& outputs) {
+  if (!enabled()) { return; }
+  // Input shapes rarely vary without bound, dropping everything keeps this simple
+  if (cached_key2value_.size() >= max_size_) { Reset(); }
+  ValueType value;
+  value.output_shapes.reserve(outputs.size());
+  value.output_data_types.reserve(outputs.size());
+  value.output_is_dynamics.reserve(outputs.size());
+  for (const auto& output : outputs) {
+    const BlobDesc& blob_desc = output->blob_desc();
+    value.output_shapes.push_back(blob_desc.shape());
+    value.output_data_types.push_back(blob_desc.data_type());
+    value.output_is_dynamics.push_back(blob_desc.is_dynamic());
+  }
+  cached_key2value_[cache_key_] = std::move(value);
+}
+
+}  // namespace one
+
+}  // namespace oneflow
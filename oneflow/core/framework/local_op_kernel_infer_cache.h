@@ -0,0 +1,116 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_FRAMEWORK_LOCAL_OP_KERNEL_INFER_CACHE_H_
+#define ONEFLOW_CORE_FRAMEWORK_LOCAL_OP_KERNEL_INFER_CACHE_H_
+
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/common/shape.h"
+#include "oneflow/core/common/data_type.pb.h"
+#include "oneflow/core/framework/attr_map.h"
+
+namespace oneflow {
+
+namespace vm {
+class EagerBlobObject;
+}
+
+namespace one {
+
+struct LocalOpKernelInferCacheKey final {
+  AttrMap attrs;
+  std::vector<Shape> input_shapes;
+  std::vector<DataType> input_data_types;
+  std::vector<bool> input_is_dynamics;
+  size_t hash_value = 0;
+
+  bool operator==(const LocalOpKernelInferCacheKey& other) const {
+    return hash_value == other.hash_value && input_shapes == other.input_shapes
+           && input_data_types == other.input_data_types
+           && input_is_dynamics == other.input_is_dynamics && attrs == other.attrs;
+  }
+};
+
+struct LocalOpKernelInferCacheValue final {
+  std::vector<Shape> output_shapes;
+  std::vector<DataType> output_data_types;
+  std::vector<bool> output_is_dynamics;
+};
+
+}  // namespace one
+
+}  // namespace oneflow
+
+namespace std {
+
+template<>
+struct hash<oneflow::one::LocalOpKernelInferCacheKey> final {
+  size_t operator()(const oneflow::one::LocalOpKernelInferCacheKey& key) const {
+    return key.hash_value;
+  }
+};
+
+}  // namespace std
+
+namespace oneflow {
+
+namespace one {
+
+// Output blob descs inferred on the main thread for the eager calls of one StatefulLocalOpKernel,
+// keyed by the input blob descs and the attrs of the call
+class LocalOpKernelInferCache final {
+ public:
+  using KeyType = LocalOpKernelInferCacheKey;
+  using ValueType = LocalOpKernelInferCacheValue;
+  using EagerBlobObjectList = std::vector<std::shared_ptr<vm::EagerBlobObject>>;
+
+  OF_DISALLOW_COPY_AND_MOVE(LocalOpKernelInferCache);
+  // max_size 0 disables the cache
+  explicit LocalOpKernelInferCache(size_t max_size) : max_size_(max_size) {}
+  LocalOpKernelInferCache() : LocalOpKernelInferCache(DefaultMaxSize()) {}
+  ~LocalOpKernelInferCache() = default;
+
+  bool enabled() const { return max_size_ > 0; }
+
+  void UpdateCacheKey(const AttrMap& attrs, const EagerBlobObjectList& inputs);
+  // Copies the cached output descs to outputs and returns true on hit
+  bool TryRestoreOutputs(const EagerBlobObjectList& outputs);
+  // Stores the output descs for the current key
+  void UpdateCacheValue(const EagerBlobObjectList& outputs);
+  void Reset() { cached_key2value_.clear(); }
+
+  int64_t hit_cnt() const { return hit_cnt_; }
+  int64_t miss_cnt() const { return miss_cnt_; }
+  size_t size() const { return cached_key2value_.size(); }
+
+  // Summed over all the caches of the process
+  static int64_t TotalHitCnt();
+  static int64_t TotalMissCnt();
+  // ONEFLOW_EAGER_INFER_CACHE_SIZE, 128 by default
+  static size_t DefaultMaxSize();
+
+ private:
+  KeyType cache_key_;
+  HashMap<KeyType, ValueType> cached_key2value_;
+  size_t max_size_;
+  int64_t hit_cnt_ = 0;
+  int64_t miss_cnt_ = 0;
+};
+
+}  // namespace one
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_FRAMEWORK_LOCAL_OP_KERNEL_INFER_CACHE_H_
@@ -0,0 +1,86 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/local_op_kernel_infer_cache.h"
+#include "oneflow/core/framework/attr_value.h"
+#include "oneflow/core/eager/eager_blob_object.h"
+
+namespace oneflow {
+namespace one {
+namespace test {
+
+namespace {
+
+std::shared_ptr<vm::EagerBlobObject> NewEagerBlobObject(const Shape& shape, DataType data_type) {
+  return std::make_shared<vm::EagerBlobObject>(std::make_shared<MemoryCase>(),
+                                               std::make_shared<Shape>(shape), data_type,
+                                               std::make_shared<vm::TensorBuffer>());
+}
+
+AttrMap NewAttrMap(int32_t axis) {
+  MutableCfgAttrMap mut_attr_map{};
+  mut_attr_map.SetAttr<int32_t>("axis", axis);
+  return AttrMap(mut_attr_map);
+}
+
+}  // namespace
+
+TEST(LocalOpKernelInferCache, hit_and_miss) {
+  LocalOpKernelInferCache cache(16);
+  LocalOpKernelInferCache::EagerBlobObjectList inputs{
+      NewEagerBlobObject(Shape({2, 3}), DataType::kFloat)};
+  LocalOpKernelInferCache::EagerBlobObjectList outputs{
+      NewEagerBlobObject(Shape({3, 2}), DataType::kDouble)};
+  outputs.at(0)->mut_blob_desc()->set_is_dynamic(true);
+  cache.UpdateCacheKey(NewAttrMap(0), inputs);
+  ASSERT_FALSE(cache.TryRestoreOutputs(outputs));
+  cache.UpdateCacheValue(outputs);
+
+  LocalOpKernelInferCache::EagerBlobObjectList new_outputs{
+      NewEagerBlobObject(Shape(), DataType::kInvalidDataType)};
+  cache.UpdateCacheKey(NewAttrMap(0), inputs);
+  ASSERT_TRUE(cache.TryRestoreOutputs(new_outputs));
+  ASSERT_EQ(new_outputs.at(0)->blob_desc(), outputs.at(0)->blob_desc());
+
+  // Transposed input shape, other dtype and other attr all miss
+  cache.UpdateCacheKey(NewAttrMap(0), {NewEagerBlobObject(Shape({3, 2}), DataType::kFloat)});
+  ASSERT_FALSE(cache.TryRestoreOutputs(new_outputs));
+  cache.UpdateCacheKey(NewAttrMap(0), {NewEagerBlobObject(Shape({2, 3}), DataType::kDouble)});
+  ASSERT_FALSE(cache.TryRestoreOutputs(new_outputs));
+  cache.UpdateCacheKey(NewAttrMap(1), inputs);
+  ASSERT_FALSE(cache.TryRestoreOutputs(new_outputs));
+  ASSERT_EQ(cache.hit_cnt(), 1);
+  ASSERT_EQ(cache.miss_cnt(), 4);
+}
+
+TEST(LocalOpKernelInferCache, max_size) {
+  LocalOpKernelInferCache cache(4);
+  LocalOpKernelInferCache::EagerBlobObjectList outputs{
+      NewEagerBlobObject(Shape({1}), DataType::kFloat)};
+  FOR_RANGE(int64_t, i, 1, 10) {
+    cache.UpdateCacheKey(AttrMap(), {NewEagerBlobObject(Shape({i}), DataType::kFloat)});
+    cache.UpdateCacheValue(outputs);
+    ASSERT_LE(cache.size(), 4);
+  }
+  LocalOpKernelInferCache disabled(0);
+  ASSERT_FALSE(disabled.enabled());
+  disabled.UpdateCacheKey(AttrMap(), outputs);
+  disabled.UpdateCacheValue(outputs);
+  ASSERT_EQ(disabled.size(), 0);
+}
+
+}  // namespace test
+}  // namespace one
+}  // namespace oneflow
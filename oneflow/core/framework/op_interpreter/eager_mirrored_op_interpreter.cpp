@@ -93,14 +93,24 @@ Maybe<void> NaiveInterpret(const UserOpExpr& user_op_expr, const TensorTuple& in
     output_eager_blob_objects->at(index)->set_is_shape_synced(false);
   }
 
-  kernel->composed_attrs_for_main_thread()->ResetPrior(attrs);
-  JUST(kernel->InferDataType(input_eager_blob_objects, output_eager_blob_objects,
-                             kernel->op_infer_ctx_for_main_thread()));
-  JUST(kernel->InferTensorDesc(input_eager_blob_objects, output_eager_blob_objects,
+  // Training loops call the same op with the same input descs and attrs over and over
+  auto* infer_cache = kernel->mut_infer_cache_for_main_thread();
+  bool infer_cache_hit = false;
+  if (infer_cache->enabled()) {
+    infer_cache->UpdateCacheKey(attrs, *input_eager_blob_objects);
+    infer_cache_hit = infer_cache->TryRestoreOutputs(*output_eager_blob_objects);
+  }
+  if (!infer_cache_hit) {
+    kernel->composed_attrs_for_main_thread()->ResetPrior(attrs);
+    JUST(kernel->InferDataType(input_eager_blob_objects, output_eager_blob_objects,
                                kernel->op_infer_ctx_for_main_thread()));
+    JUST(kernel->InferTensorDesc(input_eager_blob_objects, output_eager_blob_objects,
+                                 kernel->op_infer_ctx_for_main_thread()));
+    infer_cache->UpdateCacheValue(*output_eager_blob_objects);
+  }
 
   const auto& instr_type_name = JUST(op_device->local_call_instruction_name());
-  JUST(PhysicalRun([&](InstructionsBuilder* builder) -> Maybe<void> {
+  JUST(DeferredPhysicalRun([&](InstructionsBuilder* builder) -> Maybe<void> {
     if (need_event_record) {
       for (const auto& input_tensor : inputs) {
         const auto& tensor = std::dynamic_pointer_cast<one::MirroredTensor>(input_tensor);
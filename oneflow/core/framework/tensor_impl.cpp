@@ -61,8 +61,9 @@ void EagerMirroredTensorImpl::Init() {
   const auto& parallel_desc = this->device()->parallel_desc_ptr();
   tensor_storage_->set_releaser_hook(
       [eager_blob_object, parallel_desc](const std::shared_ptr<vm::TensorBuffer>&) {
-        PhysicalRun([&](InstructionsBuilder* builder) {
-          builder->ReleaseTensor(eager_blob_object, parallel_desc);
+        // Deferred like the ops, so that a release does not flush the instruction batch
+        DeferredPhysicalRun([&](InstructionsBuilder* builder) -> Maybe<void> {
+          return builder->ReleaseTensor(eager_blob_object, parallel_desc);
         });
       });
 }
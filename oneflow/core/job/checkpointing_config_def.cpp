@@ -23,6 +23,12 @@ REGISTER_SCOPE_CONFIG_DEF().Bool(
     "checkpointing", false,
     "enable checkpointing op/tensor for backward recomputation to sublinear memory cost");
 
+REGISTER_FUNCTION_CONFIG_DEF()
+    .Bool("enable_auto_checkpointing", false,
+          "pick forward ops for backward recomputation by blob sizes and op costs")
+    .Int64("auto_checkpointing_memory_budget_mb", 0,
+           "activation memory budget per device for auto checkpointing, 0 to minimize memory");
+
 }  // namespace
 
 }  // namespace oneflow
@@ -35,6 +35,7 @@ limitations under the License.
 #include "oneflow/core/job/model_io_job.h"
 #include "oneflow/core/job/inter_job_mem_sharing_util.h"
 #include "oneflow/core/job/plan_util.h"
+#include "oneflow/core/job/plan_cache_util.h"
 #include "oneflow/core/operator/interface_op_util.h"
 #include "oneflow/core/job/critical_section_desc.h"
 #include "oneflow/core/job/global_for.h"
@@ -1110,7 +1111,69 @@ void MakePushJob(const std::string& job_name, const std::string& op_name,
 
 REGISTER_FUNCTION_CONFIG_DEF().Bool("__is_user_function__", true, "is user defined function");
 
+// Hits and the compile seconds they saved in this process
+int64_t plan_cache_hit_num = 0;
+double plan_cache_saved_seconds = 0;
+
+// Restores plan and the session state its compilation leaves on the master from the plan cache
+Maybe<bool> TryLoadCachedPlan(const std::string& dir, const std::string& key,
+                              const PbRpf<Job>& job_confs, Plan* plan) {
+  double start = GetCurTime();
+  PlanCacheEntry entry;
+  if (!PlanCacheUtil::Load(dir, key, &entry)) {
+    LOG(INFO) << "plan cache miss " << key;
+    return false;
+  }
+  const auto& job_id2job_conf = entry.plan().job_confs().job_id2job_conf();
+  for (const auto& pair : entry.job_name2job_id()) {
+    const auto it = job_id2job_conf.find(pair.second);
+    if (it == job_id2job_conf.end() || it->second.job_name() != pair.first) {
+      LOG(WARNING) << "plan cache " << key << " has no conf of job " << pair.first;
+      return false;
+    }
+  }
+  for (const Job& job : job_confs) {
+    if (entry.job_name2job_id().count(job.job_conf().job_name()) == 0) {
+      LOG(WARNING) << "plan cache " << key << " misses job " << job.job_conf().job_name();
+      return false;
+    }
+  }
+  CHECK_OR_RETURN(Global<JobName2JobId>::Get()->empty());
+  for (const auto& pair : entry.job_name2job_id()) { AddJobName2JobId(pair.first, pair.second); }
+  *Global<InterUserJobInfo>::Get() = entry.inter_user_job_info();
+  *plan = std::move(*entry.mutable_plan());
+  plan_cache_hit_num += 1;
+  plan_cache_saved_seconds += entry.compile_seconds();
+  LOG(INFO) << "plan cache hit " << key << ", loaded in " << (GetCurTime() - start) / 1e9
+            << " seconds instead of compiling for " << entry.compile_seconds() << " seconds. "
+            << plan_cache_hit_num << " hits saved " << plan_cache_saved_seconds
+            << " seconds in total.";
+  return true;
+}
+
+void StorePlanCache(const std::string& dir, const std::string& key, const Plan& plan,
+                    double compile_seconds) {
+  PlanCacheEntry entry;
+  entry.set_key(key);
+  *entry.mutable_plan() = plan;
+  for (const auto& pair : *Global<JobName2JobId>::Get()) {
+    (*entry.mutable_job_name2job_id())[pair.first] = pair.second;
+  }
+  *entry.mutable_inter_user_job_info() = *Global<InterUserJobInfo>::Get();
+  entry.set_compile_seconds(compile_seconds);
+  PlanCacheUtil::Store(dir, entry);
+}
+
 Maybe<void> CompileJobsAndMergePlans(const PbRpf<Job>& job_confs, Plan& plan) {
+  const std::string plan_cache_dir = PlanCacheUtil::CacheDir();
+  std::string plan_cache_key;
+  if (!plan_cache_dir.empty()) {
+    plan_cache_key = PlanCacheUtil::GenKey(job_confs);
+    if (JUST(TryLoadCachedPlan(plan_cache_dir, plan_cache_key, job_confs, &plan))) {
+      return Maybe<void>::Ok();
+    }
+  }
+  double compile_start = GetCurTime();
   std::vector<std::shared_ptr<Job>> jobs(job_confs.size());
   FOR_RANGE(int, i, 0, jobs.size()) { jobs.at(i).reset(new Job(job_confs.Get(i))); }
   if (jobs.size() > 1) { CheckNonDistributeOptimizerAvailable(jobs); }
@@ -1179,6 +1242,9 @@ Maybe<void> CompileJobsAndMergePlans(const PbRpf<Job>& job_confs, Plan& plan) {
     TeePersistentLogStream::Create("merged_plan")->Write(plan);
     PlanUtil::ToDotFile(plan, "/dot/merged_plan.dot");
   }
+  if (!plan_cache_dir.empty()) {
+    StorePlanCache(plan_cache_dir, plan_cache_key, plan, (GetCurTime() - compile_start) / 1e9);
+  }
   return Maybe<void>::Ok();
 }
 
@@ -0,0 +1,204 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/job/plan_cache_util.h"
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "oneflow/core/common/str_util.h"
+#include "oneflow/core/control/global_process_ctx.h"
+#include "oneflow/core/job/job_set.pb.h"
+#include "oneflow/core/job/resource_desc.h"
+#include "oneflow/core/job/global_for.h"
+#include "oneflow/core/job/version.h"
+#include "oneflow/core/persistence/file_system.h"
+
+namespace oneflow {
+
+namespace {
+
+constexpr char kPlanCacheMagic[8] = {'O', 'F', 'P', 'L', 'A', 'N', 'C', '1'};
+
+// magic, uncompressed size, compressed size and crc32 of the compressed bytes
+struct PlanCacheFileHeader {
+  char magic[8];
+  uint64_t uncompressed_size;
+  uint64_t compressed_size;
+  uint32_t crc;
+  uint32_t reserved;
+};
+
+void AppendDeterministicSerialization(const PbMessage& msg, std::string* out) {
+  google::protobuf::io::StringOutputStream string_stream(out);
+  google::protobuf::io::CodedOutputStream coded_stream(&string_stream);
+  // Maps are serialized in key order, so equal messages give equal bytes
+  coded_stream.SetSerializationDeterministic(true);
+  CHECK(msg.SerializeToCodedStream(&coded_stream));
+}
+
+uint32_t Crc32(const char* data, size_t size) {
+  uLong crc = crc32(0L, Z_NULL, 0);
+  // crc32 takes at most uInt bytes at a time
+  while (size > 0) {
+    const uInt len = static_cast<uInt>(std::min<size_t>(size, 1U << 30));
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(data), len);
+    data += len;
+    size -= len;
+  }
+  return static_cast<uint32_t>(crc);
+}
+
+std::string CacheFilePath(const std::string& dir, const std::string& key) {
+  return JoinPath(dir, key + ".plan");
+}
+
+}  // namespace
+
+std::string PlanCacheUtil::CacheDir() {
+  const char* dir = std::getenv("ONEFLOW_PLAN_CACHE_DIR");
+  if (dir == nullptr) { return ""; }
+  if (BuildIdentity().empty()) {
+    LOG(WARNING) << "plan cache disabled, the build of this binary is unknown";
+    return "";
+  }
+  return dir;
+}
+
+std::string PlanCacheUtil::BuildIdentity() {
+  static const std::string identity = []() -> std::string {
+    // The binary holding this code, whose size and modification time change with every rebuild
+    Dl_info info;
+    if (dladdr(reinterpret_cast<void*>(&PlanCacheUtil::BuildIdentity), &info) == 0
+        || info.dli_fname == nullptr) {
+      return "";
+    }
+    struct stat st;
+    if (stat(info.dli_fname, &st) != 0) { return ""; }
+#ifdef WITH_GIT_VERSION
+    const std::string version = GetOneFlowGitVersion();
+#else
+    const std::string version = "";
+#endif  // WITH_GIT_VERSION
+    return version + ":" + std::to_string(st.st_size) + ":" + std::to_string(st.st_mtime);
+  }();
+  return identity;
+}
+
+std::string PlanCacheUtil::GenKey(const PbRpf<Job>& job_confs) {
+  std::vector<const PbMessage*> msgs;
+  msgs.push_back(&Global<ResourceDesc, ForSession>::Get()->resource());
+  msgs.push_back(Global<const IOConf>::Get());
+  for (const Job& job : job_confs) { msgs.push_back(&job); }
+  const std::string salt = BuildIdentity() + "," + std::to_string(GlobalProcessCtx::WorldSize());
+  return GenKey(salt, msgs);
+}
+
+std::string PlanCacheUtil::GenKey(const std::string& salt,
+                                  const std::vector<const PbMessage*>& msgs) {
+  std::string serialized = salt;
+  for (const PbMessage* msg : msgs) {
+    // Lengths keep the boundaries of the messages in the hashed bytes
+    const std::string size = std::to_string(msg->ByteSizeLong()) + ":";
+    serialized.append(size);
+    AppendDeterministicSerialization(*msg, &serialized);
+  }
+  // 64-bit FNV-1a and crc32 of the bytes
+  uint64_t fnv = 14695981039346656037ULL;
+  for (const char c : serialized) {
+    fnv ^= static_cast<uint8_t>(c);
+    fnv *= 1099511628211ULL;
+  }
+  std::ostringstream ss;
+  ss << std::hex << std::setfill('0') << std::setw(16) << fnv << std::setw(8)
+     << Crc32(serialized.data(), serialized.size());
+  return ss.str();
+}
+
+bool PlanCacheUtil::Load(const std::string& dir, const std::string& key, PlanCacheEntry* entry) {
+  const std::string path = CacheFilePath(dir, key);
+  fs::FileSystem* fs = LocalFS();
+  if (!fs->FileExists(path)) { return false; }
+  const uint64_t file_size = fs->GetFileSize(path);
+  PlanCacheFileHeader header{};
+  if (file_size < sizeof(header)) {
+    LOG(WARNING) << "plan cache " << path << " is truncated";
+    return false;
+  }
+  std::unique_ptr<fs::RandomAccessFile> file;
+  fs->NewRandomAccessFile(path, &file);
+  file->Read(0, sizeof(header), reinterpret_cast<char*>(&header));
+  if (std::memcmp(header.magic, kPlanCacheMagic, sizeof(kPlanCacheMagic)) != 0
+      || header.compressed_size != file_size - sizeof(header)) {
+    LOG(WARNING) << "plan cache " << path << " has a bad header";
+    return false;
+  }
+  std::string compressed(header.compressed_size, '\0');
+  file->Read(sizeof(header), compressed.size(), &compressed.at(0));
+  if (Crc32(compressed.data(), compressed.size()) != header.crc) {
+    LOG(WARNING) << "plan cache " << path << " fails its checksum";
+    return false;
+  }
+  std::string serialized(header.uncompressed_size, '\0');
+  uLongf uncompressed_size = serialized.size();
+  if (uncompress(reinterpret_cast<Bytef*>(&serialized.at(0)), &uncompressed_size,
+                 reinterpret_cast<const Bytef*>(compressed.data()), compressed.size())
+          != Z_OK
+      || uncompressed_size != serialized.size() || !entry->ParseFromString(serialized)) {
+    LOG(WARNING) << "plan cache " << path << " is corrupted";
+    return false;
+  }
+  if (entry->key() != key) {
+    LOG(WARNING) << "plan cache " << path << " belongs to key " << entry->key();
+    return false;
+  }
+  return true;
+}
+
+void PlanCacheUtil::Store(const std::string& dir, const PlanCacheEntry& entry) {
+  std::string serialized;
+  CHECK(entry.SerializeToString(&serialized));
+  std::string compressed(compressBound(serialized.size()), '\0');
+  uLongf compressed_size = compressed.size();
+  // Plans are mostly repeated names and ids, the fastest level already shrinks them several times
+  CHECK_EQ(compress2(reinterpret_cast<Bytef*>(&compressed.at(0)), &compressed_size,
+                     reinterpret_cast<const Bytef*>(serialized.data()), serialized.size(),
+                     Z_BEST_SPEED),
+           Z_OK);
+  compressed.resize(compressed_size);
+  PlanCacheFileHeader header{};
+  std::memcpy(header.magic, kPlanCacheMagic, sizeof(kPlanCacheMagic));
+  header.uncompressed_size = serialized.size();
+  header.compressed_size = compressed.size();
+  header.crc = Crc32(compressed.data(), compressed.size());
+
+  fs::FileSystem* fs = LocalFS();
+  fs->RecursivelyCreateDirIfNotExist(dir);
+  const std::string path = CacheFilePath(dir, entry.key());
+  // Written aside and renamed, so that a concurrent or interrupted run never sees half a file
+  const std::string tmp_path = path + ".tmp" + std::to_string(getpid());
+  std::unique_ptr<fs::WritableFile> file;
+  fs->NewWritableFile(tmp_path, &file);
+  file->Append(reinterpret_cast<const char*>(&header), sizeof(header));
+  file->Append(compressed.data(), compressed.size());
+  file->Close();
+  fs->RenameFile(tmp_path, path);
+  LOG(INFO) << "plan cache stored " << path << ", " << serialized.size() << " bytes compressed to "
+            << compressed.size();
+}
+
+}  // namespace oneflow
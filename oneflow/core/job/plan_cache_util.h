@@ -0,0 +1,44 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_JOB_PLAN_CACHE_UTIL_H_
+#define ONEFLOW_CORE_JOB_PLAN_CACHE_UTIL_H_
+
+#include "oneflow/core/common/protobuf.h"
+#include "oneflow/core/job/job.pb.h"
+#include "oneflow/core/job/plan_cache.pb.h"
+
+namespace oneflow {
+
+// On-disk cache of merged plans, so that a restart with the same jobs skips compilation. Entries
+// are zlib compressed files named by their key under the directory ONEFLOW_PLAN_CACHE_DIR.
+struct PlanCacheUtil {
+  // Empty when ONEFLOW_PLAN_CACHE_DIR is unset or the build is unknown, which disables the cache
+  static std::string CacheDir();
+  // Git version, size and modification time of the binary, so that a plan cached by another build
+  // is never loaded. Empty when the binary can not be found.
+  static std::string BuildIdentity();
+  // Stable hash of the jobs, the session resource, the IO conf, the world size and the build
+  static std::string GenKey(const PbRpf<Job>& job_confs);
+  // Stable hash of salt and the deterministic serializations of msgs
+  static std::string GenKey(const std::string& salt, const std::vector<const PbMessage*>& msgs);
+  // False on a miss and on a corrupted or mismatched entry, which is treated as a miss
+  static bool Load(const std::string& dir, const std::string& key, PlanCacheEntry* entry);
+  static void Store(const std::string& dir, const PlanCacheEntry& entry);
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_JOB_PLAN_CACHE_UTIL_H_
@@ -0,0 +1,130 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include "oneflow/core/common/process_state.h"
+#include "oneflow/core/common/str_util.h"
+#include "oneflow/core/job/plan_cache_util.h"
+#include "oneflow/core/persistence/file_system.h"
+
+namespace oneflow {
+
+namespace {
+
+PlanCacheEntry GenEntry(const std::string& key, int64_t job_num) {
+  PlanCacheEntry entry;
+  entry.set_key(key);
+  Plan* plan = entry.mutable_plan();
+  plan->mutable_block_chunk_list();
+  plan->mutable_net_topo();
+  plan->mutable_collective_boxing_plan();
+  plan->mutable_ctrl_regst_desc_info();
+  FOR_RANGE(int64_t, job_id, 0, job_num) {
+    const std::string job_name = "job_" + std::to_string(job_id);
+    (*plan->mutable_job_confs()->mutable_job_id2job_conf())[job_id].set_job_name(job_name);
+    (*entry.mutable_job_name2job_id())[job_name] = job_id;
+    FOR_RANGE(int64_t, i, 0, 100) {
+      const std::string op_name = job_name + "-layer_" + std::to_string(i) + "-conv-weight";
+      (*entry.mutable_inter_user_job_info()->mutable_input_or_var_op_name2push_job_name())
+          [op_name] = "System-Push-" + op_name;
+    }
+  }
+  entry.set_compile_seconds(12.5);
+  return entry;
+}
+
+std::string TestDir() {
+  std::string current_dir = GetCwd();
+  StringReplace(&current_dir, '\\', '/');
+  return JoinPath(current_dir, "/tmp_test_plan_cache_dir");
+}
+
+}  // namespace
+
+TEST(PlanCacheUtil, build_identity) {
+  const std::string identity = PlanCacheUtil::BuildIdentity();
+  ASSERT_FALSE(identity.empty());
+  ASSERT_EQ(PlanCacheUtil::BuildIdentity(), identity);
+}
+
+TEST(PlanCacheUtil, key_is_stable) {
+  InterUserJobInfo lhs;
+  InterUserJobInfo rhs;
+  FOR_RANGE(int32_t, i, 0, 64) {
+    (*lhs.mutable_input_or_var_op_name2push_job_name())["op_" + std::to_string(i)] = "push";
+    (*rhs.mutable_input_or_var_op_name2push_job_name())["op_" + std::to_string(63 - i)] = "push";
+  }
+  // Map insertion order does not matter
+  ASSERT_EQ(PlanCacheUtil::GenKey("v1", {&lhs}), PlanCacheUtil::GenKey("v1", {&rhs}));
+  ASSERT_NE(PlanCacheUtil::GenKey("v1", {&lhs}), PlanCacheUtil::GenKey("v2", {&rhs}));
+  // Neither does where one message ends and the next begins
+  InterUserJobInfo empty;
+  ASSERT_NE(PlanCacheUtil::GenKey("v1", {&lhs, &empty}), PlanCacheUtil::GenKey("v1", {&lhs}));
+  rhs.set_global_model_init_job_name("init");
+  ASSERT_NE(PlanCacheUtil::GenKey("v1", {&lhs}), PlanCacheUtil::GenKey("v1", {&rhs}));
+}
+
+TEST(PlanCacheUtil, store_and_load) {
+  fs::FileSystem* fs = LocalFS();
+  const std::string dir = TestDir();
+  if (fs->IsDirectory(dir)) { fs->RecursivelyDeleteDir(dir); }
+  const std::string key = "0123456789abcdef01234567";
+  PlanCacheEntry loaded;
+  ASSERT_FALSE(PlanCacheUtil::Load(dir, key, &loaded));
+
+  const PlanCacheEntry entry = GenEntry(key, 64);
+  double start = GetCurTime();
+  PlanCacheUtil::Store(dir, entry);
+  const double store_seconds = (GetCurTime() - start) / 1e9;
+  start = GetCurTime();
+  ASSERT_TRUE(PlanCacheUtil::Load(dir, key, &loaded));
+  const double load_seconds = (GetCurTime() - start) / 1e9;
+  ASSERT_TRUE(PbMd::Equals(entry, loaded));
+  const std::string path = JoinPath(dir, key + ".plan");
+  LOG(INFO) << entry.ByteSizeLong() << " bytes stored as " << fs->GetFileSize(path)
+            << " bytes in " << store_seconds << " seconds, loaded in " << load_seconds
+            << " seconds";
+
+  // The file of another key
+  const std::string other_key = "fedcba9876543210fedcba98";
+  fs->RenameFile(path, JoinPath(dir, other_key + ".plan"));
+  ASSERT_FALSE(PlanCacheUtil::Load(dir, other_key, &loaded));
+  fs->RenameFile(JoinPath(dir, other_key + ".plan"), path);
+
+  // A flipped byte and a truncated file
+  std::unique_ptr<fs::RandomAccessFile> file;
+  fs->NewRandomAccessFile(path, &file);
+  std::string content(fs->GetFileSize(path), '\0');
+  file->Read(0, content.size(), &content.at(0));
+  auto Rewrite = [&](const std::string& new_content) {
+    std::unique_ptr<fs::WritableFile> writable_file;
+    fs->NewWritableFile(path, &writable_file);
+    writable_file->Append(new_content.data(), new_content.size());
+    writable_file->Close();
+  };
+  std::string flipped = content;
+  flipped.at(flipped.size() / 2) ^= 1;
+  Rewrite(flipped);
+  ASSERT_FALSE(PlanCacheUtil::Load(dir, key, &loaded));
+  Rewrite(content.substr(0, content.size() - 1));
+  ASSERT_FALSE(PlanCacheUtil::Load(dir, key, &loaded));
+  Rewrite(content.substr(0, 8));
+  ASSERT_FALSE(PlanCacheUtil::Load(dir, key, &loaded));
+  Rewrite(content);
+  ASSERT_TRUE(PlanCacheUtil::Load(dir, key, &loaded));
+  fs->RecursivelyDeleteDir(dir);
+}
+
+}  // namespace oneflow
@@ -46,12 +46,24 @@ class ResourceDesc final {
   size_t reserved_host_mem_byte() const { return resource_.reserved_host_mem_mbyte() * kMB; }
   size_t reserved_device_mem_byte() const { return resource_.reserved_device_mem_mbyte() * kMB; }
   bool use_rdma() const { return resource_.use_rdma(); }
+  size_t epoll_zero_copy_min_byte() const { return resource_.epoll_zero_copy_min_kbyte() * 1024; }
+  int32_t epoll_conn_num_per_peer() const { return resource_.epoll_conn_num_per_peer(); }
+  size_t epoll_stripe_min_byte() const { return resource_.epoll_stripe_min_kbyte() * 1024; }
   bool enable_numa_aware_cuda_malloc_host() const {
     return resource_.enable_numa_aware_cuda_malloc_host();
   }
   bool thread_enable_local_message_queue() const {
     return resource_.thread_enable_local_message_queue();
   }
+  bool thread_enable_lock_free_message_channel() const {
+    return resource_.thread_enable_lock_free_message_channel();
+  }
+  size_t thread_lock_free_message_channel_capacity() const {
+    return resource_.thread_lock_free_message_channel_capacity();
+  }
+  int64_t thread_message_channel_spin_count() const {
+    return resource_.thread_message_channel_spin_count();
+  }
   bool enable_thread_local_cache() const { return resource_.enable_thread_local_cache(); }
   size_t thread_local_cache_max_size() const { return resource_.thread_local_cache_max_size(); }
   int32_t ComputeThreadPoolSize() const;
@@ -0,0 +1,166 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/job_rewriter/auto_checkpointing.h"
+
+namespace oneflow {
+
+namespace {
+
+constexpr int64_t kInvalidBytes = std::numeric_limits<int64_t>::max();
+
+// Kept bytes first, recompute flops second
+struct CheckpointingCost {
+  int64_t bytes;
+  int64_t flops;
+
+  bool is_valid() const { return bytes != kInvalidBytes; }
+  bool operator<(const CheckpointingCost& rhs) const {
+    return std::tie(bytes, flops) < std::tie(rhs.bytes, rhs.flops);
+  }
+};
+
+// Splits the candidates into kept ones and runs of recomputed ones, where the out_bytes of a run
+// sum to at most max_segment_bytes, and minimizes the kept bytes.
+// Position 0 and n + 1 are the virtual begin and end, position i is candidate i - 1.
+bool PlanWithMaxSegmentBytes(const std::vector<CheckpointingCandidate>& candidates,
+                             int64_t max_segment_bytes, CheckpointingPlan* plan) {
+  const int64_t n = candidates.size();
+  const auto Candidate = [&](int64_t pos) -> const CheckpointingCandidate& {
+    return candidates.at(pos - 1);
+  };
+  const auto IsCandidate = [&](int64_t pos) { return pos >= 1 && pos <= n; };
+  std::vector<int64_t> prefix_flops(n + 2, 0);
+  FOR_RANGE(int64_t, pos, 1, n + 1) {
+    prefix_flops.at(pos) = prefix_flops.at(pos - 1) + Candidate(pos).flops;
+  }
+  std::vector<CheckpointingCost> cost(n + 2, CheckpointingCost{kInvalidBytes, 0});
+  std::vector<int64_t> prev(n + 2, -1);
+  cost.at(0) = CheckpointingCost{0, 0};
+  // Cost of keeping pos and recomputing a run right after it, less the flops before pos
+  const auto RunHeadCost = [&](int64_t pos) {
+    CheckpointingCost ret = cost.at(pos);
+    if (IsCandidate(pos)) { ret.bytes += Candidate(pos).out_bytes - Candidate(pos).kept_bytes; }
+    ret.flops -= prefix_flops.at(pos);
+    return ret;
+  };
+  // Run heads in [lo, pos - 2] with increasing positions and increasing costs
+  std::deque<int64_t> heads;
+  // The run from lo + 1 to pos - 1 is the longest valid one ending at pos - 1
+  int64_t lo = 0;
+  int64_t run_bytes = 0;
+  FOR_RANGE(int64_t, pos, 1, n + 2) {
+    if (pos >= 2) {
+      const CheckpointingCandidate& last = Candidate(pos - 1);
+      if (last.recomputable) {
+        run_bytes += last.out_bytes;
+        while (run_bytes > max_segment_bytes) {
+          ++lo;
+          run_bytes -= Candidate(lo).out_bytes;
+        }
+      } else {
+        lo = pos - 1;
+        run_bytes = 0;
+      }
+      const int64_t head = pos - 2;
+      if (head >= lo && cost.at(head).is_valid()) {
+        const CheckpointingCost head_cost = RunHeadCost(head);
+        while (!heads.empty() && !(RunHeadCost(heads.back()) < head_cost)) { heads.pop_back(); }
+        heads.push_back(head);
+      }
+      while (!heads.empty() && heads.front() < lo) { heads.pop_front(); }
+    }
+    if (IsCandidate(pos) && Candidate(pos).must_recompute) { continue; }
+    CheckpointingCost best = cost.at(pos - 1);
+    int64_t best_prev = pos - 1;
+    if (!heads.empty()) {
+      CheckpointingCost run_cost = RunHeadCost(heads.front());
+      run_cost.flops += prefix_flops.at(pos - 1);
+      if (run_cost < best) {
+        best = run_cost;
+        best_prev = heads.front();
+      }
+    }
+    if (!best.is_valid()) { continue; }
+    if (IsCandidate(pos)) { best.bytes += Candidate(pos).kept_bytes; }
+    cost.at(pos) = best;
+    prev.at(pos) = best_prev;
+  }
+  if (!cost.at(n + 1).is_valid()) { return false; }
+
+  plan->segments.clear();
+  int64_t max_run_bytes = 0;
+  for (int64_t pos = n + 1; pos > 0; pos = prev.at(pos)) {
+    const int64_t head = prev.at(pos);
+    if (head == pos - 1) { continue; }
+    int64_t segment_bytes = 0;
+    FOR_RANGE(int64_t, i, head, pos - 1) { segment_bytes += candidates.at(i).out_bytes; }
+    max_run_bytes = std::max(max_run_bytes, segment_bytes);
+    plan->segments.emplace_back(head, pos - 1);
+  }
+  std::reverse(plan->segments.begin(), plan->segments.end());
+  plan->kept_bytes = cost.at(n + 1).bytes;
+  plan->peak_bytes = plan->kept_bytes + max_run_bytes;
+  plan->recompute_flops = cost.at(n + 1).flops;
+  return true;
+}
+
+bool IsBetterPlan(const CheckpointingPlan& lhs, const CheckpointingPlan& rhs,
+                  int64_t memory_budget) {
+  if (memory_budget > 0) {
+    const bool lhs_fits = lhs.peak_bytes <= memory_budget;
+    const bool rhs_fits = rhs.peak_bytes <= memory_budget;
+    if (lhs_fits != rhs_fits) { return lhs_fits; }
+    if (lhs_fits) {
+      return std::tie(lhs.recompute_flops, lhs.peak_bytes)
+             < std::tie(rhs.recompute_flops, rhs.peak_bytes);
+    }
+  }
+  return std::tie(lhs.peak_bytes, lhs.recompute_flops)
+         < std::tie(rhs.peak_bytes, rhs.recompute_flops);
+}
+
+}  // namespace
+
+int64_t BaselineCheckpointingPeak(const std::vector<CheckpointingCandidate>& candidates) {
+  int64_t peak_bytes = 0;
+  for (const auto& candidate : candidates) { peak_bytes += candidate.kept_bytes; }
+  return peak_bytes;
+}
+
+CheckpointingPlan PlanCheckpointing(const std::vector<CheckpointingCandidate>& candidates,
+                                    int64_t memory_budget) {
+  int64_t total_out_bytes = 0;
+  for (const auto& candidate : candidates) { total_out_bytes += candidate.out_bytes; }
+  // A smaller segment bound keeps more bytes, so try bounds from 0 up to the total out bytes
+  std::vector<int64_t> max_segment_bytes_list{0};
+  for (double bytes = total_out_bytes; bytes >= 1; bytes *= 0.9) {
+    max_segment_bytes_list.push_back(static_cast<int64_t>(bytes));
+  }
+  CheckpointingPlan best_plan;
+  bool found = false;
+  for (int64_t max_segment_bytes : max_segment_bytes_list) {
+    CheckpointingPlan plan;
+    if (!PlanWithMaxSegmentBytes(candidates, max_segment_bytes, &plan)) { continue; }
+    if (!found || IsBetterPlan(plan, best_plan, memory_budget)) {
+      best_plan = plan;
+      found = true;
+    }
+  }
+  CHECK(found) << "ops tagged for checkpointing must be recomputable";
+  return best_plan;
+}
+
+}  // namespace oneflow
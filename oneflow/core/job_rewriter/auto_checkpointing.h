@@ -0,0 +1,55 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_JOB_REWRITER_AUTO_CHECKPOINTING_H_
+#define ONEFLOW_CORE_JOB_REWRITER_AUTO_CHECKPOINTING_H_
+
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+// One forward op, listed in topological order
+struct CheckpointingCandidate {
+  // bytes held from forward until backward when the op is not recomputed
+  int64_t kept_bytes = 0;
+  // bytes of all outputs, held until backward when the op feeds a recomputed segment
+  int64_t out_bytes = 0;
+  int64_t flops = 0;
+  bool recomputable = false;
+  // tagged for recomputation by the user
+  bool must_recompute = false;
+};
+
+struct CheckpointingPlan {
+  // [begin, end) index ranges of consecutive recomputed candidates
+  std::vector<std::pair<int64_t, int64_t>> segments;
+  // bytes held until backward, including the inputs of recomputed segments
+  int64_t kept_bytes = 0;
+  // kept_bytes plus the largest segment rebuilt during backward
+  int64_t peak_bytes = 0;
+  int64_t recompute_flops = 0;
+};
+
+// Peak bytes when nothing is recomputed
+int64_t BaselineCheckpointingPeak(const std::vector<CheckpointingCandidate>& candidates);
+
+// Returns the plan with the least recompute flops whose peak fits memory_budget. Returns the plan
+// with the lowest peak when memory_budget <= 0 or when no plan fits.
+CheckpointingPlan PlanCheckpointing(const std::vector<CheckpointingCandidate>& candidates,
+                                    int64_t memory_budget);
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_JOB_REWRITER_AUTO_CHECKPOINTING_H_
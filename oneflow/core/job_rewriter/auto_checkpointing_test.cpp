@@ -0,0 +1,149 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/job_rewriter/auto_checkpointing.h"
+
+namespace oneflow {
+
+namespace {
+
+std::vector<CheckpointingCandidate> MakeChain(int64_t n, int64_t bytes, int64_t flops) {
+  std::vector<CheckpointingCandidate> candidates(n);
+  for (auto& candidate : candidates) {
+    candidate.kept_bytes = bytes;
+    candidate.out_bytes = bytes;
+    candidate.flops = flops;
+    candidate.recomputable = true;
+  }
+  return candidates;
+}
+
+bool IsRecomputed(const CheckpointingPlan& plan, int64_t index) {
+  for (const auto& segment : plan.segments) {
+    if (index >= segment.first && index < segment.second) { return true; }
+  }
+  return false;
+}
+
+// Recomputes the peak of a plan from its segments under the same memory model
+int64_t PeakOfPlan(const std::vector<CheckpointingCandidate>& candidates,
+                   const CheckpointingPlan& plan) {
+  const int64_t n = candidates.size();
+  int64_t kept_bytes = 0;
+  int64_t max_segment_bytes = 0;
+  FOR_RANGE(int64_t, i, 0, n) {
+    if (IsRecomputed(plan, i)) { continue; }
+    kept_bytes += candidates.at(i).kept_bytes;
+    if (i + 1 < n && IsRecomputed(plan, i + 1)) {
+      kept_bytes += candidates.at(i).out_bytes - candidates.at(i).kept_bytes;
+    }
+  }
+  for (const auto& segment : plan.segments) {
+    int64_t segment_bytes = 0;
+    FOR_RANGE(int64_t, i, segment.first, segment.second) {
+      segment_bytes += candidates.at(i).out_bytes;
+    }
+    max_segment_bytes = std::max(max_segment_bytes, segment_bytes);
+  }
+  return kept_bytes + max_segment_bytes;
+}
+
+}  // namespace
+
+TEST(AutoCheckpointing, fits_without_recompute) {
+  const auto candidates = MakeChain(8, 100, 10);
+  ASSERT_EQ(BaselineCheckpointingPeak(candidates), 800);
+  const CheckpointingPlan plan = PlanCheckpointing(candidates, 1000);
+  ASSERT_TRUE(plan.segments.empty());
+  ASSERT_EQ(plan.peak_bytes, 800);
+  ASSERT_EQ(plan.recompute_flops, 0);
+}
+
+TEST(AutoCheckpointing, sqrt_n_without_budget) {
+  const auto candidates = MakeChain(100, 1, 1);
+  const CheckpointingPlan plan = PlanCheckpointing(candidates, 0);
+  // About sqrt(n) checkpoints and segments of about sqrt(n) ops
+  ASSERT_LE(plan.peak_bytes, 20);
+  ASSERT_EQ(plan.peak_bytes, PeakOfPlan(candidates, plan));
+  ASSERT_GE(plan.segments.size(), 5);
+}
+
+TEST(AutoCheckpointing, least_flops_under_budget) {
+  auto candidates = MakeChain(8, 100, 1);
+  candidates.at(2).flops = 1000;
+  candidates.at(5).flops = 1000;
+  const CheckpointingPlan plan = PlanCheckpointing(candidates, 600);
+  ASSERT_LE(plan.peak_bytes, 600);
+  ASSERT_EQ(plan.peak_bytes, PeakOfPlan(candidates, plan));
+  ASSERT_FALSE(IsRecomputed(plan, 2));
+  ASSERT_FALSE(IsRecomputed(plan, 5));
+  // A looser budget never costs more recomputation
+  const CheckpointingPlan loose_plan = PlanCheckpointing(candidates, 700);
+  ASSERT_LE(loose_plan.recompute_flops, plan.recompute_flops);
+}
+
+TEST(AutoCheckpointing, recomputable_and_tagged_ops) {
+  auto candidates = MakeChain(12, 100, 1);
+  candidates.at(3).recomputable = false;
+  candidates.at(7).recomputable = false;
+  candidates.at(10).must_recompute = true;
+  for (int64_t budget : {0, 300, 600, 2000}) {
+    const CheckpointingPlan plan = PlanCheckpointing(candidates, budget);
+    ASSERT_FALSE(IsRecomputed(plan, 3));
+    ASSERT_FALSE(IsRecomputed(plan, 7));
+    ASSERT_TRUE(IsRecomputed(plan, 10));
+    ASSERT_EQ(plan.peak_bytes, PeakOfPlan(candidates, plan));
+  }
+}
+
+TEST(AutoCheckpointing, boundary_outputs_are_kept) {
+  // Big outputs that backward does not need should stay out of segment boundaries
+  auto candidates = MakeChain(9, 10, 1);
+  FOR_RANGE(int64_t, i, 0, 9) {
+    if (i % 3 != 2) { candidates.at(i).out_bytes = 1000; }
+  }
+  const CheckpointingPlan plan = PlanCheckpointing(candidates, 0);
+  ASSERT_EQ(plan.peak_bytes, PeakOfPlan(candidates, plan));
+  ASSERT_LE(plan.peak_bytes, BaselineCheckpointingPeak(candidates));
+  for (const auto& segment : plan.segments) {
+    if (segment.first > 0) { ASSERT_EQ(segment.first % 3, 0); }
+  }
+}
+
+TEST(AutoCheckpointing, random_chains) {
+  std::mt19937 gen(0);
+  FOR_RANGE(int32_t, iter, 0, 200) {
+    const int64_t n = 1 + gen() % 64;
+    std::vector<CheckpointingCandidate> candidates(n);
+    for (auto& candidate : candidates) {
+      candidate.out_bytes = 1 + gen() % 1000;
+      candidate.kept_bytes = gen() % 4 == 0 ? 0 : candidate.out_bytes;
+      candidate.flops = gen() % 1000;
+      candidate.recomputable = gen() % 8 != 0;
+      candidate.must_recompute = candidate.recomputable && gen() % 16 == 0;
+    }
+    const int64_t baseline = BaselineCheckpointingPeak(candidates);
+    for (int64_t budget : {int64_t(0), baseline / 2, baseline}) {
+      const CheckpointingPlan plan = PlanCheckpointing(candidates, budget);
+      ASSERT_EQ(plan.peak_bytes, PeakOfPlan(candidates, plan));
+      FOR_RANGE(int64_t, i, 0, n) {
+        if (!candidates.at(i).recomputable) { ASSERT_FALSE(IsRecomputed(plan, i)); }
+        if (candidates.at(i).must_recompute) { ASSERT_TRUE(IsRecomputed(plan, i)); }
+      }
+    }
+  }
+}
+
+}  // namespace oneflow
@@ -18,6 +18,7 @@ limitations under the License.
 #include "oneflow/core/job/scope.h"
 #include "oneflow/core/job/scope.cfg.h"
 #include "oneflow/core/job_rewriter/calculation_pass.h"
+#include "oneflow/core/job_rewriter/auto_checkpointing.h"
 #include "oneflow/core/vm/symbol_storage.h"
 #include "oneflow/core/framework/framework.h"
 #include "oneflow/core/operator/operator.h"
@@ -37,12 +38,13 @@ class CheckpointingPass final : public JobPass {
     if (!IsEnabled(*ctx)) { return Maybe<void>::Ok(); }
     const OpGraph op_graph(*job);
     JobBuilder job_builder(job);
-    return Apply(op_graph, &job_builder);
+    return Apply(op_graph, &job_builder, ctx->job_desc());
   }
 
   bool IsEnabled(const JobPassCtx& ctx) const { return ctx.job_desc().IsTrain(); }
 
-  Maybe<void> Apply(const OpGraph& op_graph, JobBuilder* job_builder) const;
+  Maybe<void> Apply(const OpGraph& op_graph, JobBuilder* job_builder,
+                    const JobDesc& job_desc) const;
 };
 
 const std::string kCheckpointingFakeOpNamePrefix = "OneFlow-System-Checkpointing-Fake-Fw-Op_";
@@ -62,28 +64,143 @@ bool IsForwardPass7CheckpointingScope(const Scope& scope) {
   return IsForwardPassScope(scope) && scope.Bool("checkpointing");
 }
 
-void CollectAllCheckpointingOpsInForwardPass(
-    const OpGraph& op_graph, HashMap<std::string, const OpNode*>* checkpointing_op_name2op_node) {
+bool IsCheckpointingIgnoredOp(const OperatorConf& op_conf) {
   // NOTE(chengcheng):
   //   ignore batch_norm ops because of recompute bn will repeat the calculation of 'm' and 'v'.
   //   in the future, we need to support the recomputation version of batch_norm which do NOT
   //   update forward variables.
-  HashSet<std::string> ignore_op_type_names = {"normalization", "normalization_add_relu",
-                                               "cudnn_fused_normalization_add_relu", "repeat",
-                                               "unpack"};
+  static const HashSet<std::string> ignore_op_type_names = {
+      "normalization", "normalization_add_relu", "cudnn_fused_normalization_add_relu", "repeat",
+      "unpack"};
+  return ignore_op_type_names.find(op_conf.user_conf().op_type_name())
+         != ignore_op_type_names.end();
+}
+
+void CollectAllCheckpointingOpsInForwardPass(
+    const OpGraph& op_graph, HashMap<std::string, const OpNode*>* checkpointing_op_name2op_node) {
   op_graph.ForEachNode([&](const OpNode* op_node) {
     const OperatorConf& op_conf = op_node->op().op_conf();
     if (!op_conf.has_user_conf()) { return; }
-    if (ignore_op_type_names.find(op_conf.user_conf().op_type_name())
-        != ignore_op_type_names.end()) {
-      return;
-    }
+    if (IsCheckpointingIgnoredOp(op_conf)) { return; }
     if (IsForwardPass7CheckpointingScope(Scope4OpNode(op_node))) {
       CHECK(checkpointing_op_name2op_node->emplace(op_conf.name(), op_node).second);
     }
   });
 }
 
+bool IsAutoRecomputableOp(const OpNode* op_node) {
+  // random ops would give different values when recomputed
+  static const HashSet<std::string> random_op_type_names = {
+      "random_mask_like", "generate_random_batch_permutation_indices"};
+  const OperatorConf& op_conf = op_node->op().op_conf();
+  if (!op_conf.has_user_conf() || op_conf.user_conf().input().empty()) { return false; }
+  if (IsCheckpointingIgnoredOp(op_conf)) { return false; }
+  return random_op_type_names.find(op_conf.user_conf().op_type_name())
+         == random_op_type_names.end();
+}
+
+int64_t BlobBytesPerDevice(const OpNode* op_node, const LogicalBlobId& lbi) {
+  const BlobDesc& blob_desc = op_node->LogicalBlobDesc4Lbi(lbi);
+  int64_t bytes = blob_desc.shape().elem_cnt() * GetSizeOfDataType(blob_desc.data_type());
+  const ParallelDistribution& parallel_distribution = op_node->ParallelDistribution4Lbi(lbi);
+  const Shape& hierarchy = *op_node->parallel_desc().hierarchy();
+  FOR_RANGE(int64_t, i, 0, parallel_distribution.sbp_parallel_size()) {
+    if (parallel_distribution.sbp_parallel(i).has_split_parallel()) { bytes /= hierarchy.At(i); }
+  }
+  return bytes;
+}
+
+// Multiply-adds count twice for matmul and conv, other ops cost one flop per output element
+int64_t RecomputeFlopsPerDevice(const OpNode* op_node) {
+  const Operator& op = op_node->op();
+  int64_t out_elem_cnt = 0;
+  for (const std::string& obn : op.output_bns()) {
+    out_elem_cnt += op_node->LogicalBlobDesc4Lbi(op.BnInOp2Lbi(obn)).shape().elem_cnt();
+  }
+  const user_op::UserOpConfWrapper user_op_conf(op.op_conf());
+  const auto Shape4Input = [&](const std::string& arg_name) -> const Shape& {
+    return op_node->LogicalBlobDesc4Lbi(GenLogicalBlobId(user_op_conf.input(arg_name, 0))).shape();
+  };
+  const std::string& op_type_name = user_op_conf.op_type_name();
+  int64_t flops = out_elem_cnt;
+  if (op_type_name == "matmul" || op_type_name == "batch_matmul"
+      || op_type_name == "broadcast_matmul") {
+    const Shape& a_shape = Shape4Input("a");
+    const int64_t k = user_op_conf.attr<bool>("transpose_a") ? a_shape.At(a_shape.NumAxes() - 2)
+                                                             : a_shape.At(a_shape.NumAxes() - 1);
+    flops = 2 * out_elem_cnt * k;
+  } else if (op_type_name == "conv1d" || op_type_name == "conv2d" || op_type_name == "conv3d") {
+    const Shape& weight_shape = Shape4Input("weight");
+    flops = 2 * out_elem_cnt * (weight_shape.elem_cnt() / weight_shape.At(0));
+  }
+  return flops / op_node->parallel_desc().parallel_num();
+}
+
+double Bytes2Mb(int64_t bytes) { return bytes / 1024.0 / 1024.0; }
+
+// Lists the forward ops in topological order and recomputes the segments planned for the
+// memory budget, besides the ops already in checkpointing scopes.
+void CollectAutoCheckpointingOpsInForwardPass(
+    const OpGraph& op_graph, int64_t memory_budget,
+    HashMap<std::string, const OpNode*>* checkpointing_op_name2op_node) {
+  const auto IsForwardPassOp = [](const OpNode* op_node) {
+    return op_node->op().op_conf().has_scope_symbol_id()
+           && IsForwardPassScope(Scope4OpNode(op_node));
+  };
+  std::vector<const OpNode*> op_nodes;
+  std::vector<CheckpointingCandidate> candidates;
+  op_graph.TopoForEachNode([&](const OpNode* op_node) {
+    // variables are held for the whole job anyway
+    if (!IsForwardPassOp(op_node) || op_node->op().op_conf().has_variable_conf()) { return; }
+    HashSet<LogicalBlobId> bw_consumed_lbis;
+    for (const OpEdge* edge : op_node->out_edges()) {
+      if (!edge->dst_node()->op().op_conf().has_scope_symbol_id()
+          || IsForwardPassOp(edge->dst_node())) {
+        continue;
+      }
+      bw_consumed_lbis.insert(edge->lbis().begin(), edge->lbis().end());
+    }
+    CheckpointingCandidate candidate;
+    for (const std::string& obn : op_node->op().output_bns()) {
+      const LogicalBlobId& lbi = op_node->op().BnInOp2Lbi(obn);
+      const int64_t bytes = BlobBytesPerDevice(op_node, lbi);
+      candidate.out_bytes += bytes;
+      if (bw_consumed_lbis.find(lbi) != bw_consumed_lbis.end()) { candidate.kept_bytes += bytes; }
+    }
+    candidate.must_recompute =
+        checkpointing_op_name2op_node->find(op_node->op().op_name())
+        != checkpointing_op_name2op_node->end();
+    candidate.recomputable = candidate.must_recompute || IsAutoRecomputableOp(op_node);
+    if (candidate.recomputable) { candidate.flops = RecomputeFlopsPerDevice(op_node); }
+    op_nodes.push_back(op_node);
+    candidates.push_back(candidate);
+  });
+
+  const CheckpointingPlan plan = PlanCheckpointing(candidates, memory_budget);
+  LOG(INFO) << "auto checkpointing recomputes " << plan.segments.size()
+            << " segments, predicted activation peak per device "
+            << Bytes2Mb(BaselineCheckpointingPeak(candidates)) << " MB -> "
+            << Bytes2Mb(plan.peak_bytes) << " MB, budget " << Bytes2Mb(memory_budget)
+            << " MB, recompute " << plan.recompute_flops / 1e9 << " GFLOPs";
+  if (memory_budget > 0 && plan.peak_bytes > memory_budget) {
+    LOG(WARNING) << "auto checkpointing can not fit the activations into the memory budget";
+  }
+  for (const auto& segment : plan.segments) {
+    int64_t segment_bytes = 0;
+    int64_t segment_flops = 0;
+    FOR_RANGE(int64_t, i, segment.first, segment.second) {
+      segment_bytes += candidates.at(i).out_bytes;
+      segment_flops += candidates.at(i).flops;
+      const OpNode* op_node = op_nodes.at(i);
+      checkpointing_op_name2op_node->emplace(op_node->op().op_name(), op_node);
+    }
+    LOG(INFO) << "auto checkpointing segment of " << segment.second - segment.first
+              << " ops from " << op_nodes.at(segment.first)->op().op_name() << " to "
+              << op_nodes.at(segment.second - 1)->op().op_name() << ", "
+              << Bytes2Mb(segment_bytes) << " MB, " << segment_flops / 1e9 << " GFLOPs";
+  }
+}
+
 void GenConnectedCheckpointingSubgraphs(
     const HashMap<std::string, const OpNode*>& checkpointing_op_name2op_node,
     std::vector<HashSet<const OpNode*>>* checkpointing_subgraphs) {
@@ -121,10 +238,16 @@ void GenConnectedCheckpointingSubgraphs(
   }
 }
 
-Maybe<void> CheckpointingPass::Apply(const OpGraph& op_graph, JobBuilder* job_builder) const {
+Maybe<void> CheckpointingPass::Apply(const OpGraph& op_graph, JobBuilder* job_builder,
+                                     const JobDesc& job_desc) const {
   // step 1. collect all checkpointing ops in forwardpass.
   HashMap<std::string, const OpNode*> checkpointing_op_name2op_node;
   CollectAllCheckpointingOpsInForwardPass(op_graph, &checkpointing_op_name2op_node);
+  if (job_desc.Bool("enable_auto_checkpointing")) {
+    const int64_t memory_budget = job_desc.Int64("auto_checkpointing_memory_budget_mb") << 20;
+    CollectAutoCheckpointingOpsInForwardPass(op_graph, memory_budget,
+                                             &checkpointing_op_name2op_node);
+  }
   if (checkpointing_op_name2op_node.empty()) { return Maybe<void>::Ok(); }
 
   // step 2. get all connected subgraphs in checkpointing ops.
@@ -65,6 +65,8 @@ Maybe<void> CudnnFusedNormalizationAddReluPass::Apply(const OpGraph& op_graph,
     if (op_type_name != "normalization_add_relu" && op_type_name != "normalization_add_relu_grad") {
       return;
     }
+    // The CPU kernels handle the unfused ops themselves
+    if (op_node->parallel_desc().device_type() != DeviceType::kGPU) { return; }
     const user_op::UserOpConfWrapper user_op_conf(op_conf);
     const BlobDesc& x_desc =
         op_node->LogicalBlobDesc4Lbi(GenLogicalBlobId(user_op_conf.input("x", 0)));
@@ -18,7 +18,6 @@ limitations under the License.
 #include "oneflow/core/operator/op_conf_util.h"
 #include "oneflow/core/common/balanced_splitter.h"
 #include "oneflow/core/thread/thread_manager.h"
-#include "oneflow/core/common/blocking_counter.h"
 
 namespace oneflow {
 
@@ -171,14 +170,11 @@ void ConcatSplitDataContent(DeviceCtx* ctx, std::function<Blob*(const std::strin
   int32_t part_num = in_desc.TotalElemNum() * in_desc.OneElemSize() / min_byte_one_part;
   part_num = std::min(part_num, Global<ThreadPool>::Get()->thread_num());
   if (part_num >= 2) {
-    BlockingCounter bc(part_num);
-    FOR_RANGE(int32_t, part_id, 0, part_num) {
-      Global<ThreadPool>::Get()->AddWork([&ctx, &in_desc, &out_desc, part_id, &part_num, &bc]() {
+    Global<ThreadPool>::Get()->ParallelFor(0, part_num, 1, [&](int64_t begin, int64_t end) {
+      FOR_RANGE(int64_t, part_id, begin, end) {
         ConcatSplitPartDataContent(ctx, in_desc, out_desc, part_id, part_num);
-        bc.Decrease();
-      });
-    }
-    bc.WaitUntilCntEqualZero();
+      }
+    });
   } else {
     ConcatSplitPartDataContent(ctx, in_desc, out_desc, 0, 1);
   }
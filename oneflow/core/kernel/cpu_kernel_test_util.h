@@ -0,0 +1,54 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_KERNEL_CPU_KERNEL_TEST_UTIL_H_
+#define ONEFLOW_CORE_KERNEL_CPU_KERNEL_TEST_UTIL_H_
+
+#include <random>
+#include "oneflow/core/common/global.h"
+#include "oneflow/core/thread/thread_pool.h"
+
+namespace oneflow {
+
+namespace test {
+
+// Uniform floats in [low, high), the same for the same seed
+inline std::vector<float> RandomFloats(int64_t elem_num, int64_t seed, float low = -1,
+                                       float high = 1) {
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<float> dis(low, high);
+  std::vector<float> data(elem_num);
+  for (float& x : data) { x = dis(gen); }
+  return data;
+}
+
+// Owns Global<ThreadPool> for the scope of a test, 0 thread_num for all hardware threads
+class ScopedGlobalThreadPool final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ScopedGlobalThreadPool);
+  explicit ScopedGlobalThreadPool(int32_t thread_num = 4) {
+    if (thread_num == 0) {
+      thread_num = std::max<int32_t>(std::thread::hardware_concurrency(), 1);
+    }
+    Global<ThreadPool>::New(thread_num);
+  }
+  ~ScopedGlobalThreadPool() { Global<ThreadPool>::Delete(); }
+};
+
+}  // namespace test
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_KERNEL_CPU_KERNEL_TEST_UTIL_H_
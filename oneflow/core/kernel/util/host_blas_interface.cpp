@@ -15,11 +15,16 @@ limitations under the License.
 */
 #include "oneflow/core/kernel/util/host_blas_interface.h"
 #include "oneflow/core/register/blob.h"
+#include "oneflow/core/common/global.h"
+#include "oneflow/core/thread/thread_pool.h"
 
 namespace oneflow {
 
 namespace {
 
+// Multiply-adds a task of BatchedGemmImpl does at least, below which tasks are merged
+constexpr int64_t kBatchedGemmTaskFlops = 1 << 18;
+
 template<typename T>
 static void Gemm(DeviceCtx* ctx, const enum CBLAS_ORDER order, enum CBLAS_TRANSPOSE trans_a,
                  enum CBLAS_TRANSPOSE trans_b, const int m, const int n, const int k,
@@ -42,18 +47,64 @@ static void AxpyImpl(DeviceCtx* ctx, const int n, const T alpha, const T* x, con
   }
 }
 
+// Rows [row_begin, row_end) of c = alpha * op(a) * op(b) + beta * c
+template<typename T>
+void GemmRows(const enum CBLAS_TRANSPOSE trans_a, const enum CBLAS_TRANSPOSE trans_b, int m, int n,
+              int k, int row_begin, int row_end, const double alpha, const T* a, const T* b,
+              const double beta, T* c) {
+  const int lda = (trans_a == CblasNoTrans) ? k : m;
+  const int ldb = (trans_b == CblasNoTrans) ? n : k;
+  const int64_t a_offset =
+      (trans_a == CblasNoTrans) ? row_begin * static_cast<int64_t>(k) : row_begin;
+  cblas_gemm<T>(CblasRowMajor, trans_a, trans_b, row_end - row_begin, n, k, static_cast<T>(alpha),
+                a + a_offset, lda, b, ldb, static_cast<T>(beta),
+                c + row_begin * static_cast<int64_t>(n), n);
+}
+
+// The matrices are split into row blocks so that few large matrices still keep all the threads
+// of the pool busy, and the tasks of small matrices are merged to amortize the scheduling. The
+// host BLAS is the sequential one, so the pool does all the threading.
 template<typename T>
 void BatchedGemmImpl(DeviceCtx* ctx, const enum CBLAS_ORDER order,
                      const enum CBLAS_TRANSPOSE trans_a, const enum CBLAS_TRANSPOSE trans_b,
                      int batch_size, int m, int n, int k, const double alpha, const T* a,
                      const T* b, const double beta, T* c) {
-  const int a_stride = m * k;
-  const int b_stride = k * n;
-  const int c_stride = m * n;
-  FOR_RANGE(int32_t, i, 0, batch_size) {
-    BlasIf<DeviceType::kCPU>::OFGemm(ctx, trans_a, trans_b, m, n, k, alpha, a + i * a_stride,
-                                     b + i * b_stride, beta, c + i * c_stride);
+  CHECK_EQ(order, CblasRowMajor);
+  const int64_t a_stride = static_cast<int64_t>(m) * k;
+  const int64_t b_stride = static_cast<int64_t>(k) * n;
+  const int64_t c_stride = static_cast<int64_t>(m) * n;
+  const int64_t gemm_flops = c_stride * k;
+  ThreadPool* thread_pool = Global<ThreadPool>::Get();
+  if (thread_pool == nullptr || thread_pool->thread_num() <= 1
+      || batch_size * gemm_flops <= kBatchedGemmTaskFlops) {
+    FOR_RANGE(int32_t, i, 0, batch_size) {
+      GemmRows<T>(trans_a, trans_b, m, n, k, 0, m, alpha, a + i * a_stride, b + i * b_stride, beta,
+                  c + i * c_stride);
+    }
+    return;
+  }
+  const int64_t thread_num = thread_pool->thread_num();
+  int64_t block_num = 1;
+  if (batch_size < thread_num) {
+    // Row blocks of at least kBatchedGemmTaskFlops, enough of them to cover the threads
+    const int64_t max_block_num =
+        std::max<int64_t>(gemm_flops / kBatchedGemmTaskFlops, static_cast<int64_t>(1));
+    block_num = std::min<int64_t>({(thread_num + batch_size - 1) / batch_size, max_block_num, m});
   }
+  const int64_t block_rows = (m + block_num - 1) / block_num;
+  const int64_t task_flops = block_rows * n * k;
+  const int64_t grain = std::max<int64_t>(kBatchedGemmTaskFlops / std::max<int64_t>(task_flops, 1),
+                                          static_cast<int64_t>(1));
+  thread_pool->ParallelFor(0, batch_size * block_num, grain, [&](int64_t begin, int64_t end) {
+    FOR_RANGE(int64_t, task, begin, end) {
+      const int64_t i = task / block_num;
+      const int row_begin = (task % block_num) * block_rows;
+      const int row_end = std::min<int64_t>(row_begin + block_rows, m);
+      if (row_begin >= row_end) { continue; }
+      GemmRows<T>(trans_a, trans_b, m, n, k, row_begin, row_end, alpha, a + i * a_stride,
+                  b + i * b_stride, beta, c + i * c_stride);
+    }
+  });
 }
 
 }  // namespace
@@ -0,0 +1,117 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/kernel/util/host_blas_interface.h"
+#include "oneflow/core/kernel/cpu_kernel_test_util.h"
+#include <gtest/gtest.h>
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+// The serial loop OFBatchedGemm used before, as the baseline
+void SerialBatchedGemm(enum CBLAS_TRANSPOSE trans_a, enum CBLAS_TRANSPOSE trans_b, int batch_size,
+                       int m, int n, int k, const float* a, const float* b, float* c) {
+  FOR_RANGE(int32_t, i, 0, batch_size) {
+    BlasIf<DeviceType::kCPU>::OFGemm(nullptr, trans_a, trans_b, m, n, k, 1.0,
+                                     a + static_cast<int64_t>(i) * m * k,
+                                     b + static_cast<int64_t>(i) * k * n, 0.0,
+                                     c + static_cast<int64_t>(i) * m * n);
+  }
+}
+
+}  // namespace
+
+TEST(HostBlasInterface, batched_gemm_match_naive) {
+  ScopedGlobalThreadPool thread_pool;
+  // batch, m, n, k
+  const std::vector<std::array<int32_t, 4>> cases = {
+      {1, 3, 5, 7}, {3, 64, 32, 16}, {2, 300, 70, 90}, {40, 17, 33, 9}, {5, 128, 128, 64}};
+  for (const auto& s : cases) {
+    const int32_t batch_size = s[0];
+    const int32_t m = s[1];
+    const int32_t n = s[2];
+    const int32_t k = s[3];
+    const std::vector<float> a = RandomFloats(batch_size * m * k, 1);
+    const std::vector<float> b = RandomFloats(batch_size * k * n, 2);
+    const std::vector<float> c_init = RandomFloats(batch_size * m * n, 3);
+    for (const auto trans_a : {CblasNoTrans, CblasTrans}) {
+      for (const auto trans_b : {CblasNoTrans, CblasTrans}) {
+        std::vector<float> c = c_init;
+        BlasIf<DeviceType::kCPU>::OFBatchedGemm(nullptr, trans_a, trans_b, batch_size, m, n, k,
+                                                0.5, a.data(), b.data(), 2.0, c.data());
+        FOR_RANGE(int32_t, i, 0, batch_size) {
+          FOR_RANGE(int32_t, row, 0, m) {
+            FOR_RANGE(int32_t, col, 0, n) {
+              double sum = 0;
+              FOR_RANGE(int32_t, j, 0, k) {
+                const float a_val =
+                    a.at(i * m * k + (trans_a == CblasNoTrans ? row * k + j : j * m + row));
+                const float b_val =
+                    b.at(i * k * n + (trans_b == CblasNoTrans ? j * n + col : col * k + j));
+                sum += static_cast<double>(a_val) * b_val;
+              }
+              const int64_t idx = (i * m + row) * n + col;
+              ASSERT_NEAR(c.at(idx), 0.5 * sum + 2.0 * c_init.at(idx), 1e-4 * (1 + std::abs(sum)));
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST(HostBlasInterface, DISABLED_batched_gemm_benchmark_attention_shapes) {
+  ScopedGlobalThreadPool thread_pool(0);
+  // batch * heads, m, n, k of query * key^T and scores * value, plus a few large matrices
+  const std::vector<std::array<int32_t, 4>> cases = {
+      {96, 128, 128, 64}, {96, 128, 64, 128}, {384, 64, 64, 64},     {192, 512, 512, 64},
+      {192, 512, 64, 512}, {64, 1, 128, 64},  {2, 1024, 1024, 1024}, {1, 2048, 1024, 512}};
+  for (const auto& s : cases) {
+    const int32_t batch_size = s[0];
+    const int32_t m = s[1];
+    const int32_t n = s[2];
+    const int32_t k = s[3];
+    const std::vector<float> a = RandomFloats(static_cast<int64_t>(batch_size) * m * k, 1);
+    const std::vector<float> b = RandomFloats(static_cast<int64_t>(batch_size) * k * n, 2);
+    std::vector<float> c(static_cast<int64_t>(batch_size) * m * n);
+    const int32_t iter_num = 3;
+    const auto Time = [&](const std::function<void()>& Run) {
+      Run();
+      const auto start = std::chrono::steady_clock::now();
+      FOR_RANGE(int32_t, i, 0, iter_num) { Run(); }
+      return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+                 .count()
+             / iter_num;
+    };
+    const double serial_ms = Time([&]() {
+      SerialBatchedGemm(CblasNoTrans, CblasTrans, batch_size, m, n, k, a.data(), b.data(),
+                        c.data());
+    });
+    const double batched_ms = Time([&]() {
+      BlasIf<DeviceType::kCPU>::OFBatchedGemm(nullptr, CblasNoTrans, CblasTrans, batch_size, m, n,
+                                              k, 1.0, a.data(), b.data(), 0.0, c.data());
+    });
+    LOG(INFO) << batch_size << "x" << m << "x" << n << "x" << k << ": serial " << serial_ms
+              << " ms, OFBatchedGemm " << batched_ms << " ms";
+  }
+}
+
+}  // namespace test
+
+}  // namespace oneflow
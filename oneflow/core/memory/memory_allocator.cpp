@@ -21,6 +21,7 @@ limitations under the License.
 #include "oneflow/core/register/blob.h"
 #include "oneflow/core/common/tensor_buffer.h"
 #include "oneflow/core/record/record.pb.h"
+#include "oneflow/core/vm/host_caching_allocator.h"
 
 namespace oneflow {
 
@@ -78,12 +79,27 @@ void MemoryAllocatorImpl::Deallocate(void* ptr, MemoryCase mem_case) {
 }
 
 void* MemoryAllocatorImpl::AllocateUnPinnedHostMem(size_t size) {
-  void* ptr = malloc(size);
+  void* ptr = nullptr;
+  vm::HostCachingAllocator* caching_allocator = vm::GetGlobalHostCachingAllocator();
+  if (caching_allocator != nullptr) {
+    char* mem_ptr = nullptr;
+    caching_allocator->Allocate(&mem_ptr, size);
+    ptr = mem_ptr;
+  } else {
+    ptr = malloc(size);
+  }
   CHECK_NOTNULL(ptr);
   return ptr;
 }
 
-void MemoryAllocatorImpl::DeallocateUnPinnedHostMem(void* ptr) { free(ptr); }
+void MemoryAllocatorImpl::DeallocateUnPinnedHostMem(void* ptr, size_t size) {
+  vm::HostCachingAllocator* caching_allocator = vm::GetGlobalHostCachingAllocator();
+  if (caching_allocator != nullptr) {
+    caching_allocator->Deallocate(static_cast<char*>(ptr), size);
+  } else {
+    free(ptr);
+  }
+}
 
 MemoryAllocator::~MemoryAllocator() {
   for (std::function<void()> deleter : deleters_) { deleter(); }
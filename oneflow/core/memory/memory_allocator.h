@@ -56,7 +56,8 @@ struct MemoryAllocatorImpl final {
   static void* Allocate(MemoryCase mem_case, size_t size);
   static void Deallocate(void* ptr, MemoryCase mem_case);
   static void* AllocateUnPinnedHostMem(size_t size);
-  static void DeallocateUnPinnedHostMem(void* ptr);
+  // size must be the one passed to AllocateUnPinnedHostMem
+  static void DeallocateUnPinnedHostMem(void* ptr, size_t size);
 };
 
 }  // namespace oneflow
@@ -0,0 +1,175 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_NDARRAY_CPU_BROADCAST_BINARY_CORE_H_
+#define ONEFLOW_CORE_NDARRAY_CPU_BROADCAST_BINARY_CORE_H_
+
+#include "oneflow/core/ndarray/xpu_var_ndarray.h"
+#include "oneflow/core/ndarray/binary_func.h"
+#include "oneflow/core/common/cpu_isa.h"
+#include "oneflow/core/thread/thread_pool.h"
+
+namespace oneflow {
+
+namespace cpu_broadcast_binary {
+
+constexpr int64_t kParallelMinElemNum = 1 << 15;
+
+// y[i] = binary_func(a[i * a_step], b[i * b_step]), a step of 0 broadcasts a scalar. Written as a
+// plain loop, so that the compiler vectorizes it for the target of the caller
+template<typename T, template<typename> class binary_func, int a_step, int b_step>
+ALWAYS_INLINE inline void BinaryRow(int64_t n,
+                                    typename BinaryFuncTrait<binary_func, T>::return_type* y,
+                                    const T* a, const T* b) {
+  if (a_step == 0 && b_step == 0) {
+    const auto value = binary_func<T>::Invoke(*a, *b);
+    for (int64_t i = 0; i < n; ++i) { y[i] = value; }
+  } else if (a_step == 0) {
+    const T a_value = *a;
+    for (int64_t i = 0; i < n; ++i) { y[i] = binary_func<T>::Invoke(a_value, b[i]); }
+  } else if (b_step == 0) {
+    const T b_value = *b;
+    for (int64_t i = 0; i < n; ++i) { y[i] = binary_func<T>::Invoke(a[i], b_value); }
+  } else {
+    for (int64_t i = 0; i < n; ++i) { y[i] = binary_func<T>::Invoke(a[i], b[i]); }
+  }
+}
+
+template<typename T, template<typename> class binary_func, int a_step, int b_step>
+void BinaryRowDefault(int64_t n, typename BinaryFuncTrait<binary_func, T>::return_type* y,
+                      const T* a, const T* b) {
+  BinaryRow<T, binary_func, a_step, b_step>(n, y, a, b);
+}
+
+#ifdef OF_CPU_ISA_DISPATCH_ENABLED
+template<typename T, template<typename> class binary_func, int a_step, int b_step>
+OF_CPU_TARGET_AVX2 void BinaryRowAvx2(int64_t n,
+                                      typename BinaryFuncTrait<binary_func, T>::return_type* y,
+                                      const T* a, const T* b) {
+  BinaryRow<T, binary_func, a_step, b_step>(n, y, a, b);
+}
+
+template<typename T, template<typename> class binary_func, int a_step, int b_step>
+OF_CPU_TARGET_AVX512 void BinaryRowAvx512(int64_t n,
+                                          typename BinaryFuncTrait<binary_func, T>::return_type* y,
+                                          const T* a, const T* b) {
+  BinaryRow<T, binary_func, a_step, b_step>(n, y, a, b);
+}
+#endif  // OF_CPU_ISA_DISPATCH_ENABLED
+
+}  // namespace cpu_broadcast_binary
+
+// Broadcast binary on CPU for shapes simplified by SimplifyBroadcastShapes. Instead of mapping
+// every output element to its input coordinates, the output is walked row by row along the last
+// axis, where each input is either contiguous or a broadcast scalar. This covers same shape,
+// scalar, row, column and inner block broadcasts. Rows are vectorized by the best instruction
+// set of the CPU and split over the ThreadPool when the output is large.
+template<typename T, template<typename> class binary_func>
+struct CpuBroadcastBinaryCore final {
+  using RetT = typename BinaryFuncTrait<binary_func, T>::return_type;
+  using RowFunc = void (*)(int64_t n, RetT* y, const T* a, const T* b);
+
+  static void Apply(const XpuVarNdarray<RetT>& y, const XpuVarNdarray<const T>& a,
+                    const XpuVarNdarray<const T>& b) {
+    const XpuShape& y_shape = y.host_shape();
+    const int64_t elem_num = y_shape.HostElemNum();
+    if (elem_num == 0) { return; }
+    const int64_t num_axes = y_shape.NumAxes();
+    CHECK_EQ(a.host_shape().NumAxes(), y_shape.NumAxes());
+    CHECK_EQ(b.host_shape().NumAxes(), y_shape.NumAxes());
+    // Strides of the inputs in each axis of y, 0 for broadcast axes
+    int64_t a_strides[OF_PP_SEQ_SIZE(DIM_SEQ)];
+    int64_t b_strides[OF_PP_SEQ_SIZE(DIM_SEQ)];
+    FOR_RANGE(int64_t, axis, 0, num_axes) {
+      const bool a_broadcast = a.host_shape().At(axis) == 1 && y_shape.At(axis) != 1;
+      const bool b_broadcast = b.host_shape().At(axis) == 1 && y_shape.At(axis) != 1;
+      a_strides[axis] = a_broadcast ? 0 : a.host_shape().DimElemNum(axis);
+      b_strides[axis] = b_broadcast ? 0 : b.host_shape().DimElemNum(axis);
+    }
+    const int64_t row_size = y_shape.At(num_axes - 1);
+    const int64_t row_num = elem_num / row_size;
+    const int64_t a_step = a_strides[num_axes - 1];
+    const int64_t b_step = b_strides[num_axes - 1];
+    const RowFunc DoRow = GetRowFunc(GetCpuIsa(), a_step, b_step);
+    RetT* y_ptr = y.ptr();
+    const T* a_ptr = a.ptr();
+    const T* b_ptr = b.ptr();
+    ThreadPool* thread_pool = Global<ThreadPool>::Get();
+    const bool parallel = thread_pool != nullptr && thread_pool->thread_num() > 1
+                          && elem_num >= cpu_broadcast_binary::kParallelMinElemNum;
+    if (row_num == 1) {
+      // A single row is split into column ranges instead
+      const auto DoCols = [&](int64_t begin, int64_t end) {
+        DoRow(end - begin, y_ptr + begin, a_ptr + begin * a_step, b_ptr + begin * b_step);
+      };
+      if (!parallel) { return DoCols(0, row_size); }
+      thread_pool->ParallelFor(0, row_size, GetGrain(row_size, thread_pool), DoCols);
+      return;
+    }
+    const auto DoRows = [&](int64_t begin, int64_t end) {
+      // Coordinate of the row in the outer axes, advanced like an odometer
+      int64_t coord[OF_PP_SEQ_SIZE(DIM_SEQ)];
+      int64_t a_offset = 0;
+      int64_t b_offset = 0;
+      int64_t remainder = begin;
+      for (int64_t axis = num_axes - 2; axis >= 0; --axis) {
+        coord[axis] = remainder % y_shape.At(axis);
+        remainder /= y_shape.At(axis);
+        a_offset += coord[axis] * a_strides[axis];
+        b_offset += coord[axis] * b_strides[axis];
+      }
+      FOR_RANGE(int64_t, row, begin, end) {
+        DoRow(row_size, y_ptr + row * row_size, a_ptr + a_offset, b_ptr + b_offset);
+        for (int64_t axis = num_axes - 2; axis >= 0; --axis) {
+          a_offset += a_strides[axis];
+          b_offset += b_strides[axis];
+          if (++coord[axis] < y_shape.At(axis)) { break; }
+          a_offset -= coord[axis] * a_strides[axis];
+          b_offset -= coord[axis] * b_strides[axis];
+          coord[axis] = 0;
+        }
+      }
+    };
+    if (!parallel) { return DoRows(0, row_num); }
+    const int64_t min_rows =
+        std::max<int64_t>(cpu_broadcast_binary::kParallelMinElemNum / 4 / row_size, 1);
+    thread_pool->ParallelFor(0, row_num, std::max(GetGrain(row_num, thread_pool), min_rows),
+                             DoRows);
+  }
+
+ private:
+  static int64_t GetGrain(int64_t num, ThreadPool* thread_pool) {
+    // A few ranges per thread leaves room for stealing
+    return std::max<int64_t>(num / (thread_pool->thread_num() * 4), 1);
+  }
+
+  static RowFunc GetRowFunc(CpuIsa isa, int64_t a_step, int64_t b_step) {
+#define SELECT_ROW_FUNC(func)                                            \
+  if (a_step == 0 && b_step == 0) { return &func<T, binary_func, 0, 0>; } \
+  if (a_step == 0) { return &func<T, binary_func, 0, 1>; }                \
+  if (b_step == 0) { return &func<T, binary_func, 1, 0>; }                \
+  return &func<T, binary_func, 1, 1>;
+#ifdef OF_CPU_ISA_DISPATCH_ENABLED
+    if (isa == CpuIsa::kAvx512) { SELECT_ROW_FUNC(cpu_broadcast_binary::BinaryRowAvx512); }
+    if (isa == CpuIsa::kAvx2) { SELECT_ROW_FUNC(cpu_broadcast_binary::BinaryRowAvx2); }
+#endif
+    SELECT_ROW_FUNC(cpu_broadcast_binary::BinaryRowDefault);
+#undef SELECT_ROW_FUNC
+  }
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_NDARRAY_CPU_BROADCAST_BINARY_CORE_H_
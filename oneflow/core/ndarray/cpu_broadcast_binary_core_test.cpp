@@ -0,0 +1,143 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/ndarray/cpu_broadcast_binary_core.h"
+#include "oneflow/core/ndarray/ndarray_apply_broadcast_binary_core.h"
+#include "oneflow/core/kernel/cpu_kernel_test_util.h"
+#include <gtest/gtest.h>
+#include <numeric>
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+struct BroadcastCase {
+  std::string name;
+  std::vector<int64_t> y_dims;
+  std::vector<int64_t> a_dims;
+  std::vector<int64_t> b_dims;
+};
+
+// Simplified shapes of the common broadcast patterns
+std::vector<BroadcastCase> BroadcastCases(int64_t scale) {
+  return {{"same_shape", {scale * scale}, {scale * scale}, {scale * scale}},
+          {"scalar", {scale * scale}, {scale * scale}, {1}},
+          {"row", {scale, scale}, {scale, scale}, {1, scale}},
+          {"column", {scale, scale}, {scale, scale}, {scale, 1}},
+          {"outer", {scale, scale}, {scale, 1}, {1, scale}},
+          {"inner_block", {scale / 16, 16, scale}, {scale / 16, 16, scale}, {1, 16, 1}},
+          {"bias_nchw", {4, scale / 4, scale / 16, 16}, {4, scale / 4, scale / 16, 16},
+           {1, scale / 4, 1, 1}}};
+}
+
+int64_t ElemNum(const std::vector<int64_t>& dims) {
+  return std::accumulate(dims.begin(), dims.end(), 1LL, std::multiplies<int64_t>());
+}
+
+// The element by element path this replaces on CPU
+template<template<typename> class binary_func>
+void GenericApply(const XpuVarNdarray<float>& y, const XpuVarNdarray<const float>& a,
+                  const XpuVarNdarray<const float>& b) {
+  switch (y.host_shape().NumAxes()) {
+    case 1: return NdarrayApplyBroadcastBinaryCore<float, 1, binary_func>::Apply(y, a, b);
+    case 2: return NdarrayApplyBroadcastBinaryCore<float, 2, binary_func>::Apply(y, a, b);
+    case 3: return NdarrayApplyBroadcastBinaryCore<float, 3, binary_func>::Apply(y, a, b);
+    case 4: return NdarrayApplyBroadcastBinaryCore<float, 4, binary_func>::Apply(y, a, b);
+    default: UNIMPLEMENTED();
+  }
+}
+
+template<template<typename> class binary_func>
+void CheckCase(const BroadcastCase& c) {
+  const std::vector<float> a = RandomFloats(ElemNum(c.a_dims), 1);
+  const std::vector<float> b = RandomFloats(ElemNum(c.b_dims), 2);
+  std::vector<float> y(ElemNum(c.y_dims));
+  std::vector<float> expected(y.size());
+  const XpuShape y_shape(c.y_dims.data(), c.y_dims.size());
+  const XpuVarNdarray<const float> a_ndarray(XpuShape(c.a_dims.data(), c.a_dims.size()), a.data());
+  const XpuVarNdarray<const float> b_ndarray(XpuShape(c.b_dims.data(), c.b_dims.size()), b.data());
+  CpuBroadcastBinaryCore<float, binary_func>::Apply(XpuVarNdarray<float>(y_shape, y.data()),
+                                                    a_ndarray, b_ndarray);
+  GenericApply<binary_func>(XpuVarNdarray<float>(y_shape, expected.data()), a_ndarray, b_ndarray);
+  ASSERT_TRUE(y == expected) << c.name;
+}
+
+}  // namespace
+
+TEST(CpuBroadcastBinaryCore, match_generic) {
+  ScopedGlobalThreadPool thread_pool;
+  // 256 is past kParallelMinElemNum, so the multi-threaded paths are covered too
+  for (int64_t scale : {16, 256}) {
+    for (const BroadcastCase& c : BroadcastCases(scale)) {
+      CheckCase<BinaryFuncAdd>(c);
+      CheckCase<BinaryFuncMul>(c);
+      CheckCase<BinaryFuncDiv>(c);
+      CheckCase<BinaryFuncMax>(c);
+    }
+  }
+}
+
+TEST(CpuBroadcastBinaryCore, inplace) {
+  std::vector<int32_t> y(6, 1);
+  const std::vector<int32_t> x{1, 2, 3};
+  const int64_t y_dims[] = {2, 3};
+  const int64_t x_dims[] = {1, 3};
+  const XpuShape y_shape(y_dims, 2);
+  CpuBroadcastBinaryCore<int32_t, BinaryFuncSub>::Apply(
+      XpuVarNdarray<int32_t>(y_shape, y.data()), XpuVarNdarray<const int32_t>(y_shape, y.data()),
+      XpuVarNdarray<const int32_t>(XpuShape(x_dims, 2), x.data()));
+  ASSERT_EQ(y, std::vector<int32_t>({0, -1, -2, 0, -1, -2}));
+}
+
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST(CpuBroadcastBinaryCore, DISABLED_benchmark_vs_generic) {
+  ScopedGlobalThreadPool thread_pool(0);
+  LOG(INFO) << "cpu isa " << static_cast<int>(GetCpuIsa()) << ", thread num "
+            << Global<ThreadPool>::Get()->thread_num();
+  const int64_t scale = 2048;
+  const int32_t iter_num = 10;
+  for (const BroadcastCase& c : BroadcastCases(scale)) {
+    const std::vector<float> a = RandomFloats(ElemNum(c.a_dims), 1);
+    const std::vector<float> b = RandomFloats(ElemNum(c.b_dims), 2);
+    std::vector<float> y(ElemNum(c.y_dims));
+    const XpuVarNdarray<float> y_ndarray(XpuShape(c.y_dims.data(), c.y_dims.size()), y.data());
+    const XpuVarNdarray<const float> a_ndarray(XpuShape(c.a_dims.data(), c.a_dims.size()),
+                                               a.data());
+    const XpuVarNdarray<const float> b_ndarray(XpuShape(c.b_dims.data(), c.b_dims.size()),
+                                               b.data());
+    std::vector<double> gbps;
+    for (bool fast : {false, true}) {
+      const auto start = std::chrono::steady_clock::now();
+      FOR_RANGE(int32_t, i, 0, iter_num) {
+        if (fast) {
+          CpuBroadcastBinaryCore<float, BinaryFuncAdd>::Apply(y_ndarray, a_ndarray, b_ndarray);
+        } else {
+          GenericApply<BinaryFuncAdd>(y_ndarray, a_ndarray, b_ndarray);
+        }
+      }
+      const double seconds =
+          std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      gbps.push_back((a.size() + b.size() + y.size()) * sizeof(float) * iter_num / seconds / 1e9);
+    }
+    LOG(INFO) << "broadcast_add " << c.name << ": generic " << gbps.at(0) << " GB/s, fast path "
+              << gbps.at(1) << " GB/s";
+  }
+}
+
+}  // namespace test
+
+}  // namespace oneflow
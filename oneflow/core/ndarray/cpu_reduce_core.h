@@ -0,0 +1,222 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_NDARRAY_CPU_REDUCE_CORE_H_
+#define ONEFLOW_CORE_NDARRAY_CPU_REDUCE_CORE_H_
+
+#include "oneflow/core/ndarray/binary_func.h"
+#include "oneflow/core/common/cpu_isa.h"
+#include "oneflow/core/thread/thread_pool.h"
+
+namespace oneflow {
+
+namespace cpu_reduce {
+
+// Independent accumulators of a contiguous reduce, they are what gets vectorized
+constexpr int64_t kLaneNum = 16;
+// Leaves of the pairwise reduce, which keeps the rounding error of float sums O(log n)
+constexpr int64_t kPairwiseBlockSize = 256;
+constexpr int64_t kPairwiseRowNum = 32;
+// Columns accumulated together, so that the partial results stay in L1
+constexpr int64_t kColBlockSize = 256;
+// Elements of a task. The tasks only depend on the shape, so results do not depend on the number
+// of threads
+constexpr int64_t kTaskElemNum = 1 << 15;
+
+template<typename T, template<typename> class binary_func>
+ALWAYS_INLINE inline T ReduceBlock(const T* x, int64_t n) {
+  T lanes[kLaneNum];
+  std::fill(lanes, lanes + kLaneNum, UnitOfBinaryFunc<T, binary_func>::Val());
+  int64_t i = 0;
+  for (; i + kLaneNum <= n; i += kLaneNum) {
+    for (int64_t j = 0; j < kLaneNum; ++j) {
+      lanes[j] = binary_func<T>::Invoke(lanes[j], x[i + j]);
+    }
+  }
+  for (; i < n; ++i) { lanes[0] = binary_func<T>::Invoke(lanes[0], x[i]); }
+  for (int64_t width = kLaneNum / 2; width > 0; width /= 2) {
+    for (int64_t j = 0; j < width; ++j) {
+      lanes[j] = binary_func<T>::Invoke(lanes[j], lanes[j + width]);
+    }
+  }
+  return lanes[0];
+}
+
+// y[c] = binary_func(y[c], x[r * x_row_stride + c]) for all rows, vectorized over the columns
+template<typename T, template<typename> class binary_func>
+ALWAYS_INLINE inline void AccumulateRows(T* y, const T* x, int64_t rows, int64_t cols,
+                                         int64_t x_row_stride) {
+  for (int64_t r = 0; r < rows; ++r) {
+    const T* x_row = x + r * x_row_stride;
+    for (int64_t c = 0; c < cols; ++c) { y[c] = binary_func<T>::Invoke(y[c], x_row[c]); }
+  }
+}
+
+#define DEFINE_CPU_REDUCE_ISA_KERNELS(suffix, target)                                     \
+  template<typename T, template<typename> class binary_func>                              \
+  target T ReduceBlock##suffix(const T* x, int64_t n) {                                   \
+    return ReduceBlock<T, binary_func>(x, n);                                             \
+  }                                                                                       \
+  template<typename T, template<typename> class binary_func>                              \
+  target void AccumulateRows##suffix(T* y, const T* x, int64_t rows, int64_t cols,        \
+                                     int64_t x_row_stride) {                              \
+    AccumulateRows<T, binary_func>(y, x, rows, cols, x_row_stride);                       \
+  }
+DEFINE_CPU_REDUCE_ISA_KERNELS(Default, )
+#ifdef OF_CPU_ISA_DISPATCH_ENABLED
+DEFINE_CPU_REDUCE_ISA_KERNELS(Avx2, OF_CPU_TARGET_AVX2)
+DEFINE_CPU_REDUCE_ISA_KERNELS(Avx512, OF_CPU_TARGET_AVX512)
+#endif
+#undef DEFINE_CPU_REDUCE_ISA_KERNELS
+
+}  // namespace cpu_reduce
+
+// Reductions on CPU for the shapes the NdarrayReduce specializations match: contiguous rows
+// (scalar, matrix row) and strided columns (matrix column, cube y). Cube xz is a row reduce
+// followed by a column reduce. Work is split into tasks of fixed size over the ThreadPool.
+template<typename T, template<typename> class binary_func>
+struct CpuReduceCore final {
+  using BlockFunc = T (*)(const T* x, int64_t n);
+  using AccumulateFunc = void (*)(T* y, const T* x, int64_t rows, int64_t cols,
+                                  int64_t x_row_stride);
+
+  // y[r] = reduce of x[r * cols, (r + 1) * cols)
+  static void RowReduce(T* y, const T* x, int64_t rows, int64_t cols) {
+    const BlockFunc Block = GetBlockFunc();
+    const int64_t chunk_num = RoundUpDiv(cols, cpu_reduce::kTaskElemNum);
+    if (chunk_num == 1) {
+      const int64_t rows_per_task = std::max<int64_t>(cpu_reduce::kTaskElemNum / cols, 1);
+      ParallelForTasks(RoundUpDiv(rows, rows_per_task), [&](int64_t task) {
+        const int64_t end = std::min(rows, (task + 1) * rows_per_task);
+        FOR_RANGE(int64_t, r, task * rows_per_task, end) {
+          y[r] = ReducePairwise(Block, x + r * cols, cols);
+        }
+      });
+      return;
+    }
+    // Rows longer than a task are reduced by chunks first
+    std::vector<T> partials(rows * chunk_num);
+    ParallelForTasks(rows * chunk_num, [&](int64_t task) {
+      const int64_t r = task / chunk_num;
+      const int64_t begin = (task % chunk_num) * cpu_reduce::kTaskElemNum;
+      const int64_t n = std::min(cols - begin, cpu_reduce::kTaskElemNum);
+      partials.at(task) = ReducePairwise(Block, x + r * cols + begin, n);
+    });
+    FOR_RANGE(int64_t, r, 0, rows) {
+      y[r] = ReducePairwise(Block, partials.data() + r * chunk_num, chunk_num);
+    }
+  }
+
+  // y[b * cols + c] = reduce of x[b * rows * cols + r * cols + c] over r
+  static void ColReduce(T* y, const T* x, int64_t batch, int64_t rows, int64_t cols) {
+    if (cols == 0) { return; }
+    if (rows == 0) {
+      std::fill(y, y + batch * cols, UnitOfBinaryFunc<T, binary_func>::Val());
+      return;
+    }
+    const AccumulateFunc Accumulate = GetAccumulateFunc();
+    const int64_t col_block_num = RoundUpDiv(cols, cpu_reduce::kColBlockSize);
+    const int64_t rows_per_chunk =
+        std::max(cpu_reduce::kTaskElemNum / cols, cpu_reduce::kPairwiseRowNum);
+    const int64_t row_chunk_num = RoundUpDiv(rows, rows_per_chunk);
+    // Reduces the rows of one column block of one chunk, or of the whole batch when there is a
+    // single chunk
+    const auto ReduceColBlock = [&](T* dst, const T* src, int64_t row_num, int64_t col_block) {
+      const int64_t begin = col_block * cpu_reduce::kColBlockSize;
+      const int64_t width = std::min(cols - begin, cpu_reduce::kColBlockSize);
+      ColReducePairwise(Accumulate, dst + begin, src + begin, row_num, width, cols);
+    };
+    if (row_chunk_num == 1) {
+      ParallelForTasks(batch * col_block_num, [&](int64_t task) {
+        const int64_t b = task / col_block_num;
+        ReduceColBlock(y + b * cols, x + b * rows * cols, rows, task % col_block_num);
+      });
+      return;
+    }
+    std::vector<T> partials(batch * row_chunk_num * cols);
+    ParallelForTasks(batch * row_chunk_num * col_block_num, [&](int64_t task) {
+      const int64_t chunk = task / col_block_num;
+      const int64_t b = chunk / row_chunk_num;
+      const int64_t row_begin = (chunk % row_chunk_num) * rows_per_chunk;
+      const int64_t row_num = std::min(rows - row_begin, rows_per_chunk);
+      ReduceColBlock(partials.data() + chunk * cols, x + (b * rows + row_begin) * cols, row_num,
+                     task % col_block_num);
+    });
+    ParallelForTasks(batch * col_block_num, [&](int64_t task) {
+      const int64_t b = task / col_block_num;
+      ReduceColBlock(y + b * cols, partials.data() + b * row_chunk_num * cols, row_chunk_num,
+                     task % col_block_num);
+    });
+  }
+
+ private:
+  static int64_t RoundUpDiv(int64_t n, int64_t d) { return (n + d - 1) / d; }
+
+  static void ParallelForTasks(int64_t task_num, const std::function<void(int64_t)>& DoTask) {
+    ThreadPool* thread_pool = Global<ThreadPool>::Get();
+    if (task_num == 1 || thread_pool == nullptr || thread_pool->thread_num() <= 1) {
+      FOR_RANGE(int64_t, task, 0, task_num) { DoTask(task); }
+      return;
+    }
+    thread_pool->ParallelFor(0, task_num, 1, [&](int64_t begin, int64_t end) {
+      FOR_RANGE(int64_t, task, begin, end) { DoTask(task); }
+    });
+  }
+
+  static T ReducePairwise(BlockFunc Block, const T* x, int64_t n) {
+    if (n <= cpu_reduce::kPairwiseBlockSize) { return Block(x, n); }
+    const int64_t half_block_num = RoundUpDiv(n, cpu_reduce::kPairwiseBlockSize) / 2;
+    const int64_t half = half_block_num * cpu_reduce::kPairwiseBlockSize;
+    return binary_func<T>::Invoke(ReducePairwise(Block, x, half),
+                                  ReducePairwise(Block, x + half, n - half));
+  }
+
+  // cols is at most kColBlockSize
+  static void ColReducePairwise(AccumulateFunc Accumulate, T* y, const T* x, int64_t rows,
+                                int64_t cols, int64_t x_row_stride) {
+    if (rows <= cpu_reduce::kPairwiseRowNum) {
+      std::fill(y, y + cols, UnitOfBinaryFunc<T, binary_func>::Val());
+      Accumulate(y, x, rows, cols, x_row_stride);
+      return;
+    }
+    const int64_t half = rows / 2;
+    T right[cpu_reduce::kColBlockSize];
+    ColReducePairwise(Accumulate, y, x, half, cols, x_row_stride);
+    ColReducePairwise(Accumulate, right, x + half * x_row_stride, rows - half, cols,
+                      x_row_stride);
+    FOR_RANGE(int64_t, c, 0, cols) { y[c] = binary_func<T>::Invoke(y[c], right[c]); }
+  }
+
+#define SELECT_CPU_REDUCE_ISA_KERNEL(func)                                                    \
+  switch (GetCpuIsa()) {                                                                      \
+    OF_CPU_REDUCE_ISA_CASES(func)                                                             \
+    default: return &cpu_reduce::func##Default<T, binary_func>;                              \
+  }
+#ifdef OF_CPU_ISA_DISPATCH_ENABLED
+#define OF_CPU_REDUCE_ISA_CASES(func)                                      \
+  case CpuIsa::kAvx512: return &cpu_reduce::func##Avx512<T, binary_func>; \
+  case CpuIsa::kAvx2: return &cpu_reduce::func##Avx2<T, binary_func>;
+#else
+#define OF_CPU_REDUCE_ISA_CASES(func)
+#endif
+  static BlockFunc GetBlockFunc() { SELECT_CPU_REDUCE_ISA_KERNEL(ReduceBlock); }
+  static AccumulateFunc GetAccumulateFunc() { SELECT_CPU_REDUCE_ISA_KERNEL(AccumulateRows); }
+#undef OF_CPU_REDUCE_ISA_CASES
+#undef SELECT_CPU_REDUCE_ISA_KERNEL
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_NDARRAY_CPU_REDUCE_CORE_H_
@@ -0,0 +1,157 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/ndarray/ndarray_reduce.h"
+#include "oneflow/core/kernel/cpu_kernel_test_util.h"
+#include <gtest/gtest.h>
+#include <numeric>
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+struct ReduceCase {
+  std::string name;
+  std::vector<int64_t> x_dims;
+  std::vector<int64_t> y_dims;
+};
+
+// Shapes of softmax, bias_add grads and full reductions, one for each specialization
+std::vector<ReduceCase> ReduceCases(int64_t scale) {
+  return {{"scalar", {scale * scale}, {1}},
+          {"softmax_row", {scale * 4, scale}, {scale * 4, 1}},
+          {"bias_add_grad_nhwc", {scale * 32, scale / 4}, {1, scale / 4}},
+          {"cube_y", {scale / 8, scale, scale / 8}, {scale / 8, 1, scale / 8}},
+          {"bias_add_grad_nchw", {32, scale / 4, scale}, {1, scale / 4, 1}}};
+}
+
+Shape ToShape(const std::vector<int64_t>& dims) {
+  return Shape(DimVector(dims.begin(), dims.end()));
+}
+
+int64_t ElemNum(const std::vector<int64_t>& dims) {
+  return std::accumulate(dims.begin(), dims.end(), 1LL, std::multiplies<int64_t>());
+}
+
+// Sums in double, as the reference of the float results
+std::vector<double> ReferenceSum(const ReduceCase& c, const std::vector<float>& x) {
+  std::vector<double> y(ElemNum(c.y_dims), 0);
+  const int64_t num_axes = c.x_dims.size();
+  std::vector<int64_t> coord(num_axes, 0);
+  for (float value : x) {
+    int64_t offset = 0;
+    FOR_RANGE(int64_t, axis, 0, num_axes) {
+      offset = offset * c.y_dims.at(axis) + (c.y_dims.at(axis) == 1 ? 0 : coord.at(axis));
+    }
+    y.at(offset) += value;
+    for (int64_t axis = num_axes - 1; axis >= 0; --axis) {
+      if (++coord.at(axis) < c.x_dims.at(axis)) { break; }
+      coord.at(axis) = 0;
+    }
+  }
+  return y;
+}
+
+}  // namespace
+
+TEST(CpuReduceCore, match_reference) {
+  ScopedGlobalThreadPool thread_pool;
+  // 128 is past kTaskElemNum for most cases, so the multi-threaded paths are covered too
+  for (int64_t scale : {16, 128}) {
+    for (const ReduceCase& c : ReduceCases(scale)) {
+      const std::vector<float> x = RandomFloats(ElemNum(c.x_dims), 1, 0, 1);
+      std::vector<float> tmp(x.size());
+      std::vector<float> y(ElemNum(c.y_dims));
+      NdarrayReduce<DeviceType::kCPU, float, BinaryFuncSum>::Reduce(
+          nullptr, XpuVarNdarray<float>(ToShape(c.y_dims), y.data()),
+          XpuVarNdarray<const float>(ToShape(c.x_dims), x.data()),
+          XpuVarNdarray<float>(ToShape(c.x_dims), tmp.data()));
+      const std::vector<double> expected = ReferenceSum(c, x);
+      FOR_RANGE(size_t, i, 0, y.size()) {
+        ASSERT_NEAR(y.at(i), expected.at(i), 1e-5 * expected.at(i) + 1e-5) << c.name;
+      }
+      std::vector<float> max_y(y.size());
+      std::vector<float> default_max_y(y.size());
+      NdarrayReduce<DeviceType::kCPU, float, BinaryFuncMax>::Reduce(
+          nullptr, XpuVarNdarray<float>(ToShape(c.y_dims), max_y.data()),
+          XpuVarNdarray<const float>(ToShape(c.x_dims), x.data()),
+          XpuVarNdarray<float>(ToShape(c.x_dims), tmp.data()));
+      NdarrayDefaultReduce<DeviceType::kCPU, float, BinaryFuncMax>::Reduce(
+          nullptr, XpuVarNdarray<float>(ToShape(c.y_dims), default_max_y.data()),
+          XpuVarNdarray<const float>(ToShape(c.x_dims), x.data()),
+          XpuVarNdarray<float>(ToShape(c.x_dims), tmp.data()));
+      ASSERT_TRUE(max_y == default_max_y) << c.name;
+    }
+  }
+}
+
+TEST(CpuReduceCore, pairwise_sum_accuracy) {
+  // Summed one by one in float, 0.1 * 2^22 would be off by more than 1%
+  const std::vector<float> x(1 << 22, 0.1f);
+  float y = 0;
+  CpuReduceCore<float, BinaryFuncSum>::RowReduce(&y, x.data(), 1, x.size());
+  ASSERT_NEAR(y, 0.1 * x.size(), 1e-6 * 0.1 * x.size());
+  std::vector<float> col_y(4);
+  CpuReduceCore<float, BinaryFuncSum>::ColReduce(col_y.data(), x.data(), 1, x.size() / 4, 4);
+  for (float sum : col_y) { ASSERT_NEAR(sum, 0.1 * x.size() / 4, 1e-6 * 0.1 * x.size()); }
+}
+
+TEST(CpuReduceCore, empty) {
+  std::vector<float> y(6, 1);
+  CpuReduceCore<float, BinaryFuncSum>::ColReduce(y.data(), nullptr, 2, 3, 0);
+  ASSERT_EQ(y, std::vector<float>(6, 1));
+  CpuReduceCore<float, BinaryFuncSum>::ColReduce(y.data(), nullptr, 2, 0, 3);
+  ASSERT_EQ(y, std::vector<float>(6, 0));
+  CpuReduceCore<float, BinaryFuncMax>::RowReduce(y.data(), nullptr, 2, 0);
+  ASSERT_EQ(y.at(0), GetMinVal<float>());
+}
+
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST(CpuReduceCore, DISABLED_benchmark_vs_default_reduce) {
+  ScopedGlobalThreadPool thread_pool(0);
+  const int32_t iter_num = 5;
+  for (const ReduceCase& c : ReduceCases(1024)) {
+    const std::vector<float> x = RandomFloats(ElemNum(c.x_dims), 1, 0, 1);
+    std::vector<float> tmp(x.size());
+    std::vector<float> y(ElemNum(c.y_dims));
+    std::vector<double> gbps;
+    for (bool fast : {false, true}) {
+      const auto start = std::chrono::steady_clock::now();
+      FOR_RANGE(int32_t, i, 0, iter_num) {
+        const XpuVarNdarray<float> y_ndarray(ToShape(c.y_dims), y.data());
+        const XpuVarNdarray<const float> x_ndarray(ToShape(c.x_dims), x.data());
+        const XpuVarNdarray<float> tmp_ndarray(ToShape(c.x_dims), tmp.data());
+        if (fast) {
+          NdarrayReduce<DeviceType::kCPU, float, BinaryFuncSum>::Reduce(nullptr, y_ndarray,
+                                                                        x_ndarray, tmp_ndarray);
+        } else {
+          NdarrayDefaultReduce<DeviceType::kCPU, float, BinaryFuncSum>::Reduce(
+              nullptr, y_ndarray, x_ndarray, tmp_ndarray);
+        }
+      }
+      const double seconds =
+          std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      gbps.push_back(x.size() * sizeof(float) * iter_num / seconds / 1e9);
+    }
+    LOG(INFO) << "reduce_sum " << c.name << ": default " << gbps.at(0) << " GB/s, specialized "
+              << gbps.at(1) << " GB/s";
+  }
+}
+
+}  // namespace test
+
+}  // namespace oneflow
@@ -0,0 +1,98 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_NDARRAY_CPU_WELFORD_H_
+#define ONEFLOW_CORE_NDARRAY_CPU_WELFORD_H_
+
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+// Single pass mean and m2 (the sum of squared deviations from the mean) for CPU kernels. They
+// are ALWAYS_INLINE so that kernels can wrap them into OF_CPU_TARGET_* variants.
+namespace cpu_welford {
+
+// Independent accumulators of a row, they are what gets vectorized
+constexpr int64_t kLaneNum = 16;
+
+// Merges the statistics of b into those of a
+template<typename T>
+ALWAYS_INLINE inline void Combine(T a_count, T* a_mean, T* a_m2, T b_count, T b_mean, T b_m2) {
+  const T count = a_count + b_count;
+  if (count == 0) { return; }
+  const T delta = b_mean - *a_mean;
+  const T b_ratio = b_count / count;
+  *a_mean += delta * b_ratio;
+  *a_m2 += b_m2 + delta * delta * a_count * b_ratio;
+}
+
+// Welford over kLaneNum interleaved lanes, the lanes are merged pairwise and the tail is added
+// one by one
+template<typename T>
+ALWAYS_INLINE inline void Row(const T* x, int64_t n, T* mean, T* m2) {
+  T lane_mean[kLaneNum] = {};
+  T lane_m2[kLaneNum] = {};
+  const int64_t step_num = n / kLaneNum;
+  FOR_RANGE(int64_t, s, 0, step_num) {
+    const T inv_count = static_cast<T>(1) / static_cast<T>(s + 1);
+    const T* x_step = x + s * kLaneNum;
+    for (int64_t j = 0; j < kLaneNum; ++j) {
+      const T delta = x_step[j] - lane_mean[j];
+      lane_mean[j] += delta * inv_count;
+      lane_m2[j] += delta * (x_step[j] - lane_mean[j]);
+    }
+  }
+  T count = static_cast<T>(step_num);
+  for (int64_t width = kLaneNum / 2; width > 0; width /= 2) {
+    for (int64_t j = 0; j < width; ++j) {
+      const T delta = lane_mean[j + width] - lane_mean[j];
+      lane_mean[j] = (lane_mean[j] + lane_mean[j + width]) * static_cast<T>(0.5);
+      lane_m2[j] += lane_m2[j + width] + delta * delta * count * static_cast<T>(0.5);
+    }
+    count *= 2;
+  }
+  T cur_mean = lane_mean[0];
+  T cur_m2 = lane_m2[0];
+  FOR_RANGE(int64_t, i, step_num * kLaneNum, n) {
+    const T delta = x[i] - cur_mean;
+    cur_mean += delta / static_cast<T>(i + 1);
+    cur_m2 += delta * (x[i] - cur_mean);
+  }
+  *mean = cur_mean;
+  *m2 = cur_m2;
+}
+
+// Welford of each column of a rows x cols block, vectorized over the columns
+template<typename T>
+ALWAYS_INLINE inline void Cols(const T* x, int64_t rows, int64_t cols, int64_t row_stride, T* mean,
+                               T* m2) {
+  std::fill_n(mean, cols, 0);
+  std::fill_n(m2, cols, 0);
+  for (int64_t r = 0; r < rows; ++r) {
+    const T inv_count = static_cast<T>(1) / static_cast<T>(r + 1);
+    const T* x_row = x + r * row_stride;
+    for (int64_t c = 0; c < cols; ++c) {
+      const T delta = x_row[c] - mean[c];
+      mean[c] += delta * inv_count;
+      m2[c] += delta * (x_row[c] - mean[c]);
+    }
+  }
+}
+
+}  // namespace cpu_welford
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_NDARRAY_CPU_WELFORD_H_
@@ -15,19 +15,28 @@ limitations under the License.
 */
 #include "oneflow/core/ndarray/ndarray_apply_binary_core.h"
 #include "oneflow/core/ndarray/binary_func.h"
+#include "oneflow/core/ndarray/cpu_broadcast_binary_core.h"
 
 namespace oneflow {
 
 template<typename T, template<typename> class binary_func>
 struct NdarrayApplyBinaryCoreWrapper<DeviceType::kCPU, T, binary_func> final {
-  static void Apply(DeviceCtx* ctx,
-                    const XpuVarNdarray<typename BinaryFuncTrait<binary_func, T>::return_type>& y,
-                    const XpuVarNdarray<const T>& a, const XpuVarNdarray<const T>& b) {
-    NdarrayApplyBinaryCore<T, binary_func>::Apply(y.shape().ElemNum(), y.ptr(), a.ptr(), b.ptr());
+  using RetT = typename BinaryFuncTrait<binary_func, T>::return_type;
+  static void Apply(DeviceCtx* ctx, const XpuVarNdarray<RetT>& y, const XpuVarNdarray<const T>& a,
+                    const XpuVarNdarray<const T>& b) {
+    const int64_t elem_num = y.host_shape().HostElemNum();
+    const XpuShape shape(&elem_num, 1);
+    CpuBroadcastBinaryCore<T, binary_func>::Apply(XpuVarNdarray<RetT>(shape, y.ptr()),
+                                                  XpuVarNdarray<const T>(shape, a.ptr()),
+                                                  XpuVarNdarray<const T>(shape, b.ptr()));
   }
   static void InplaceApply(DeviceCtx* ctx, const XpuVarNdarray<T>& y,
                            const XpuVarNdarray<const T>& x) {
-    NdarrayApplyBinaryCore<T, binary_func>::InplaceApply(y.shape().ElemNum(), y.ptr(), x.ptr());
+    const int64_t elem_num = y.host_shape().HostElemNum();
+    const XpuShape shape(&elem_num, 1);
+    CpuBroadcastBinaryCore<T, binary_func>::Apply(XpuVarNdarray<T>(shape, y.ptr()),
+                                                  XpuVarNdarray<const T>(shape, y.ptr()),
+                                                  XpuVarNdarray<const T>(shape, x.ptr()));
   }
 };
 
@@ -34,6 +34,10 @@ class BinaryInStream {
   virtual void set_cur_file_pos(uint64_t val) = 0;
   virtual bool IsEof() const = 0;
 
+  // Reads n bytes starting at offset without moving cur_file_pos, safe for concurrent use
+  virtual bool SupportReadAt() const { return false; }
+  virtual void ReadAt(uint64_t offset, char* s, size_t n) const { UNIMPLEMENTED(); }
+
  protected:
   BinaryInStream() = default;
 };
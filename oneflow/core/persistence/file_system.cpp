@@ -20,6 +20,7 @@ limitations under the License.
 #include "oneflow/core/job/job_set.pb.h"
 #include "oneflow/core/persistence/hadoop/hadoop_file_system.h"
 #include "oneflow/core/persistence/posix/posix_file_system.h"
+#include "oneflow/core/persistence/posix/uring_file_system.h"
 #include "oneflow/core/job/job_set.pb.h"
 
 namespace oneflow {
@@ -122,6 +123,13 @@ fs::FileSystem* HadoopFS(const HdfsConf& hdfs_conf) {
   return fs;
 }
 
+fs::FileSystem* LocalUringFS(const LocalUringFsConf& local_uring_fs_conf) {
+#ifdef OF_PLATFORM_POSIX
+  static fs::FileSystem* fs = new fs::UringFileSystem(local_uring_fs_conf);
+#endif
+  return fs;
+}
+
 fs::FileSystem* GetFS(const FileSystemConf& file_system_conf) {
   if (file_system_conf.has_localfs_conf()) {
     return LocalFS();
@@ -129,6 +137,8 @@ fs::FileSystem* GetFS(const FileSystemConf& file_system_conf) {
     return NetworkFS();
   } else if (file_system_conf.has_hdfs_conf()) {
     return HadoopFS(file_system_conf.hdfs_conf());
+  } else if (file_system_conf.has_local_uring_fs_conf()) {
+    return LocalUringFS(file_system_conf.local_uring_fs_conf());
   } else {
     UNIMPLEMENTED();
   }
@@ -37,6 +37,13 @@ size_t GetBufferSize(int64_t session_id) {
   }
 }
 
+int32_t GetReadAheadChunkNum(int64_t session_id) {
+  const auto& io_conf = *Global<const IOConf>::Get(session_id);
+  const int32_t chunk_num = io_conf.persistence_read_ahead_chunk_num();
+  CHECK_GE(chunk_num, 0);
+  return chunk_num;
+}
+
 }  // namespace
 
 PersistentInStream::PersistentInStream(fs::FileSystem* fs,
@@ -61,7 +68,14 @@ PersistentInStream::PersistentInStream(int64_t session_id, fs::FileSystem* fs,
   } else {
     stream_scanner_.reset(new AcyclicStreamScanner(fs, streams, offset));
   }
-  buffer_.resize(GetBufferSize(session_id) + 1);
+  const size_t buffer_size = GetBufferSize(session_id);
+  buffer_.resize(buffer_size + 1);
+  const int32_t read_ahead_chunk_num = GetReadAheadChunkNum(session_id);
+  // Streams with local copy have to be read sequentially
+  if (read_ahead_chunk_num > 0 && stream_scanner_->SupportReadAt()) {
+    prefetcher_.reset(
+        new StreamPrefetcher(stream_scanner_.get(), buffer_size, read_ahead_chunk_num));
+  }
   cur_buf_begin_ = buffer_.data();
   cur_buf_end_ = buffer_.data();
   *cur_buf_end_ = '\0';
@@ -122,13 +136,15 @@ int32_t PersistentInStream::ReadFully(char* s, size_t n) {
 
 void PersistentInStream::UpdateBuffer() {
   CHECK_EQ(cur_buf_begin_, cur_buf_end_);
-  uint64_t n = stream_scanner_->UpdateBuffer(&buffer_);
+  uint64_t n = prefetcher_ ? prefetcher_->UpdateBuffer(&buffer_)
+                          : stream_scanner_->UpdateBuffer(&buffer_);
   cur_buf_begin_ = buffer_.data();
   cur_buf_end_ = buffer_.data() + n;
   *cur_buf_end_ = '\0';
 }
 
 bool PersistentInStream::IsEof() const {
-  return cur_buf_begin_ == cur_buf_end_ && stream_scanner_->IsEof();
+  if (cur_buf_begin_ != cur_buf_end_) { return false; }
+  return prefetcher_ ? prefetcher_->IsEof() : stream_scanner_->IsEof();
 }
 }  // namespace oneflow
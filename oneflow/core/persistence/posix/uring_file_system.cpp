@@ -0,0 +1,527 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/persistence/posix/uring_file_system.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cstring>
+
+#if defined(__linux__) && defined(__NR_io_uring_setup) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define OF_WITH_IO_URING
+#endif
+
+namespace oneflow {
+
+namespace fs {
+
+namespace {
+
+// Offsets, sizes and buffers of O_DIRECT io must be multiples of the logical block size, which is
+// at most 4KiB on the devices we care about
+constexpr size_t kDirectIoAlignment = 4096;
+
+uint64_t RoundDown(uint64_t val) { return val / kDirectIoAlignment * kDirectIoAlignment; }
+uint64_t RoundUp(uint64_t val) { return RoundDown(val + kDirectIoAlignment - 1); }
+
+bool IsAligned(uint64_t offset, size_t n, const char* buf) {
+  return offset % kDirectIoAlignment == 0 && n % kDirectIoAlignment == 0
+         && reinterpret_cast<uintptr_t>(buf) % kDirectIoAlignment == 0;
+}
+
+class AlignedBuffer final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(AlignedBuffer);
+  explicit AlignedBuffer(size_t size) : data_(nullptr) {
+    CHECK_EQ(posix_memalign(reinterpret_cast<void**>(&data_), kDirectIoAlignment, size), 0);
+  }
+  ~AlignedBuffer() { free(data_); }
+
+  char* data() const { return data_; }
+
+ private:
+  char* data_;
+};
+
+}  // namespace
+
+// One readv or writev, advanced in place on short transfers
+struct IoRequest {
+  struct iovec iov;
+  uint64_t offset;
+  // bytes that have to be transferred, the rest of a read may be cut off by the end of the file
+  size_t required;
+  // leading bytes transferred before, resubmitted to keep O_DIRECT offsets aligned
+  size_t redone = 0;
+};
+
+#ifdef OF_WITH_IO_URING
+
+class IoUring final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(IoUring);
+  ~IoUring();
+
+  // nullptr when the kernel does not support io_uring or it is forbidden by seccomp
+  static std::unique_ptr<IoUring> New(uint32_t depth);
+
+  uint32_t depth() const { return depth_; }
+  // Queues req, which has to stay alive until its completion is popped
+  void Prepare(bool is_write, int fd, IoRequest* req);
+  // Submits all queued requests and waits for at least min_complete completions
+  void SubmitAndWait(uint32_t min_complete);
+  bool PopCompletion(IoRequest** req, int32_t* res);
+
+ private:
+  IoUring() = default;
+
+  uint32_t depth_ = 0;
+  int ring_fd_ = -1;
+  uint32_t num_to_submit_ = 0;
+  void* sq_ring_ = MAP_FAILED;
+  size_t sq_ring_size_ = 0;
+  void* cq_ring_ = MAP_FAILED;
+  size_t cq_ring_size_ = 0;
+  io_uring_sqe* sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+  size_t sqes_size_ = 0;
+  uint32_t* sq_tail_ = nullptr;
+  uint32_t* sq_mask_ = nullptr;
+  uint32_t* sq_array_ = nullptr;
+  uint32_t* cq_head_ = nullptr;
+  uint32_t* cq_tail_ = nullptr;
+  uint32_t* cq_mask_ = nullptr;
+  io_uring_cqe* cqes_ = nullptr;
+};
+
+IoUring::~IoUring() {
+  if (sqes_ != MAP_FAILED) { munmap(sqes_, sqes_size_); }
+  if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) { munmap(cq_ring_, cq_ring_size_); }
+  if (sq_ring_ != MAP_FAILED) { munmap(sq_ring_, sq_ring_size_); }
+  if (ring_fd_ >= 0) { close(ring_fd_); }
+}
+
+std::unique_ptr<IoUring> IoUring::New(uint32_t depth) {
+  std::unique_ptr<IoUring> ring(new IoUring());
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  ring->ring_fd_ = static_cast<int>(syscall(__NR_io_uring_setup, depth, &params));
+  if (ring->ring_fd_ < 0) { return nullptr; }
+  ring->depth_ = depth;
+  ring->sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  ring->cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap) {
+    ring->sq_ring_size_ = std::max(ring->sq_ring_size_, ring->cq_ring_size_);
+    ring->cq_ring_size_ = ring->sq_ring_size_;
+  }
+  ring->sq_ring_ = mmap(nullptr, ring->sq_ring_size_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->ring_fd_, IORING_OFF_SQ_RING);
+  if (ring->sq_ring_ == MAP_FAILED) { return nullptr; }
+  if (single_mmap) {
+    ring->cq_ring_ = ring->sq_ring_;
+  } else {
+    ring->cq_ring_ = mmap(nullptr, ring->cq_ring_size_, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring->ring_fd_, IORING_OFF_CQ_RING);
+    if (ring->cq_ring_ == MAP_FAILED) { return nullptr; }
+  }
+  ring->sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  ring->sqes_ = static_cast<io_uring_sqe*>(mmap(nullptr, ring->sqes_size_, PROT_READ | PROT_WRITE,
+                                                MAP_SHARED | MAP_POPULATE, ring->ring_fd_,
+                                                IORING_OFF_SQES));
+  if (ring->sqes_ == MAP_FAILED) { return nullptr; }
+  char* sq_ring = static_cast<char*>(ring->sq_ring_);
+  char* cq_ring = static_cast<char*>(ring->cq_ring_);
+  ring->sq_tail_ = reinterpret_cast<uint32_t*>(sq_ring + params.sq_off.tail);
+  ring->sq_mask_ = reinterpret_cast<uint32_t*>(sq_ring + params.sq_off.ring_mask);
+  ring->sq_array_ = reinterpret_cast<uint32_t*>(sq_ring + params.sq_off.array);
+  ring->cq_head_ = reinterpret_cast<uint32_t*>(cq_ring + params.cq_off.head);
+  ring->cq_tail_ = reinterpret_cast<uint32_t*>(cq_ring + params.cq_off.tail);
+  ring->cq_mask_ = reinterpret_cast<uint32_t*>(cq_ring + params.cq_off.ring_mask);
+  ring->cqes_ = reinterpret_cast<io_uring_cqe*>(cq_ring + params.cq_off.cqes);
+  return ring;
+}
+
+void IoUring::Prepare(bool is_write, int fd, IoRequest* req) {
+  CHECK_LT(num_to_submit_, depth_);
+  // Only this thread produces submissions, the kernel reads the tail
+  const uint32_t tail = *sq_tail_;
+  const uint32_t index = tail & *sq_mask_;
+  io_uring_sqe* sqe = &sqes_[index];
+  std::memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = is_write ? IORING_OP_WRITEV : IORING_OP_READV;
+  sqe->fd = fd;
+  sqe->off = req->offset;
+  sqe->addr = reinterpret_cast<uint64_t>(&req->iov);
+  sqe->len = 1;
+  sqe->user_data = reinterpret_cast<uint64_t>(req);
+  sq_array_[index] = index;
+  __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+  num_to_submit_ += 1;
+}
+
+void IoUring::SubmitAndWait(uint32_t min_complete) {
+  while (true) {
+    const int ret = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd_, num_to_submit_,
+                                             min_complete, IORING_ENTER_GETEVENTS, nullptr, 0));
+    if (ret >= 0) {
+      CHECK_LE(static_cast<uint32_t>(ret), num_to_submit_);
+      num_to_submit_ -= static_cast<uint32_t>(ret);
+      if (num_to_submit_ == 0) { return; }
+    } else {
+      PCHECK(errno == EINTR || errno == EAGAIN) << "Fail to submit to io_uring";
+    }
+  }
+}
+
+bool IoUring::PopCompletion(IoRequest** req, int32_t* res) {
+  const uint32_t head = *cq_head_;
+  if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) { return false; }
+  const io_uring_cqe* cqe = &cqes_[head & *cq_mask_];
+  *req = reinterpret_cast<IoRequest*>(cqe->user_data);
+  *res = cqe->res;
+  __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+#else
+
+class IoUring final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(IoUring);
+  ~IoUring() = default;
+
+  static std::unique_ptr<IoUring> New(uint32_t depth) { return nullptr; }
+
+  uint32_t depth() const {
+    UNIMPLEMENTED();
+    return 0;
+  }
+  void Prepare(bool is_write, int fd, IoRequest* req) { UNIMPLEMENTED(); }
+  void SubmitAndWait(uint32_t min_complete) { UNIMPLEMENTED(); }
+  bool PopCompletion(IoRequest** req, int32_t* res) {
+    UNIMPLEMENTED();
+    return false;
+  }
+};
+
+#endif  // OF_WITH_IO_URING
+
+namespace {
+
+// Returns whether req is done after transferring res bytes. The rest of a short transfer is
+// resubmitted from its offset rounded down to alignment, which O_DIRECT requires
+bool AdvanceIoRequest(bool is_write, size_t alignment, IoRequest* req, int32_t res) {
+  if (res == -EINTR || res == -EAGAIN) { return false; }
+  CHECK_GE(res, 0) << "Fail to " << (is_write ? "write" : "read") << ": " << std::strerror(-res);
+  if (!is_write && static_cast<size_t>(res) <= req->redone) {
+    CHECK_LE(req->required, static_cast<size_t>(res)) << "Read EOF";
+    return true;
+  }
+  req->iov.iov_base = static_cast<char*>(req->iov.iov_base) + res;
+  req->iov.iov_len -= res;
+  req->offset += res;
+  req->required -= std::min<size_t>(req->required, res);
+  req->redone = 0;
+  if (req->iov.iov_len == 0 || (!is_write && req->required == 0)) { return true; }
+  const size_t unaligned = req->offset % alignment;
+  req->iov.iov_base = static_cast<char*>(req->iov.iov_base) - unaligned;
+  req->iov.iov_len += unaligned;
+  req->offset -= unaligned;
+  req->required += unaligned;
+  req->redone = unaligned;
+  return false;
+}
+
+size_t IoAlignment(bool is_direct) { return is_direct ? kDirectIoAlignment : 1; }
+
+void RunIo(IoUring* ring, bool is_write, size_t alignment, int fd, std::vector<IoRequest>* reqs) {
+  if (ring == nullptr) {
+    for (IoRequest& req : *reqs) {
+      bool done = false;
+      while (!done) {
+        const ssize_t ret = is_write ? pwrite(fd, req.iov.iov_base, req.iov.iov_len, req.offset)
+                                     : pread(fd, req.iov.iov_base, req.iov.iov_len, req.offset);
+        done = AdvanceIoRequest(is_write, alignment, &req,
+                                ret >= 0 ? static_cast<int32_t>(ret) : -errno);
+      }
+    }
+    return;
+  }
+  size_t next = 0;
+  uint32_t num_in_flight = 0;
+  while (next < reqs->size() || num_in_flight > 0) {
+    while (next < reqs->size() && num_in_flight < ring->depth()) {
+      ring->Prepare(is_write, fd, &reqs->at(next));
+      next += 1;
+      num_in_flight += 1;
+    }
+    ring->SubmitAndWait(1);
+    IoRequest* req = nullptr;
+    int32_t res = 0;
+    std::vector<IoRequest*> unfinished;
+    while (ring->PopCompletion(&req, &res)) {
+      num_in_flight -= 1;
+      if (!AdvanceIoRequest(is_write, alignment, req, res)) { unfinished.push_back(req); }
+    }
+    for (IoRequest* unfinished_req : unfinished) {
+      ring->Prepare(is_write, fd, unfinished_req);
+      num_in_flight += 1;
+    }
+  }
+}
+
+// Splits [offset, offset + n) into block_size requests, of which the first required bytes have to
+// be transferred
+std::vector<IoRequest> SplitIoRequests(uint64_t offset, size_t n, char* buf, size_t required,
+                                       size_t block_size) {
+  std::vector<IoRequest> reqs;
+  for (size_t pos = 0; pos < n; pos += block_size) {
+    IoRequest req;
+    req.iov.iov_base = buf + pos;
+    req.iov.iov_len = std::min(block_size, n - pos);
+    req.offset = offset + pos;
+    req.required = required > pos ? std::min(req.iov.iov_len, required - pos) : 0;
+    reqs.push_back(req);
+  }
+  return reqs;
+}
+
+class UringRandomAccessFile final : public RandomAccessFile {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(UringRandomAccessFile);
+  UringRandomAccessFile(UringFileSystem* fs, const std::string& fname, int fd, bool is_direct,
+                        size_t block_size, size_t queue_depth)
+      : fs_(fs),
+        fname_(fname),
+        fd_(fd),
+        is_direct_(is_direct),
+        block_size_(block_size),
+        queue_depth_(queue_depth) {}
+  ~UringRandomAccessFile() override { close(fd_); }
+
+  void Read(uint64_t offset, size_t n, char* result) const override {
+    if (n == 0) { return; }
+    std::unique_ptr<IoUring> ring = fs_->AcquireRing();
+    if (!is_direct_ || IsAligned(offset, n, result)) {
+      std::vector<IoRequest> reqs = SplitIoRequests(offset, n, result, n, block_size_);
+      RunIo(ring.get(), false, IoAlignment(is_direct_), fd_, &reqs);
+    } else {
+      // Read whole aligned blocks into a bounce buffer, one window of queue_depth blocks at a time
+      const uint64_t aligned_begin = RoundDown(offset);
+      const uint64_t aligned_end = RoundUp(offset + n);
+      const size_t window_size = std::min(aligned_end - aligned_begin, block_size_ * queue_depth_);
+      AlignedBuffer bounce(window_size);
+      for (uint64_t begin = aligned_begin; begin < aligned_end; begin += window_size) {
+        const uint64_t end = std::min<uint64_t>(begin + window_size, aligned_end);
+        const uint64_t copy_begin = std::max(begin, offset);
+        const uint64_t copy_end = std::min(end, offset + n);
+        std::vector<IoRequest> reqs =
+            SplitIoRequests(begin, end - begin, bounce.data(), copy_end - begin, block_size_);
+        RunIo(ring.get(), false, kDirectIoAlignment, fd_, &reqs);
+        std::memcpy(result + (copy_begin - offset), bounce.data() + (copy_begin - begin),
+                    copy_end - copy_begin);
+      }
+    }
+    fs_->ReleaseRing(std::move(ring));
+  }
+
+ private:
+  UringFileSystem* fs_;
+  std::string fname_;
+  int fd_;
+  bool is_direct_;
+  size_t block_size_;
+  size_t queue_depth_;
+};
+
+// Appended data is staged in an aligned buffer of queue_depth blocks, which are written
+// concurrently once the buffer is full. With O_DIRECT the last partial block is written padded
+// with zeros and rewritten by the next write, and the file is truncated to its real size on Close
+class UringWritableFile final : public WritableFile {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(UringWritableFile);
+  UringWritableFile(UringFileSystem* fs, const std::string& fname, int fd, bool is_direct,
+                    uint64_t file_offset, size_t block_size, size_t queue_depth)
+      : fs_(fs),
+        fname_(fname),
+        fd_(fd),
+        is_direct_(is_direct),
+        block_size_(block_size),
+        ring_(fs->AcquireRing()),
+        staging_(block_size * queue_depth),
+        staging_capacity_(block_size * queue_depth),
+        staging_size_(0),
+        file_offset_(file_offset) {
+    if (is_direct) { CHECK_EQ(file_offset % kDirectIoAlignment, 0); }
+  }
+  ~UringWritableFile() override {
+    if (fd_ >= 0) { Close(); }
+  }
+
+  void Append(const char* data, size_t n) override {
+    while (n > 0) {
+      const size_t copy_size = std::min(n, staging_capacity_ - staging_size_);
+      std::memcpy(staging_.data() + staging_size_, data, copy_size);
+      staging_size_ += copy_size;
+      data += copy_size;
+      n -= copy_size;
+      if (staging_size_ == staging_capacity_) { WriteStaging(); }
+    }
+  }
+
+  void Close() override {
+    Flush();
+    if (is_direct_) {
+      PCHECK(ftruncate(fd_, file_offset_ + staging_size_) == 0) << "Fail to truncate " << fname_;
+    }
+    PCHECK(close(fd_) == 0) << "Fail to close file " << fname_;
+    fd_ = -1;
+    fs_->ReleaseRing(std::move(ring_));
+  }
+
+  void Flush() override {
+    if (staging_size_ > 0) { WriteStaging(); }
+  }
+
+ private:
+  void WriteStaging() {
+    size_t write_size = staging_size_;
+    if (is_direct_) {
+      write_size = RoundUp(staging_size_);
+      std::memset(staging_.data() + staging_size_, 0, write_size - staging_size_);
+    }
+    std::vector<IoRequest> reqs =
+        SplitIoRequests(file_offset_, write_size, staging_.data(), write_size, block_size_);
+    RunIo(ring_.get(), true, IoAlignment(is_direct_), fd_, &reqs);
+    const size_t done_size = is_direct_ ? RoundDown(staging_size_) : staging_size_;
+    std::memmove(staging_.data(), staging_.data() + done_size, staging_size_ - done_size);
+    staging_size_ -= done_size;
+    file_offset_ += done_size;
+  }
+
+  UringFileSystem* fs_;
+  std::string fname_;
+  int fd_;
+  bool is_direct_;
+  size_t block_size_;
+  std::unique_ptr<IoUring> ring_;
+  AlignedBuffer staging_;
+  size_t staging_capacity_;
+  size_t staging_size_;
+  // file offset of the first staged byte
+  uint64_t file_offset_;
+};
+
+}  // namespace
+
+UringFileSystem::UringFileSystem(const LocalUringFsConf& conf) : conf_(conf) {
+  CHECK_GT(conf.queue_depth(), 0);
+  CHECK_GT(conf.block_size(), 0);
+  CHECK_EQ(conf.block_size() % kDirectIoAlignment, 0);
+  std::unique_ptr<IoUring> ring = IoUring::New(conf.queue_depth());
+  is_uring_available_ = (ring != nullptr);
+  if (is_uring_available_) {
+    free_rings_.push_back(std::move(ring));
+  } else {
+    LOG(WARNING) << "io_uring is unavailable, falling back to pread and pwrite";
+  }
+}
+
+UringFileSystem::~UringFileSystem() = default;
+
+std::unique_ptr<IoUring> UringFileSystem::AcquireRing() {
+  if (!is_uring_available_) { return nullptr; }
+  {
+    std::unique_lock<std::mutex> lock(ring_mutex_);
+    if (!free_rings_.empty()) {
+      std::unique_ptr<IoUring> ring = std::move(free_rings_.back());
+      free_rings_.pop_back();
+      return ring;
+    }
+  }
+  // May still fail, e.g. by hitting RLIMIT_MEMLOCK on older kernels, then the caller falls back
+  return IoUring::New(conf_.queue_depth());
+}
+
+void UringFileSystem::ReleaseRing(std::unique_ptr<IoUring>&& ring) {
+  if (!ring) { return; }
+  std::unique_lock<std::mutex> lock(ring_mutex_);
+  free_rings_.push_back(std::move(ring));
+}
+
+int UringFileSystem::OpenFile(const std::string& fname, int flags, bool* is_direct) const {
+  const std::string translated_fname = TranslateName(fname);
+  *is_direct = false;
+  if (conf_.use_direct_io()) {
+    const int fd = open(translated_fname.c_str(), flags | O_DIRECT, 0644);
+    if (fd >= 0) {
+      *is_direct = true;
+      return fd;
+    }
+    // Some file systems like tmpfs do not support O_DIRECT
+    PCHECK(errno == EINVAL) << "Fail to open file " << fname;
+  }
+  const int fd = open(translated_fname.c_str(), flags, 0644);
+  PCHECK(fd >= 0) << "Fail to open file " << fname;
+  return fd;
+}
+
+void UringFileSystem::NewRandomAccessFile(const std::string& fname,
+                                          std::unique_ptr<RandomAccessFile>* result) {
+  bool is_direct = false;
+  const int fd = OpenFile(fname, O_RDONLY, &is_direct);
+  result->reset(new UringRandomAccessFile(this, fname, fd, is_direct, conf_.block_size(),
+                                          conf_.queue_depth()));
+}
+
+void UringFileSystem::NewWritableFile(const std::string& fname,
+                                      std::unique_ptr<WritableFile>* result) {
+  bool is_direct = false;
+  const int fd = OpenFile(fname, O_WRONLY | O_CREAT | O_TRUNC, &is_direct);
+  result->reset(new UringWritableFile(this, fname, fd, is_direct, 0, conf_.block_size(),
+                                      conf_.queue_depth()));
+}
+
+void UringFileSystem::NewAppendableFile(const std::string& fname,
+                                        std::unique_ptr<WritableFile>* result) {
+  // O_APPEND would ignore the offsets of concurrent writes, so append at the current size instead
+  bool is_direct = false;
+  int fd = OpenFile(fname, O_WRONLY | O_CREAT, &is_direct);
+  struct stat sbuf;
+  PCHECK(fstat(fd, &sbuf) == 0) << "Fail to load statistics of " << fname;
+  if (is_direct && sbuf.st_size % kDirectIoAlignment != 0) {
+    // The unaligned tail can not be rewritten with O_DIRECT
+    PCHECK(close(fd) == 0) << "Fail to close file " << fname;
+    fd = open(TranslateName(fname).c_str(), O_WRONLY);
+    PCHECK(fd >= 0) << "Fail to open file " << fname;
+    is_direct = false;
+  }
+  result->reset(new UringWritableFile(this, fname, fd, is_direct, sbuf.st_size,
+                                      conf_.block_size(), conf_.queue_depth()));
+}
+
+}  // namespace fs
+
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
@@ -0,0 +1,92 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_PERSISTENCE_POSIX_URING_FILE_SYSTEM_H_
+#define ONEFLOW_CORE_PERSISTENCE_POSIX_URING_FILE_SYSTEM_H_
+
+#include "oneflow/core/persistence/posix/posix_file_system.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+#include <mutex>
+
+namespace oneflow {
+
+namespace fs {
+
+class IoUring;
+
+// Local file system which splits reads and writes into block_size requests and keeps up to
+// queue_depth of them in flight through one io_uring submission. Files are opened with O_DIRECT
+// when use_direct_io is set and the underlying file system supports it, in which case data goes
+// through aligned bounce buffers and skips the page cache. Falls back to blocking pread/pwrite
+// when the kernel has no io_uring. Directory operations are the same as PosixFileSystem.
+class UringFileSystem final : public FileSystem {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(UringFileSystem);
+  explicit UringFileSystem(const LocalUringFsConf& conf);
+  ~UringFileSystem() override;
+
+  void NewRandomAccessFile(const std::string& fname,
+                           std::unique_ptr<RandomAccessFile>* result) override;
+
+  void NewWritableFile(const std::string& fname, std::unique_ptr<WritableFile>* result) override;
+
+  void NewAppendableFile(const std::string& fname, std::unique_ptr<WritableFile>* result) override;
+
+  bool FileExists(const std::string& fname) override { return posix_fs_.FileExists(fname); }
+
+  std::vector<std::string> ListDir(const std::string& dir) override {
+    return posix_fs_.ListDir(dir);
+  }
+
+  void DelFile(const std::string& fname) override { posix_fs_.DelFile(fname); }
+
+  void CreateDir(const std::string& dirname) override { posix_fs_.CreateDir(dirname); }
+
+  void DeleteDir(const std::string& dirname) override { posix_fs_.DeleteDir(dirname); }
+
+  uint64_t GetFileSize(const std::string& fname) override { return posix_fs_.GetFileSize(fname); }
+
+  void RenameFile(const std::string& old_name, const std::string& new_name) override {
+    posix_fs_.RenameFile(old_name, new_name);
+  }
+
+  bool IsDirectory(const std::string& fname) override { return posix_fs_.IsDirectory(fname); }
+
+  // Whether io_uring is used, false when falling back to pread/pwrite
+  bool IsUringAvailable() const { return is_uring_available_; }
+
+  // Rings are created on demand and shared by concurrent reads. nullptr without io_uring
+  std::unique_ptr<IoUring> AcquireRing();
+  void ReleaseRing(std::unique_ptr<IoUring>&& ring);
+
+ private:
+  int OpenFile(const std::string& fname, int flags, bool* is_direct) const;
+
+  const LocalUringFsConf conf_;
+  bool is_uring_available_;
+  PosixFileSystem posix_fs_;
+  std::mutex ring_mutex_;
+  std::vector<std::unique_ptr<IoUring>> free_rings_;
+};
+
+}  // namespace fs
+
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
+
+#endif  // ONEFLOW_CORE_PERSISTENCE_POSIX_URING_FILE_SYSTEM_H_
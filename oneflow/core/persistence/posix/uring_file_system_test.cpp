@@ -0,0 +1,142 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include "oneflow/core/common/process_state.h"
+#include "oneflow/core/common/str_util.h"
+#include "oneflow/core/persistence/posix/uring_file_system.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+namespace oneflow {
+
+namespace fs {
+
+namespace {
+
+std::string TestFilePath(const std::string& name) {
+  std::string current_dir = GetCwd();
+  StringReplace(&current_dir, '\\', '/');
+  return JoinPath(current_dir, name);
+}
+
+std::string TempFilePath(const std::string& name) {
+  const char* tmp_dir = std::getenv("TMPDIR");
+  return JoinPath(tmp_dir != nullptr ? tmp_dir : "/tmp", name);
+}
+
+std::string RandomContent(size_t size) {
+  std::mt19937_64 gen(size);
+  std::string content(size, '\0');
+  for (size_t pos = 0; pos < size; pos += sizeof(uint64_t)) {
+    const uint64_t val = gen();
+    std::memcpy(&content.at(pos), &val, std::min(sizeof(uint64_t), size - pos));
+  }
+  return content;
+}
+
+double WriteGBps(FileSystem* file_system, const std::string& file_name, const std::string& content,
+                 size_t append_size) {
+  const auto start = std::chrono::steady_clock::now();
+  std::unique_ptr<WritableFile> file;
+  file_system->NewWritableFile(file_name, &file);
+  for (size_t pos = 0; pos < content.size(); pos += append_size) {
+    file->Append(content.data() + pos, std::min(append_size, content.size() - pos));
+  }
+  file->Close();
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return content.size() / seconds / 1e9;
+}
+
+double ReadGBps(FileSystem* file_system, const std::string& file_name, std::string* content,
+                size_t read_size) {
+  const auto start = std::chrono::steady_clock::now();
+  std::unique_ptr<RandomAccessFile> file;
+  file_system->NewRandomAccessFile(file_name, &file);
+  for (size_t pos = 0; pos < content->size(); pos += read_size) {
+    file->Read(pos, std::min(read_size, content->size() - pos), &content->at(pos));
+  }
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return content->size() / seconds / 1e9;
+}
+
+}  // namespace
+
+TEST(UringFileSystem, read_write) {
+  for (bool use_direct_io : {false, true}) {
+    LocalUringFsConf conf;
+    conf.set_use_direct_io(use_direct_io);
+    conf.set_queue_depth(4);
+    conf.set_block_size(8192);
+    UringFileSystem file_system(conf);
+    const std::string file_name = TestFilePath("tmp_test_uring_file_asdfasdf");
+    const std::string content = RandomContent(100000);
+
+    std::unique_ptr<WritableFile> writable_file;
+    file_system.NewWritableFile(file_name, &writable_file);
+    writable_file->Append(content.data(), 10);
+    writable_file->Flush();
+    writable_file->Append(content.data() + 10, 50000 - 10);
+    writable_file->Close();
+    std::unique_ptr<WritableFile> appendable_file;
+    file_system.NewAppendableFile(file_name, &appendable_file);
+    appendable_file->Append(content.data() + 50000, 50000);
+    appendable_file->Close();
+    ASSERT_EQ(file_system.GetFileSize(file_name), content.size());
+
+    std::unique_ptr<RandomAccessFile> random_access_file;
+    file_system.NewRandomAccessFile(file_name, &random_access_file);
+    std::vector<char> buffer(content.size());
+    for (std::pair<uint64_t, size_t> range :
+         {std::make_pair(0, 100000), std::make_pair(4096, 8192), std::make_pair(1, 3),
+          std::make_pair(12345, 87655), std::make_pair(99999, 1)}) {
+      random_access_file->Read(range.first, range.second, buffer.data());
+      ASSERT_EQ(std::string(buffer.data(), range.second),
+                content.substr(range.first, range.second));
+    }
+    file_system.DelFile(file_name);
+  }
+}
+
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST(UringFileSystem, DISABLED_sequential_bandwidth_vs_posix) {
+  const std::string file_name = TempFilePath("tmp_test_uring_bandwidth_asdfasdf");
+  const std::string content = RandomContent(128 << 20);
+  std::string read_content(content.size(), '\0');
+  PosixFileSystem posix_fs;
+  LOG(INFO) << "posix write " << WriteGBps(&posix_fs, file_name, content, 4 << 20)
+            << " GB/s, read " << ReadGBps(&posix_fs, file_name, &read_content, 4 << 20) << " GB/s";
+  ASSERT_TRUE(read_content == content);
+  for (bool use_direct_io : {false, true}) {
+    LocalUringFsConf conf;
+    conf.set_use_direct_io(use_direct_io);
+    UringFileSystem uring_fs(conf);
+    std::fill(read_content.begin(), read_content.end(), '\0');
+    LOG(INFO) << "io_uring" << (uring_fs.IsUringAvailable() ? "" : " (unavailable)")
+              << (use_direct_io ? " with O_DIRECT" : "") << " write "
+              << WriteGBps(&uring_fs, file_name, content, 4 << 20) << " GB/s, read "
+              << ReadGBps(&uring_fs, file_name, &read_content, 4 << 20) << " GB/s";
+    ASSERT_TRUE(read_content == content);
+  }
+  posix_fs.DelFile(file_name);
+}
+
+}  // namespace fs
+
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
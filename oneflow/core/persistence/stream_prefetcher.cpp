@@ -0,0 +1,121 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/persistence/stream_prefetcher.h"
+#include <chrono>
+
+namespace oneflow {
+
+namespace {
+
+double SecondsSince(const std::chrono::steady_clock::time_point& start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+StreamPrefetcher::StreamPrefetcher(StreamScanner* scanner, uint64_t chunk_size, int32_t chunk_num)
+    : scanner_(scanner),
+      chunk_size_(chunk_size),
+      slots_(chunk_num),
+      next_issue_id_(0),
+      next_consume_id_(0),
+      scanner_eof_(false),
+      is_closed_(false) {
+  CHECK_GT(chunk_size, 0);
+  CHECK_GT(chunk_num, 0);
+  CHECK(scanner->SupportReadAt());
+  for (Slot& slot : slots_) {
+    slot.buffer.resize(chunk_size + 1);
+    slot.size = 0;
+    slot.ready = false;
+  }
+  FOR_RANGE(int32_t, i, 0, chunk_num) {
+    threads_.emplace_back(&StreamPrefetcher::PollChunks, this);
+  }
+}
+
+StreamPrefetcher::~StreamPrefetcher() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    is_closed_ = true;
+  }
+  issue_cond_.notify_all();
+  for (std::thread& thread : threads_) { thread.join(); }
+  VLOG(1) << "StreamPrefetcher read " << stats_.bytes_read << " bytes in " << stats_.num_chunks
+          << " chunks, " << stats_.read_bytes_per_second()
+          << " bytes/s per reader, consumer waited " << stats_.wait_seconds << "s";
+}
+
+void StreamPrefetcher::PollChunks() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    issue_cond_.wait(lock, [this]() {
+      return is_closed_
+             || (!scanner_eof_
+                 && next_issue_id_ < next_consume_id_ + static_cast<int64_t>(slots_.size()));
+    });
+    if (is_closed_) { return; }
+    StreamChunk chunk{};
+    if (!scanner_->NextChunk(chunk_size_, &chunk)) {
+      scanner_eof_ = true;
+      ready_cond_.notify_all();
+      continue;
+    }
+    Slot* slot = &slots_.at(next_issue_id_ % slots_.size());
+    ++next_issue_id_;
+    lock.unlock();
+    const auto start = std::chrono::steady_clock::now();
+    scanner_->stream(chunk.stream_id).ReadAt(chunk.offset, slot->buffer.data(), chunk.size);
+    const double read_seconds = SecondsSince(start);
+    lock.lock();
+    slot->size = chunk.size;
+    slot->ready = true;
+    stats_.bytes_read += chunk.size;
+    stats_.num_chunks += 1;
+    stats_.read_seconds += read_seconds;
+    ready_cond_.notify_all();
+  }
+}
+
+uint64_t StreamPrefetcher::UpdateBuffer(std::vector<char>* buffer) {
+  CHECK_EQ(buffer->size(), chunk_size_ + 1);
+  std::unique_lock<std::mutex> lock(mutex_);
+  Slot* slot = &slots_.at(next_consume_id_ % slots_.size());
+  const auto start = std::chrono::steady_clock::now();
+  ready_cond_.wait(lock, [&]() {
+    return slot->ready || (scanner_eof_ && next_consume_id_ == next_issue_id_);
+  });
+  stats_.wait_seconds += SecondsSince(start);
+  if (!slot->ready) { return 0; }
+  buffer->swap(slot->buffer);
+  const uint64_t size = slot->size;
+  slot->ready = false;
+  ++next_consume_id_;
+  issue_cond_.notify_one();
+  return size;
+}
+
+bool StreamPrefetcher::IsEof() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return (scanner_eof_ || scanner_->IsEof()) && next_consume_id_ == next_issue_id_;
+}
+
+StreamPrefetcherStats StreamPrefetcher::GetStats() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+}  // namespace oneflow
@@ -0,0 +1,80 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_PERSISTENCE_STREAM_PREFETCHER_H_
+#define ONEFLOW_CORE_PERSISTENCE_STREAM_PREFETCHER_H_
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "oneflow/core/persistence/stream_scanner.h"
+
+namespace oneflow {
+
+struct StreamPrefetcherStats {
+  int64_t bytes_read = 0;
+  int64_t num_chunks = 0;
+  // summed over all reader threads
+  double read_seconds = 0;
+  // time the consumer spent waiting for a chunk that was not ready yet
+  double wait_seconds = 0;
+
+  double read_bytes_per_second() const { return read_seconds > 0 ? bytes_read / read_seconds : 0; }
+};
+
+// Reads the chunks of a StreamScanner ahead of the consumer. Up to chunk_num chunks are in flight
+// at the same time, each read by its own thread through BinaryInStream::ReadAt, so that consecutive
+// chunks, which may belong to different part files, are fetched concurrently. Chunks are handed
+// out in the order of the scanner.
+class StreamPrefetcher final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(StreamPrefetcher);
+  StreamPrefetcher(StreamScanner* scanner, uint64_t chunk_size, int32_t chunk_num);
+  ~StreamPrefetcher();
+
+  // Same contract as StreamScanner::UpdateBuffer. The ready chunk is swapped into buffer, whose
+  // size must be chunk_size + 1
+  uint64_t UpdateBuffer(std::vector<char>* buffer);
+  // True once all chunks of the scanner have been handed out
+  bool IsEof() const;
+  StreamPrefetcherStats GetStats() const;
+
+ private:
+  struct Slot {
+    std::vector<char> buffer;
+    uint64_t size;
+    bool ready;
+  };
+
+  void PollChunks();
+
+  StreamScanner* scanner_;
+  const uint64_t chunk_size_;
+  std::vector<Slot> slots_;
+  // chunks are numbered in scanner order, chunk i lives in slots_[i % slots_.size()]
+  int64_t next_issue_id_;
+  int64_t next_consume_id_;
+  bool scanner_eof_;
+  bool is_closed_;
+  StreamPrefetcherStats stats_;
+  mutable std::mutex mutex_;
+  std::condition_variable issue_cond_;
+  std::condition_variable ready_cond_;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_PERSISTENCE_STREAM_PREFETCHER_H_
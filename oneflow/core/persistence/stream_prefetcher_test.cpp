@@ -0,0 +1,132 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/persistence/stream_prefetcher.h"
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+// In-memory stream whose reads take read_latency_us, like a file on NFS
+class MemoryInStream final : public BinaryInStream {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(MemoryInStream);
+  MemoryInStream(std::string content, int64_t read_latency_us)
+      : content_(std::move(content)), read_latency_us_(read_latency_us), cur_file_pos_(0) {}
+  ~MemoryInStream() override = default;
+
+  int32_t Read(char* s, size_t n) override {
+    if (IsEof()) { return -1; }
+    ReadAt(cur_file_pos_, s, n);
+    cur_file_pos_ += n;
+    return 0;
+  }
+  uint64_t file_size() const override { return content_.size(); }
+  uint64_t cur_file_pos() const override { return cur_file_pos_; }
+  void set_cur_file_pos(uint64_t val) override { cur_file_pos_ = val; }
+  bool IsEof() const override { return cur_file_pos_ == content_.size(); }
+  bool SupportReadAt() const override { return true; }
+  void ReadAt(uint64_t offset, char* s, size_t n) const override {
+    CHECK_LE(offset + n, content_.size());
+    std::this_thread::sleep_for(std::chrono::microseconds(read_latency_us_));
+    std::memcpy(s, content_.data() + offset, n);
+  }
+
+ private:
+  const std::string content_;
+  const int64_t read_latency_us_;
+  uint64_t cur_file_pos_;
+};
+
+std::vector<std::shared_ptr<BinaryInStream>> NewStreams(const std::vector<std::string>& contents,
+                                                        int64_t read_latency_us) {
+  std::vector<std::shared_ptr<BinaryInStream>> streams;
+  for (const std::string& content : contents) {
+    streams.emplace_back(new MemoryInStream(content, read_latency_us));
+  }
+  return streams;
+}
+
+std::string ReadAll(StreamPrefetcher* prefetcher, uint64_t chunk_size) {
+  std::string ret;
+  std::vector<char> buffer(chunk_size + 1);
+  while (!prefetcher->IsEof()) {
+    const uint64_t n = prefetcher->UpdateBuffer(&buffer);
+    ret.append(buffer.data(), n);
+  }
+  return ret;
+}
+
+}  // namespace
+
+TEST(StreamPrefetcher, acyclic_in_order_across_files) {
+  std::vector<std::string> contents;
+  std::string expected;
+  FOR_RANGE(int32_t, i, 0, 5) {
+    contents.emplace_back(std::string(100 + i * 37, 'a' + i));
+    expected += contents.back();
+  }
+  for (int32_t chunk_num : {1, 3, 16}) {
+    for (uint64_t offset : {0, 150}) {
+      AcyclicStreamScanner scanner(nullptr, NewStreams(contents, 0), offset);
+      StreamPrefetcher prefetcher(&scanner, 64, chunk_num);
+      ASSERT_EQ(ReadAll(&prefetcher, 64), expected.substr(offset));
+      ASSERT_EQ(prefetcher.GetStats().bytes_read, expected.size() - offset);
+    }
+  }
+}
+
+TEST(StreamPrefetcher, cyclic_wraps_around) {
+  const std::vector<std::string> contents{"0123456789", "abcdefghij"};
+  CyclicStreamScanner scanner(nullptr, NewStreams(contents, 0), 5);
+  StreamPrefetcher prefetcher(&scanner, 4, 4);
+  std::string content;
+  std::vector<char> buffer(5);
+  while (content.size() < 45) {
+    ASSERT_FALSE(prefetcher.IsEof());
+    const uint64_t n = prefetcher.UpdateBuffer(&buffer);
+    content.append(buffer.data(), n);
+  }
+  ASSERT_EQ(content.substr(0, 35), "56789abcdefghij0123456789abcdefghij");
+}
+
+TEST(StreamPrefetcher, empty) {
+  AcyclicStreamScanner scanner(nullptr, {}, 0);
+  StreamPrefetcher prefetcher(&scanner, 64, 2);
+  ASSERT_TRUE(prefetcher.IsEof());
+}
+
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST(StreamPrefetcher, DISABLED_read_ahead_hides_latency) {
+  const uint64_t chunk_size = 4096;
+  const std::vector<std::string> contents(8, std::string(16 * chunk_size, 'x'));
+  for (int32_t chunk_num : {1, 8}) {
+    AcyclicStreamScanner scanner(nullptr, NewStreams(contents, 500), 0);
+    const auto start = std::chrono::steady_clock::now();
+    StreamPrefetcher prefetcher(&scanner, chunk_size, chunk_num);
+    ASSERT_EQ(ReadAll(&prefetcher, chunk_size).size(), contents.size() * contents.front().size());
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const StreamPrefetcherStats stats = prefetcher.GetStats();
+    LOG(INFO) << "chunk_num: " << chunk_num << ", " << stats.bytes_read / seconds
+              << " bytes/s, consumer waited " << stats.wait_seconds << "s";
+  }
+}
+
+}  // namespace test
+
+}  // namespace oneflow
@@ -24,6 +24,8 @@ StreamScanner::StreamScanner(fs::FileSystem* fs,
                              uint64_t offset)
     : whole_file_offset_(offset) {
   stream_num_ = streams.size();
+  // stays at stream_num_ when offset is the end of all streams
+  cur_stream_id_ = stream_num_;
   whole_file_size_ = 0;
   int64_t idx = 0;
   for (auto& stream : streams) {
@@ -64,6 +66,26 @@ uint64_t StreamScanner::UpdateBuffer(std::vector<char>* buffer) {
   return n;
 }
 
+bool StreamScanner::NextChunk(uint64_t max_size, StreamChunk* chunk) {
+  if (cur_stream_id_ == stream_num_) { return false; }
+  const std::shared_ptr<BinaryInStream>& stream = streams_[cur_stream_id_];
+  const uint64_t n = std::min<uint64_t>(max_size, stream->file_size() - stream->cur_file_pos());
+  if (n == 0) { return false; }
+  chunk->stream_id = cur_stream_id_;
+  chunk->offset = stream->cur_file_pos();
+  chunk->size = n;
+  stream->set_cur_file_pos(chunk->offset + n);
+  AddNForCurFilePos(n);
+  return true;
+}
+
+bool StreamScanner::SupportReadAt() const {
+  return std::all_of(streams_.begin(), streams_.end(),
+                     [](const std::shared_ptr<BinaryInStream>& stream) {
+                       return stream->SupportReadAt();
+                     });
+}
+
 void AcyclicStreamScanner::AddNForCurFilePos(uint64_t n) {
   whole_file_pos_ += n;
   if (streams_[cur_stream_id_]->IsEof()) { ++cur_stream_id_; }
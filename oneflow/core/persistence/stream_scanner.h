@@ -23,6 +23,12 @@ limitations under the License.
 
 namespace oneflow {
 
+struct StreamChunk {
+  int32_t stream_id;
+  uint64_t offset;
+  uint64_t size;
+};
+
 class StreamScanner {
  public:
   OF_DISALLOW_COPY_AND_MOVE(StreamScanner);
@@ -32,6 +38,11 @@ class StreamScanner {
                 uint64_t offset);
   bool IsEof() const;
   uint64_t UpdateBuffer(std::vector<char>* buffer);
+  // Advances the scanner over the next chunk of at most max_size bytes like UpdateBuffer does, but
+  // leaves the reading to the caller
+  bool NextChunk(uint64_t max_size, StreamChunk* chunk);
+  bool SupportReadAt() const;
+  const BinaryInStream& stream(int32_t stream_id) const { return *streams_.at(stream_id); }
 
  protected:
   virtual void AddNForCurFilePos(uint64_t n) = 0;
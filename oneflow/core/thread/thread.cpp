@@ -21,10 +21,20 @@ limitations under the License.
 
 namespace oneflow {
 
+Thread::Thread() {
+  const ResourceDesc* resource_desc = Global<ResourceDesc, ForSession>::Get();
+  enable_local_msg_queue_ = resource_desc->thread_enable_local_message_queue();
+  if (resource_desc->thread_enable_lock_free_message_channel()) {
+    mpsc_msg_channel_.reset(
+        new MpscChannel<ActorMsg>(resource_desc->thread_lock_free_message_channel_capacity(),
+                                  resource_desc->thread_message_channel_spin_count()));
+  }
+}
+
 Thread::~Thread() {
   actor_thread_.join();
   CHECK(id2task_.empty());
-  msg_channel_.Close();
+  CloseMsgChannel();
 }
 
 void Thread::AddTask(const TaskProto& task) {
@@ -33,18 +43,17 @@ void Thread::AddTask(const TaskProto& task) {
 }
 
 void Thread::EnqueueActorMsg(const ActorMsg& msg) {
-  if (Global<ResourceDesc, ForSession>::Get()->thread_enable_local_message_queue()
-      && std::this_thread::get_id() == actor_thread_.get_id()) {
+  if (enable_local_msg_queue_ && std::this_thread::get_id() == actor_thread_.get_id()) {
     local_msg_queue_.push(msg);
   } else {
-    msg_channel_.Send(msg);
+    SendToMsgChannel(msg);
   }
 }
 
 void Thread::PollMsgChannel(const ThreadCtx& thread_ctx) {
   while (true) {
     if (local_msg_queue_.empty()) {
-      CHECK_EQ(msg_channel_.ReceiveMany(&local_msg_queue_), kChannelStatusSuccess);
+      CHECK_EQ(ReceiveManyFromMsgChannel(&local_msg_queue_), kChannelStatusSuccess);
     }
     ActorMsg msg = std::move(local_msg_queue_.front());
     local_msg_queue_.pop();
@@ -82,4 +91,19 @@ void Thread::ConstructActor(int64_t actor_id, const ThreadCtx& thread_ctx) {
   Global<RuntimeCtx>::Get()->DecreaseCounter("constructing_actor_cnt");
 }
 
+ChannelStatus Thread::SendToMsgChannel(const ActorMsg& msg) {
+  if (mpsc_msg_channel_) { return mpsc_msg_channel_->Send(msg); }
+  return msg_channel_.Send(msg);
+}
+
+ChannelStatus Thread::ReceiveManyFromMsgChannel(std::queue<ActorMsg>* msgs) {
+  if (mpsc_msg_channel_) { return mpsc_msg_channel_->ReceiveMany(msgs); }
+  return msg_channel_.ReceiveMany(msgs);
+}
+
+void Thread::CloseMsgChannel() {
+  if (mpsc_msg_channel_) { mpsc_msg_channel_->Close(); }
+  msg_channel_.Close();
+}
+
 }  // namespace oneflow
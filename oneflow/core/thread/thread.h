@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "oneflow/core/actor/actor_message_bus.h"
 #include "oneflow/core/common/channel.h"
+#include "oneflow/core/common/mpsc_channel.h"
 #include "oneflow/core/common/util.h"
 #include "oneflow/core/job/task.pb.h"
 #include "oneflow/core/thread/thread_context.h"
@@ -32,25 +33,30 @@ class Thread {
 
   void AddTask(const TaskProto&);
 
-  Channel<ActorMsg>* GetMsgChannelPtr() { return &msg_channel_; }
   void EnqueueActorMsg(const ActorMsg& msg);
 
   void JoinAllActor() { actor_thread_.join(); }
 
  protected:
-  Thread() = default;
+  Thread();
   std::thread& mut_actor_thread() { return actor_thread_; }
   void PollMsgChannel(const ThreadCtx& thread_ctx);
   void set_thrd_id(int64_t val) { thrd_id_ = val; }
 
  private:
   void ConstructActor(int64_t actor_id, const ThreadCtx& thread_ctx);
+  ChannelStatus SendToMsgChannel(const ActorMsg& msg);
+  ChannelStatus ReceiveManyFromMsgChannel(std::queue<ActorMsg>* msgs);
+  void CloseMsgChannel();
 
   HashMap<int64_t, TaskProto> id2task_;
   std::mutex id2task_mtx_;
 
   std::thread actor_thread_;
+  bool enable_local_msg_queue_;
   Channel<ActorMsg> msg_channel_;
+  // Replaces msg_channel_ when thread_enable_lock_free_message_channel is on
+  std::unique_ptr<MpscChannel<ActorMsg>> mpsc_msg_channel_;
   HashMap<int64_t, std::unique_ptr<Actor>> id2actor_ptr_;
   std::queue<ActorMsg> local_msg_queue_;
 
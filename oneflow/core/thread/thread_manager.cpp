@@ -18,8 +18,6 @@ limitations under the License.
 #include "oneflow/core/job/global_for.h"
 #include "oneflow/core/thread/cpu_thread.h"
 #include "oneflow/core/thread/gpu_thread.h"
-#include "oneflow/core/common/balanced_splitter.h"
-#include "oneflow/core/common/blocking_counter.h"
 #include "oneflow/core/control/global_process_ctx.h"
 #include "oneflow/core/job/global_for.h"
 #include "oneflow/core/common/id_util.h"
@@ -30,7 +28,7 @@ namespace oneflow {
 ThreadMgr::~ThreadMgr() {
   for (auto& thread_pair : threads_) {
     ActorMsg msg = ActorMsg::BuildCommandMsg(-1, ActorCmd::kStopThread);
-    thread_pair.second->GetMsgChannelPtr()->Send(msg);
+    thread_pair.second->EnqueueActorMsg(msg);
     thread_pair.second.reset();
     LOG(INFO) << "actor thread " << thread_pair.first << " finish";
   }
@@ -62,17 +60,12 @@ void SingleThreadLoop(size_t num, std::function<void(size_t i)> Callback) {
 }
 
 void MultiThreadLoop(size_t num, std::function<void(size_t i)> Callback) {
-  size_t thread_num = Global<ThreadPool>::Get()->thread_num();
-  thread_num = std::min(num, thread_num);
-  BalancedSplitter bs(num, thread_num);
-  BlockingCounter bc(thread_num);
-  FOR_RANGE(size_t, range_id, 0, thread_num) {
-    Global<ThreadPool>::Get()->AddWork([&bc, &bs, range_id, Callback] {
-      FOR_RANGE(size_t, i, bs.At(range_id).begin(), bs.At(range_id).end()) { Callback(i); }
-      bc.Decrease();
-    });
-  }
-  bc.WaitUntilCntEqualZero();
+  ThreadPool* thread_pool = Global<ThreadPool>::Get();
+  // A few ranges per thread leaves room for stealing when per-element cost is skewed
+  const int64_t grain = std::max<int64_t>(num / (std::max(thread_pool->thread_num(), 1) * 4), 1);
+  thread_pool->ParallelFor(0, num, grain, [&](int64_t begin, int64_t end) {
+    FOR_RANGE(int64_t, i, begin, end) { Callback(i); }
+  });
 }
 
 }  // namespace oneflow
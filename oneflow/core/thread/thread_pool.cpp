@@ -17,28 +17,190 @@ limitations under the License.
 
 namespace oneflow {
 
+namespace {
+
+constexpr int32_t kSpinCountBeforeSleep = 64;
+
+struct WorkerCtx {
+  const ThreadPool* pool;
+  int32_t worker_id;
+};
+
+thread_local WorkerCtx worker_ctx{nullptr, -1};
+
+// Chunks of one ParallelFor, claimed in order by its caller and by the helper works it submits.
+// Helpers may run after the call has returned, they only touch DoEachRange for a claimed chunk.
+struct ParallelForCtx {
+  ParallelForCtx(int64_t begin, int64_t end, int64_t grain,
+                 const std::function<void(int64_t, int64_t)>* DoEachRange)
+      : begin(begin),
+        end(end),
+        grain(grain),
+        chunk_num((end - begin + grain - 1) / grain),
+        DoEachRange(DoEachRange),
+        next_chunk(0),
+        done_chunk_cnt(0) {}
+
+  void RunChunks() {
+    int64_t run_cnt = 0;
+    for (int64_t i = next_chunk++; i < chunk_num; i = next_chunk++) {
+      const int64_t chunk_begin = begin + i * grain;
+      (*DoEachRange)(chunk_begin, std::min(chunk_begin + grain, end));
+      run_cnt += 1;
+    }
+    if (run_cnt > 0 && (done_chunk_cnt += run_cnt) == chunk_num) {
+      std::unique_lock<std::mutex> lock(mutex);
+      cond.notify_all();
+    }
+  }
+
+  void WaitUntilDone() {
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [this]() { return done_chunk_cnt == chunk_num; });
+  }
+
+  const int64_t begin;
+  const int64_t end;
+  const int64_t grain;
+  const int64_t chunk_num;
+  const std::function<void(int64_t, int64_t)>* DoEachRange;
+  std::atomic<int64_t> next_chunk;
+  std::atomic<int64_t> done_chunk_cnt;
+  std::mutex mutex;
+  std::condition_variable cond;
+};
+
+uint32_t NextStealSeed() {
+  static thread_local uint32_t seed = std::hash<std::thread::id>()(std::this_thread::get_id());
+  // xorshift32
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+}  // namespace
+
 ThreadPool::ThreadPool(int32_t thread_num)
-    : work_chans_(thread_num), threads_(thread_num), work_cnt_(0) {
+    : shared_queue_work_cnt_(0),
+      pending_work_cnt_(0),
+      sleeping_worker_cnt_(0),
+      is_stopped_(false),
+      threads_(thread_num) {
+  FOR_RANGE(int32_t, i, 0, thread_num) { deques_.emplace_back(new WorkStealingDeque<Work*>()); }
   FOR_RANGE(int32_t, i, 0, thread_num) {
-    Channel<std::function<void()>>* chan = &(work_chans_.at(i));
-    threads_[i] = std::thread([chan]() {
-      std::function<void()> work;
-      while (chan->Receive(&work) == kChannelStatusSuccess) { work(); }
-    });
+    threads_[i] = std::thread([this, i]() { WorkerLoop(i); });
   }
 }
 
 ThreadPool::~ThreadPool() {
-  FOR_RANGE(int32_t, i, 0, work_chans_.size()) {
-    work_chans_.at(i).Close();
-    threads_.at(i).join();
+  {
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    is_stopped_ = true;
+    sleep_cond_.notify_all();
+  }
+  for (std::thread& thread : threads_) { thread.join(); }
+  CHECK_EQ(pending_work_cnt_, 0);
+}
+
+void ThreadPool::AddWork(const std::function<void()>& work) { Submit(new Work(work)); }
+
+void ThreadPool::ParallelFor(int64_t begin, int64_t end, int64_t grain,
+                             const std::function<void(int64_t, int64_t)>& DoEachRange) {
+  if (begin >= end) { return; }
+  grain = std::max<int64_t>(grain, 1);
+  if (end - begin <= grain || thread_num() == 0) {
+    DoEachRange(begin, end);
+    return;
+  }
+  auto ctx = std::make_shared<ParallelForCtx>(begin, end, grain, &DoEachRange);
+  const int64_t helper_num = std::min<int64_t>(ctx->chunk_num - 1, thread_num());
+  FOR_RANGE(int64_t, i, 0, helper_num) { Submit(new Work([ctx]() { ctx->RunChunks(); })); }
+  // Only chunks of this call are run here, unrelated work may block or take long
+  ctx->RunChunks();
+  ctx->WaitUntilDone();
+}
+
+void ThreadPool::WorkerLoop(int32_t worker_id) {
+  worker_ctx.pool = this;
+  worker_ctx.worker_id = worker_id;
+  int32_t idle_cnt = 0;
+  while (true) {
+    if (TryRunOneWork(worker_id)) {
+      idle_cnt = 0;
+      continue;
+    }
+    // Work counted as pending but not visible yet is about to be pushed by its submitter
+    if (pending_work_cnt_ > 0 || ++idle_cnt < kSpinCountBeforeSleep) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (is_stopped_) { break; }
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    sleeping_worker_cnt_ += 1;
+    sleep_cond_.wait(lock, [this]() { return pending_work_cnt_ > 0 || is_stopped_; });
+    sleeping_worker_cnt_ -= 1;
+    idle_cnt = 0;
+  }
+}
+
+int32_t ThreadPool::CurrentWorkerId() const {
+  return worker_ctx.pool == this ? worker_ctx.worker_id : -1;
+}
+
+void ThreadPool::Submit(Work* work) {
+  pending_work_cnt_ += 1;
+  const int32_t worker_id = CurrentWorkerId();
+  if (worker_id >= 0) {
+    deques_.at(worker_id)->Push(work);
+  } else {
+    std::unique_lock<std::mutex> lock(shared_queue_mutex_);
+    shared_queue_.push(work);
+    shared_queue_work_cnt_ += 1;
+  }
+  WakeUpOneWorker();
+}
+
+bool ThreadPool::TryGetWork(int32_t worker_id, Work** work) {
+  bool found = worker_id >= 0 && deques_.at(worker_id)->Pop(work);
+  if (!found && shared_queue_work_cnt_ > 0) {
+    std::unique_lock<std::mutex> lock(shared_queue_mutex_);
+    if (!shared_queue_.empty()) {
+      *work = shared_queue_.front();
+      shared_queue_.pop();
+      shared_queue_work_cnt_ -= 1;
+      found = true;
+    }
   }
+  if (!found && !deques_.empty()) {
+    const int32_t deque_num = deques_.size();
+    const int32_t start = NextStealSeed() % deque_num;
+    FOR_RANGE(int32_t, i, 0, deque_num) {
+      const int32_t victim = (start + i) % deque_num;
+      if (victim == worker_id) { continue; }
+      if (deques_.at(victim)->Steal(work)) {
+        found = true;
+        break;
+      }
+    }
+  }
+  if (found) { pending_work_cnt_ -= 1; }
+  return found;
+}
+
+bool ThreadPool::TryRunOneWork(int32_t worker_id) {
+  Work* work = nullptr;
+  if (!TryGetWork(worker_id, &work)) { return false; }
+  std::unique_ptr<Work> work_guard(work);
+  (*work)();
+  return true;
 }
 
-void ThreadPool::AddWork(const std::function<void()>& work) {
-  const size_t cur_chan_idx =
-      work_cnt_.fetch_add(1, std::memory_order_relaxed) % work_chans_.size();
-  work_chans_.at(cur_chan_idx).Send(work);
+void ThreadPool::WakeUpOneWorker() {
+  if (sleeping_worker_cnt_ > 0) {
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    sleep_cond_.notify_one();
+  }
 }
 
 }  // namespace oneflow
@@ -17,10 +17,15 @@ limitations under the License.
 #define ONEFLOW_CORE_THREAD_THREAD_POOL_H_
 
 #include "oneflow/core/common/util.h"
-#include "oneflow/core/common/channel.h"
+#include "oneflow/core/thread/work_stealing_deque.h"
 
 namespace oneflow {
 
+// Work-stealing thread pool. Work added from outside the pool goes to a shared FIFO queue; work
+// added by a worker goes to the bottom of its own deque, and idle workers steal from the top of
+// the other deques. The caller of ParallelFor runs the chunks of that call that no worker has
+// claimed yet and then blocks, so nested ParallelFor calls from inside a work item cannot
+// deadlock.
 class ThreadPool final {
  public:
   OF_DISALLOW_COPY_AND_MOVE(ThreadPool);
@@ -30,12 +35,34 @@ class ThreadPool final {
 
   int32_t thread_num() const { return threads_.size(); }
   void AddWork(const std::function<void()>& work);
+  // Calls DoEachRange on disjoint sub-ranges of [begin, end) of at most `grain` elements and
+  // returns when all of them are done
+  void ParallelFor(int64_t begin, int64_t end, int64_t grain,
+                   const std::function<void(int64_t begin, int64_t end)>& DoEachRange);
 
  private:
-  std::vector<Channel<std::function<void()>>> work_chans_;
-  std::vector<std::thread> threads_;
+  using Work = std::function<void()>;
+
+  void WorkerLoop(int32_t worker_id);
+  // worker_id is -1 for threads not owned by this pool
+  int32_t CurrentWorkerId() const;
+  void Submit(Work* work);
+  bool TryGetWork(int32_t worker_id, Work** work);
+  bool TryRunOneWork(int32_t worker_id);
+  void WakeUpOneWorker();
+
+  std::vector<std::unique_ptr<WorkStealingDeque<Work*>>> deques_;
+  std::queue<Work*> shared_queue_;
+  std::mutex shared_queue_mutex_;
+  std::atomic<int64_t> shared_queue_work_cnt_;
 
-  std::atomic<size_t> work_cnt_;
+  std::atomic<int64_t> pending_work_cnt_;
+  std::atomic<int32_t> sleeping_worker_cnt_;
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cond_;
+  std::atomic<bool> is_stopped_;
+
+  std::vector<std::thread> threads_;
 };
 
 }  // namespace oneflow
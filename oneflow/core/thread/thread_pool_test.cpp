@@ -0,0 +1,151 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/thread/thread_pool.h"
+#include "oneflow/core/common/blocking_counter.h"
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+// Busy work whose cost varies 10x between elements, like decoding JPEGs of different sizes. The
+// expensive elements are clustered at the front so that a static split is unbalanced.
+uint64_t SkewedWork(int64_t i) {
+  const int64_t iter_num = i < 64 ? 100000 : 10000;
+  uint64_t acc = i;
+  FOR_RANGE(int64_t, j, 0, iter_num) { acc = acc * 6364136223846793005ULL + j; }
+  return acc;
+}
+
+}  // namespace
+
+TEST(WorkStealingDeque, push_pop_steal) {
+  WorkStealingDeque<int64_t> deque(2);
+  FOR_RANGE(int64_t, i, 0, 10) { deque.Push(i); }
+  int64_t item = -1;
+  ASSERT_TRUE(deque.Steal(&item));
+  ASSERT_EQ(item, 0);
+  ASSERT_TRUE(deque.Pop(&item));
+  ASSERT_EQ(item, 9);
+  int64_t cnt = 0;
+  while (deque.Pop(&item)) { ++cnt; }
+  ASSERT_EQ(cnt, 8);
+  ASSERT_TRUE(deque.Empty());
+  ASSERT_FALSE(deque.Steal(&item));
+}
+
+TEST(ThreadPool, add_work) {
+  ThreadPool thread_pool(4);
+  const int64_t work_num = 1000;
+  std::atomic<int64_t> sum(0);
+  BlockingCounter bc(work_num);
+  FOR_RANGE(int64_t, i, 0, work_num) {
+    thread_pool.AddWork([i, &sum, &bc]() {
+      sum += i;
+      bc.Decrease();
+    });
+  }
+  bc.WaitUntilCntEqualZero();
+  ASSERT_EQ(sum, work_num * (work_num - 1) / 2);
+}
+
+TEST(ThreadPool, parallel_for_visits_each_index_once) {
+  ThreadPool thread_pool(4);
+  for (int64_t grain : {1, 7, 1000, 100000}) {
+    std::vector<std::atomic<int32_t>> visits(10000);
+    for (auto& visit : visits) { visit = 0; }
+    thread_pool.ParallelFor(0, visits.size(), grain, [&](int64_t begin, int64_t end) {
+      ASSERT_LE(end - begin, grain);
+      FOR_RANGE(int64_t, i, begin, end) { visits.at(i) += 1; }
+    });
+    for (const auto& visit : visits) { ASSERT_EQ(visit, 1); }
+  }
+}
+
+TEST(ThreadPool, nested_parallel_for) {
+  // Fewer workers than outer ranges, every one of them blocking in an inner ParallelFor
+  ThreadPool thread_pool(2);
+  const int64_t outer_num = 16;
+  const int64_t inner_num = 256;
+  std::atomic<int64_t> cnt(0);
+  thread_pool.ParallelFor(0, outer_num, 1, [&](int64_t begin, int64_t end) {
+    FOR_RANGE(int64_t, i, begin, end) {
+      thread_pool.ParallelFor(0, inner_num, 4, [&](int64_t inner_begin, int64_t inner_end) {
+        cnt += inner_end - inner_begin;
+      });
+    }
+  });
+  ASSERT_EQ(cnt, outer_num * inner_num);
+}
+
+TEST(ThreadPool, parallel_for_skips_unrelated_work) {
+  ThreadPool thread_pool(1);
+  BlockingCounter worker_busy(1);
+  BlockingCounter release_worker(1);
+  thread_pool.AddWork([&]() {
+    worker_busy.Decrease();
+    release_worker.WaitUntilCntEqualZero();
+  });
+  worker_busy.WaitUntilCntEqualZero();
+  // Queued behind the busy worker, it would block the caller of ParallelFor if run there
+  std::atomic<bool> parallel_for_done(false);
+  BlockingCounter unrelated_done(1);
+  thread_pool.AddWork([&]() {
+    ASSERT_TRUE(parallel_for_done);
+    unrelated_done.Decrease();
+  });
+  std::atomic<int64_t> cnt(0);
+  thread_pool.ParallelFor(0, 100, 1, [&](int64_t begin, int64_t end) { cnt += end - begin; });
+  ASSERT_EQ(cnt, 100);
+  parallel_for_done = true;
+  release_worker.Decrease();
+  unrelated_done.WaitUntilCntEqualZero();
+}
+
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST(ThreadPool, DISABLED_skewed_work_static_split_vs_parallel_for) {
+  const int32_t thread_num = 4;
+  const int64_t num = 512;
+  std::vector<uint64_t> out(num);
+  ThreadPool thread_pool(thread_num);
+
+  const auto static_start = std::chrono::steady_clock::now();
+  BlockingCounter bc(thread_num);
+  FOR_RANGE(int32_t, part_id, 0, thread_num) {
+    thread_pool.AddWork([&, part_id]() {
+      const int64_t part_size = num / thread_num;
+      FOR_RANGE(int64_t, i, part_id * part_size, (part_id + 1) * part_size) {
+        out[i] = SkewedWork(i);
+      }
+      bc.Decrease();
+    });
+  }
+  bc.WaitUntilCntEqualZero();
+  const auto static_end = std::chrono::steady_clock::now();
+
+  thread_pool.ParallelFor(0, num, 1, [&](int64_t begin, int64_t end) {
+    FOR_RANGE(int64_t, i, begin, end) { ASSERT_EQ(out[i], SkewedWork(i)); }
+  });
+  const auto stealing_end = std::chrono::steady_clock::now();
+  LOG(INFO) << "static split: " << std::chrono::duration<double>(static_end - static_start).count()
+            << "s, ParallelFor: "
+            << std::chrono::duration<double>(stealing_end - static_end).count() << "s";
+}
+
+}  // namespace test
+
+}  // namespace oneflow
@@ -0,0 +1,137 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_THREAD_WORK_STEALING_DEQUE_H_
+#define ONEFLOW_CORE_THREAD_WORK_STEALING_DEQUE_H_
+
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+// Chase-Lev work-stealing deque following "Correct and Efficient Work-Stealing for Weak Memory
+// Models" (Le et al., PPoPP'13). Only the owner thread may call Push and Pop, which work on the
+// bottom end; any thread may call Steal, which takes from the top end. T must be trivially
+// copyable, in practice a pointer to the task.
+template<typename T>
+class WorkStealingDeque final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(WorkStealingDeque);
+  explicit WorkStealingDeque(int64_t capacity = 1024);
+  ~WorkStealingDeque() = default;
+
+  void Push(T item);
+  bool Pop(T* item);
+  bool Steal(T* item);
+  bool Empty() const;
+
+ private:
+  class Array final {
+   public:
+    OF_DISALLOW_COPY_AND_MOVE(Array);
+    explicit Array(int64_t capacity)
+        : capacity_(capacity), mask_(capacity - 1), buffer_(new std::atomic<T>[capacity]) {}
+    ~Array() = default;
+
+    int64_t capacity() const { return capacity_; }
+    T Get(int64_t i) const { return buffer_[i & mask_].load(std::memory_order_relaxed); }
+    void Put(int64_t i, T item) { buffer_[i & mask_].store(item, std::memory_order_relaxed); }
+    Array* Grow(int64_t bottom, int64_t top) const {
+      Array* array = new Array(capacity_ * 2);
+      for (int64_t i = top; i < bottom; ++i) { array->Put(i, Get(i)); }
+      return array;
+    }
+
+   private:
+    const int64_t capacity_;
+    const int64_t mask_;
+    std::unique_ptr<std::atomic<T>[]> buffer_;
+  };
+
+  std::atomic<int64_t> top_;
+  std::atomic<int64_t> bottom_;
+  std::atomic<Array*> array_;
+  // Retired arrays may still be read by concurrent stealers, so they live as long as the deque
+  std::vector<std::unique_ptr<Array>> arrays_;
+};
+
+template<typename T>
+WorkStealingDeque<T>::WorkStealingDeque(int64_t capacity) : top_(0), bottom_(0) {
+  CHECK_GT(capacity, 0);
+  CHECK_EQ(capacity & (capacity - 1), 0);
+  arrays_.emplace_back(new Array(capacity));
+  array_.store(arrays_.back().get(), std::memory_order_relaxed);
+}
+
+template<typename T>
+void WorkStealingDeque<T>::Push(T item) {
+  const int64_t bottom = bottom_.load(std::memory_order_relaxed);
+  const int64_t top = top_.load(std::memory_order_acquire);
+  Array* array = array_.load(std::memory_order_relaxed);
+  if (bottom - top > array->capacity() - 1) {
+    arrays_.emplace_back(array->Grow(bottom, top));
+    array = arrays_.back().get();
+    array_.store(array, std::memory_order_release);
+  }
+  array->Put(bottom, item);
+  std::atomic_thread_fence(std::memory_order_release);
+  bottom_.store(bottom + 1, std::memory_order_relaxed);
+}
+
+template<typename T>
+bool WorkStealingDeque<T>::Pop(T* item) {
+  const int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+  Array* array = array_.load(std::memory_order_relaxed);
+  bottom_.store(bottom, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t top = top_.load(std::memory_order_relaxed);
+  if (top > bottom) {
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+    return false;
+  }
+  *item = array->Get(bottom);
+  if (top == bottom) {
+    // Last item, race against stealers
+    const bool won = top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                                  std::memory_order_relaxed);
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+    return won;
+  }
+  return true;
+}
+
+template<typename T>
+bool WorkStealingDeque<T>::Steal(T* item) {
+  int64_t top = top_.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  const int64_t bottom = bottom_.load(std::memory_order_acquire);
+  if (top >= bottom) { return false; }
+  Array* array = array_.load(std::memory_order_acquire);
+  const T stolen = array->Get(top);
+  if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                    std::memory_order_relaxed)) {
+    return false;
+  }
+  *item = stolen;
+  return true;
+}
+
+template<typename T>
+bool WorkStealingDeque<T>::Empty() const {
+  return bottom_.load(std::memory_order_relaxed) <= top_.load(std::memory_order_relaxed);
+}
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_THREAD_WORK_STEALING_DEQUE_H_
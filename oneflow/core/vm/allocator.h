@@ -27,6 +27,8 @@ class Allocator {
 
   virtual void Allocate(char** mem_ptr, std::size_t size) = 0;
   virtual void Deallocate(char* mem_ptr, std::size_t size) = 0;
+  // Same as Allocate except that *mem_ptr is nullptr when out of memory, instead of failing
+  virtual void TryAllocate(char** mem_ptr, std::size_t size) { Allocate(mem_ptr, size); }
 
  protected:
   Allocator() = default;
@@ -15,16 +15,29 @@ limitations under the License.
 */
 #include <cstdlib>
 #include "oneflow/core/vm/cpu_allocator.h"
+#include "oneflow/core/vm/host_caching_allocator.h"
 #include "oneflow/core/common/util.h"
 
 namespace oneflow {
 namespace vm {
 
 void CpuAllocator::Allocate(char** mem_ptr, std::size_t size) {
-  *mem_ptr = reinterpret_cast<char*>(std::malloc(size));
+  HostCachingAllocator* caching_allocator = GetGlobalHostCachingAllocator();
+  if (caching_allocator != nullptr) {
+    caching_allocator->Allocate(mem_ptr, size);
+  } else {
+    *mem_ptr = reinterpret_cast<char*>(std::malloc(size));
+  }
 }
 
-void CpuAllocator::Deallocate(char* mem_ptr, std::size_t size) { std::free(mem_ptr); }
+void CpuAllocator::Deallocate(char* mem_ptr, std::size_t size) {
+  HostCachingAllocator* caching_allocator = GetGlobalHostCachingAllocator();
+  if (caching_allocator != nullptr) {
+    caching_allocator->Deallocate(mem_ptr, size);
+  } else {
+    std::free(mem_ptr);
+  }
+}
 
 COMMAND(Global<CpuAllocator>::SetAllocated(new CpuAllocator()));
 
@@ -260,6 +260,12 @@ bool CudaAllocator::DeallocateFreeBlockForGarbageCollection() {
 }
 
 void CudaAllocator::Allocate(char** mem_ptr, std::size_t size) {
+  TryAllocate(mem_ptr, size);
+  CHECK(size == 0 || *mem_ptr != nullptr)
+      << "Error! : Out of memory when allocate size : " << size;
+}
+
+void CudaAllocator::TryAllocate(char** mem_ptr, std::size_t size) {
   if (size == 0) {
     *mem_ptr = nullptr;
     return;
@@ -277,7 +283,10 @@ void CudaAllocator::Allocate(char** mem_ptr, std::size_t size) {
     }
   }
 
-  CHECK(piece != nullptr) << "Error! : Out of memory when allocate size : " << size;
+  if (piece == nullptr) {
+    *mem_ptr = nullptr;
+    return;
+  }
   CHECK_NOTNULL(piece->ptr);
   CHECK(ptr2piece_.find(piece->ptr) != ptr2piece_.end());
   *mem_ptr = piece->ptr;
@@ -30,6 +30,7 @@ class CudaAllocator final : public Allocator {
 
   void Allocate(char** mem_ptr, std::size_t size) override;
   void Deallocate(char* mem_ptr, std::size_t size) override;
+  void TryAllocate(char** mem_ptr, std::size_t size) override;
 
  private:
   static constexpr int32_t kInvalidBinNum = -1;
@@ -0,0 +1,523 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <array>
+#include <cstdlib>
+#include <set>
+#include <sys/mman.h>
+#include "oneflow/core/vm/host_caching_allocator.h"
+
+namespace oneflow {
+namespace vm {
+
+namespace {
+
+constexpr size_t kHostMemAllocAlignSize = 64;
+constexpr size_t kHugePageSize = 2 << 20;        // 2MiB
+constexpr size_t kMinAlloc = 1 << 20;             // allocations less than 1MiB share Blocks
+constexpr size_t kPieceSplitThreshold = 64 << 20;  // 64MiB
+constexpr int32_t kInvalidBinNum = -1;
+constexpr int32_t kBinNumSize = 24;
+
+constexpr int32_t kThreadCacheClassNum = 10;  // 64B, 128B, ..., 32KiB
+constexpr size_t kThreadCacheBytesPerClass = 512 * 1024;
+
+inline size_t HostMemAlignedBytes(size_t bytes) { return RoundUp(bytes, kHostMemAllocAlignSize); }
+
+inline int32_t Log2Floor(uint64_t value) { return 63 ^ __builtin_clzll(value); }
+
+// Index of the smallest power of two class that holds size, size <= kMaxThreadCachedSize
+inline int32_t ThreadCacheClass4Size(size_t size) {
+  if (size <= kHostMemAllocAlignSize) { return 0; }
+  return Log2Floor((size - 1) / kHostMemAllocAlignSize) + 1;
+}
+
+inline size_t ThreadCacheClassSize(int32_t cls) { return kHostMemAllocAlignSize << cls; }
+
+inline int64_t ThreadCacheMaxCount(int32_t cls) {
+  return std::max<int64_t>(kThreadCacheBytesPerClass / ThreadCacheClassSize(cls), 8);
+}
+
+char* AllocateFromSystem(size_t bytes) {
+  void* ptr = nullptr;
+  if (posix_memalign(&ptr, kHugePageSize, bytes) != 0) { return nullptr; }
+#ifdef MADV_HUGEPAGE
+  madvise(ptr, bytes, MADV_HUGEPAGE);
+#endif
+  return static_cast<char*>(ptr);
+}
+
+size_t ParseSizeFromEnv(const char* env_var, size_t default_value) {
+  const char* env_p = std::getenv(env_var);
+  if (env_p == nullptr) { return default_value; }
+  return std::stoull(env_p);
+}
+
+}  // namespace
+
+// Mutex guarded binned allocator shared by all threads of one HostCachingAllocator
+class HostBinnedArena final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(HostBinnedArena);
+  explicit HostBinnedArena(size_t max_cached_bytes);
+  ~HostBinnedArena();
+
+  char* Allocate(size_t aligned_size);
+  void Deallocate(char* ptr);
+  // Deallocates a list of pointers linked through their first bytes, with a single lock
+  void DeallocateLinkedList(char* head);
+  void ReleaseFreeBlocks();
+  void AddThreadCachedBytes(int64_t delta) { thread_cached_bytes_ += delta; }
+  HostCachingAllocatorStats GetStats() const;
+
+ private:
+  struct Piece {
+    size_t size = 0;
+    char* ptr = nullptr;
+    bool is_free = false;
+    Piece* prev = nullptr;
+    Piece* next = nullptr;
+    int32_t bin_num = kInvalidBinNum;
+  };
+
+  // Bin sizes are 64, 128, ..., 256MiB, the last Bin also holds all larger Pieces
+  struct Bin {
+    size_t size = 0;
+
+    struct PieceCmp {
+      bool operator()(const Piece* lhs, const Piece* rhs) const {
+        if (lhs->size != rhs->size) { return lhs->size < rhs->size; }
+        return lhs->ptr < rhs->ptr;
+      }
+    };
+    std::set<Piece*, PieceCmp> pieces;
+  };
+
+  struct Block {
+    size_t size = 0;
+    char* ptr = nullptr;
+    Piece* start_piece = nullptr;
+    Block(Piece* p) : size(p->size), ptr(p->ptr), start_piece(p) {}
+  };
+
+  size_t BinSize4BinNum(int32_t bin_num) const { return kHostMemAllocAlignSize << bin_num; }
+
+  int32_t BinNum4BinSize(size_t size) const {
+    const uint64_t value = std::max(size, kHostMemAllocAlignSize) / kHostMemAllocAlignSize;
+    return std::min(kBinNumSize - 1, Log2Floor(value));
+  }
+
+  char* AllocateLocked(size_t aligned_size);
+  void DeallocateLocked(char* ptr);
+  Piece* FindPiece(size_t aligned_size);
+  void InsertPiece2Bin(Piece* piece);
+  void RemovePieceFromBin(Piece* piece);
+  Piece* AllocatePiece();
+  void DeallocatePiece(Piece* piece);
+  void MarkPiece(Piece* piece);
+  void UnMarkPiece(Piece* piece);
+  void MergeNeighbourFreePiece(Piece* lhs, Piece* rhs);
+  bool AllocateBlockToExtendTotalMem(size_t aligned_size);
+  // Frees fully free Blocks until the cached bytes are no more than target_cached_bytes
+  bool DeallocateFreeBlocks(size_t target_cached_bytes);
+
+  const size_t max_cached_bytes_;
+  mutable std::mutex mutex_;
+  size_t total_memory_bytes_;
+  size_t in_use_bytes_;
+  int64_t num_system_allocs_;
+  int64_t num_system_frees_;
+  std::atomic<int64_t> thread_cached_bytes_;
+  HashMap<char*, Block> mem_ptr2block_;
+
+  std::vector<Bin> bins_;
+  std::vector<std::unique_ptr<Piece>> pieces_;
+  HashMap<char*, Piece*> ptr2piece_;
+  Piece* recycle_piece_list_;
+};
+
+HostBinnedArena::HostBinnedArena(size_t max_cached_bytes)
+    : max_cached_bytes_(max_cached_bytes),
+      total_memory_bytes_(0),
+      in_use_bytes_(0),
+      num_system_allocs_(0),
+      num_system_frees_(0),
+      thread_cached_bytes_(0),
+      recycle_piece_list_(nullptr) {
+  bins_.resize(kBinNumSize);
+  for (int32_t i = 0; i < kBinNumSize; ++i) {
+    size_t bin_size = BinSize4BinNum(i);
+    bins_.at(i).size = bin_size;
+    CHECK_EQ(BinNum4BinSize(bin_size), i);
+    CHECK_EQ(BinNum4BinSize(bin_size * 2 - 1), i);
+  }
+}
+
+HostBinnedArena::~HostBinnedArena() {
+  for (auto& pair : mem_ptr2block_) { std::free(pair.first); }
+}
+
+char* HostBinnedArena::Allocate(size_t aligned_size) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return AllocateLocked(aligned_size);
+}
+
+void HostBinnedArena::Deallocate(char* ptr) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  DeallocateLocked(ptr);
+  if (total_memory_bytes_ - in_use_bytes_ > max_cached_bytes_) {
+    DeallocateFreeBlocks(max_cached_bytes_);
+  }
+}
+
+void HostBinnedArena::DeallocateLinkedList(char* head) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (head != nullptr) {
+    char* next = *reinterpret_cast<char**>(head);
+    DeallocateLocked(head);
+    head = next;
+  }
+  if (total_memory_bytes_ - in_use_bytes_ > max_cached_bytes_) {
+    DeallocateFreeBlocks(max_cached_bytes_);
+  }
+}
+
+void HostBinnedArena::ReleaseFreeBlocks() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  DeallocateFreeBlocks(0);
+}
+
+HostCachingAllocatorStats HostBinnedArena::GetStats() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  HostCachingAllocatorStats stats;
+  stats.bytes_thread_cached = thread_cached_bytes_;
+  stats.bytes_in_use = in_use_bytes_ - stats.bytes_thread_cached;
+  stats.bytes_reserved = total_memory_bytes_;
+  stats.bytes_cached = total_memory_bytes_ - stats.bytes_in_use;
+  for (auto it = bins_.rbegin(); it != bins_.rend(); ++it) {
+    if (!it->pieces.empty()) {
+      stats.largest_free_piece_bytes = (*it->pieces.rbegin())->size;
+      break;
+    }
+  }
+  stats.num_blocks = mem_ptr2block_.size();
+  stats.num_system_allocs = num_system_allocs_;
+  stats.num_system_frees = num_system_frees_;
+  return stats;
+}
+
+char* HostBinnedArena::AllocateLocked(size_t aligned_size) {
+  Piece* piece = FindPiece(aligned_size);
+  if (piece == nullptr) {
+    if (AllocateBlockToExtendTotalMem(aligned_size)) { piece = FindPiece(aligned_size); }
+  }
+  if (piece == nullptr) {
+    if (DeallocateFreeBlocks(0) && AllocateBlockToExtendTotalMem(aligned_size)) {
+      piece = FindPiece(aligned_size);
+    }
+  }
+  CHECK(piece != nullptr) << "Error! : Out of host memory when allocate size : " << aligned_size;
+  in_use_bytes_ += piece->size;
+  return piece->ptr;
+}
+
+void HostBinnedArena::DeallocateLocked(char* ptr) {
+  auto it = ptr2piece_.find(ptr);
+  CHECK(it != ptr2piece_.end()) << "Error! : Try deallocate mem_ptr non-existent. mem ptr = "
+                                << static_cast<void*>(ptr);
+  Piece* piece = it->second;
+  CHECK(!piece->is_free);
+  piece->is_free = true;
+  in_use_bytes_ -= piece->size;
+
+  Piece* last_piece_insert_to_bin = piece;
+  Piece* next_p = piece->next;
+  Piece* prev_p = piece->prev;
+  if (next_p != nullptr && next_p->is_free) {
+    RemovePieceFromBin(next_p);
+    MergeNeighbourFreePiece(piece, next_p);
+  }
+  if (prev_p != nullptr && prev_p->is_free) {
+    RemovePieceFromBin(prev_p);
+    MergeNeighbourFreePiece(prev_p, piece);
+    last_piece_insert_to_bin = prev_p;
+  }
+  InsertPiece2Bin(last_piece_insert_to_bin);
+}
+
+HostBinnedArena::Piece* HostBinnedArena::FindPiece(size_t aligned_size) {
+  Piece key;
+  key.size = aligned_size;
+  for (int32_t bin_num = BinNum4BinSize(aligned_size); bin_num < kBinNumSize; ++bin_num) {
+    Bin* bin = &bins_.at(bin_num);
+    // Pieces are ordered by size, so this is the best fit within the Bin
+    auto it = bin->pieces.lower_bound(&key);
+    if (it == bin->pieces.end()) { continue; }
+    Piece* piece = *it;
+    bin->pieces.erase(it);
+    piece->bin_num = kInvalidBinNum;
+    piece->is_free = false;
+    if (piece->size >= aligned_size * 2 || piece->size - aligned_size >= kPieceSplitThreshold) {
+      Piece* new_piece = AllocatePiece();
+      new_piece->ptr = piece->ptr + aligned_size;
+      new_piece->size = piece->size - aligned_size;
+      piece->size = aligned_size;
+
+      Piece* next_p = piece->next;
+      piece->next = new_piece;
+      new_piece->prev = piece;
+      new_piece->next = next_p;
+      if (next_p != nullptr) { next_p->prev = new_piece; }
+
+      new_piece->is_free = true;
+      new_piece->bin_num = kInvalidBinNum;
+      InsertPiece2Bin(new_piece);
+      MarkPiece(new_piece);
+    }
+    return piece;
+  }
+  return nullptr;
+}
+
+void HostBinnedArena::InsertPiece2Bin(Piece* piece) {
+  CHECK(piece->is_free && piece->bin_num == kInvalidBinNum);
+  int32_t bin_num = BinNum4BinSize(piece->size);
+  piece->bin_num = bin_num;
+  CHECK(bins_.at(bin_num).pieces.insert(piece).second);
+}
+
+void HostBinnedArena::RemovePieceFromBin(Piece* piece) {
+  CHECK(piece->is_free);
+  CHECK_NE(piece->bin_num, kInvalidBinNum);
+  CHECK_GT(bins_.at(piece->bin_num).pieces.erase(piece), 0);
+  piece->bin_num = kInvalidBinNum;
+}
+
+HostBinnedArena::Piece* HostBinnedArena::AllocatePiece() {
+  if (recycle_piece_list_) {
+    Piece* ret = recycle_piece_list_;
+    recycle_piece_list_ = recycle_piece_list_->next;
+    return ret;
+  } else {
+    pieces_.emplace_back(new Piece());
+    return pieces_.back().get();
+  }
+}
+
+void HostBinnedArena::DeallocatePiece(Piece* piece) {
+  piece->ptr = nullptr;
+  piece->size = 0;
+  piece->bin_num = kInvalidBinNum;
+  piece->is_free = true;
+  piece->prev = nullptr;
+  piece->next = recycle_piece_list_;
+  recycle_piece_list_ = piece;
+}
+
+void HostBinnedArena::MarkPiece(Piece* piece) {
+  CHECK_NOTNULL(piece->ptr);
+  CHECK(ptr2piece_.emplace(piece->ptr, piece).second);
+}
+
+void HostBinnedArena::UnMarkPiece(Piece* piece) {
+  CHECK_NOTNULL(piece->ptr);
+  CHECK_EQ(ptr2piece_.erase(piece->ptr), 1);
+}
+
+void HostBinnedArena::MergeNeighbourFreePiece(Piece* lhs, Piece* rhs) {
+  CHECK(lhs->is_free);
+  CHECK(rhs->is_free);
+  CHECK(lhs->next == rhs);
+  CHECK(lhs->ptr + lhs->size == rhs->ptr);
+
+  lhs->size += rhs->size;
+  lhs->next = rhs->next;
+  if (rhs->next != nullptr) { rhs->next->prev = lhs; }
+  UnMarkPiece(rhs);
+  DeallocatePiece(rhs);
+}
+
+bool HostBinnedArena::AllocateBlockToExtendTotalMem(size_t aligned_size) {
+  const size_t allocate_bytes = RoundUp(std::max(aligned_size, kMinAlloc), kHugePageSize);
+  char* mem_ptr = AllocateFromSystem(allocate_bytes);
+  if (mem_ptr == nullptr) { return false; }
+  total_memory_bytes_ += allocate_bytes;
+  num_system_allocs_ += 1;
+
+  Piece* piece = AllocatePiece();
+  piece->size = allocate_bytes;
+  piece->ptr = mem_ptr;
+  piece->prev = nullptr;
+  piece->next = nullptr;
+  piece->is_free = true;
+  piece->bin_num = kInvalidBinNum;
+  InsertPiece2Bin(piece);
+  MarkPiece(piece);
+  CHECK(mem_ptr2block_.emplace(mem_ptr, Block(piece)).second);
+  return true;
+}
+
+bool HostBinnedArena::DeallocateFreeBlocks(size_t target_cached_bytes) {
+  size_t total_free_bytes = 0;
+  for (auto it = mem_ptr2block_.begin(); it != mem_ptr2block_.end();) {
+    if (total_memory_bytes_ - in_use_bytes_ <= target_cached_bytes) { break; }
+    const Block& block = it->second;
+    // A fully free Block has been coalesced into a single free Piece
+    Piece* p = block.start_piece;
+    if (!(p->is_free && p->next == nullptr)) {
+      ++it;
+      continue;
+    }
+    CHECK_EQ(p->size, block.size);
+    RemovePieceFromBin(p);
+    UnMarkPiece(p);
+    DeallocatePiece(p);
+    std::free(it->first);
+    total_memory_bytes_ -= block.size;
+    total_free_bytes += block.size;
+    num_system_frees_ += 1;
+    it = mem_ptr2block_.erase(it);
+  }
+  return total_free_bytes > 0;
+}
+
+namespace {
+
+// Free lists of one thread for one HostCachingAllocator. Freed pointers are linked through their
+// first bytes
+struct ThreadCacheEntry {
+  uint64_t allocator_id = 0;
+  std::weak_ptr<HostBinnedArena> arena;
+  std::array<char*, kThreadCacheClassNum> free_lists{};
+  std::array<int64_t, kThreadCacheClassNum> free_list_sizes{};
+};
+
+class ThreadCache final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ThreadCache);
+  ThreadCache() : last_entry_(nullptr) {}
+  ~ThreadCache() {
+    for (auto& entry : entries_) {
+      std::shared_ptr<HostBinnedArena> arena = entry->arena.lock();
+      // The memory of a destroyed allocator has already been freed
+      if (!arena) { continue; }
+      FOR_RANGE(int32_t, cls, 0, kThreadCacheClassNum) {
+        const int64_t class_size = ThreadCacheClassSize(cls);
+        arena->AddThreadCachedBytes(-entry->free_list_sizes.at(cls) * class_size);
+        arena->DeallocateLinkedList(entry->free_lists.at(cls));
+      }
+    }
+  }
+
+  ThreadCacheEntry* Get(uint64_t allocator_id, const std::shared_ptr<HostBinnedArena>& arena) {
+    if (last_entry_ != nullptr && last_entry_->allocator_id == allocator_id) { return last_entry_; }
+    for (auto& entry : entries_) {
+      if (entry->allocator_id == allocator_id) {
+        last_entry_ = entry.get();
+        return last_entry_;
+      }
+    }
+    entries_.emplace_back(new ThreadCacheEntry());
+    last_entry_ = entries_.back().get();
+    last_entry_->allocator_id = allocator_id;
+    last_entry_->arena = arena;
+    return last_entry_;
+  }
+
+ private:
+  std::vector<std::unique_ptr<ThreadCacheEntry>> entries_;
+  ThreadCacheEntry* last_entry_;
+};
+
+thread_local ThreadCache thread_cache;
+
+uint64_t NewAllocatorId() {
+  static std::atomic<uint64_t> id(1);
+  return id++;
+}
+
+}  // namespace
+
+HostCachingAllocator::HostCachingAllocator(size_t max_cached_bytes)
+    : Allocator(), id_(NewAllocatorId()), arena_(new HostBinnedArena(max_cached_bytes)) {
+  CHECK_EQ(ThreadCacheClassSize(kThreadCacheClassNum - 1), kMaxThreadCachedSize);
+}
+
+HostCachingAllocator::~HostCachingAllocator() = default;
+
+void HostCachingAllocator::Allocate(char** mem_ptr, std::size_t size) {
+  // Size 0 gets a piece of the smallest class, as callers treat nullptr as out of memory
+  if (size > kMaxThreadCachedSize) {
+    *mem_ptr = arena_->Allocate(HostMemAlignedBytes(size));
+    return;
+  }
+  const int32_t cls = ThreadCacheClass4Size(size);
+  ThreadCacheEntry* entry = thread_cache.Get(id_, arena_);
+  char* head = entry->free_lists.at(cls);
+  if (head != nullptr) {
+    entry->free_lists.at(cls) = *reinterpret_cast<char**>(head);
+    entry->free_list_sizes.at(cls) -= 1;
+    const int64_t class_size = ThreadCacheClassSize(cls);
+    arena_->AddThreadCachedBytes(-class_size);
+    *mem_ptr = head;
+  } else {
+    *mem_ptr = arena_->Allocate(ThreadCacheClassSize(cls));
+  }
+}
+
+void HostCachingAllocator::Deallocate(char* mem_ptr, std::size_t size) {
+  if (mem_ptr == nullptr) { return; }
+  if (size > kMaxThreadCachedSize) {
+    arena_->Deallocate(mem_ptr);
+    return;
+  }
+  const int32_t cls = ThreadCacheClass4Size(size);
+  ThreadCacheEntry* entry = thread_cache.Get(id_, arena_);
+  *reinterpret_cast<char**>(mem_ptr) = entry->free_lists.at(cls);
+  entry->free_lists.at(cls) = mem_ptr;
+  entry->free_list_sizes.at(cls) += 1;
+  const int64_t class_size = ThreadCacheClassSize(cls);
+  arena_->AddThreadCachedBytes(class_size);
+  const int64_t max_count = ThreadCacheMaxCount(cls);
+  if (entry->free_list_sizes.at(cls) > max_count) {
+    // Return the older half to the arena in one batch
+    char* tail = entry->free_lists.at(cls);
+    FOR_RANGE(int64_t, i, 1, max_count / 2) { tail = *reinterpret_cast<char**>(tail); }
+    char* released = *reinterpret_cast<char**>(tail);
+    *reinterpret_cast<char**>(tail) = nullptr;
+    const int64_t released_cnt = entry->free_list_sizes.at(cls) - max_count / 2;
+    entry->free_list_sizes.at(cls) = max_count / 2;
+    arena_->AddThreadCachedBytes(-released_cnt * class_size);
+    arena_->DeallocateLinkedList(released);
+  }
+}
+
+HostCachingAllocatorStats HostCachingAllocator::GetStats() const { return arena_->GetStats(); }
+
+void HostCachingAllocator::ReleaseCachedMemory() { arena_->ReleaseFreeBlocks(); }
+
+HostCachingAllocator* GetGlobalHostCachingAllocator() {
+  // Never destroyed, so that thread caches may still flush into it at process exit
+  static HostCachingAllocator* allocator = []() -> HostCachingAllocator* {
+    if (std::getenv("ONEFLOW_DISABLE_HOST_CACHING_ALLOCATOR") != nullptr) { return nullptr; }
+    const size_t max_cached_mbyte =
+        ParseSizeFromEnv("ONEFLOW_HOST_CACHING_ALLOCATOR_MAX_CACHED_MBYTE", 1024);
+    return new HostCachingAllocator(max_cached_mbyte << 20);
+  }();
+  return allocator;
+}
+
+}  // namespace vm
+}  // namespace oneflow
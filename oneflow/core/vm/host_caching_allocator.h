@@ -0,0 +1,85 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_VM_HOST_CACHING_ALLOCATOR_H_
+#define ONEFLOW_CORE_VM_HOST_CACHING_ALLOCATOR_H_
+
+#include <cstdint>
+#include "oneflow/core/vm/allocator.h"
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+namespace vm {
+
+struct HostCachingAllocatorStats {
+  // bytes handed out to users, rounded up to the allocation unit
+  size_t bytes_in_use = 0;
+  // bytes of all blocks obtained from the system
+  size_t bytes_reserved = 0;
+  // reserved but not in use, including bytes held by per-thread caches
+  size_t bytes_cached = 0;
+  size_t bytes_thread_cached = 0;
+  size_t largest_free_piece_bytes = 0;
+  int64_t num_blocks = 0;
+  int64_t num_system_allocs = 0;
+  int64_t num_system_frees = 0;
+
+  // 0 when all free memory in the arena is one contiguous piece, close to 1 when it is scattered
+  double fragmentation() const {
+    const size_t arena_free_bytes = bytes_cached - bytes_thread_cached;
+    if (arena_free_bytes == 0) { return 0; }
+    return 1.0 - static_cast<double>(largest_free_piece_bytes) / arena_free_bytes;
+  }
+};
+
+class HostBinnedArena;
+
+// Caching allocator for host memory.
+//
+// Allocations up to kMaxThreadCachedSize are rounded up to a power of two and recycled through
+// per-thread free lists, so that the common small-size path takes no lock. Everything else is
+// served by HostBinnedArena, which splits and coalesces Pieces of large Blocks in the same way as
+// CudaAllocator. Blocks are multiples of 2MiB, aligned to 2MiB and advised to use transparent huge
+// pages. Once the cached bytes exceed max_cached_bytes, fully free Blocks are returned to the
+// system, and when the system runs out of memory all free Blocks are released before retrying.
+class HostCachingAllocator final : public Allocator {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(HostCachingAllocator);
+  explicit HostCachingAllocator(size_t max_cached_bytes);
+  ~HostCachingAllocator() override;
+
+  void Allocate(char** mem_ptr, std::size_t size) override;
+  void Deallocate(char* mem_ptr, std::size_t size) override;
+
+  HostCachingAllocatorStats GetStats() const;
+  // Returns all fully free Blocks to the system. Memory held by per-thread caches is kept
+  void ReleaseCachedMemory();
+
+  static constexpr size_t kMaxThreadCachedSize = 32 * 1024;
+
+ private:
+  const uint64_t id_;
+  std::shared_ptr<HostBinnedArena> arena_;
+};
+
+// Process-wide instance used for unpinned host memory, or nullptr when disabled by setting the
+// environment variable ONEFLOW_DISABLE_HOST_CACHING_ALLOCATOR. The cache limit defaults to 1GiB and
+// can be set by ONEFLOW_HOST_CACHING_ALLOCATOR_MAX_CACHED_MBYTE.
+HostCachingAllocator* GetGlobalHostCachingAllocator();
+
+}  // namespace vm
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_VM_HOST_CACHING_ALLOCATOR_H_
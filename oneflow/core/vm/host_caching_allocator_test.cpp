@@ -0,0 +1,119 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/vm/host_caching_allocator.h"
+
+namespace oneflow {
+namespace vm {
+
+TEST(HostCachingAllocator, reuse_and_coalesce) {
+  HostCachingAllocator allocator(1 << 30);
+  std::vector<char*> ptrs;
+  for (size_t size : {1, 100, 4096, 100000, 3 << 20}) {
+    char* ptr = nullptr;
+    allocator.Allocate(&ptr, size);
+    ASSERT_TRUE(ptr != nullptr);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(ptr) % 64, 0);
+    std::memset(ptr, 1, size);
+    ptrs.push_back(ptr);
+  }
+  HostCachingAllocatorStats stats = allocator.GetStats();
+  ASSERT_GE(stats.bytes_in_use, 1 + 100 + 4096 + 100000 + (3 << 20));
+  ASSERT_EQ(stats.bytes_reserved % (2 << 20), 0);
+
+  // A freed small buffer comes back from the thread cache
+  allocator.Deallocate(ptrs.at(1), 100);
+  char* ptr = nullptr;
+  allocator.Allocate(&ptr, 120);
+  ASSERT_EQ(ptr, ptrs.at(1));
+  ptrs.at(1) = ptr;
+
+  const std::vector<size_t> sizes{1, 120, 4096, 100000, 3 << 20};
+  FOR_RANGE(size_t, i, 0, ptrs.size()) { allocator.Deallocate(ptrs.at(i), sizes.at(i)); }
+  stats = allocator.GetStats();
+  ASSERT_EQ(stats.bytes_in_use, 0);
+  ASSERT_EQ(stats.bytes_cached, stats.bytes_reserved);
+  const int64_t num_system_allocs = stats.num_system_allocs;
+
+  // The large buffer is served from the cache without touching the system allocator
+  allocator.Allocate(&ptr, 3 << 20);
+  allocator.Deallocate(ptr, 3 << 20);
+  ASSERT_EQ(allocator.GetStats().num_system_allocs, num_system_allocs);
+
+  // Only the Block holding the thread cached small buffers is kept
+  allocator.ReleaseCachedMemory();
+  stats = allocator.GetStats();
+  ASSERT_EQ(stats.num_blocks, 1);
+  ASSERT_EQ(stats.bytes_reserved, 2 << 20);
+}
+
+TEST(HostCachingAllocator, zero_size) {
+  HostCachingAllocator allocator(1 << 30);
+  char* ptr = nullptr;
+  allocator.Allocate(&ptr, 0);
+  ASSERT_TRUE(ptr != nullptr);
+  char* other_ptr = nullptr;
+  allocator.Allocate(&other_ptr, 0);
+  ASSERT_TRUE(other_ptr != nullptr);
+  ASSERT_NE(ptr, other_ptr);
+  allocator.Deallocate(ptr, 0);
+  allocator.Deallocate(other_ptr, 0);
+  ASSERT_EQ(allocator.GetStats().bytes_in_use, 0);
+}
+
+TEST(HostCachingAllocator, release_over_limit) {
+  HostCachingAllocator allocator(4 << 20);
+  std::vector<char*> ptrs(8);
+  for (char*& ptr : ptrs) { allocator.Allocate(&ptr, 2 << 20); }
+  for (char* ptr : ptrs) { allocator.Deallocate(ptr, 2 << 20); }
+  const HostCachingAllocatorStats stats = allocator.GetStats();
+  ASSERT_LE(stats.bytes_cached, 4 << 20);
+  ASSERT_GT(stats.num_system_frees, 0);
+}
+
+TEST(HostCachingAllocator, multi_thread) {
+  HostCachingAllocator allocator(1 << 30);
+  std::vector<std::thread> threads;
+  FOR_RANGE(int32_t, thread_id, 0, 8) {
+    threads.emplace_back([&allocator, thread_id]() {
+      std::mt19937 gen(thread_id);
+      std::vector<std::pair<char*, size_t>> live;
+      FOR_RANGE(int32_t, i, 0, 20000) {
+        if (live.size() > 64 || (!live.empty() && gen() % 2 == 0)) {
+          const size_t idx = gen() % live.size();
+          ASSERT_EQ(*live.at(idx).first, static_cast<char>(live.at(idx).second));
+          allocator.Deallocate(live.at(idx).first, live.at(idx).second);
+          live.erase(live.begin() + idx);
+        } else {
+          const size_t size = 1 + gen() % ((gen() % 8 == 0) ? (1 << 20) : 4096);
+          char* ptr = nullptr;
+          allocator.Allocate(&ptr, size);
+          *ptr = static_cast<char>(size);
+          live.emplace_back(ptr, size);
+        }
+      }
+      for (const auto& pair : live) { allocator.Deallocate(pair.first, pair.second); }
+    });
+  }
+  for (std::thread& thread : threads) { thread.join(); }
+  // Exited threads have flushed their caches
+  const HostCachingAllocatorStats stats = allocator.GetStats();
+  ASSERT_EQ(stats.bytes_in_use, 0);
+  ASSERT_EQ(stats.bytes_thread_cached, 0);
+  LOG(INFO) << "reserved: " << stats.bytes_reserved << " fragmentation: " << stats.fragmentation();
+}
+
+}  // namespace vm
+}  // namespace oneflow
@@ -23,8 +23,24 @@ limitations under the License.
 
 namespace oneflow {
 
+namespace {
+
+int64_t ParseIntegerFromEnv(const char* env_var, int64_t default_value) {
+  const char* env_p = std::getenv(env_var);
+  if (env_p == nullptr) { return default_value; }
+  return std::stoll(env_p);
+}
+
+}  // namespace
+
 OneflowVM::OneflowVM(const Resource& resource, int64_t this_machine_id)
-    : vm_(ObjectMsgPtr<vm::VirtualMachine>::New(vm::MakeVmDesc(resource, this_machine_id).Get())) {
+    : vm_(ObjectMsgPtr<vm::VirtualMachine>::New(vm::MakeVmDesc(resource, this_machine_id).Get())),
+      scheduler_spin_us_(ParseIntegerFromEnv("ONEFLOW_VM_SCHEDULER_SPIN_US", 200)),
+      schedule_iteration_cnt_(0),
+      instruction_batch_size_(ParseIntegerFromEnv("ONEFLOW_EAGER_INSTRUCTION_BATCH_SIZE", 0)),
+      deferred_instruction_cnt_(0),
+      deferred_batch_cnt_(0) {
+  CHECK_GE(instruction_batch_size_, 0);
   OBJECT_MSG_LIST_UNSAFE_FOR_EACH_PTR(vm_->mut_thread_ctx_list(), thread_ctx) {
     auto thread = std::make_unique<std::thread>(&vm::ThreadCtx::LoopRun, thread_ctx);
     worker_threads_.push_back(std::move(thread));
@@ -45,19 +61,57 @@ void MakeCtrlSeqInstructions(vm::InstructionMsgList* list,
   list->EmplaceBack(std::move(instruction));
 }
 
-void ControlSync(vm::VirtualMachine* vm) {
+void ControlSync(OneflowVM* oneflow_vm) {
   BlockingCounter bc(1);
   vm::InstructionMsgList list;
   MakeCtrlSeqInstructions(&list, [&] { bc.Decrease(); });
-  vm->Receive(&list);
+  oneflow_vm->Receive(&list);
   bc.WaitUntilCntEqualZero();
 }
 
 }  // namespace
 
+void OneflowVM::Receive(vm::InstructionMsgList* instr_msg_list) {
+  // Blocks while too many instructions are in flight. It is not done under the lock since
+  // instructions finishing meanwhile may release tensors, which comes back here
+  mut_vm()->ThrottleReceive();
+  // Taking the deferred batch and handing it to the vm is one step under the lock, so the vm
+  // gets the instructions in the order they were submitted from any thread
+  std::unique_lock<std::mutex> lock(deferred_mutex_);
+  if (deferred_instr_msg_list_.empty()) {
+    if (instr_msg_list->empty()) { return; }
+    mut_vm()->ReceiveWithoutThrottle(instr_msg_list);
+  } else {
+    vm::InstructionMsgList list;
+    deferred_instr_msg_list_.MoveTo(&list);
+    deferred_batch_cnt_ += 1;
+    instr_msg_list->MoveTo(&list);
+    mut_vm()->ReceiveWithoutThrottle(&list);
+  }
+}
+
+void OneflowVM::DeferReceive(vm::InstructionMsgList* instr_msg_list) {
+  const int64_t batch_size = instruction_batch_size_;
+  if (batch_size <= 1) { return Receive(instr_msg_list); }
+  {
+    std::unique_lock<std::mutex> lock(deferred_mutex_);
+    deferred_instruction_cnt_ += instr_msg_list->size();
+    instr_msg_list->MoveTo(&deferred_instr_msg_list_);
+    if (static_cast<int64_t>(deferred_instr_msg_list_.size()) < batch_size) { return; }
+  }
+  FlushDeferred();
+}
+
+void OneflowVM::FlushDeferred() {
+  vm::InstructionMsgList list;
+  Receive(&list);
+}
+
 OneflowVM::~OneflowVM() {
-  ControlSync(mut_vm());
+  FlushDeferred();
+  ControlSync(this);
   exiting_ = true;
+  mut_vm()->mut_scheduler_notifier()->Notify();
   OBJECT_MSG_LIST_UNSAFE_FOR_EACH_PTR(vm_->mut_thread_ctx_list(), thread_ctx) {
     thread_ctx->mut_pending_instruction_list()->Close();
   }
@@ -65,11 +119,57 @@ OneflowVM::~OneflowVM() {
   schedule_thread_.join();
   CHECK(scheduler_exited_);
   CHECK(mut_vm()->Empty());
+  LOG(INFO) << "vm scheduler " << SchedulerStatsString();
+  if (deferred_batch_cnt_ > 0) {
+    LOG(INFO) << "vm received " << deferred_instruction_cnt_ << " deferred instructions in "
+              << deferred_batch_cnt_ << " batches";
+  }
+}
+
+std::string OneflowVM::SchedulerStatsString() const {
+  const vm::SchedulerNotifier& notifier = vm().scheduler_notifier();
+  const int64_t iteration_cnt = schedule_iteration_cnt_;
+  const int64_t instruction_cnt = notifier.received_instruction_cnt();
+  std::ostringstream ss;
+  ss << iteration_cnt << " schedule iterations for " << instruction_cnt << " instructions ("
+     << static_cast<double>(iteration_cnt) / std::max<int64_t>(instruction_cnt, 1)
+     << " per instruction), " << notifier.park_cnt() << " parks, " << notifier.wakeup_cnt()
+     << " woken by new work, " << notifier.parked_us() / 1e6 << " seconds parked";
+  return ss.str();
 }
 
 void OneflowVM::Loop() {
   auto* vm = mut_vm();
-  while (!exiting_) { vm->Schedule(); }
+  auto* notifier = vm->mut_scheduler_notifier();
+  const auto spin_duration = std::chrono::microseconds(scheduler_spin_us_);
+  uint64_t epoch = notifier->epoch();
+  int64_t flying_instruction_cnt = 0;
+  auto idle_start = std::chrono::steady_clock::now();
+  while (!exiting_) {
+    vm->Schedule();
+    schedule_iteration_cnt_ += 1;
+    if (scheduler_spin_us_ < 0) { continue; }
+    // New or finished instructions restart the spinning, so bursts of eager ops are dispatched
+    // with no wakeup latency
+    const uint64_t cur_epoch = notifier->epoch();
+    const int64_t cur_flying_instruction_cnt = *vm->mut_flying_instruction_cnt();
+    if (cur_epoch != epoch || cur_flying_instruction_cnt != flying_instruction_cnt) {
+      epoch = cur_epoch;
+      flying_instruction_cnt = cur_flying_instruction_cnt;
+      idle_start = std::chrono::steady_clock::now();
+      continue;
+    }
+    if (std::chrono::steady_clock::now() - idle_start < spin_duration) { continue; }
+    if (!vm->Empty()) {
+      // Device streams do not notify on completion, their instructions are polled without
+      // parking so that a finished kernel never waits for a park timeout
+      std::this_thread::yield();
+      continue;
+    }
+    // Nothing in flight, only Receive or the destructor can bring work. The timeout is only a
+    // safety net.
+    notifier->WaitFor(epoch, 1000 * 1000);
+  }
   scheduler_exited_ = true;
 }
 
@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef ONEFLOW_CORE_VM_ONEFLOW_VM_H_
 #define ONEFLOW_CORE_VM_ONEFLOW_VM_H_
 
+#include <atomic>
+#include <mutex>
 #include "oneflow/core/vm/interpret_type.h"
 #include "oneflow/core/vm/vm_desc.msg.h"
 #include "oneflow/core/vm/virtual_machine.msg.h"
@@ -33,6 +35,27 @@ class OneflowVM final {
   vm::VirtualMachine* mut_vm() { return vm_.Mutable(); }
   const vm::VirtualMachine& vm() const { return *vm_; }
 
+  // Hands instr_msg_list to the vm, after the deferred instructions if there are any. Submissions
+  // from different threads reach the vm in the order they took deferred_mutex_
+  void Receive(vm::InstructionMsgList* instr_msg_list);
+  // Appends instr_msg_list to the deferred batch, which is handed to the vm once it has
+  // instruction_batch_size() instructions, on the next Receive or on FlushDeferred
+  void DeferReceive(vm::InstructionMsgList* instr_msg_list);
+  void FlushDeferred();
+  int64_t instruction_batch_size() const { return instruction_batch_size_; }
+  // Instructions deferred so far, and the batches they were handed to the vm in
+  int64_t deferred_instruction_cnt() const { return deferred_instruction_cnt_; }
+  int64_t deferred_batch_cnt() const { return deferred_batch_cnt_; }
+  // 0 or 1 disables deferring
+  void set_instruction_batch_size(int64_t size) {
+    CHECK_GE(size, 0);
+    instruction_batch_size_ = size;
+  }
+
+  int64_t schedule_iteration_cnt() const { return schedule_iteration_cnt_; }
+  // Schedule iterations, parks, wakeups, idle time and received instructions so far
+  std::string SchedulerStatsString() const;
+
  private:
   void Loop();
 
@@ -42,6 +65,16 @@ class OneflowVM final {
   std::thread schedule_thread_;
   std::atomic<bool> exiting_;
   std::atomic<bool> scheduler_exited_;
+  // The scheduler spins this long without new work before it parks, negative to never park. It
+  // never parks while instructions are in flight, since their completion on devices is polled.
+  int64_t scheduler_spin_us_;
+  std::atomic<int64_t> schedule_iteration_cnt_;
+  std::atomic<int64_t> instruction_batch_size_;
+  // Guards the deferred batch and every hand-off to the vm
+  std::mutex deferred_mutex_;
+  vm::InstructionMsgList deferred_instr_msg_list_;
+  std::atomic<int64_t> deferred_instruction_cnt_;
+  std::atomic<int64_t> deferred_batch_cnt_;
 };
 
 }  // namespace oneflow
@@ -0,0 +1,57 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/vm/scheduler_notifier.h"
+
+namespace oneflow {
+namespace vm {
+
+void SchedulerNotifier::NotifyReceived(int64_t instruction_cnt) {
+  received_instruction_cnt_ += instruction_cnt;
+  Notify();
+}
+
+void SchedulerNotifier::Notify() {
+  // Both the increment and the load of parked_ are seq_cst, and so is the store of parked_ in
+  // WaitFor before it checks the epoch, so either the waiter sees the new epoch or this sees the
+  // waiter parked and notifies it under the mutex
+  epoch_.fetch_add(1, std::memory_order_seq_cst);
+  if (parked_.load(std::memory_order_seq_cst)) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.notify_one();
+  }
+}
+
+bool SchedulerNotifier::WaitFor(uint64_t epoch, int64_t timeout_us) {
+  const auto start = std::chrono::steady_clock::now();
+  bool notified = false;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    parked_.store(true, std::memory_order_seq_cst);
+    notified = cond_.wait_for(lock, std::chrono::microseconds(timeout_us), [&]() {
+      return epoch_.load(std::memory_order_seq_cst) != epoch;
+    });
+    parked_.store(false, std::memory_order_seq_cst);
+  }
+  park_cnt_ += 1;
+  if (notified) { wakeup_cnt_ += 1; }
+  parked_us_ += std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+  return notified;
+}
+
+}  // namespace vm
+}  // namespace oneflow
@@ -0,0 +1,66 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_VM_SCHEDULER_NOTIFIER_H_
+#define ONEFLOW_CORE_VM_SCHEDULER_NOTIFIER_H_
+
+#include <condition_variable>
+#include <mutex>
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+namespace vm {
+
+// Wakes the parked VM scheduler thread when there is new work for it. Notify is a single atomic
+// increment unless the scheduler is parked, so producers can call it on every instruction.
+class SchedulerNotifier final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(SchedulerNotifier);
+  SchedulerNotifier()
+      : epoch_(0), parked_(false), received_instruction_cnt_(0), park_cnt_(0), wakeup_cnt_(0),
+        parked_us_(0) {}
+  ~SchedulerNotifier() = default;
+
+  // Called by VirtualMachine::Receive with the number of received instructions
+  void NotifyReceived(int64_t instruction_cnt);
+  // Called by the worker threads after running instructions
+  void Notify();
+
+  // Changes whenever Notify is called
+  uint64_t epoch() const { return epoch_.load(std::memory_order_seq_cst); }
+  // Blocks until epoch() differs from epoch or timeout_us passes. True if woken by a Notify.
+  bool WaitFor(uint64_t epoch, int64_t timeout_us);
+
+  int64_t received_instruction_cnt() const { return received_instruction_cnt_; }
+  int64_t park_cnt() const { return park_cnt_; }
+  int64_t wakeup_cnt() const { return wakeup_cnt_; }
+  int64_t parked_us() const { return parked_us_; }
+
+ private:
+  std::atomic<uint64_t> epoch_;
+  std::atomic<bool> parked_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+
+  std::atomic<int64_t> received_instruction_cnt_;
+  std::atomic<int64_t> park_cnt_;
+  std::atomic<int64_t> wakeup_cnt_;
+  std::atomic<int64_t> parked_us_;
+};
+
+}  // namespace vm
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_VM_SCHEDULER_NOTIFIER_H_
@@ -0,0 +1,114 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/vm/scheduler_notifier.h"
+
+namespace oneflow {
+namespace vm {
+
+namespace {
+
+int64_t ElapsedUs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now()
+                                                               - start)
+      .count();
+}
+
+}  // namespace
+
+TEST(SchedulerNotifier, timeout) {
+  SchedulerNotifier notifier;
+  const auto start = std::chrono::steady_clock::now();
+  ASSERT_FALSE(notifier.WaitFor(notifier.epoch(), 2000));
+  ASSERT_GE(ElapsedUs(start), 2000);
+  ASSERT_EQ(notifier.park_cnt(), 1);
+  ASSERT_EQ(notifier.wakeup_cnt(), 0);
+}
+
+TEST(SchedulerNotifier, stale_epoch) {
+  SchedulerNotifier notifier;
+  const uint64_t epoch = notifier.epoch();
+  notifier.NotifyReceived(3);
+  // A notify between reading the epoch and parking must not be lost
+  ASSERT_TRUE(notifier.WaitFor(epoch, 1000 * 1000 * 1000));
+  ASSERT_EQ(notifier.received_instruction_cnt(), 3);
+}
+
+TEST(SchedulerNotifier, wake_on_notify) {
+  SchedulerNotifier notifier;
+  const int32_t round_num = 2000;
+  std::atomic<int32_t> consumed(0);
+  uint64_t epoch = notifier.epoch();
+  std::thread scheduler([&]() {
+    while (consumed < round_num) {
+      notifier.WaitFor(epoch, 1000 * 1000 * 1000);
+      epoch = notifier.epoch();
+      consumed += 1;
+    }
+  });
+  FOR_RANGE(int32_t, i, 0, round_num) {
+    const int32_t expected = consumed + 1;
+    notifier.NotifyReceived(1);
+    while (consumed < expected && consumed < round_num) { std::this_thread::yield(); }
+  }
+  scheduler.join();
+  ASSERT_EQ(notifier.received_instruction_cnt(), round_num);
+  ASSERT_EQ(notifier.park_cnt(), round_num);
+}
+
+// Round trip latency and scheduler cpu time of spinning vs parking when producer is mostly idle.
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST(SchedulerNotifier, DISABLED_spin_vs_park) {
+  const int32_t round_num = 200;
+  for (bool park : {false, true}) {
+    SchedulerNotifier notifier;
+    std::atomic<bool> exiting(false);
+    std::atomic<int32_t> handled(0);
+    std::atomic<int64_t> cpu_us(0);
+    uint64_t epoch = notifier.epoch();
+    std::thread scheduler([&]() {
+      while (!exiting) {
+        const uint64_t cur_epoch = notifier.epoch();
+        if (cur_epoch != epoch) {
+          epoch = cur_epoch;
+          handled += 1;
+        } else if (park) {
+          notifier.WaitFor(epoch, 1000 * 1000);
+        }
+      }
+      timespec cpu_time;
+      clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_time);
+      cpu_us = cpu_time.tv_sec * 1000000 + cpu_time.tv_nsec / 1000;
+    });
+    int64_t latency_us = 0;
+    const auto start = std::chrono::steady_clock::now();
+    FOR_RANGE(int32_t, i, 0, round_num) {
+      std::this_thread::sleep_for(std::chrono::microseconds(500));
+      const auto notify_time = std::chrono::steady_clock::now();
+      notifier.NotifyReceived(1);
+      while (handled <= i) { std::this_thread::yield(); }
+      latency_us += ElapsedUs(notify_time);
+    }
+    const int64_t wall_us = ElapsedUs(start);
+    exiting = true;
+    notifier.Notify();
+    scheduler.join();
+    LOG(INFO) << (park ? "park" : "spin") << ": " << static_cast<double>(latency_us) / round_num
+              << " us per wakeup, scheduler busy " << 100.0 * cpu_us / wall_us << "%";
+  }
+}
+
+}  // namespace vm
+}  // namespace oneflow
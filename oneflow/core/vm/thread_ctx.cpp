@@ -31,6 +31,7 @@ ObjectMsgConditionListStatus ThreadCtx::ReceiveAndRun() {
     tmp_list.Erase(instruction.Mutable());
     stream_type.Run(instruction.Mutable());
   }
+  if (has_scheduler_notifier()) { mut_scheduler_notifier()->Notify(); }
   return status;
 }
 
@@ -43,6 +44,7 @@ ObjectMsgConditionListStatus ThreadCtx::TryReceiveAndRun() {
     tmp_list.Erase(instruction);
     stream_type.Run(instruction);
   }
+  if (has_scheduler_notifier()) { mut_scheduler_notifier()->Notify(); }
   return status;
 }
 
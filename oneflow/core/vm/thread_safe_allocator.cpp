@@ -15,6 +15,10 @@ limitations under the License.
 */
 #include "oneflow/core/vm/thread_safe_allocator.h"
 #include "oneflow/core/common/util.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <set>
 
 namespace oneflow {
 namespace vm {
@@ -29,6 +33,269 @@ void ThreadSafeAllocator::Deallocate(char* mem_ptr, std::size_t size) {
   backend_allocator_->Deallocate(mem_ptr, size);
 }
 
+namespace {
+
+constexpr std::size_t kMinClassSize = 512;
+constexpr int32_t kClassNum = 37;  // 512B, 640B, 768B, 896B, 1KiB, 1.25KiB, ..., 256KiB
+constexpr std::size_t kMagazineBytes = 256 << 10;
+constexpr std::size_t kMaxDepotMagazineNum = 4;
+
+inline int32_t Log2Floor(uint64_t value) { return 63 ^ __builtin_clzll(value); }
+
+inline int32_t SizeClass(std::size_t size) {
+  if (size <= kMinClassSize) { return 0; }
+  const uint64_t val = size - 1;
+  const int32_t log = Log2Floor(val);
+  return 1 + (log - 9) * 4 + static_cast<int32_t>((val >> (log - 2)) - 4);
+}
+
+inline std::size_t ClassSize(int32_t cls) {
+  if (cls == 0) { return kMinClassSize; }
+  const int32_t log = 9 + (cls - 1) / 4;
+  return static_cast<std::size_t>(4 + (cls - 1) % 4 + 1) << (log - 2);
+}
+
+inline std::size_t MagazineCapacity(int32_t cls) {
+  return std::min<std::size_t>(std::max<std::size_t>(kMagazineBytes / ClassSize(cls), 2), 64);
+}
+
+using Magazine = std::vector<char*>;
+
+}  // namespace
+
+// Magazines of one thread for one ShardedThreadSafeAllocator. The previous magazine avoids
+// going to the depot on every allocation when a thread alternates around a magazine boundary
+struct ThreadMagazines {
+  uint64_t allocator_id = 0;
+  std::weak_ptr<ShardedAllocatorDepot> depot;
+  std::array<Magazine, kClassNum> loaded;
+  std::array<Magazine, kClassNum> previous;
+};
+
+// Owns the backend allocator and the full magazines given back by threads
+class ShardedAllocatorDepot final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ShardedAllocatorDepot);
+  explicit ShardedAllocatorDepot(std::unique_ptr<Allocator>&& backend_allocator)
+      : backend_allocator_(std::move(backend_allocator)), shards_(kClassNum) {}
+  // Only runs once no thread holds the depot, so no thread is allocating from it. Magazines
+  // of threads still alive are drained here, the exit hook of such a thread then skips them
+  ~ShardedAllocatorDepot() {
+    std::set<std::shared_ptr<ThreadMagazines>> thread_magazines;
+    {
+      std::unique_lock<std::mutex> lock(thread_magazines_mutex_);
+      thread_magazines.swap(thread_magazines_);
+    }
+    for (const auto& magazines : thread_magazines) {
+      FOR_RANGE(int32_t, cls, 0, kClassNum) {
+        BackendDeallocate(magazines->loaded.at(cls), ClassSize(cls));
+        BackendDeallocate(magazines->previous.at(cls), ClassSize(cls));
+        magazines->loaded.at(cls).clear();
+        magazines->previous.at(cls).clear();
+      }
+    }
+    FOR_RANGE(int32_t, cls, 0, kClassNum) {
+      for (const Magazine& magazine : shards_.at(cls).magazines) {
+        BackendDeallocate(magazine, ClassSize(cls));
+      }
+    }
+  }
+
+  void RegisterThreadMagazines(const std::shared_ptr<ThreadMagazines>& thread_magazines) {
+    std::unique_lock<std::mutex> lock(thread_magazines_mutex_);
+    thread_magazines_.insert(thread_magazines);
+  }
+  // Called by the owner thread on exit. Whoever unregisters the magazines drains them
+  void FlushThreadMagazines(const std::shared_ptr<ThreadMagazines>& thread_magazines) {
+    {
+      std::unique_lock<std::mutex> lock(thread_magazines_mutex_);
+      if (thread_magazines_.erase(thread_magazines) == 0) { return; }
+    }
+    FOR_RANGE(int32_t, cls, 0, kClassNum) {
+      for (Magazine* magazine :
+           {&thread_magazines->loaded.at(cls), &thread_magazines->previous.at(cls)}) {
+        if (!magazine->empty()) { PushFull(cls, std::move(*magazine)); }
+        magazine->clear();
+      }
+    }
+  }
+
+  // When the backend is out of memory, the cached blocks of the depot and of the calling thread
+  // are given back to it before retrying, so that its own garbage collection sees them. The
+  // magazines of other threads are only touched by their owners and stay cached.
+  char* BackendAllocate(std::size_t size, ThreadMagazines* magazines) {
+    char* ptr = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(backend_mutex_);
+      backend_allocator_->TryAllocate(&ptr, size);
+    }
+    if (ptr != nullptr || size == 0) { return ptr; }
+    FOR_RANGE(int32_t, cls, 0, kClassNum) {
+      BackendDeallocate(magazines->loaded.at(cls), ClassSize(cls));
+      BackendDeallocate(magazines->previous.at(cls), ClassSize(cls));
+      magazines->loaded.at(cls).clear();
+      magazines->previous.at(cls).clear();
+      std::vector<Magazine> depot_magazines;
+      {
+        std::unique_lock<std::mutex> lock(shards_.at(cls).mutex);
+        depot_magazines.swap(shards_.at(cls).magazines);
+      }
+      for (const Magazine& magazine : depot_magazines) {
+        BackendDeallocate(magazine, ClassSize(cls));
+      }
+    }
+    std::unique_lock<std::mutex> lock(backend_mutex_);
+    backend_allocator_->Allocate(&ptr, size);
+    return ptr;
+  }
+  void BackendDeallocate(char* ptr, std::size_t size) {
+    std::unique_lock<std::mutex> lock(backend_mutex_);
+    backend_allocator_->Deallocate(ptr, size);
+  }
+  void BackendDeallocate(const Magazine& magazine, std::size_t size) {
+    std::unique_lock<std::mutex> lock(backend_mutex_);
+    for (char* ptr : magazine) { backend_allocator_->Deallocate(ptr, size); }
+  }
+
+  bool PopFull(int32_t cls, Magazine* magazine) {
+    Shard& shard = shards_.at(cls);
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    if (shard.magazines.empty()) { return false; }
+    *magazine = std::move(shard.magazines.back());
+    shard.magazines.pop_back();
+    return true;
+  }
+  void PushFull(int32_t cls, Magazine&& magazine) {
+    Shard& shard = shards_.at(cls);
+    {
+      std::unique_lock<std::mutex> lock(shard.mutex);
+      if (shard.magazines.size() < kMaxDepotMagazineNum) {
+        shard.magazines.push_back(std::move(magazine));
+        return;
+      }
+    }
+    BackendDeallocate(magazine, ClassSize(cls));
+  }
+
+ private:
+  struct Shard {
+    std::mutex mutex;
+    std::vector<Magazine> magazines;
+  };
+
+  std::unique_ptr<Allocator> backend_allocator_;
+  std::mutex backend_mutex_;
+  std::vector<Shard> shards_;
+  std::mutex thread_magazines_mutex_;
+  std::set<std::shared_ptr<ThreadMagazines>> thread_magazines_;
+};
+
+namespace {
+
+class ThreadMagazineCache final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ThreadMagazineCache);
+  ThreadMagazineCache() : last_entry_(nullptr) {}
+  ~ThreadMagazineCache() {
+    for (auto& entry : entries_) {
+      // The depot of a destroyed allocator has taken the magazines back itself
+      std::shared_ptr<ShardedAllocatorDepot> depot = entry->depot.lock();
+      if (depot) { depot->FlushThreadMagazines(entry); }
+    }
+  }
+
+  ThreadMagazines* Get(uint64_t allocator_id,
+                       const std::shared_ptr<ShardedAllocatorDepot>& depot) {
+    if (last_entry_ != nullptr && last_entry_->allocator_id == allocator_id) { return last_entry_; }
+    for (auto& entry : entries_) {
+      if (entry->allocator_id == allocator_id) {
+        last_entry_ = entry.get();
+        return last_entry_;
+      }
+    }
+    // Entries of destroyed allocators hold no memory any more
+    entries_.erase(std::remove_if(entries_.begin(), entries_.end(),
+                                  [](const std::shared_ptr<ThreadMagazines>& entry) {
+                                    return entry->depot.expired();
+                                  }),
+                   entries_.end());
+    entries_.emplace_back(std::make_shared<ThreadMagazines>());
+    last_entry_ = entries_.back().get();
+    last_entry_->allocator_id = allocator_id;
+    last_entry_->depot = depot;
+    depot->RegisterThreadMagazines(entries_.back());
+    return last_entry_;
+  }
+
+ private:
+  std::vector<std::shared_ptr<ThreadMagazines>> entries_;
+  ThreadMagazines* last_entry_;
+};
+
+thread_local ThreadMagazineCache thread_magazine_cache;
+
+uint64_t NewShardedAllocatorId() {
+  static std::atomic<uint64_t> id(1);
+  return id++;
+}
+
+}  // namespace
+
+constexpr std::size_t ShardedThreadSafeAllocator::kMaxCachedSize;
+
+ShardedThreadSafeAllocator::ShardedThreadSafeAllocator(
+    std::unique_ptr<Allocator>&& backend_allocator)
+    : Allocator(),
+      id_(NewShardedAllocatorId()),
+      depot_(new ShardedAllocatorDepot(std::move(backend_allocator))) {
+  CHECK_EQ(ClassSize(kClassNum - 1), kMaxCachedSize);
+}
+
+ShardedThreadSafeAllocator::~ShardedThreadSafeAllocator() = default;
+
+void ShardedThreadSafeAllocator::Allocate(char** mem_ptr, std::size_t size) {
+  ThreadMagazines* magazines = thread_magazine_cache.Get(id_, depot_);
+  if (size == 0 || size > kMaxCachedSize) {
+    *mem_ptr = depot_->BackendAllocate(size, magazines);
+    return;
+  }
+  const int32_t cls = SizeClass(size);
+  Magazine* loaded = &magazines->loaded.at(cls);
+  if (loaded->empty()) {
+    if (!magazines->previous.at(cls).empty()) {
+      std::swap(*loaded, magazines->previous.at(cls));
+    } else if (!depot_->PopFull(cls, loaded)) {
+      *mem_ptr = depot_->BackendAllocate(ClassSize(cls), magazines);
+      return;
+    }
+  }
+  *mem_ptr = loaded->back();
+  loaded->pop_back();
+}
+
+void ShardedThreadSafeAllocator::Deallocate(char* mem_ptr, std::size_t size) {
+  if (size == 0 || size > kMaxCachedSize) {
+    depot_->BackendDeallocate(mem_ptr, size);
+    return;
+  }
+  const int32_t cls = SizeClass(size);
+  ThreadMagazines* magazines = thread_magazine_cache.Get(id_, depot_);
+  Magazine* loaded = &magazines->loaded.at(cls);
+  Magazine* previous = &magazines->previous.at(cls);
+  const std::size_t capacity = MagazineCapacity(cls);
+  if (loaded->size() == capacity) {
+    // The previous magazine is always either empty or full. A full one goes to the depot, all its
+    // blocks in one batch
+    if (!previous->empty()) {
+      depot_->PushFull(cls, std::move(*previous));
+      previous->clear();
+    }
+    std::swap(*loaded, *previous);
+    loaded->reserve(capacity);
+  }
+  loaded->push_back(mem_ptr);
+}
+
 void SingleThreadOnlyAllocator::Allocate(char** mem_ptr, std::size_t size) {
   CheckUniqueThreadAccess();
   backend_allocator_->Allocate(mem_ptr, size);
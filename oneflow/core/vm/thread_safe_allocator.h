@@ -17,6 +17,7 @@ limitations under the License.
 #define ONEFLOW_CORE_VM_THREAD_SAFE_ALLOCATOR_H_
 
 #include <cstdint>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include "oneflow/core/vm/allocator.h"
@@ -39,6 +40,29 @@ class ThreadSafeAllocator final : public Allocator {
   std::mutex mutex4backend_allocator_;
 };
 
+class ShardedAllocatorDepot;
+
+// Thread-safe wrapper that keeps the backend lock off the common path. Sizes up to
+// kMaxCachedSize are rounded up to one of 4 classes per power of two, and freed blocks are
+// recycled through per-thread magazines of their class. Full magazines are exchanged with a
+// central depot under a per-class lock, so only depot misses and larger sizes lock the backend.
+// When the backend runs out of memory, the depot and the calling thread hand their cached blocks
+// back to it before it collects garbage.
+class ShardedThreadSafeAllocator final : public Allocator {
+ public:
+  explicit ShardedThreadSafeAllocator(std::unique_ptr<Allocator>&& backend_allocator);
+  ~ShardedThreadSafeAllocator() override;
+
+  void Allocate(char** mem_ptr, std::size_t size) override;
+  void Deallocate(char* mem_ptr, std::size_t size) override;
+
+  static constexpr std::size_t kMaxCachedSize = 256 << 10;
+
+ private:
+  const uint64_t id_;
+  std::shared_ptr<ShardedAllocatorDepot> depot_;
+};
+
 class SingleThreadOnlyAllocator final : public Allocator {
  public:
   explicit SingleThreadOnlyAllocator(std::unique_ptr<Allocator>&& backend_allocator)
@@ -0,0 +1,213 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/vm/thread_safe_allocator.h"
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+namespace vm {
+
+namespace {
+
+// Counts the live blocks so that leaks and double frees show up
+class MallocAllocator final : public Allocator {
+ public:
+  explicit MallocAllocator(std::atomic<int64_t>* live_num) : live_num_(live_num) {}
+  ~MallocAllocator() override = default;
+
+  void Allocate(char** mem_ptr, std::size_t size) override {
+    *mem_ptr = static_cast<char*>(std::malloc(std::max<std::size_t>(size, 1)));
+    *live_num_ += 1;
+  }
+  void Deallocate(char* mem_ptr, std::size_t size) override {
+    std::free(mem_ptr);
+    *live_num_ -= 1;
+  }
+
+ private:
+  std::atomic<int64_t>* live_num_;
+};
+
+// Fails allocations beyond capacity bytes in use, like a device running out of memory
+class BoundedAllocator final : public Allocator {
+ public:
+  explicit BoundedAllocator(std::size_t capacity) : capacity_(capacity), used_(0) {}
+  ~BoundedAllocator() override { CHECK_EQ(used_, 0); }
+
+  void Allocate(char** mem_ptr, std::size_t size) override {
+    TryAllocate(mem_ptr, size);
+    CHECK(*mem_ptr != nullptr) << "out of memory";
+  }
+  void Deallocate(char* mem_ptr, std::size_t size) override {
+    std::free(mem_ptr);
+    used_ -= size;
+  }
+  void TryAllocate(char** mem_ptr, std::size_t size) override {
+    *mem_ptr = nullptr;
+    if (used_ + size > capacity_) { return; }
+    *mem_ptr = static_cast<char*>(std::malloc(size));
+    used_ += size;
+  }
+
+ private:
+  std::size_t capacity_;
+  std::size_t used_;
+};
+
+// Each thread keeps up to max_live blocks of random sizes and checks their contents on free
+void RunMixedSizes(Allocator* allocator, int32_t thread_num, int32_t iter_num, size_t max_live) {
+  std::vector<std::thread> threads;
+  FOR_RANGE(int32_t, thread_id, 0, thread_num) {
+    threads.emplace_back([allocator, thread_id, iter_num, max_live]() {
+      std::mt19937 gen(thread_id);
+      std::vector<std::pair<char*, size_t>> live;
+      FOR_RANGE(int32_t, i, 0, iter_num) {
+        if (live.size() >= max_live || (!live.empty() && gen() % 2 == 0)) {
+          const size_t idx = gen() % live.size();
+          const std::pair<char*, size_t> block = live.at(idx);
+          live.at(idx) = live.back();
+          live.pop_back();
+          if (block.second > 1) { CHECK_EQ(block.first[0], static_cast<char>(block.second)); }
+          CHECK_EQ(block.first[block.second - 1], static_cast<char>(thread_id));
+          allocator->Deallocate(block.first, block.second);
+        } else {
+          // Mostly small sizes, now and then one beyond the cached ones
+          const size_t size = gen() % 16 == 0 ? 1 + gen() % (512 << 10) : 1 + gen() % 16384;
+          char* ptr = nullptr;
+          allocator->Allocate(&ptr, size);
+          ptr[0] = static_cast<char>(size);
+          ptr[size - 1] = static_cast<char>(thread_id);
+          live.emplace_back(ptr, size);
+        }
+      }
+      for (const auto& block : live) { allocator->Deallocate(block.first, block.second); }
+    });
+  }
+  for (std::thread& thread : threads) { thread.join(); }
+}
+
+}  // namespace
+
+TEST(ShardedThreadSafeAllocator, reuse) {
+  std::atomic<int64_t> live_num(0);
+  {
+    ShardedThreadSafeAllocator allocator(
+        std::unique_ptr<Allocator>(new MallocAllocator(&live_num)));
+    char* ptr = nullptr;
+    allocator.Allocate(&ptr, 1000);
+    std::memset(ptr, 1, 1000);
+    allocator.Deallocate(ptr, 1000);
+    // Sizes of the same class share the freed block
+    char* reused_ptr = nullptr;
+    allocator.Allocate(&reused_ptr, 1024);
+    ASSERT_EQ(reused_ptr, ptr);
+    std::memset(reused_ptr, 1, 1024);
+    allocator.Deallocate(reused_ptr, 1024);
+    ASSERT_EQ(live_num, 1);
+
+    char* large_ptr = nullptr;
+    allocator.Allocate(&large_ptr, ShardedThreadSafeAllocator::kMaxCachedSize + 1);
+    allocator.Deallocate(large_ptr, ShardedThreadSafeAllocator::kMaxCachedSize + 1);
+    ASSERT_EQ(live_num, 1);
+  }
+  ASSERT_EQ(live_num, 0);
+}
+
+TEST(ShardedThreadSafeAllocator, multi_thread) {
+  std::atomic<int64_t> live_num(0);
+  {
+    ShardedThreadSafeAllocator allocator(
+        std::unique_ptr<Allocator>(new MallocAllocator(&live_num)));
+    RunMixedSizes(&allocator, 8, 20000, 64);
+    // Blocks freed by exited threads are kept in the depot or returned to the backend
+    RunMixedSizes(&allocator, 8, 20000, 64);
+  }
+  ASSERT_EQ(live_num, 0);
+}
+
+TEST(ShardedThreadSafeAllocator, destroyed_before_thread_exit) {
+  std::atomic<int64_t> live_num(0);
+  std::unique_ptr<ShardedThreadSafeAllocator> allocator(
+      new ShardedThreadSafeAllocator(std::unique_ptr<Allocator>(new MallocAllocator(&live_num))));
+  std::mutex mutex;
+  std::condition_variable cond;
+  bool cached = false;
+  bool destroyed = false;
+  std::thread thread([&]() {
+    std::vector<char*> ptrs(100);
+    for (char*& ptr : ptrs) { allocator->Allocate(&ptr, 1000); }
+    for (char* ptr : ptrs) { allocator->Deallocate(ptr, 1000); }
+    std::unique_lock<std::mutex> lock(mutex);
+    cached = true;
+    cond.notify_one();
+    // The magazines of this thread are drained by the allocator, not on exit
+    cond.wait(lock, [&]() { return destroyed; });
+  });
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [&]() { return cached; });
+    ASSERT_GT(live_num, 0);
+    allocator.reset();
+    ASSERT_EQ(live_num, 0);
+    destroyed = true;
+    cond.notify_one();
+  }
+  thread.join();
+  ASSERT_EQ(live_num, 0);
+}
+
+TEST(ShardedThreadSafeAllocator, drain_cached_blocks_when_backend_out_of_memory) {
+  const std::size_t capacity = 4 << 20;
+  ShardedThreadSafeAllocator allocator(
+      std::unique_ptr<Allocator>(new BoundedAllocator(capacity)));
+  // Blocks freed by another thread end up in the depot, those of this thread in its magazines
+  std::thread thread([&]() {
+    std::vector<char*> ptrs(capacity / 2 / 1024);
+    for (char*& ptr : ptrs) { allocator.Allocate(&ptr, 1024); }
+    for (char* ptr : ptrs) { allocator.Deallocate(ptr, 1024); }
+  });
+  thread.join();
+  std::vector<char*> ptrs(capacity / 4 / 4096);
+  for (char*& ptr : ptrs) { allocator.Allocate(&ptr, 4096); }
+  for (char* ptr : ptrs) { allocator.Deallocate(ptr, 4096); }
+  // Only fits once all the cached blocks are back in the backend
+  char* ptr = nullptr;
+  allocator.Allocate(&ptr, capacity);
+  ASSERT_TRUE(ptr != nullptr);
+  allocator.Deallocate(ptr, capacity);
+}
+
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST(ShardedThreadSafeAllocator, DISABLED_contention_vs_thread_safe_allocator) {
+  const int32_t iter_num = 200000;
+  for (int32_t thread_num : {1, 4, 16}) {
+    std::atomic<int64_t> live_num(0);
+    ThreadSafeAllocator locked(std::unique_ptr<Allocator>(new MallocAllocator(&live_num)));
+    ShardedThreadSafeAllocator sharded(std::unique_ptr<Allocator>(new MallocAllocator(&live_num)));
+    std::vector<double> mops;
+    for (Allocator* allocator : std::vector<Allocator*>{&locked, &sharded}) {
+      const auto start = std::chrono::steady_clock::now();
+      RunMixedSizes(allocator, thread_num, iter_num, 16);
+      const double seconds =
+          std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      mops.push_back(thread_num * iter_num / seconds / 1e6);
+    }
+    LOG(INFO) << thread_num << " threads, ThreadSafeAllocator " << mops.at(0)
+              << " Mops/s, ShardedThreadSafeAllocator " << mops.at(1) << " Mops/s";
+  }
+}
+
+}  // namespace vm
+}  // namespace oneflow
@@ -559,6 +559,7 @@ void VirtualMachine::__Init__(const VmDesc& vm_desc, ObjectMsgAllocator* allocat
     BalancedSplitter bs(stream_desc->parallel_num(), stream_desc->num_threads());
     for (int64_t i = 0, rel_global_device_id = 0; i < stream_desc->num_threads(); ++i) {
       auto thread_ctx = ObjectMsgPtr<ThreadCtx>::NewFrom(allocator, stream_rt_desc.Get());
+      thread_ctx->set_scheduler_notifier(mut_scheduler_notifier());
       mut_thread_ctx_list()->PushBack(thread_ctx.Mutable());
       for (int j = bs.At(i).begin(); j < bs.At(i).end(); ++j, ++rel_global_device_id) {
         StreamId stream_id;
@@ -575,13 +576,11 @@ void VirtualMachine::__Init__(const VmDesc& vm_desc, ObjectMsgAllocator* allocat
 }
 
 void VirtualMachine::Receive(InstructionMsgList* compute_instr_msg_list) {
-  InstructionMsgList new_instr_msg_list;
-  OBJECT_MSG_LIST_FOR_EACH_PTR(compute_instr_msg_list, compute_instr_msg) {
-    if (!compute_instr_msg->phy_instr_operand()) {
-      new_instr_msg_list.EmplaceBack(compute_instr_msg->MakeInferInstrMsg());
-    }
-    compute_instr_msg_list->MoveToDstBack(compute_instr_msg, &new_instr_msg_list);
-  }
+  ThrottleReceive();
+  ReceiveWithoutThrottle(compute_instr_msg_list);
+}
+
+void VirtualMachine::ThrottleReceive() {
   static const int64_t kHighWaterMark = 500;
   static const int64_t kLowWaterMark = 200;
   if (*mut_flying_instruction_cnt() > kHighWaterMark) {
@@ -589,7 +588,19 @@ void VirtualMachine::Receive(InstructionMsgList* compute_instr_msg_list) {
       while (*mut_flying_instruction_cnt() > kLowWaterMark) {}
     });
   }
+}
+
+void VirtualMachine::ReceiveWithoutThrottle(InstructionMsgList* compute_instr_msg_list) {
+  InstructionMsgList new_instr_msg_list;
+  OBJECT_MSG_LIST_FOR_EACH_PTR(compute_instr_msg_list, compute_instr_msg) {
+    if (!compute_instr_msg->phy_instr_operand()) {
+      new_instr_msg_list.EmplaceBack(compute_instr_msg->MakeInferInstrMsg());
+    }
+    compute_instr_msg_list->MoveToDstBack(compute_instr_msg, &new_instr_msg_list);
+  }
+  const int64_t instr_cnt = new_instr_msg_list.size();
   mut_pending_msg_list()->MoveFrom(&new_instr_msg_list);
+  mut_scheduler_notifier()->NotifyReceived(instr_cnt);
 }
 
 void VirtualMachine::Receive(ObjectMsgPtr<InstructionMsg>&& compute_instr_msg) {
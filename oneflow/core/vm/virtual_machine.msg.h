@@ -25,6 +25,7 @@ limitations under the License.
 #include "oneflow/core/vm/thread_ctx.msg.h"
 #include "oneflow/core/vm/vm_object.msg.h"
 #include "oneflow/core/vm/vm_resource_desc.msg.h"
+#include "oneflow/core/vm/scheduler_notifier.h"
 #include "oneflow/core/common/range.h"
 #include "oneflow/core/job/parallel_desc.h"
 
@@ -40,6 +41,9 @@ OBJECT_MSG_BEGIN(VirtualMachine);
   OF_PUBLIC void __Init__(const VmDesc& vm_desc, ObjectMsgAllocator* allocator);
   OF_PUBLIC void Receive(InstructionMsgList* instr_list);
   OF_PUBLIC void Receive(ObjectMsgPtr<InstructionMsg>&& instruction_msg);
+  // Receive is ThrottleReceive followed by ReceiveWithoutThrottle
+  OF_PUBLIC void ThrottleReceive();
+  OF_PUBLIC void ReceiveWithoutThrottle(InstructionMsgList* instr_list);
   OF_PUBLIC void Schedule();
   OF_PUBLIC bool Empty() const;
   OF_PUBLIC Maybe<const ParallelDesc> GetInstructionParallelDesc(const InstructionMsg&);
@@ -57,6 +61,7 @@ OBJECT_MSG_BEGIN(VirtualMachine);
   OBJECT_MSG_DEFINE_STRUCT(Range, machine_id_range);
   OBJECT_MSG_DEFINE_STRUCT(std::atomic<int64_t>, flying_instruction_cnt);
   OBJECT_MSG_DEFINE_PTR(ObjectMsgAllocator, vm_thread_only_allocator);
+  OBJECT_MSG_DEFINE_STRUCT(SchedulerNotifier, scheduler_notifier);
 
   // heads
   OBJECT_MSG_DEFINE_LIST_HEAD(Stream, active_stream_link, active_stream_list);
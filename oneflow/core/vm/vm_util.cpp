@@ -36,11 +36,35 @@ ObjectMsgPtr<InstructionMsg> NewInstruction(const std::string& instr_type_name)
 
 Maybe<void> Run(vm::InstructionMsgList* instr_msg_list) {
   auto* oneflow_vm = JUST(GlobalMaybe<OneflowVM>());
-  auto* vm = oneflow_vm->mut_vm();
-  vm->Receive(instr_msg_list);
+  oneflow_vm->Receive(instr_msg_list);
   return Maybe<void>::Ok();
 }
 
+Maybe<void> DeferredRun(vm::InstructionMsgList* instr_msg_list) {
+  auto* oneflow_vm = JUST(GlobalMaybe<OneflowVM>());
+  oneflow_vm->DeferReceive(instr_msg_list);
+  return Maybe<void>::Ok();
+}
+
+Maybe<void> FlushDeferred() {
+  auto* oneflow_vm = JUST(GlobalMaybe<OneflowVM>());
+  oneflow_vm->FlushDeferred();
+  return Maybe<void>::Ok();
+}
+
+Maybe<void> SetInstructionBatchSize(int64_t size) {
+  auto* oneflow_vm = JUST(GlobalMaybe<OneflowVM>());
+  CHECK_GE_OR_RETURN(size, 0);
+  oneflow_vm->FlushDeferred();
+  oneflow_vm->set_instruction_batch_size(size);
+  return Maybe<void>::Ok();
+}
+
+Maybe<std::pair<int64_t, int64_t>> DeferredInstructionAndBatchCnt() {
+  auto* oneflow_vm = JUST(GlobalMaybe<OneflowVM>());
+  return std::make_pair(oneflow_vm->deferred_instruction_cnt(), oneflow_vm->deferred_batch_cnt());
+}
+
 Maybe<void> SingleClientSync() {
   BlockingCounter bc(1);
   LogicalRun([&bc](InstructionsBuilder* builder) {
@@ -28,6 +28,11 @@ class InstructionMsg;
 ObjectMsgPtr<InstructionMsg> NewInstruction(const std::string& instr_type_name);
 
 Maybe<void> Run(vm::InstructionMsgList* instr_msg_list);
+// Like Run, but the instructions may wait in a batch until the next Run or FlushDeferred
+Maybe<void> DeferredRun(vm::InstructionMsgList* instr_msg_list);
+Maybe<void> FlushDeferred();
+Maybe<void> SetInstructionBatchSize(int64_t size);
+Maybe<std::pair<int64_t, int64_t>> DeferredInstructionAndBatchCnt();
 Maybe<void> SingleClientSync();
 
 }  // namespace vm
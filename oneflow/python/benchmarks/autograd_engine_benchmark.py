@@ -0,0 +1,87 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+"""
+Compares the graph and stack autograd engines on a deep chain of small ops with side branches
+that do not lead to the requested grad. Each engine runs in its own process, since
+ONEFLOW_AUTOGRAD_ENGINE is read once.
+
+    python3 autograd_engine_benchmark.py [--depth 200] [--size 262144] [--iters 10]
+"""
+import argparse
+import os
+import resource
+import subprocess
+import sys
+import time
+
+import numpy as np
+
+
+def run_once(args):
+    import oneflow.experimental as flow
+
+    flow.enable_eager_execution()
+    np_x = np.random.randn(args.size).astype(np.float32)
+    x = flow.Tensor(np_x, requires_grad=True)
+    w = flow.Tensor(np_x, requires_grad=True)
+    backward_seconds = []
+    for _ in range(args.iters):
+        h = x
+        side = None
+        for i in range(args.depth):
+            h = h * 0.5 + h
+            if i % 4 == 0:
+                # Dead ends for autograd.grad(x), the graph engine never runs them
+                side = h * w if side is None else side + h * w
+        y = (h + side).sum()
+        start = time.perf_counter()
+        (x_grad,) = flow.autograd.grad(y, x, None)
+        x_grad.numpy()
+        backward_seconds.append(time.perf_counter() - start)
+    peak_mb = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss / 1024.0
+    print(
+        "%s engine: backward %.2f ms (median of %d), peak rss %.1f MB"
+        % (
+            os.environ.get("ONEFLOW_AUTOGRAD_ENGINE", "stack"),
+            1000 * float(np.median(backward_seconds)),
+            args.iters,
+            peak_mb,
+        )
+    )
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--depth", type=int, default=200)
+    parser.add_argument("--size", type=int, default=262144)
+    parser.add_argument("--iters", type=int, default=10)
+    parser.add_argument("--child", action="store_true")
+    args = parser.parse_args()
+    if args.child:
+        run_once(args)
+        return
+    for engine in ["stack", "graph"]:
+        env = dict(os.environ, ONEFLOW_AUTOGRAD_ENGINE=engine)
+        subprocess.check_call(
+            [sys.executable, __file__, "--child"]
+            + ["--depth", str(args.depth), "--size", str(args.size)]
+            + ["--iters", str(args.iters)],
+            env=env,
+        )
+
+
+if __name__ == "__main__":
+    main()
@@ -270,6 +270,59 @@ def use_rdma(val=True):
     sess.config_proto.resource.use_rdma = val
 
 
+@oneflow_export("config.epoll_zero_copy_min_kbyte")
+def api_epoll_zero_copy_min_kbyte(val: int) -> None:
+    r"""Send the bodies of at least this size with MSG_ZEROCOPY in epoll mode, 0 disables it.
+
+    Args:
+        val (int): body size, e.g. 64(kb)
+    """
+    return enable_if.unique([epoll_zero_copy_min_kbyte, do_nothing])(val)
+
+
+@enable_if.condition(hob.in_normal_mode & ~hob.session_initialized)
+def epoll_zero_copy_min_kbyte(val):
+    sess = session_ctx.GetDefaultSession()
+    assert type(val) is int
+    sess.config_proto.resource.epoll_zero_copy_min_kbyte = val
+
+
+@oneflow_export("config.epoll_conn_num_per_peer")
+def api_epoll_conn_num_per_peer(val: int) -> None:
+    r"""Set up the number of connections to each peer in epoll mode. With more than one, the
+    first connection carries the actor messages and the reads are spread over the others.
+
+    Args:
+        val (int): number of connections, e.g. 4
+    """
+    return enable_if.unique([epoll_conn_num_per_peer, do_nothing])(val)
+
+
+@enable_if.condition(hob.in_normal_mode & ~hob.session_initialized)
+def epoll_conn_num_per_peer(val):
+    sess = session_ctx.GetDefaultSession()
+    assert type(val) is int
+    sess.config_proto.resource.epoll_conn_num_per_peer = val
+
+
+@oneflow_export("config.epoll_stripe_min_kbyte")
+def api_epoll_stripe_min_kbyte(val: int) -> None:
+    r"""Split the reads of at least this size into stripes over the connections to the peer in
+    epoll mode.
+
+    Args:
+        val (int): read size, e.g. 1024(kb)
+    """
+    return enable_if.unique([epoll_stripe_min_kbyte, do_nothing])(val)
+
+
+@enable_if.condition(hob.in_normal_mode & ~hob.session_initialized)
+def epoll_stripe_min_kbyte(val):
+    sess = session_ctx.GetDefaultSession()
+    assert type(val) is int
+    sess.config_proto.resource.epoll_stripe_min_kbyte = val
+
+
 @oneflow_export("config.thread_enable_local_message_queue")
 def api_thread_enable_local_message_queue(val: bool) -> None:
     """Whether or not enable thread using local  message queue.
@@ -287,6 +340,58 @@ def thread_enable_local_message_queue(val):
     sess.config_proto.resource.thread_enable_local_message_queue = val
 
 
+@oneflow_export("config.thread_enable_lock_free_message_channel")
+def api_thread_enable_lock_free_message_channel(val: bool) -> None:
+    """Whether or not actor threads receive messages through a lock-free multi-producer single-consumer channel.
+
+    Args:
+        val (bool):  True or False
+    """
+    return enable_if.unique([thread_enable_lock_free_message_channel, do_nothing])(val)
+
+
+@enable_if.condition(hob.in_normal_mode & ~hob.session_initialized)
+def thread_enable_lock_free_message_channel(val):
+    sess = session_ctx.GetDefaultSession()
+    assert type(val) is bool
+    sess.config_proto.resource.thread_enable_lock_free_message_channel = val
+
+
+@oneflow_export("config.thread_lock_free_message_channel_capacity")
+def api_thread_lock_free_message_channel_capacity(val: int) -> None:
+    """Set the ring buffer capacity of the lock-free message channel of each actor thread.
+    Messages beyond the capacity are spilled to an overflow queue.
+
+    Args:
+        val (int): number of messages, rounded up to a power of two
+    """
+    return enable_if.unique([thread_lock_free_message_channel_capacity, do_nothing])(val)
+
+
+@enable_if.condition(hob.in_normal_mode & ~hob.session_initialized)
+def thread_lock_free_message_channel_capacity(val):
+    sess = session_ctx.GetDefaultSession()
+    assert type(val) is int
+    sess.config_proto.resource.thread_lock_free_message_channel_capacity = val
+
+
+@oneflow_export("config.thread_message_channel_spin_count")
+def api_thread_message_channel_spin_count(val: int) -> None:
+    """Set how many times an idle actor thread polls the lock-free message channel before it sleeps.
+
+    Args:
+        val (int): number of polls
+    """
+    return enable_if.unique([thread_message_channel_spin_count, do_nothing])(val)
+
+
+@enable_if.condition(hob.in_normal_mode & ~hob.session_initialized)
+def thread_message_channel_spin_count(val):
+    sess = session_ctx.GetDefaultSession()
+    assert type(val) is int
+    sess.config_proto.resource.thread_message_channel_spin_count = val
+
+
 @oneflow_export("config.enable_debug_mode")
 def api_enable_debug_mode(val: bool) -> None:
     r"""Whether use debug mode or not.
@@ -338,6 +443,57 @@ def persistence_buf_byte(val):
     sess.config_proto.io_conf.persistence_buf_byte = val
 
 
+@oneflow_export("config.persistence_read_ahead_chunk_num")
+def api_persistence_read_ahead_chunk_num(val: int) -> None:
+    r"""Set up the number of chunks read ahead concurrently by persistent in streams.
+
+    Args:
+        val (int): e.g. 4, 0 to disable read-ahead
+    """
+    return enable_if.unique([persistence_read_ahead_chunk_num, do_nothing])(val)
+
+
+@enable_if.condition(hob.in_normal_mode & ~hob.session_initialized)
+def persistence_read_ahead_chunk_num(val):
+    sess = session_ctx.GetDefaultSession()
+    assert type(val) is int
+    sess.config_proto.io_conf.persistence_read_ahead_chunk_num = val
+
+
+@oneflow_export("config.enable_io_uring_file_system")
+def api_enable_io_uring_file_system(
+    val: bool = True, direct_io: bool = True, queue_depth: int = 16
+) -> None:
+    r"""Whether or not read and write data and snapshots on local file system through io_uring.
+
+    Args:
+        val (bool, optional): True or False. Defaults to True.
+        direct_io (bool, optional): Whether or not bypass page cache with O_DIRECT. Defaults to True.
+        queue_depth (int, optional): Max number of in-flight requests per file. Defaults to 16.
+    """
+    return enable_if.unique([enable_io_uring_file_system, do_nothing])(
+        val, direct_io, queue_depth
+    )
+
+
+@enable_if.condition(hob.in_normal_mode & ~hob.session_initialized)
+def enable_io_uring_file_system(val, direct_io, queue_depth):
+    sess = session_ctx.GetDefaultSession()
+    assert type(val) is bool
+    assert type(direct_io) is bool
+    assert type(queue_depth) is int
+    io_conf = sess.config_proto.io_conf
+    for fs_conf in [io_conf.data_fs_conf, io_conf.snapshot_fs_conf]:
+        is_local = fs_conf.HasField("localfs_conf") or fs_conf.HasField(
+            "local_uring_fs_conf"
+        )
+        if val and is_local:
+            fs_conf.local_uring_fs_conf.use_direct_io = direct_io
+            fs_conf.local_uring_fs_conf.queue_depth = queue_depth
+        elif not val and fs_conf.HasField("local_uring_fs_conf"):
+            fs_conf.localfs_conf.SetInParent()
+
+
 @oneflow_export("config.legacy_model_io_enabled")
 def api_legacy_model_io_enabled():
     sess = session_ctx.GetDefaultSession()
@@ -65,6 +65,9 @@ class OfrecordReader(Module):
         shuffle_after_epoch: bool = False,
         random_seed: int = -1,
         name: Optional[str] = None,
+        use_mmap: bool = False,
+        use_record_index: bool = False,
+        skip_num_samples: int = 0,
     ):
         super().__init__()
         seed, has_seed = mirrored_gen_random_seed(random_seed)
@@ -80,6 +83,9 @@ class OfrecordReader(Module):
             .Attr("shuffle_after_epoch", shuffle_after_epoch)
             .Attr("part_name_suffix_length", part_name_suffix_length)
             .Attr("seed", seed)
+            .Attr("use_mmap", use_mmap)
+            .Attr("use_record_index", use_record_index)
+            .Attr("skip_num_samples", skip_num_samples)
             .Build()
         )
 
@@ -274,6 +274,9 @@ def ofrecord_reader(
     shuffle_buffer_size: int = 1024,
     shuffle_after_epoch: bool = False,
     name: Optional[str] = None,
+    use_mmap: bool = False,
+    use_record_index: bool = False,
+    skip_num_samples: int = 0,
 ) -> oneflow._oneflow_internal.BlobDesc:
     r"""Get ofrecord object from ofrecord dataset.
 
@@ -287,6 +290,9 @@ def ofrecord_reader(
         shuffle_buffer_size (int, optional): Shuffle buffer size. Defaults to 1024.
         shuffle_after_epoch (bool, optional): Shuffled or not after each epoch. Defaults to False.
         name (Optional[str], optional): Optional name. Defaults to None.
+        use_mmap (bool, optional): Memory map the partitions on local file system and read records without copying, shuffling is then an exact per-epoch permutation and shuffle_buffer_size is ignored. Defaults to False.
+        use_record_index (bool, optional): Read records at random through the `<part>.idx` index files, which are built and saved next to writable local partitions when missing. The records of all partitions are then shuffled as a whole and sharded by record among ranks. Defaults to False.
+        skip_num_samples (int, optional): Number of samples already consumed by all ranks to skip when resuming, only used with use_record_index. Defaults to 0.
 
     Returns:
         oneflow._oneflow_internal.BlobDesc: The result Blob
@@ -349,12 +355,27 @@ def ofrecord_reader(
         .Attr("shuffle_buffer_size", shuffle_buffer_size)
         .Attr("shuffle_after_epoch", shuffle_after_epoch)
         .Attr("part_name_suffix_length", part_name_suffix_length)
+        .Attr("use_mmap", use_mmap)
+        .Attr("use_record_index", use_record_index)
+        .Attr("skip_num_samples", skip_num_samples)
         .Build()
         .InferAndTryRun()
         .RemoteBlobList()[0]
     )
 
 
+@oneflow_export("data.build_ofrecord_index")
+def build_ofrecord_index(part_path: str, with_crc: bool = False) -> None:
+    r"""Build the index file `<part_path>.idx` of an ofrecord partition on local file system,
+    which is used by :func:`oneflow.data.ofrecord_reader` with `use_record_index=True`.
+
+    Args:
+        part_path (str): Path to the ofrecord partition.
+        with_crc (bool, optional): Also store the crc32c of each record, which is verified every time the record is read. Defaults to False.
+    """
+    oneflow._oneflow_internal.data.BuildOFRecordIndex(part_path, with_crc)
+
+
 @oneflow_export("data.decode_random")
 def decode_random(
     shape: Sequence[int],
@@ -0,0 +1,88 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import os
+import subprocess
+import sys
+import unittest
+
+import numpy as np
+
+import oneflow.experimental as flow
+
+
+def _test_diamond_backward(test_case):
+    # x feeds two branches that join again, so x's accumulate node has two consumers
+    np_x = np.random.randn(2, 3).astype(np.float32)
+    x = flow.Tensor(np_x, requires_grad=True)
+    a = x * 2
+    b = x * x
+    c = a * b
+    c.retain_grad()
+    y = (c + a).sum()
+    y.backward()
+    test_case.assertTrue(np.allclose(x.grad.numpy(), 6 * np_x * np_x + 2, 1e-4, 1e-4))
+    test_case.assertTrue(np.allclose(c.grad.numpy(), np.ones((2, 3)), 1e-4, 1e-4))
+    test_case.assertIsNone(a.grad)
+
+
+def _test_grad_prunes_other_branches(test_case):
+    np_x = np.random.randn(4).astype(np.float32)
+    np_w = np.random.randn(4).astype(np.float32)
+    x = flow.Tensor(np_x, requires_grad=True)
+    w = flow.Tensor(np_w, requires_grad=True)
+    y = (x * w + w * w).sum()
+    (x_grad,) = flow.autograd.grad(y, x, None)
+    test_case.assertTrue(np.allclose(x_grad.numpy(), np_w, 1e-4, 1e-4))
+    # autograd.grad does not touch the grads of tensors outside of inputs
+    test_case.assertIsNone(w.grad)
+    test_case.assertIsNone(x.grad)
+
+
+def _test_retain_graph(test_case):
+    np_x = np.random.randn(3).astype(np.float32)
+    x = flow.Tensor(np_x, requires_grad=True)
+    y = (x * x).sum()
+    y.backward(retain_graph=True)
+    y.backward()
+    test_case.assertTrue(np.allclose(x.grad.numpy(), 4 * np_x, 1e-4, 1e-4))
+
+
+@unittest.skipIf(
+    not flow.unittest.env.eager_execution_enabled(),
+    ".numpy() doesn't work in lazy mode",
+)
+class TestAutogradEngine(flow.unittest.TestCase):
+    def test_autograd_engine(test_case):
+        for test_fun in [
+            _test_diamond_backward,
+            _test_grad_prunes_other_branches,
+            _test_retain_graph,
+        ]:
+            test_fun(test_case)
+
+    @unittest.skipIf(
+        "ONEFLOW_AUTOGRAD_ENGINE" in os.environ,
+        "the engine is chosen by ONEFLOW_AUTOGRAD_ENGINE already",
+    )
+    def test_graph_autograd_engine(test_case):
+        # The engine is chosen once per process, so the graph one runs in a subprocess
+        env = dict(os.environ, ONEFLOW_AUTOGRAD_ENGINE="graph")
+        result = subprocess.run([sys.executable, __file__], env=env)
+        test_case.assertEqual(result.returncode, 0)
+
+
+if __name__ == "__main__":
+    unittest.main()
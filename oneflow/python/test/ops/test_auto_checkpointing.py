@@ -0,0 +1,87 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import unittest
+import os
+
+import numpy as np
+import oneflow as flow
+import oneflow.typing as tp
+import oneflow.python.framework.c_api_util as c_api_util
+
+_FAKE_FW_OP_NAME_PREFIX = "OneFlow-System-Checkpointing-Fake-Fw-Op_"
+
+
+def _recomputed_op_num(job_name):
+    for job in c_api_util.GetJobSet().job:
+        if job.job_conf.job_name == job_name:
+            return sum(op.name.startswith(_FAKE_FW_OP_NAME_PREFIX) for op in job.net.op)
+    raise ValueError("job {} not found".format(job_name))
+
+
+def _run_mlp(device_type, x, enable_auto_checkpointing, memory_budget_mb):
+    flow.clear_default_session()
+    func_config = flow.FunctionConfig()
+    func_config.default_data_type(flow.float)
+    if enable_auto_checkpointing:
+        func_config.enable_auto_checkpointing(True)
+        func_config.auto_checkpointing_memory_budget_mb(memory_budget_mb)
+
+    @flow.global_function(type="train", function_config=func_config)
+    def MlpJob(x: tp.Numpy.Placeholder(x.shape)) -> tp.Numpy:
+        with flow.scope.placement(device_type, "0:0"):
+            out = x
+            for i in range(4):
+                w = flow.get_variable(
+                    "w{}".format(i),
+                    shape=(out.shape[1], 1024),
+                    initializer=flow.constant_initializer(0.1 * (i + 1) / out.shape[1]),
+                )
+                out = flow.math.tanh(flow.matmul(out, w) + 0.1 * i)
+            loss = flow.math.reduce_mean(out * out)
+            flow.optimizer.SGD(
+                flow.optimizer.PiecewiseConstantScheduler([], [0.1]), momentum=0
+            ).minimize(loss)
+        return loss
+
+    losses = [MlpJob(x) for _ in range(3)]
+    # The jobs are compiled by the first call
+    return losses, _recomputed_op_num("MlpJob")
+
+
+def _test_auto_checkpointing(test_case, device_type):
+    x = np.random.uniform(-1, 1, (128, 16)).astype(np.float32)
+    expected, recomputed_op_num = _run_mlp(device_type, x, False, 0)
+    test_case.assertEqual(recomputed_op_num, 0)
+    # 0 minimizes the memory, 1 MB can not hold the 512 KB activations of all 4 layers
+    for memory_budget_mb in [0, 1]:
+        losses, recomputed_op_num = _run_mlp(device_type, x, True, memory_budget_mb)
+        test_case.assertGreater(recomputed_op_num, 0)
+        for loss, expected_loss in zip(losses, expected):
+            test_case.assertTrue(np.allclose(loss, expected_loss, rtol=1e-5, atol=1e-5))
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestAutoCheckpointing(flow.unittest.TestCase):
+    def test_auto_checkpointing_cpu(test_case):
+        _test_auto_checkpointing(test_case, "cpu")
+
+    @unittest.skipIf(os.getenv("ONEFLOW_TEST_CPU_ONLY"), "only test cpu cases")
+    def test_auto_checkpointing_gpu(test_case):
+        _test_auto_checkpointing(test_case, "gpu")
+
+
+if __name__ == "__main__":
+    unittest.main()
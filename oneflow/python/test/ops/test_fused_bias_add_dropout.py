@@ -175,26 +175,34 @@ def compare_with_not_fused(
     )
 
 
+def _gen_arg_dict(device_type):
+    arg_dict = OrderedDict()
+    arg_dict["device_type"] = [device_type]
+    arg_dict["x_shape"] = [
+        (10, 10),
+        (10, 5),
+        (1, 10, 10, 10),
+        (2, 10, 10, 10),
+    ]
+    arg_dict["data_type"] = ["float32", "double"]
+    if device_type == "gpu":
+        arg_dict["data_type"].insert(0, "float16")
+    arg_dict["data_format"] = ["NCHW"]
+    arg_dict["rate"] = [0.1]
+    arg_dict["seed"] = [1234]
+    arg_dict["fuse_add_to_output"] = [True, False]
+    return arg_dict
+
+
 @flow.unittest.skip_unless_1n1d()
 class TestFusedBiasAdd(flow.unittest.TestCase):
+    def test_fused_bias_add_cpu(test_case):
+        for arg in GenArgList(_gen_arg_dict("cpu")):
+            compare_with_not_fused(test_case, *arg)
+
     @unittest.skipIf(os.getenv("ONEFLOW_TEST_CPU_ONLY"), "only test cpu cases")
-    def test_fused_bias_add(test_case):
-        arg_dict = OrderedDict()
-        arg_dict["device_type"] = ["gpu"]
-        arg_dict["x_shape"] = [
-            (10, 10),
-            (10, 5),
-            (1, 10, 10, 10),
-            (2, 10, 10, 10),
-        ]
-        arg_dict["data_type"] = ["float16", "float32", "double"]
-        arg_dict["data_format"] = ["NCHW"]
-        arg_dict["rate"] = [0.1]
-        arg_dict["seed"] = [1234]
-        arg_dict["fuse_add_to_output"] = [True, False]
-        for arg in GenArgList(arg_dict):
-            if arg[0] == "cpu" and arg[2] == "float16":
-                continue
+    def test_fused_bias_add_gpu(test_case):
+        for arg in GenArgList(_gen_arg_dict("gpu")):
             compare_with_not_fused(test_case, *arg)
 
 
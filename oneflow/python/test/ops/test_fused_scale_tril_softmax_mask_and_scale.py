@@ -126,27 +126,35 @@ def compare_with_not_fused(
     )
 
 
+def _gen_arg_dict(device_type):
+    arg_dict = OrderedDict()
+    arg_dict["device_type"] = [device_type]
+    arg_dict["x_shape"] = [
+        (2, 2, 5, 5),
+        (10, 20),
+        (32, 12, 128),
+        (10, 960),
+    ]
+    arg_dict["data_type"] = ["float32", "double"]
+    if device_type == "gpu":
+        arg_dict["data_type"].insert(0, "float16")
+    arg_dict["diagonal"] = [-1, 0]
+    arg_dict["fill_value"] = [float("-inf"), 0]
+    arg_dict["scale"] = [0.125]
+    arg_dict["rate"] = [0.5]
+    arg_dict["seed"] = [12345]
+    return arg_dict
+
+
 @flow.unittest.skip_unless_1n1d()
 class TestFusedScaleTrilSoftmaxDropout(flow.unittest.TestCase):
+    def test_fused_scale_tril_softmax_dropout_cpu(test_case):
+        for arg in GenArgList(_gen_arg_dict("cpu")):
+            compare_with_not_fused(test_case, *arg)
+
     @unittest.skipIf(os.getenv("ONEFLOW_TEST_CPU_ONLY"), "only test cpu cases")
-    def test_fused_scale_tril_softmax_dropout(test_case):
-        arg_dict = OrderedDict()
-        arg_dict["device_type"] = ["gpu"]
-        arg_dict["x_shape"] = [
-            (2, 2, 5, 5),
-            (10, 20),
-            (32, 12, 128),
-            (10, 960),
-        ]
-        arg_dict["data_type"] = ["float16", "float32", "double"]
-        arg_dict["diagonal"] = [-1, 0]
-        arg_dict["fill_value"] = [float("-inf"), 0]
-        arg_dict["scale"] = [0.125]
-        arg_dict["rate"] = [0.5]
-        arg_dict["seed"] = [12345]
-        for arg in GenArgList(arg_dict):
-            if arg[0] == "cpu" and arg[2] == "float16":
-                continue
+    def test_fused_scale_tril_softmax_dropout_gpu(test_case):
+        for arg in GenArgList(_gen_arg_dict("gpu")):
             compare_with_not_fused(test_case, *arg)
 
 
@@ -320,7 +320,7 @@ def compare_with_numpy(
     device_type, input_shape, dtype, size, data_format, interpolation, align_corners
 ):
     # TODO (shijie wang): numpy upsample2d backward implementation.
-    assert device_type in ["gpu"]
+    assert device_type in ["gpu", "cpu"]
     flow.clear_default_session()
 
     func_config = flow.FunctionConfig()
@@ -392,7 +392,7 @@ def compare_with_numpy(
 class TestUpsample(flow.unittest.TestCase):
     def test_upsample(test_case):
         arg_dict = OrderedDict()
-        arg_dict["device_type"] = ["gpu"]
+        arg_dict["device_type"] = ["gpu", "cpu"]
         arg_dict["input_shape"] = [(2, 11, 12, 13)]
         arg_dict["dtype"] = ["float32", "double"]
         arg_dict["size"] = [(2, 2), 3, (1, 2)]
@@ -404,7 +404,7 @@ class TestUpsample(flow.unittest.TestCase):
 
     def test_upsample_align_corners(test_case):
         arg_dict = OrderedDict()
-        arg_dict["device_type"] = ["gpu"]
+        arg_dict["device_type"] = ["gpu", "cpu"]
         arg_dict["input_shape"] = [(2, 5, 6, 7)]
         arg_dict["dtype"] = ["float32", "double"]
         arg_dict["size"] = [(2, 2), 3, (1, 2)]
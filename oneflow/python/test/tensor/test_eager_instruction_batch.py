@@ -0,0 +1,79 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import unittest
+
+import numpy as np
+
+import oneflow
+import oneflow.experimental as flow
+
+
+def _set_batch_size(size):
+    oneflow._oneflow_internal.eager.single_client.SetInstructionBatchSize(size)
+
+
+def _deferred_instruction_and_batch_cnt():
+    return (
+        oneflow._oneflow_internal.eager.single_client.DeferredInstructionAndBatchCnt()
+    )
+
+
+def _run_tiny_ops(op_num):
+    x = flow.Tensor(np.ones((1,), dtype=np.float32))
+    y = flow.Tensor(np.full((1,), 0.5, dtype=np.float32))
+    for _ in range(op_num):
+        x = flow.add(x, y)
+    return x.numpy()
+
+
+@flow.unittest.skip_unless_1n1d()
+@unittest.skipIf(
+    not flow.unittest.env.eager_execution_enabled(),
+    ".numpy() doesn't work in lazy mode",
+)
+class TestEagerInstructionBatch(flow.unittest.TestCase):
+    def test_same_result(test_case):
+        for batch_size in [0, 1, 7, 64]:
+            _set_batch_size(batch_size)
+            # 100 ops is not a multiple of the batch size, numpy() flushes the rest
+            test_case.assertTrue(np.allclose(_run_tiny_ops(100), [51.0]))
+        _set_batch_size(0)
+
+    def test_explicit_flush(test_case):
+        _set_batch_size(1000)
+        x = flow.Tensor(np.zeros((1,), dtype=np.float32))
+        y = flow.add(x, x)
+        oneflow._oneflow_internal.eager.single_client.FlushDeferredInstructions()
+        test_case.assertTrue(np.allclose(y.numpy(), [0.0]))
+        _set_batch_size(0)
+
+    def test_tensor_release_does_not_flush(test_case):
+        op_num = 1000
+        batch_size = 64
+        _run_tiny_ops(100)
+        _set_batch_size(batch_size)
+        (instruction_cnt, batch_cnt) = _deferred_instruction_and_batch_cnt()
+        _run_tiny_ops(op_num)
+        (end_instruction_cnt, end_batch_cnt) = _deferred_instruction_and_batch_cnt()
+        _set_batch_size(0)
+        # Every op drops the previous x, whose release is deferred too instead of
+        # handing the batch to the vm early
+        test_case.assertGreaterEqual(end_instruction_cnt - instruction_cnt, op_num)
+        test_case.assertLess(end_batch_cnt - batch_cnt, op_num // 10)
+
+
+if __name__ == "__main__":
+    unittest.main()
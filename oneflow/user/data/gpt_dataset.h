@@ -17,6 +17,7 @@ limitations under the License.
 #define ONEFLOW_USER_DATA_GPT_DATASET_H_
 
 #include "oneflow/core/common/util.h"
+#include "oneflow/user/data/mapped_buffer.h"
 
 namespace oneflow {
 
@@ -45,19 +46,6 @@ class MegatronGPTIndex final {
   std::vector<int64_t> doc_offsets_;
 };
 
-class MappedBuffer final {
- public:
-  MappedBuffer(const std::string& filename);
-  ~MappedBuffer();
-
-  const void* ptr() const { return mapped_; }
-  size_t size() const { return size_; }
-
- private:
-  void* mapped_;
-  size_t size_;
-};
-
 class MegatronGPTMMapDataset final {
  public:
   MegatronGPTMMapDataset(const std::string& data_file_prefix, size_t seq_len, size_t label_len,
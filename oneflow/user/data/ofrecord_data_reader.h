@@ -18,6 +18,9 @@ limitations under the License.
 
 #include "oneflow/user/data/data_reader.h"
 #include "oneflow/user/data/ofrecord_dataset.h"
+#include "oneflow/user/data/ofrecord_mmap_dataset.h"
+#include "oneflow/user/data/ofrecord_indexed_dataset.h"
+#include "oneflow/user/data/distributed_training_dataset.h"
 #include "oneflow/user/data/ofrecord_parser.h"
 #include "oneflow/user/data/random_shuffle_dataset.h"
 #include "oneflow/user/data/batch_dataset.h"
@@ -29,10 +32,39 @@ namespace data {
 class OFRecordDataReader final : public DataReader<TensorBuffer> {
  public:
   OFRecordDataReader(user_op::KernelInitContext* ctx) : DataReader<TensorBuffer>(ctx) {
-    loader_.reset(new OFRecordDataset(ctx));
     parser_.reset(new OFRecordParser());
-    if (ctx->Attr<bool>("random_shuffle")) {
-      loader_.reset(new RandomShuffleDataset<TensorBuffer>(ctx, std::move(loader_)));
+    if (ctx->Attr<bool>("use_mmap")) {
+      // Records are accessed in O(1), so shuffling is an exact permutation per epoch instead of a
+      // shuffle buffer
+      const bool shuffle =
+          ctx->Attr<bool>("random_shuffle") || ctx->Attr<bool>("shuffle_after_epoch");
+      int64_t seed = ctx->Attr<int64_t>("seed");
+      if (seed == -1) { seed = NewRandomSeed(); }
+      std::unique_ptr<RandomAccessDataset<TensorBuffer>> mmap_dataset(
+          new OFRecordMMapDataset(ctx, shuffle));
+      // Parts are already split among ranks by OFRecordMMapDataset
+      loader_.reset(new DistributedTrainingDataset<TensorBuffer>(1, 0, false, shuffle, seed,
+                                                                 std::move(mmap_dataset)));
+    } else if (ctx->Attr<bool>("use_record_index")) {
+      const bool shuffle =
+          ctx->Attr<bool>("random_shuffle") || ctx->Attr<bool>("shuffle_after_epoch");
+      // All ranks must draw the same permutation to shard it by record
+      int64_t seed = ctx->Attr<int64_t>("seed");
+      if (seed == -1) { seed = kOneflowDatasetSeed; }
+      std::unique_ptr<RandomAccessDataset<TensorBuffer>> indexed_dataset(
+          new OFRecordIndexedDataset(ctx));
+      std::unique_ptr<DistributedTrainingDataset<TensorBuffer>> dataset(
+          new DistributedTrainingDataset<TensorBuffer>(
+              ctx->parallel_ctx().parallel_num(), ctx->parallel_ctx().parallel_id(), false,
+              shuffle, seed, std::move(indexed_dataset)));
+      // skip_num_samples counts the samples of all ranks, each rank skips its share
+      dataset->Skip(ctx->Attr<int64_t>("skip_num_samples") / ctx->parallel_ctx().parallel_num());
+      loader_ = std::move(dataset);
+    } else {
+      loader_.reset(new OFRecordDataset(ctx));
+      if (ctx->Attr<bool>("random_shuffle")) {
+        loader_.reset(new RandomShuffleDataset<TensorBuffer>(ctx, std::move(loader_)));
+      }
     }
     int32_t batch_size = ctx->TensorDesc4ArgNameAndIndex("out", 0)->shape().elem_cnt();
     loader_.reset(new BatchDataset<TensorBuffer>(batch_size, std::move(loader_)));
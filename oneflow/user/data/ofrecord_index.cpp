@@ -0,0 +1,189 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/data/ofrecord_index.h"
+#include "oneflow/user/summary/crc32c.h"
+#include <chrono>
+
+namespace oneflow {
+
+namespace data {
+
+namespace {
+
+template<typename T>
+void AppendPod(std::string* out, const T* ptr, size_t num) {
+  out->append(reinterpret_cast<const char*>(ptr), sizeof(T) * num);
+}
+
+// Reads PODs from the serialized index, returns false when it runs out of bytes
+class IndexReader final {
+ public:
+  IndexReader(const std::vector<char>& buffer) : buffer_(buffer), pos_(0) {}
+
+  template<typename T>
+  bool Read(T* ptr, size_t num) {
+    const size_t num_bytes = sizeof(T) * num;
+    if (num_bytes == 0) { return true; }
+    if (pos_ + num_bytes > buffer_.size()) { return false; }
+    std::memcpy(ptr, buffer_.data() + pos_, num_bytes);
+    pos_ += num_bytes;
+    return true;
+  }
+  size_t remaining() const { return buffer_.size() - pos_; }
+
+ private:
+  const std::vector<char>& buffer_;
+  size_t pos_;
+};
+
+}  // namespace
+
+constexpr char OFRecordIndex::kMagicCode[];
+constexpr size_t OFRecordIndex::kMagicCodeLen;
+constexpr uint32_t OFRecordIndex::kVersion;
+constexpr uint32_t OFRecordIndex::kHasCrcFlag;
+
+std::unique_ptr<const OFRecordIndex> OFRecordIndex::Build(fs::FileSystem* fs,
+                                                          const std::string& part_path,
+                                                          bool with_crc) {
+  auto start = std::chrono::system_clock::now();
+  std::unique_ptr<OFRecordIndex> index(new OFRecordIndex());
+  index->part_size_ = fs->GetFileSize(part_path);
+  std::unique_ptr<fs::RandomAccessFile> file;
+  fs->NewRandomAccessFile(part_path, &file);
+  std::vector<char> payload;
+  uint64_t offset = 0;
+  while (offset < index->part_size_) {
+    int64_t record_size = -1;
+    CHECK_LE(offset + sizeof(int64_t), index->part_size_)
+        << "truncated OFRecord part " << part_path;
+    file->Read(offset, sizeof(int64_t), reinterpret_cast<char*>(&record_size));
+    offset += sizeof(int64_t);
+    CHECK_GT(record_size, 0) << "invalid record at offset " << offset << " of " << part_path;
+    CHECK_LE(offset + record_size, index->part_size_)
+        << "truncated OFRecord part " << part_path;
+    index->offsets_.push_back(offset);
+    index->sizes_.push_back(record_size);
+    if (with_crc) {
+      payload.resize(record_size);
+      file->Read(offset, record_size, payload.data());
+      index->crcs_.push_back(summary::GetCrc32(payload.data(), record_size));
+    }
+    offset += record_size;
+  }
+  std::chrono::duration<double, std::milli> elapse = std::chrono::system_clock::now() - start;
+  LOG(INFO) << "Build OFRecord index of " << part_path << ", number of records: "
+            << index->num_records() << ", elapsed time: " << elapse.count() << " ms";
+  return std::unique_ptr<const OFRecordIndex>(index.release());
+}
+
+std::unique_ptr<const OFRecordIndex> OFRecordIndex::Load(fs::FileSystem* fs,
+                                                         const std::string& part_path) {
+  const std::string index_path = IndexPath(part_path);
+  if (!fs->FileExists(index_path)) { return nullptr; }
+  std::vector<char> buffer(fs->GetFileSize(index_path));
+  std::unique_ptr<fs::RandomAccessFile> file;
+  fs->NewRandomAccessFile(index_path, &file);
+  file->Read(0, buffer.size(), buffer.data());
+  IndexReader reader(buffer);
+  char magic_code[kMagicCodeLen];
+  uint32_t version = 0;
+  uint32_t flags = 0;
+  uint64_t num_records = 0;
+  std::unique_ptr<OFRecordIndex> index(new OFRecordIndex());
+  if (!reader.Read(magic_code, kMagicCodeLen)
+      || std::memcmp(magic_code, kMagicCode, kMagicCodeLen) != 0) {
+    LOG(WARNING) << "ignore " << index_path << ", not an OFRecord index file";
+    return nullptr;
+  }
+  if (!reader.Read(&version, 1) || version != kVersion) {
+    LOG(WARNING) << "ignore unsupported version " << version << " of " << index_path;
+    return nullptr;
+  }
+  if (!reader.Read(&flags, 1) || !reader.Read(&index->part_size_, 1)
+      || !reader.Read(&num_records, 1)) {
+    LOG(WARNING) << "ignore truncated index file " << index_path;
+    return nullptr;
+  }
+  if (index->part_size_ != fs->GetFileSize(part_path)) {
+    LOG(WARNING) << "ignore stale index file " << index_path;
+    return nullptr;
+  }
+  // Checked before allocating, a corrupted record count may be huge
+  const size_t record_bytes =
+      2 * sizeof(int64_t) + ((flags & kHasCrcFlag) ? sizeof(uint32_t) : 0);
+  if (reader.remaining() != num_records * record_bytes) {
+    LOG(WARNING) << "ignore corrupted index file " << index_path;
+    return nullptr;
+  }
+  index->offsets_.resize(num_records);
+  index->sizes_.resize(num_records);
+  if (flags & kHasCrcFlag) { index->crcs_.resize(num_records); }
+  reader.Read(index->offsets_.data(), num_records);
+  reader.Read(index->sizes_.data(), num_records);
+  reader.Read(index->crcs_.data(), index->crcs_.size());
+  FOR_RANGE(size_t, i, 0, num_records) {
+    const int64_t offset = index->offsets_.at(i);
+    const int64_t size = index->sizes_.at(i);
+    if (offset < static_cast<int64_t>(sizeof(int64_t)) || size <= 0
+        || offset + size > static_cast<int64_t>(index->part_size_)) {
+      LOG(WARNING) << "ignore corrupted index file " << index_path;
+      return nullptr;
+    }
+  }
+  return std::unique_ptr<const OFRecordIndex>(index.release());
+}
+
+std::unique_ptr<const OFRecordIndex> OFRecordIndex::LoadOrBuild(fs::FileSystem* fs,
+                                                                const std::string& part_path,
+                                                                bool persist) {
+  std::unique_ptr<const OFRecordIndex> index = Load(fs, part_path);
+  if (index) { return index; }
+  index = Build(fs, part_path, false);
+  if (persist) { index->Save(fs, part_path); }
+  return index;
+}
+
+void OFRecordIndex::Save(fs::FileSystem* fs, const std::string& part_path) const {
+  std::string content;
+  const uint32_t version = kVersion;
+  const uint32_t flags = has_crc() ? kHasCrcFlag : 0;
+  const uint64_t num = num_records();
+  AppendPod(&content, kMagicCode, kMagicCodeLen);
+  AppendPod(&content, &version, 1);
+  AppendPod(&content, &flags, 1);
+  AppendPod(&content, &part_size_, 1);
+  AppendPod(&content, &num, 1);
+  AppendPod(&content, offsets_.data(), offsets_.size());
+  AppendPod(&content, sizes_.data(), sizes_.size());
+  AppendPod(&content, crcs_.data(), crcs_.size());
+  const std::string index_path = IndexPath(part_path);
+  const std::string tmp_path = index_path + ".tmp" + std::to_string(NewRandomSeed());
+  std::unique_ptr<fs::WritableFile> file;
+  fs->NewWritableFile(tmp_path, &file);
+  file->Append(content.data(), content.size());
+  file->Close();
+  fs->RenameFile(tmp_path, index_path);
+}
+
+void OFRecordIndex::CheckCrc(size_t record_index, const char* payload) const {
+  CHECK_EQ(summary::GetCrc32(payload, size(record_index)), crcs_.at(record_index))
+      << "crc mismatch of record " << record_index;
+}
+
+}  // namespace data
+
+}  // namespace oneflow
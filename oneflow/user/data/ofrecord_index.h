@@ -0,0 +1,78 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_DATA_OFRECORD_INDEX_H_
+#define ONEFLOW_USER_DATA_OFRECORD_INDEX_H_
+
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/persistence/file_system.h"
+
+namespace oneflow {
+
+namespace data {
+
+// Offsets and sizes of the records in an OFRecord part file, persisted next to it as <part>.idx:
+//
+//   magic code | uint32 version | uint32 flags | uint64 part size | uint64 num records
+//   | int64 offsets[num records] | int64 sizes[num records] | uint32 crcs[num records]
+//
+// Offsets point to the payload behind the int64 size prefix of each record. The crc32c of each
+// payload is only stored when flags has kHasCrcFlag set. An index whose part size does not match
+// the part file any more is stale, and gets rebuilt like a truncated or corrupted one.
+class OFRecordIndex final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(OFRecordIndex);
+  ~OFRecordIndex() = default;
+
+  static constexpr char kMagicCode[] = "OFRIDX\x00\x00";
+  static constexpr size_t kMagicCodeLen = sizeof(kMagicCode) - 1;
+  static constexpr uint32_t kVersion = 1;
+  static constexpr uint32_t kHasCrcFlag = 1;
+
+  // Scans the size prefixes of all records, and reads the payloads too when with_crc
+  static std::unique_ptr<const OFRecordIndex> Build(fs::FileSystem* fs,
+                                                    const std::string& part_path, bool with_crc);
+  // nullptr when the index file is missing, stale, truncated or corrupted
+  static std::unique_ptr<const OFRecordIndex> Load(fs::FileSystem* fs,
+                                                   const std::string& part_path);
+  // Loads the index of part_path, or builds it and saves it when persist
+  static std::unique_ptr<const OFRecordIndex> LoadOrBuild(fs::FileSystem* fs,
+                                                          const std::string& part_path,
+                                                          bool persist);
+  static std::string IndexPath(const std::string& part_path) { return part_path + ".idx"; }
+
+  // Writes to a temporary file first, so that concurrent readers never see a partial index
+  void Save(fs::FileSystem* fs, const std::string& part_path) const;
+
+  size_t num_records() const { return sizes_.size(); }
+  int64_t offset(size_t record_index) const { return offsets_.at(record_index); }
+  int64_t size(size_t record_index) const { return sizes_.at(record_index); }
+  bool has_crc() const { return !crcs_.empty(); }
+  void CheckCrc(size_t record_index, const char* payload) const;
+
+ private:
+  OFRecordIndex() = default;
+
+  uint64_t part_size_;
+  std::vector<int64_t> offsets_;
+  std::vector<int64_t> sizes_;
+  std::vector<uint32_t> crcs_;
+};
+
+}  // namespace data
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_DATA_OFRECORD_INDEX_H_
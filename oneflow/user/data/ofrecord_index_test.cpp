@@ -0,0 +1,130 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include "oneflow/core/common/process_state.h"
+#include "oneflow/core/common/str_util.h"
+#include "oneflow/core/persistence/posix/posix_file_system.h"
+#include "oneflow/user/data/ofrecord_index.h"
+
+#ifdef OF_PLATFORM_POSIX
+
+namespace oneflow {
+
+namespace data {
+
+namespace test {
+
+namespace {
+
+std::string TestFilePath(const std::string& name) {
+  std::string current_dir = GetCwd();
+  StringReplace(&current_dir, '\\', '/');
+  return JoinPath(current_dir, name);
+}
+
+void WriteFile(fs::FileSystem* fs, const std::string& path, const std::string& content) {
+  std::unique_ptr<fs::WritableFile> file;
+  fs->NewWritableFile(path, &file);
+  file->Append(content.data(), content.size());
+  file->Close();
+}
+
+std::string ReadFile(fs::FileSystem* fs, const std::string& path) {
+  std::string content(fs->GetFileSize(path), '\0');
+  std::unique_ptr<fs::RandomAccessFile> file;
+  fs->NewRandomAccessFile(path, &file);
+  file->Read(0, content.size(), &content.at(0));
+  return content;
+}
+
+// Records of sizes 3, 1 and 5, each behind its int64 size prefix
+std::string PartContent() {
+  std::string content;
+  for (const std::string& payload : std::vector<std::string>{"abc", "d", "efghi"}) {
+    const int64_t size = payload.size();
+    content.append(reinterpret_cast<const char*>(&size), sizeof(size));
+    content.append(payload);
+  }
+  return content;
+}
+
+void CheckIndex(const OFRecordIndex& index) {
+  ASSERT_EQ(index.num_records(), 3);
+  ASSERT_EQ(index.offset(0), 8);
+  ASSERT_EQ(index.size(0), 3);
+  ASSERT_EQ(index.offset(1), 19);
+  ASSERT_EQ(index.size(1), 1);
+  ASSERT_EQ(index.offset(2), 28);
+  ASSERT_EQ(index.size(2), 5);
+}
+
+}  // namespace
+
+TEST(OFRecordIndex, save_and_load) {
+  fs::PosixFileSystem posix_fs;
+  const std::string part_path = TestFilePath("tmp_test_ofrecord_index_part_asdfasdf");
+  WriteFile(&posix_fs, part_path, PartContent());
+  for (bool with_crc : {false, true}) {
+    std::unique_ptr<const OFRecordIndex> built =
+        OFRecordIndex::Build(&posix_fs, part_path, with_crc);
+    CheckIndex(*built);
+    built->Save(&posix_fs, part_path);
+    std::unique_ptr<const OFRecordIndex> loaded = OFRecordIndex::Load(&posix_fs, part_path);
+    ASSERT_TRUE(loaded != nullptr);
+    CheckIndex(*loaded);
+    ASSERT_EQ(loaded->has_crc(), with_crc);
+  }
+  posix_fs.DelFile(OFRecordIndex::IndexPath(part_path));
+  posix_fs.DelFile(part_path);
+}
+
+TEST(OFRecordIndex, rebuild_truncated_or_corrupted) {
+  fs::PosixFileSystem posix_fs;
+  const std::string part_path = TestFilePath("tmp_test_ofrecord_index_part_asdfasdf");
+  const std::string index_path = OFRecordIndex::IndexPath(part_path);
+  WriteFile(&posix_fs, part_path, PartContent());
+  OFRecordIndex::Build(&posix_fs, part_path, true)->Save(&posix_fs, part_path);
+  const std::string index_content = ReadFile(&posix_fs, index_path);
+  std::string bad_version = index_content;
+  bad_version.at(OFRecordIndex::kMagicCodeLen) += 1;
+  std::string bad_record_num = index_content;
+  bad_record_num.at(OFRecordIndex::kMagicCodeLen + 16) = '\xff';
+  std::string bad_offset = index_content;
+  bad_offset.at(OFRecordIndex::kMagicCodeLen + 24) = '\x7f';
+  for (const std::string& bad_content :
+       {std::string(), index_content.substr(0, 5), index_content.substr(0, 20),
+        index_content.substr(0, index_content.size() - 1), "x" + index_content.substr(1),
+        bad_version, bad_record_num, bad_offset}) {
+    WriteFile(&posix_fs, index_path, bad_content);
+    ASSERT_TRUE(OFRecordIndex::Load(&posix_fs, part_path) == nullptr);
+    std::unique_ptr<const OFRecordIndex> rebuilt =
+        OFRecordIndex::LoadOrBuild(&posix_fs, part_path, true);
+    CheckIndex(*rebuilt);
+    std::unique_ptr<const OFRecordIndex> loaded = OFRecordIndex::Load(&posix_fs, part_path);
+    ASSERT_TRUE(loaded != nullptr);
+    CheckIndex(*loaded);
+  }
+  posix_fs.DelFile(index_path);
+  posix_fs.DelFile(part_path);
+}
+
+}  // namespace test
+
+}  // namespace data
+
+}  // namespace oneflow
+
+#endif  // OF_PLATFORM_POSIX
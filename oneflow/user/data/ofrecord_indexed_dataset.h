@@ -0,0 +1,104 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_DATA_OFRECORD_INDEXED_DATASET_H_
+#define ONEFLOW_USER_DATA_OFRECORD_INDEXED_DATASET_H_
+
+#include "oneflow/user/data/dataset.h"
+#include "oneflow/user/data/ofrecord_index.h"
+#include "oneflow/core/common/str_util.h"
+#include "oneflow/core/framework/op_kernel.h"
+#include "oneflow/core/job/job_set.pb.h"
+
+#ifdef OF_PLATFORM_POSIX
+#include <unistd.h>
+#endif
+
+namespace oneflow {
+namespace data {
+
+// All records of all OFRecord parts, addressed through their OFRecordIndex. Every rank sees the
+// whole dataset, so that it can be sharded by record instead of by part.
+class OFRecordIndexedDataset final : public RandomAccessDataset<TensorBuffer> {
+ public:
+  using LoadTargetShdPtr = std::shared_ptr<TensorBuffer>;
+  using LoadTargetShdPtrVec = std::vector<LoadTargetShdPtr>;
+  OF_DISALLOW_COPY_AND_MOVE(OFRecordIndexedDataset);
+  OFRecordIndexedDataset(user_op::KernelInitContext* ctx) {
+    std::string data_dir = ctx->Attr<std::string>("data_dir");
+    int32_t data_part_num = ctx->Attr<int32_t>("data_part_num");
+    std::string part_name_prefix = ctx->Attr<std::string>("part_name_prefix");
+    int32_t part_name_suffix_length = ctx->Attr<int32_t>("part_name_suffix_length");
+    const bool persist = IsIndexPersistable(data_dir);
+    int64_t num_records = 0;
+    for (int i = 0; i < data_part_num; ++i) {
+      std::string num = std::to_string(i);
+      int32_t zero_count =
+          std::max(part_name_suffix_length - static_cast<int32_t>(num.length()), 0);
+      std::string file_path =
+          JoinPath(data_dir, part_name_prefix + std::string(zero_count, '0') + num);
+      indexes_.emplace_back(OFRecordIndex::LoadOrBuild(DataFS(), file_path, persist));
+      files_.emplace_back();
+      DataFS()->NewRandomAccessFile(file_path, &files_.back());
+      num_records += indexes_.back()->num_records();
+      part_record_end_.push_back(num_records);
+    }
+    CHECK_GT(num_records, 0) << "no record found in " << data_dir;
+  }
+  ~OFRecordIndexedDataset() = default;
+
+  LoadTargetShdPtrVec At(int64_t index) const override {
+    const auto part_it =
+        std::upper_bound(part_record_end_.begin(), part_record_end_.end(), index);
+    CHECK(part_it != part_record_end_.end());
+    const int64_t part_id = part_it - part_record_end_.begin();
+    const int64_t record_index = index - (part_id == 0 ? 0 : part_record_end_.at(part_id - 1));
+    const OFRecordIndex& part_index = *indexes_.at(part_id);
+    LoadTargetShdPtr sample(new TensorBuffer());
+    sample->Resize(Shape({part_index.size(record_index)}), DataType::kChar);
+    files_.at(part_id)->Read(part_index.offset(record_index), part_index.size(record_index),
+                             sample->mut_data<char>());
+    if (part_index.has_crc()) { part_index.CheckCrc(record_index, sample->data<char>()); }
+    LoadTargetShdPtrVec ret;
+    ret.push_back(std::move(sample));
+    return ret;
+  }
+
+  size_t Size() const override { return part_record_end_.back(); }
+
+  // Lazily built indexes are saved next to the parts only on writable local file systems
+  static bool IsIndexPersistable(const std::string& data_dir) {
+    const FileSystemConf& data_fs_conf = Global<const IOConf>::Get()->data_fs_conf();
+    if (!data_fs_conf.has_localfs_conf() && !data_fs_conf.has_local_uring_fs_conf()) {
+      return false;
+    }
+#ifdef OF_PLATFORM_POSIX
+    return access(data_dir.c_str(), W_OK) == 0;
+#else
+    return false;
+#endif
+  }
+
+ private:
+  std::vector<std::unique_ptr<const OFRecordIndex>> indexes_;
+  std::vector<std::unique_ptr<fs::RandomAccessFile>> files_;
+  // exclusive prefix end of the global record indices of each part
+  std::vector<int64_t> part_record_end_;
+};
+
+}  // namespace data
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_DATA_OFRECORD_INDEXED_DATASET_H_
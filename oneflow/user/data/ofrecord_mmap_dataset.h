@@ -0,0 +1,104 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_DATA_OFRECORD_MMAP_DATASET_H_
+#define ONEFLOW_USER_DATA_OFRECORD_MMAP_DATASET_H_
+
+#include "oneflow/user/data/dataset.h"
+#include "oneflow/user/data/mapped_buffer.h"
+#include "oneflow/user/data/ofrecord_index.h"
+#include "oneflow/user/data/ofrecord_indexed_dataset.h"
+#include "oneflow/core/common/balanced_splitter.h"
+#include "oneflow/core/common/str_util.h"
+#include "oneflow/core/framework/op_kernel.h"
+#include "oneflow/core/job/job_set.pb.h"
+
+namespace oneflow {
+namespace data {
+
+// Maps the local OFRecord part files of this rank and addresses their records through the
+// OFRecordIndex of each part, so that any record is accessed in O(1) and handed out as a
+// TensorBuffer view into the mapping without copying.
+class OFRecordMMapDataset final : public RandomAccessDataset<TensorBuffer> {
+ public:
+  using LoadTargetShdPtr = std::shared_ptr<TensorBuffer>;
+  using LoadTargetShdPtrVec = std::vector<LoadTargetShdPtr>;
+  OF_DISALLOW_COPY_AND_MOVE(OFRecordMMapDataset);
+  OFRecordMMapDataset(user_op::KernelInitContext* ctx, bool random_access) {
+    const FileSystemConf& data_fs_conf = Global<const IOConf>::Get()->data_fs_conf();
+    CHECK(data_fs_conf.has_localfs_conf() || data_fs_conf.has_local_uring_fs_conf())
+        << "OFRecord mmap requires the dataset on local file system";
+    std::string data_dir = ctx->Attr<std::string>("data_dir");
+    int32_t data_part_num = ctx->Attr<int32_t>("data_part_num");
+    std::string part_name_prefix = ctx->Attr<std::string>("part_name_prefix");
+    int32_t part_name_suffix_length = ctx->Attr<int32_t>("part_name_suffix_length");
+    int64_t parallel_num = ctx->parallel_ctx().parallel_num();
+    CHECK_LE(parallel_num, data_part_num);
+    BalancedSplitter bs(data_part_num, parallel_num);
+    Range range = bs.At(ctx->parallel_ctx().parallel_id());
+    const bool persist = OFRecordIndexedDataset::IsIndexPersistable(data_dir);
+    int64_t num_records = 0;
+    for (int i = range.begin(); i < range.end(); ++i) {
+      std::string num = std::to_string(i);
+      int32_t zero_count =
+          std::max(part_name_suffix_length - static_cast<int32_t>(num.length()), 0);
+      std::string file_path =
+          JoinPath(data_dir, part_name_prefix + std::string(zero_count, '0') + num);
+      indexes_.emplace_back(OFRecordIndex::LoadOrBuild(DataFS(), file_path, persist));
+      parts_.emplace_back(std::make_shared<const MappedBuffer>(file_path));
+      if (random_access) { parts_.back()->AdviseRandomAccess(); }
+      const OFRecordIndex& part_index = *indexes_.back();
+      if (part_index.num_records() > 0) {
+        const size_t last = part_index.num_records() - 1;
+        CHECK_LE(part_index.offset(last) + part_index.size(last), parts_.back()->size())
+            << "OFRecord part " << file_path << " changed while being indexed";
+      }
+      num_records += part_index.num_records();
+      part_record_end_.push_back(num_records);
+    }
+    CHECK_GT(num_records, 0) << "no record found in " << data_dir;
+  }
+  ~OFRecordMMapDataset() = default;
+
+  LoadTargetShdPtrVec At(int64_t index) const override {
+    const auto part_it =
+        std::upper_bound(part_record_end_.begin(), part_record_end_.end(), index);
+    CHECK(part_it != part_record_end_.end());
+    const int64_t part_id = part_it - part_record_end_.begin();
+    const int64_t record_index = index - (part_id == 0 ? 0 : part_record_end_.at(part_id - 1));
+    const OFRecordIndex& part_index = *indexes_.at(part_id);
+    const std::shared_ptr<const MappedBuffer>& part = parts_.at(part_id);
+    const char* payload = static_cast<const char*>(part->ptr()) + part_index.offset(record_index);
+    if (part_index.has_crc()) { part_index.CheckCrc(record_index, payload); }
+    LoadTargetShdPtr sample(new TensorBuffer());
+    sample->ResetAsView(Shape({part_index.size(record_index)}), DataType::kChar, payload, part);
+    LoadTargetShdPtrVec ret;
+    ret.push_back(std::move(sample));
+    return ret;
+  }
+
+  size_t Size() const override { return part_record_end_.back(); }
+
+ private:
+  std::vector<std::unique_ptr<const OFRecordIndex>> indexes_;
+  std::vector<std::shared_ptr<const MappedBuffer>> parts_;
+  // exclusive prefix end of the record indices of each part
+  std::vector<int64_t> part_record_end_;
+};
+
+}  // namespace data
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_DATA_OFRECORD_MMAP_DATASET_H_
@@ -0,0 +1,604 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/conv_cpu_kernel_util.h"
+#include "oneflow/core/common/blas.h"
+#include "oneflow/core/thread/thread_pool.h"
+
+namespace oneflow {
+
+namespace {
+
+// Elements handled by a task
+constexpr int64_t kTaskElemNum = 1 << 15;
+// Column buffer of kBatchedIm2ColGemm
+constexpr int64_t kBatchedColBufBytes = 32 << 20;
+// Transformed inputs and outputs of a block of Winograd tiles
+constexpr int64_t kWinogradBlockBytes = 16 << 20;
+
+// Runs DoRange over ranges of tasks of about task_elem_cnt elements each
+void ParallelForTaskRanges(int64_t task_num, int64_t task_elem_cnt,
+                           const std::function<void(int64_t, int64_t)>& DoRange) {
+  const int64_t grain = std::max<int64_t>(kTaskElemNum / std::max<int64_t>(task_elem_cnt, 1), 1);
+  ThreadPool* thread_pool = Global<ThreadPool>::Get();
+  if (task_num <= grain || thread_pool == nullptr || thread_pool->thread_num() <= 1) {
+    DoRange(0, task_num);
+    return;
+  }
+  thread_pool->ParallelFor(0, task_num, grain, DoRange);
+}
+
+// c = a * b of row major matrices
+template<typename T>
+void Gemm(enum CBLAS_TRANSPOSE trans_a, enum CBLAS_TRANSPOSE trans_b, int64_t m, int64_t n,
+          int64_t k, const T* a, int64_t lda, const T* b, int64_t ldb, T* c, int64_t ldc) {
+  cblas_gemm<T>(CblasRowMajor, trans_a, trans_b, static_cast<int>(m), static_cast<int>(n),
+                static_cast<int>(k), static_cast<T>(1), a, static_cast<int>(lda), b,
+                static_cast<int>(ldb), static_cast<T>(0), c, static_cast<int>(ldc));
+}
+
+// [begin, end) of the outputs o whose input o * stride + offset lies in [0, in_size)
+void GetValidRange(int64_t out_size, int64_t stride, int64_t offset, int64_t in_size,
+                   int64_t* begin, int64_t* end) {
+  *begin = offset >= 0 ? 0 : (-offset + stride - 1) / stride;
+  *end = in_size - offset <= 0 ? 0 : (in_size - 1 - offset) / stride + 1;
+  *end = std::min(*end, out_size);
+  *begin = std::min(*begin, *end);
+}
+
+int64_t GetKernelSize(const Conv2dCpuParams& p) {
+  return p.in_channels * p.kernel_height * p.kernel_width;
+}
+
+int64_t GetOutPlaneSize(const Conv2dCpuParams& p) { return p.out_height * p.out_width; }
+
+// The rows (ci, kh, kw) of n_num NCHW samples, each row holding n_num * OH * OW columns
+template<typename T>
+void Im2ColNchw(const Conv2dCpuParams& p, const T* in, int64_t n_num, T* col) {
+  const int64_t in_plane_size = p.in_height * p.in_width;
+  const int64_t out_plane_size = GetOutPlaneSize(p);
+  const int64_t row_size = n_num * out_plane_size;
+  const int64_t window_size = p.kernel_height * p.kernel_width;
+  ParallelForTaskRanges(GetKernelSize(p), row_size, [&](int64_t begin, int64_t end) {
+    FOR_RANGE(int64_t, row, begin, end) {
+      const int64_t ci = row / window_size;
+      const int64_t kh = (row % window_size) / p.kernel_width;
+      const int64_t kw = row % p.kernel_width;
+      const int64_t w_offset = kw * p.dilation_width - p.pad_width;
+      int64_t ow_begin = 0;
+      int64_t ow_end = 0;
+      GetValidRange(p.out_width, p.stride_width, w_offset, p.in_width, &ow_begin, &ow_end);
+      FOR_RANGE(int64_t, n, 0, n_num) {
+        const T* in_plane = in + (n * p.in_channels + ci) * in_plane_size;
+        T* col_row = col + row * row_size + n * out_plane_size;
+        FOR_RANGE(int64_t, oh, 0, p.out_height) {
+          const int64_t ih = oh * p.stride_height + kh * p.dilation_height - p.pad_height;
+          T* dst = col_row + oh * p.out_width;
+          if (ih < 0 || ih >= p.in_height) {
+            std::fill_n(dst, p.out_width, static_cast<T>(0));
+            continue;
+          }
+          const T* src = in_plane + ih * p.in_width + w_offset;
+          std::fill_n(dst, ow_begin, static_cast<T>(0));
+          if (p.stride_width == 1) {
+            std::copy(src + ow_begin, src + ow_end, dst + ow_begin);
+          } else {
+            FOR_RANGE(int64_t, ow, ow_begin, ow_end) { dst[ow] = src[ow * p.stride_width]; }
+          }
+          std::fill(dst + ow_end, dst + p.out_width, static_cast<T>(0));
+        }
+      }
+    }
+  });
+}
+
+// A row (kh, kw, ci) for each output pixel of n_num NHWC samples
+template<typename T>
+void Im2ColNhwc(const Conv2dCpuParams& p, const T* in, int64_t n_num, T* col) {
+  const int64_t kernel_size = GetKernelSize(p);
+  const int64_t channels = p.in_channels;
+  ParallelForTaskRanges(
+      n_num * p.out_height, p.out_width * kernel_size, [&](int64_t begin, int64_t end) {
+        FOR_RANGE(int64_t, task, begin, end) {
+          const int64_t n = task / p.out_height;
+          const int64_t oh = task % p.out_height;
+          FOR_RANGE(int64_t, ow, 0, p.out_width) {
+            T* dst = col + (task * p.out_width + ow) * kernel_size;
+            FOR_RANGE(int64_t, kh, 0, p.kernel_height) {
+              const int64_t ih = oh * p.stride_height + kh * p.dilation_height - p.pad_height;
+              FOR_RANGE(int64_t, kw, 0, p.kernel_width) {
+                const int64_t iw = ow * p.stride_width + kw * p.dilation_width - p.pad_width;
+                T* dst_channels = dst + (kh * p.kernel_width + kw) * channels;
+                if (ih < 0 || ih >= p.in_height || iw < 0 || iw >= p.in_width) {
+                  std::fill_n(dst_channels, channels, static_cast<T>(0));
+                } else {
+                  std::copy_n(in + ((n * p.in_height + ih) * p.in_width + iw) * channels,
+                              channels, dst_channels);
+                }
+              }
+            }
+          }
+        }
+      });
+}
+
+// Samples of a GEMM of kBatchedIm2ColGemm
+template<typename T>
+int64_t GetBatchedSampleNum(const Conv2dCpuParams& p) {
+  const int64_t sample_col_bytes = GetKernelSize(p) * GetOutPlaneSize(p) * sizeof(T);
+  return std::min(p.batch_num, std::max<int64_t>(kBatchedColBufBytes / sample_col_bytes, 1));
+}
+
+// im2col of sample_num samples at a time, then one GEMM for them. NCHW stages the GEMM output
+// in the workspace, since it comes out channel major.
+template<typename T>
+void Im2ColGemmForward(const Conv2dCpuParams& p, int64_t sample_num, const T* in,
+                       const T* weight, T* out, T* workspace) {
+  const int64_t kernel_size = GetKernelSize(p);
+  const int64_t in_sample_size = p.in_channels * p.in_height * p.in_width;
+  const int64_t out_plane_size = GetOutPlaneSize(p);
+  const int64_t out_sample_size = p.out_channels * out_plane_size;
+  for (int64_t n = 0; n < p.batch_num; n += sample_num) {
+    const int64_t n_num = std::min(sample_num, p.batch_num - n);
+    T* col = workspace;
+    T* out_samples = out + n * out_sample_size;
+    if (p.channels_last) {
+      Im2ColNhwc<T>(p, in + n * in_sample_size, n_num, col);
+      Gemm<T>(CblasNoTrans, CblasTrans, n_num * out_plane_size, p.out_channels, kernel_size, col,
+              kernel_size, weight, kernel_size, out_samples, p.out_channels);
+    } else if (n_num == 1) {
+      Im2ColNchw<T>(p, in + n * in_sample_size, n_num, col);
+      Gemm<T>(CblasNoTrans, CblasNoTrans, p.out_channels, out_plane_size, kernel_size, weight,
+              kernel_size, col, out_plane_size, out_samples, out_plane_size);
+    } else {
+      Im2ColNchw<T>(p, in + n * in_sample_size, n_num, col);
+      const int64_t col_size = n_num * out_plane_size;
+      T* staged = col + kernel_size * col_size;
+      Gemm<T>(CblasNoTrans, CblasNoTrans, p.out_channels, col_size, kernel_size, weight,
+              kernel_size, col, col_size, staged, col_size);
+      // staged is (Co, n_num, OH * OW)
+      ParallelForTaskRanges(n_num * p.out_channels, out_plane_size,
+                            [&](int64_t begin, int64_t end) {
+                              FOR_RANGE(int64_t, plane, begin, end) {
+                                const int64_t i = plane / p.out_channels;
+                                const int64_t co = plane % p.out_channels;
+                                std::copy_n(staged + (co * n_num + i) * out_plane_size,
+                                            out_plane_size, out_samples + plane * out_plane_size);
+                              }
+                            });
+    }
+  }
+}
+
+// 1x1 kernels without padding, where x is already the column buffer: NHWC x is (pixels, Ci)
+// with the rows of an output row evenly spaced, NCHW x of stride 1 is (Ci, pixels) per sample
+template<typename T>
+void Direct1x1Forward(const Conv2dCpuParams& p, const T* in, const T* weight, T* out) {
+  const int64_t ci = p.in_channels;
+  const int64_t co = p.out_channels;
+  if (p.channels_last && p.stride_height == 1 && p.stride_width == 1) {
+    Gemm<T>(CblasNoTrans, CblasTrans, p.batch_num * GetOutPlaneSize(p), co, ci, in, ci, weight,
+            ci, out, co);
+  } else if (p.channels_last) {
+    FOR_RANGE(int64_t, n, 0, p.batch_num) {
+      FOR_RANGE(int64_t, oh, 0, p.out_height) {
+        const T* in_row = in + (n * p.in_height + oh * p.stride_height) * p.in_width * ci;
+        T* out_row = out + (n * p.out_height + oh) * p.out_width * co;
+        Gemm<T>(CblasNoTrans, CblasTrans, p.out_width, co, ci, in_row, p.stride_width * ci,
+                weight, ci, out_row, co);
+      }
+    }
+  } else {
+    const int64_t plane_size = GetOutPlaneSize(p);
+    FOR_RANGE(int64_t, n, 0, p.batch_num) {
+      Gemm<T>(CblasNoTrans, CblasNoTrans, co, plane_size, ci, weight, ci,
+              in + n * ci * plane_size, plane_size, out + n * co * plane_size, plane_size);
+    }
+  }
+}
+
+// Transforms of Lavin and Gray, "Fast Algorithms for Convolutional Neural Networks"
+constexpr double kF23BT[4][4] = {{1, 0, -1, 0}, {0, 1, 1, 0}, {0, -1, 1, 0}, {0, 1, 0, -1}};
+constexpr double kF23G[4][3] = {{1, 0, 0}, {0.5, 0.5, 0.5}, {0.5, -0.5, 0.5}, {0, 0, 1}};
+constexpr double kF23AT[2][4] = {{1, 1, 1, 0}, {0, 1, -1, -1}};
+constexpr double kF43BT[6][6] = {{4, 0, -5, 0, 1, 0},  {0, -4, -4, 1, 1, 0},
+                                 {0, 4, -4, -1, 1, 0}, {0, -2, -1, 2, 1, 0},
+                                 {0, 2, -1, -2, 1, 0}, {0, 4, 0, -5, 0, 1}};
+constexpr double kF43G[6][3] = {{1.0 / 4, 0, 0},
+                                {-1.0 / 6, -1.0 / 6, -1.0 / 6},
+                                {-1.0 / 6, 1.0 / 6, -1.0 / 6},
+                                {1.0 / 24, 1.0 / 12, 1.0 / 6},
+                                {1.0 / 24, -1.0 / 12, 1.0 / 6},
+                                {0, 0, 1}};
+constexpr double kF43AT[4][6] = {
+    {1, 1, 1, 1, 1, 0}, {0, 1, -1, 2, -2, 0}, {0, 1, 1, 4, 4, 0}, {0, 1, -1, 8, -8, 1}};
+
+// F(m x m, 3 x 3) with tiles of alpha = m + 2
+template<int64_t m>
+struct Winograd;
+
+template<>
+struct Winograd<2> {
+  static constexpr int64_t kAlpha = 4;
+  static double BT(int64_t i, int64_t j) { return kF23BT[i][j]; }
+  static double G(int64_t i, int64_t j) { return kF23G[i][j]; }
+  static double AT(int64_t i, int64_t j) { return kF23AT[i][j]; }
+};
+
+template<>
+struct Winograd<4> {
+  static constexpr int64_t kAlpha = 6;
+  static double BT(int64_t i, int64_t j) { return kF43BT[i][j]; }
+  static double G(int64_t i, int64_t j) { return kF43G[i][j]; }
+  static double AT(int64_t i, int64_t j) { return kF43AT[i][j]; }
+};
+
+// Element strides of the n, c, h and w axes
+struct Strides4d final {
+  int64_t n;
+  int64_t c;
+  int64_t h;
+  int64_t w;
+};
+
+Strides4d GetStrides(bool channels_last, int64_t channels, int64_t height, int64_t width) {
+  if (channels_last) { return Strides4d{height * width * channels, 1, width * channels, channels}; }
+  return Strides4d{channels * height * width, height * width, width, 1};
+}
+
+template<int64_t m>
+struct WinogradTiles final {
+  explicit WinogradTiles(const Conv2dCpuParams& p)
+      : tiles_h(RoundUp(p.out_height, m) / m),
+        tiles_w(RoundUp(p.out_width, m) / m),
+        tile_num(p.batch_num * tiles_h * tiles_w) {}
+
+  void Decode(int64_t tile, int64_t* n, int64_t* oh, int64_t* ow) const {
+    *n = tile / (tiles_h * tiles_w);
+    *oh = (tile / tiles_w) % tiles_h * m;
+    *ow = tile % tiles_w * m;
+  }
+
+  int64_t tiles_h;
+  int64_t tiles_w;
+  int64_t tile_num;
+};
+
+// Tiles of a block, so that its transformed inputs and outputs fit in kWinogradBlockBytes
+template<typename T, int64_t m>
+int64_t GetWinogradBlockTileNum(const Conv2dCpuParams& p) {
+  constexpr int64_t alpha = Winograd<m>::kAlpha;
+  const int64_t tile_bytes = alpha * alpha * (p.in_channels + p.out_channels) * sizeof(T);
+  return std::min(WinogradTiles<m>(p).tile_num,
+                  std::max<int64_t>(kWinogradBlockBytes / tile_bytes, 1));
+}
+
+template<typename T, int64_t m>
+size_t GetWinogradWorkspaceSize(const Conv2dCpuParams& p) {
+  constexpr int64_t alpha = Winograd<m>::kAlpha;
+  const int64_t filter_size = alpha * alpha * p.out_channels * p.in_channels;
+  const int64_t block_size =
+      alpha * alpha * (p.in_channels + p.out_channels) * GetWinogradBlockTileNum<T, m>(p);
+  return (filter_size + block_size) * sizeof(T);
+}
+
+// U[xi][nu] = (G g G^T)[xi][nu] as (Co, Ci) matrices
+template<typename T, int64_t m>
+void WinogradFilterTransform(const Conv2dCpuParams& p, const T* weight, T* u) {
+  using W = Winograd<m>;
+  constexpr int64_t alpha = W::kAlpha;
+  const int64_t ci_num = p.in_channels;
+  const int64_t pair_num = p.out_channels * ci_num;
+  const int64_t kh_stride = p.channels_last ? 3 * ci_num : 3;
+  const int64_t kw_stride = p.channels_last ? ci_num : 1;
+  ParallelForTaskRanges(pair_num, alpha * alpha * 4, [&](int64_t begin, int64_t end) {
+    FOR_RANGE(int64_t, pair, begin, end) {
+      const int64_t co = pair / ci_num;
+      const int64_t ci = pair % ci_num;
+      const T* g = weight + co * 9 * ci_num + (p.channels_last ? ci : ci * 9);
+      T tmp[alpha][3];
+      for (int64_t i = 0; i < alpha; ++i) {
+        for (int64_t j = 0; j < 3; ++j) {
+          T sum = 0;
+          for (int64_t k = 0; k < 3; ++k) { sum += W::G(i, k) * g[k * kh_stride + j * kw_stride]; }
+          tmp[i][j] = sum;
+        }
+      }
+      for (int64_t i = 0; i < alpha; ++i) {
+        for (int64_t j = 0; j < alpha; ++j) {
+          T sum = 0;
+          for (int64_t k = 0; k < 3; ++k) { sum += tmp[i][k] * W::G(j, k); }
+          u[(i * alpha + j) * pair_num + pair] = sum;
+        }
+      }
+    }
+  });
+}
+
+// V[xi][nu] = (B^T d B)[xi][nu] as (Ci, block_tile_num) matrices, d being the input tiles
+template<typename T, int64_t m>
+void WinogradInputTransform(const Conv2dCpuParams& p, const WinogradTiles<m>& tiles,
+                            int64_t tile_begin, int64_t block_tile_num, const T* in, T* v) {
+  using W = Winograd<m>;
+  constexpr int64_t alpha = W::kAlpha;
+  const int64_t ci_num = p.in_channels;
+  const Strides4d s = GetStrides(p.channels_last, ci_num, p.in_height, p.in_width);
+  ParallelForTaskRanges(block_tile_num, alpha * alpha * ci_num, [&](int64_t begin, int64_t end) {
+    FOR_RANGE(int64_t, t, begin, end) {
+      int64_t n = 0;
+      int64_t oh = 0;
+      int64_t ow = 0;
+      tiles.Decode(tile_begin + t, &n, &oh, &ow);
+      const int64_t ih0 = oh - p.pad_height;
+      const int64_t iw0 = ow - p.pad_width;
+      FOR_RANGE(int64_t, ci, 0, ci_num) {
+        const T* in_channel = in + n * s.n + ci * s.c;
+        T d[alpha][alpha];
+        for (int64_t i = 0; i < alpha; ++i) {
+          const int64_t ih = ih0 + i;
+          for (int64_t j = 0; j < alpha; ++j) {
+            const int64_t iw = iw0 + j;
+            const bool valid = ih >= 0 && ih < p.in_height && iw >= 0 && iw < p.in_width;
+            d[i][j] = valid ? in_channel[ih * s.h + iw * s.w] : static_cast<T>(0);
+          }
+        }
+        T tmp[alpha][alpha];
+        for (int64_t i = 0; i < alpha; ++i) {
+          for (int64_t j = 0; j < alpha; ++j) {
+            T sum = 0;
+            for (int64_t k = 0; k < alpha; ++k) { sum += W::BT(i, k) * d[k][j]; }
+            tmp[i][j] = sum;
+          }
+        }
+        for (int64_t i = 0; i < alpha; ++i) {
+          for (int64_t j = 0; j < alpha; ++j) {
+            T sum = 0;
+            for (int64_t k = 0; k < alpha; ++k) { sum += tmp[i][k] * W::BT(j, k); }
+            v[((i * alpha + j) * ci_num + ci) * block_tile_num + t] = sum;
+          }
+        }
+      }
+    }
+  });
+}
+
+// out = A^T M A (+ bias) for the outputs of the tiles inside out, M[xi][nu] being
+// (Co, block_tile_num) matrices
+template<typename T, int64_t m>
+void WinogradOutputTransform(const Conv2dCpuParams& p, const WinogradTiles<m>& tiles,
+                             int64_t tile_begin, int64_t block_tile_num, const T* mat,
+                             const T* bias, T* out) {
+  using W = Winograd<m>;
+  constexpr int64_t alpha = W::kAlpha;
+  const int64_t co_num = p.out_channels;
+  const Strides4d s = GetStrides(p.channels_last, co_num, p.out_height, p.out_width);
+  ParallelForTaskRanges(block_tile_num, alpha * alpha * co_num, [&](int64_t begin, int64_t end) {
+    FOR_RANGE(int64_t, t, begin, end) {
+      int64_t n = 0;
+      int64_t oh = 0;
+      int64_t ow = 0;
+      tiles.Decode(tile_begin + t, &n, &oh, &ow);
+      const int64_t h_num = std::min(m, p.out_height - oh);
+      const int64_t w_num = std::min(m, p.out_width - ow);
+      FOR_RANGE(int64_t, co, 0, co_num) {
+        T tmp[m][alpha];
+        for (int64_t i = 0; i < m; ++i) {
+          for (int64_t j = 0; j < alpha; ++j) {
+            T sum = 0;
+            for (int64_t k = 0; k < alpha; ++k) {
+              sum += W::AT(i, k) * mat[((k * alpha + j) * co_num + co) * block_tile_num + t];
+            }
+            tmp[i][j] = sum;
+          }
+        }
+        const T b = bias == nullptr ? static_cast<T>(0) : bias[co];
+        T* out_channel = out + n * s.n + co * s.c;
+        for (int64_t i = 0; i < h_num; ++i) {
+          for (int64_t j = 0; j < w_num; ++j) {
+            T sum = b;
+            for (int64_t k = 0; k < alpha; ++k) { sum += tmp[i][k] * W::AT(j, k); }
+            out_channel[(oh + i) * s.h + (ow + j) * s.w] = sum;
+          }
+        }
+      }
+    }
+  });
+}
+
+// Blocks of tiles: transform the inputs, one (Co, Ci) x (Ci, tiles) GEMM per element of the
+// tile, then transform the outputs
+template<typename T, int64_t m>
+void WinogradForward(const Conv2dCpuParams& p, const T* in, const T* weight, const T* bias,
+                     T* out, T* workspace) {
+  constexpr int64_t alpha = Winograd<m>::kAlpha;
+  const WinogradTiles<m> tiles(p);
+  const int64_t max_block_tile_num = GetWinogradBlockTileNum<T, m>(p);
+  const int64_t ci_num = p.in_channels;
+  const int64_t co_num = p.out_channels;
+  T* u = workspace;
+  T* v = u + alpha * alpha * co_num * ci_num;
+  T* mat = v + alpha * alpha * ci_num * max_block_tile_num;
+  WinogradFilterTransform<T, m>(p, weight, u);
+  for (int64_t tile_begin = 0; tile_begin < tiles.tile_num; tile_begin += max_block_tile_num) {
+    const int64_t block_tile_num = std::min(max_block_tile_num, tiles.tile_num - tile_begin);
+    WinogradInputTransform<T, m>(p, tiles, tile_begin, block_tile_num, in, v);
+    FOR_RANGE(int64_t, i, 0, alpha * alpha) {
+      Gemm<T>(CblasNoTrans, CblasNoTrans, co_num, block_tile_num, ci_num,
+              u + i * co_num * ci_num, ci_num, v + i * ci_num * block_tile_num, block_tile_num,
+              mat + i * co_num * block_tile_num, block_tile_num);
+    }
+    WinogradOutputTransform<T, m>(p, tiles, tile_begin, block_tile_num, mat, bias, out);
+  }
+}
+
+template<typename T>
+void AddBias(const Conv2dCpuParams& p, const T* bias, T* out) {
+  const int64_t plane_size = GetOutPlaneSize(p);
+  const int64_t co_num = p.out_channels;
+  if (p.channels_last) {
+    ParallelForTaskRanges(p.batch_num * plane_size, co_num, [&](int64_t begin, int64_t end) {
+      FOR_RANGE(int64_t, pixel, begin, end) {
+        T* out_pixel = out + pixel * co_num;
+        for (int64_t co = 0; co < co_num; ++co) { out_pixel[co] += bias[co]; }
+      }
+    });
+  } else {
+    ParallelForTaskRanges(p.batch_num * co_num, plane_size, [&](int64_t begin, int64_t end) {
+      FOR_RANGE(int64_t, plane, begin, end) {
+        const T b = bias[plane % co_num];
+        T* out_plane = out + plane * plane_size;
+        for (int64_t i = 0; i < plane_size; ++i) { out_plane[i] += b; }
+      }
+    });
+  }
+}
+
+const std::vector<ConvCpuAlgo>& AllAlgos() {
+  static const std::vector<ConvCpuAlgo> algos = {
+      ConvCpuAlgo::kIm2ColGemm, ConvCpuAlgo::kBatchedIm2ColGemm, ConvCpuAlgo::kDirect1x1,
+      ConvCpuAlgo::kWinogradF23, ConvCpuAlgo::kWinogradF43};
+  return algos;
+}
+
+bool GetAlgoFromName(const std::string& name, ConvCpuAlgo* algo) {
+  const HashMap<std::string, ConvCpuAlgo> name2algo = {
+      {"im2col", ConvCpuAlgo::kIm2ColGemm},
+      {"batched_im2col", ConvCpuAlgo::kBatchedIm2ColGemm},
+      {"direct_1x1", ConvCpuAlgo::kDirect1x1},
+      {"winograd_f23", ConvCpuAlgo::kWinogradF23},
+      {"winograd_f43", ConvCpuAlgo::kWinogradF43}};
+  const auto it = name2algo.find(name);
+  if (it == name2algo.end()) { return false; }
+  *algo = it->second;
+  return true;
+}
+
+}  // namespace
+
+template<typename T>
+bool ConvCpuKernelUtil<T>::IsSupported(ConvCpuAlgo algo, const Conv2dCpuParams& p) {
+  switch (algo) {
+    case ConvCpuAlgo::kIm2ColGemm: return true;
+    case ConvCpuAlgo::kBatchedIm2ColGemm: return GetBatchedSampleNum<T>(p) > 1;
+    case ConvCpuAlgo::kDirect1x1:
+      return p.kernel_height == 1 && p.kernel_width == 1 && p.pad_height == 0
+             && p.pad_width == 0
+             && (p.channels_last
+                 || (p.out_height == p.in_height && p.out_width == p.in_width
+                     && p.stride_height == 1 && p.stride_width == 1));
+    case ConvCpuAlgo::kWinogradF23:
+    case ConvCpuAlgo::kWinogradF43:
+      return p.kernel_height == 3 && p.kernel_width == 3 && p.stride_height == 1
+             && p.stride_width == 1 && p.dilation_height == 1 && p.dilation_width == 1;
+    default: UNIMPLEMENTED();
+  }
+  return false;
+}
+
+template<typename T>
+size_t ConvCpuKernelUtil<T>::GetWorkspaceSize(ConvCpuAlgo algo, const Conv2dCpuParams& p) {
+  const int64_t sample_col_size = GetKernelSize(p) * GetOutPlaneSize(p);
+  switch (algo) {
+    case ConvCpuAlgo::kIm2ColGemm: return sample_col_size * sizeof(T);
+    case ConvCpuAlgo::kBatchedIm2ColGemm: {
+      const int64_t sample_num = GetBatchedSampleNum<T>(p);
+      const int64_t staged_size =
+          p.channels_last ? 0 : sample_num * p.out_channels * GetOutPlaneSize(p);
+      return (sample_num * sample_col_size + staged_size) * sizeof(T);
+    }
+    case ConvCpuAlgo::kDirect1x1: return 0;
+    case ConvCpuAlgo::kWinogradF23: return GetWinogradWorkspaceSize<T, 2>(p);
+    case ConvCpuAlgo::kWinogradF43: return GetWinogradWorkspaceSize<T, 4>(p);
+    default: UNIMPLEMENTED();
+  }
+  return 0;
+}
+
+template<typename T>
+size_t ConvCpuKernelUtil<T>::GetMaxWorkspaceSize(const Conv2dCpuParams& p) {
+  size_t max_size = 0;
+  for (const ConvCpuAlgo algo : AllAlgos()) {
+    if (IsSupported(algo, p)) { max_size = std::max(max_size, GetWorkspaceSize(algo, p)); }
+  }
+  return max_size;
+}
+
+template<typename T>
+void ConvCpuKernelUtil<T>::Forward(ConvCpuAlgo algo, const Conv2dCpuParams& p, const T* in,
+                                   const T* weight, const T* bias, T* out, void* workspace) {
+  CHECK(IsSupported(algo, p));
+  T* ws = static_cast<T*>(workspace);
+  switch (algo) {
+    case ConvCpuAlgo::kIm2ColGemm: Im2ColGemmForward<T>(p, 1, in, weight, out, ws); break;
+    case ConvCpuAlgo::kBatchedIm2ColGemm:
+      Im2ColGemmForward<T>(p, GetBatchedSampleNum<T>(p), in, weight, out, ws);
+      break;
+    case ConvCpuAlgo::kDirect1x1: Direct1x1Forward<T>(p, in, weight, out); break;
+    // Winograd adds the bias in its output transform
+    case ConvCpuAlgo::kWinogradF23: WinogradForward<T, 2>(p, in, weight, bias, out, ws); return;
+    case ConvCpuAlgo::kWinogradF43: WinogradForward<T, 4>(p, in, weight, bias, out, ws); return;
+    default: UNIMPLEMENTED();
+  }
+  if (bias != nullptr) { AddBias<T>(p, bias, out); }
+}
+
+template<typename T>
+ConvCpuAlgo ConvCpuKernelUtil<T>::HeuristicAlgo(const Conv2dCpuParams& p, size_t workspace_size) {
+  const auto Fits = [&](ConvCpuAlgo algo) {
+    return IsSupported(algo, p) && GetWorkspaceSize(algo, p) <= workspace_size;
+  };
+  // 1x1 kernels skip im2col. Winograd only pays off its transforms with many channels.
+  if (Fits(ConvCpuAlgo::kDirect1x1)) { return ConvCpuAlgo::kDirect1x1; }
+  if (p.in_channels >= 256 && p.out_channels >= 256 && Fits(ConvCpuAlgo::kWinogradF43)) {
+    return ConvCpuAlgo::kWinogradF43;
+  }
+  CHECK(Fits(ConvCpuAlgo::kIm2ColGemm));
+  return ConvCpuAlgo::kIm2ColGemm;
+}
+
+template<typename T>
+ConvCpuAlgo ConvCpuKernelUtil<T>::SearchAlgo(const Conv2dCpuParams& p, size_t workspace_size,
+                                             const T* in, const T* weight, const T* bias,
+                                             T* out, void* workspace) {
+  const auto Fits = [&](ConvCpuAlgo algo) {
+    return IsSupported(algo, p) && GetWorkspaceSize(algo, p) <= workspace_size;
+  };
+  const char* env = std::getenv("ONEFLOW_CPU_CONV_ALGO");
+  const std::string env_algo_name = env == nullptr ? "" : env;
+  ConvCpuAlgo env_algo = ConvCpuAlgo::kIm2ColGemm;
+  if (GetAlgoFromName(env_algo_name, &env_algo) && Fits(env_algo)) { return env_algo; }
+  if (env_algo_name != "search") { return HeuristicAlgo(p, workspace_size); }
+  ConvCpuAlgo best_algo = ConvCpuAlgo::kIm2ColGemm;
+  CHECK(Fits(best_algo));
+  double best_seconds = std::numeric_limits<double>::max();
+  for (const ConvCpuAlgo algo : AllAlgos()) {
+    if (!Fits(algo)) { continue; }
+    const auto start = std::chrono::steady_clock::now();
+    Forward(algo, p, in, weight, bias, out, workspace);
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    VLOG(2) << "cpu conv algo " << static_cast<int>(algo) << ": " << seconds * 1e3 << " ms";
+    if (seconds < best_seconds) {
+      best_seconds = seconds;
+      best_algo = algo;
+    }
+  }
+  return best_algo;
+}
+
+template struct ConvCpuKernelUtil<float>;
+template struct ConvCpuKernelUtil<double>;
+
+}  // namespace oneflow
@@ -0,0 +1,81 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_CONV_CPU_KERNEL_UTIL_H_
+#define ONEFLOW_USER_KERNELS_CONV_CPU_KERNEL_UTIL_H_
+
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+enum class ConvCpuAlgo {
+  // im2col of one sample, then a GEMM per sample
+  kIm2ColGemm = 0,
+  // im2col of several samples into one column buffer, then one GEMM for all of them
+  kBatchedIm2ColGemm = 1,
+  // 1x1 kernels read x as the GEMM operand directly
+  kDirect1x1 = 2,
+  // Winograd F(2x2, 3x3) and F(4x4, 3x3) for 3x3 kernels of stride 1
+  kWinogradF23 = 3,
+  kWinogradF43 = 4,
+};
+
+// A conv with groups 1 of NCHW or NHWC tensors, the 1d one being the case of height 1.
+// The weight is (out_channels, in_channels, kh, kw) for NCHW and (out_channels, kh, kw,
+// in_channels) for NHWC.
+struct Conv2dCpuParams final {
+  int64_t batch_num;
+  int64_t in_channels;
+  int64_t in_height;
+  int64_t in_width;
+  int64_t out_channels;
+  int64_t out_height;
+  int64_t out_width;
+  int64_t kernel_height;
+  int64_t kernel_width;
+  int64_t stride_height;
+  int64_t stride_width;
+  int64_t dilation_height;
+  int64_t dilation_width;
+  int64_t pad_height;
+  int64_t pad_width;
+  bool channels_last;
+};
+
+template<typename T>
+struct ConvCpuKernelUtil final {
+  static bool IsSupported(ConvCpuAlgo algo, const Conv2dCpuParams& params);
+  // Bytes of workspace algo needs
+  static size_t GetWorkspaceSize(ConvCpuAlgo algo, const Conv2dCpuParams& params);
+  // The largest workspace of the supported algorithms
+  static size_t GetMaxWorkspaceSize(const Conv2dCpuParams& params);
+  // out = conv(in, weight) + bias, where bias may be null
+  static void Forward(ConvCpuAlgo algo, const Conv2dCpuParams& params, const T* in,
+                      const T* weight, const T* bias, T* out, void* workspace);
+  // The algorithm picked from the params alone among those whose workspace fits, so that every
+  // run and every rank computes a conv the same way
+  static ConvCpuAlgo HeuristicAlgo(const Conv2dCpuParams& params, size_t workspace_size);
+  // The algorithm of env ONEFLOW_CPU_CONV_ALGO (im2col, batched_im2col, direct_1x1, winograd_f23
+  // or winograd_f43) when it is supported, otherwise the HeuristicAlgo. With
+  // ONEFLOW_CPU_CONV_ALGO=search, the fastest of the algorithms whose workspace fits instead, timed
+  // on these tensors in each process. out is overwritten then.
+  static ConvCpuAlgo SearchAlgo(const Conv2dCpuParams& params, size_t workspace_size,
+                                const T* in, const T* weight, const T* bias, T* out,
+                                void* workspace);
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_CONV_CPU_KERNEL_UTIL_H_
@@ -0,0 +1,218 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/conv_cpu_kernel_util.h"
+#include "oneflow/core/kernel/cpu_kernel_test_util.h"
+#include <gtest/gtest.h>
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+const std::vector<ConvCpuAlgo> kAlgos = {ConvCpuAlgo::kIm2ColGemm, ConvCpuAlgo::kBatchedIm2ColGemm,
+                                         ConvCpuAlgo::kDirect1x1, ConvCpuAlgo::kWinogradF23,
+                                         ConvCpuAlgo::kWinogradF43};
+
+Conv2dCpuParams MakeParams(int64_t batch_num, int64_t in_channels, int64_t in_height,
+                           int64_t in_width, int64_t out_channels, int64_t kernel,
+                           int64_t stride, int64_t dilation, int64_t pad, bool channels_last) {
+  Conv2dCpuParams p{};
+  p.batch_num = batch_num;
+  p.in_channels = in_channels;
+  p.in_height = in_height;
+  p.in_width = in_width;
+  p.out_channels = out_channels;
+  p.kernel_height = kernel;
+  p.kernel_width = kernel;
+  p.stride_height = stride;
+  p.stride_width = stride;
+  p.dilation_height = dilation;
+  p.dilation_width = dilation;
+  p.pad_height = pad;
+  p.pad_width = pad;
+  p.out_height = (in_height + 2 * pad - dilation * (kernel - 1) - 1) / stride + 1;
+  p.out_width = (in_width + 2 * pad - dilation * (kernel - 1) - 1) / stride + 1;
+  p.channels_last = channels_last;
+  return p;
+}
+
+int64_t Index(bool channels_last, int64_t n, int64_t c, int64_t h, int64_t w, int64_t channels,
+              int64_t height, int64_t width) {
+  return channels_last ? ((n * height + h) * width + w) * channels + c
+                       : ((n * channels + c) * height + h) * width + w;
+}
+
+std::vector<double> NaiveConv(const Conv2dCpuParams& p, const std::vector<float>& in,
+                              const std::vector<float>& weight, const std::vector<float>& bias) {
+  std::vector<double> out(p.batch_num * p.out_channels * p.out_height * p.out_width);
+  FOR_RANGE(int64_t, n, 0, p.batch_num) {
+    FOR_RANGE(int64_t, co, 0, p.out_channels) {
+      FOR_RANGE(int64_t, oh, 0, p.out_height) {
+        FOR_RANGE(int64_t, ow, 0, p.out_width) {
+          double sum = bias.empty() ? 0 : bias.at(co);
+          FOR_RANGE(int64_t, ci, 0, p.in_channels) {
+            FOR_RANGE(int64_t, kh, 0, p.kernel_height) {
+              FOR_RANGE(int64_t, kw, 0, p.kernel_width) {
+                const int64_t ih = oh * p.stride_height + kh * p.dilation_height - p.pad_height;
+                const int64_t iw = ow * p.stride_width + kw * p.dilation_width - p.pad_width;
+                if (ih < 0 || ih >= p.in_height || iw < 0 || iw >= p.in_width) { continue; }
+                // The weight is laid out as a sample of out_channels channels and kernel pixels
+                const int64_t w_idx = Index(p.channels_last, co, ci, kh, kw, p.in_channels,
+                                            p.kernel_height, p.kernel_width);
+                sum += static_cast<double>(weight.at(w_idx))
+                       * in.at(Index(p.channels_last, n, ci, ih, iw, p.in_channels,
+                                     p.in_height, p.in_width));
+              }
+            }
+          }
+          out.at(Index(p.channels_last, n, co, oh, ow, p.out_channels, p.out_height,
+                       p.out_width)) = sum;
+        }
+      }
+    }
+  }
+  return out;
+}
+
+}  // namespace
+
+TEST(ConvCpuKernelUtil, match_naive) {
+  ScopedGlobalThreadPool thread_pool;
+  // batch, in channels, height, width, out channels, kernel, stride, dilation, pad
+  const std::vector<std::array<int64_t, 9>> cases = {
+      {2, 3, 7, 9, 5, 3, 1, 1, 1},  {3, 4, 8, 8, 6, 3, 1, 1, 0},   {1, 5, 11, 6, 4, 3, 1, 1, 2},
+      {2, 8, 6, 7, 16, 1, 1, 1, 0}, {2, 8, 9, 9, 16, 1, 2, 1, 0},  {2, 3, 10, 9, 4, 3, 2, 1, 1},
+      {2, 3, 12, 10, 4, 3, 1, 2, 2}, {1, 2, 13, 13, 3, 5, 2, 1, 2}, {4, 16, 5, 5, 8, 3, 1, 1, 1},
+      {1, 3, 1, 17, 4, 1, 1, 1, 0}};
+  for (const auto& c : cases) {
+    for (const bool channels_last : {false, true}) {
+      for (const bool has_bias : {false, true}) {
+        const Conv2dCpuParams p =
+            MakeParams(c[0], c[1], c[2], c[3], c[4], c[5], c[6], c[7], c[8], channels_last);
+        const std::vector<float> in =
+            RandomFloats(p.batch_num * p.in_channels * p.in_height * p.in_width, 1);
+        const std::vector<float> weight =
+            RandomFloats(p.out_channels * p.in_channels * p.kernel_height * p.kernel_width, 2);
+        const std::vector<float> bias =
+            has_bias ? RandomFloats(p.out_channels, 3) : std::vector<float>();
+        const std::vector<double> expected = NaiveConv(p, in, weight, bias);
+        for (const ConvCpuAlgo algo : kAlgos) {
+          if (!ConvCpuKernelUtil<float>::IsSupported(algo, p)) { continue; }
+          std::vector<char> workspace(ConvCpuKernelUtil<float>::GetWorkspaceSize(algo, p));
+          ASSERT_LE(workspace.size(), ConvCpuKernelUtil<float>::GetMaxWorkspaceSize(p));
+          std::vector<float> out(expected.size(), NAN);
+          ConvCpuKernelUtil<float>::Forward(algo, p, in.data(), weight.data(),
+                                            has_bias ? bias.data() : nullptr, out.data(),
+                                            workspace.data());
+          // F(4x4, 3x3) loses a few bits in its transforms
+          const double tol = algo == ConvCpuAlgo::kWinogradF43 ? 1e-3 : 1e-4;
+          FOR_RANGE(size_t, i, 0, out.size()) {
+            ASSERT_NEAR(out.at(i), expected.at(i), tol * (1 + std::abs(expected.at(i))))
+                << "algo " << static_cast<int>(algo) << " channels_last " << channels_last
+                << " case " << c[0] << "x" << c[1] << "x" << c[2] << "x" << c[3] << " i " << i;
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(ConvCpuKernelUtil, heuristic_algo) {
+  const auto Algo = [](const Conv2dCpuParams& p) {
+    return ConvCpuKernelUtil<float>::HeuristicAlgo(
+        p, ConvCpuKernelUtil<float>::GetMaxWorkspaceSize(p));
+  };
+  ASSERT_EQ(Algo(MakeParams(8, 64, 56, 56, 256, 1, 1, 1, 0, false)), ConvCpuAlgo::kDirect1x1);
+  ASSERT_EQ(Algo(MakeParams(8, 64, 56, 56, 64, 3, 1, 1, 1, false)), ConvCpuAlgo::kIm2ColGemm);
+  ASSERT_EQ(Algo(MakeParams(8, 256, 14, 14, 256, 3, 1, 1, 1, true)), ConvCpuAlgo::kWinogradF43);
+  ASSERT_EQ(Algo(MakeParams(8, 256, 14, 14, 256, 3, 2, 1, 1, true)), ConvCpuAlgo::kIm2ColGemm);
+  // Falls back to im2col of one sample when the workspace is too small
+  const Conv2dCpuParams p = MakeParams(8, 256, 14, 14, 256, 3, 1, 1, 1, false);
+  ASSERT_EQ(ConvCpuKernelUtil<float>::HeuristicAlgo(
+                p, ConvCpuKernelUtil<float>::GetWorkspaceSize(ConvCpuAlgo::kIm2ColGemm, p)),
+            ConvCpuAlgo::kIm2ColGemm);
+  // Without env ONEFLOW_CPU_CONV_ALGO, SearchAlgo does not run any algorithm
+  ASSERT_EQ(unsetenv("ONEFLOW_CPU_CONV_ALGO"), 0);
+  std::vector<char> workspace(ConvCpuKernelUtil<float>::GetMaxWorkspaceSize(p));
+  ASSERT_EQ(ConvCpuKernelUtil<float>::SearchAlgo(p, workspace.size(), nullptr, nullptr, nullptr,
+                                                 nullptr, workspace.data()),
+            ConvCpuAlgo::kWinogradF43);
+}
+
+TEST(ConvCpuKernelUtil, search_algo) {
+  ASSERT_EQ(setenv("ONEFLOW_CPU_CONV_ALGO", "search", 1), 0);
+  const Conv2dCpuParams p = MakeParams(2, 8, 10, 10, 8, 3, 1, 1, 1, false);
+  const std::vector<float> in = RandomFloats(2 * 8 * 10 * 10, 1);
+  const std::vector<float> weight = RandomFloats(8 * 8 * 9, 2);
+  std::vector<float> out(2 * 8 * 10 * 10);
+  std::vector<char> workspace(ConvCpuKernelUtil<float>::GetMaxWorkspaceSize(p));
+  const ConvCpuAlgo algo = ConvCpuKernelUtil<float>::SearchAlgo(
+      p, workspace.size(), in.data(), weight.data(), nullptr, out.data(), workspace.data());
+  ASSERT_TRUE(ConvCpuKernelUtil<float>::IsSupported(algo, p));
+  // The batched and Winograd algorithms need more workspace than im2col of one sample
+  const size_t im2col_size =
+      ConvCpuKernelUtil<float>::GetWorkspaceSize(ConvCpuAlgo::kIm2ColGemm, p);
+  ASSERT_EQ(ConvCpuKernelUtil<float>::SearchAlgo(p, im2col_size, in.data(), weight.data(),
+                                                 nullptr, out.data(), workspace.data()),
+            ConvCpuAlgo::kIm2ColGemm);
+  ASSERT_EQ(unsetenv("ONEFLOW_CPU_CONV_ALGO"), 0);
+}
+
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST(ConvCpuKernelUtil, DISABLED_benchmark_resnet_shapes) {
+  ScopedGlobalThreadPool thread_pool(0);
+  // batch, in channels, height, width, out channels, kernel, stride, pad
+  const std::vector<std::array<int64_t, 8>> cases = {
+      {8, 64, 56, 56, 64, 3, 1, 1},     {8, 64, 56, 56, 256, 1, 1, 0},
+      {8, 128, 28, 28, 128, 3, 1, 1},   {8, 256, 56, 56, 128, 1, 2, 0},
+      {8, 256, 14, 14, 256, 3, 1, 1},   {8, 3, 224, 224, 64, 7, 2, 3},
+      {32, 512, 7, 7, 512, 3, 1, 1}};
+  for (const auto& c : cases) {
+    for (const bool channels_last : {false, true}) {
+      const Conv2dCpuParams p =
+          MakeParams(c[0], c[1], c[2], c[3], c[4], c[5], c[6], 1, c[7], channels_last);
+      const std::vector<float> in =
+          RandomFloats(p.batch_num * p.in_channels * p.in_height * p.in_width, 1);
+      const std::vector<float> weight =
+          RandomFloats(p.out_channels * p.in_channels * p.kernel_height * p.kernel_width, 2);
+      std::vector<float> out(p.batch_num * p.out_channels * p.out_height * p.out_width);
+      std::vector<char> workspace(ConvCpuKernelUtil<float>::GetMaxWorkspaceSize(p));
+      std::ostringstream oss;
+      oss << (channels_last ? "NHWC " : "NCHW ") << c[0] << "x" << c[1] << "x" << c[2] << "x"
+          << c[3] << " -> " << c[4] << " k" << c[5] << " s" << c[6] << ":";
+      for (const ConvCpuAlgo algo : kAlgos) {
+        if (!ConvCpuKernelUtil<float>::IsSupported(algo, p)) { continue; }
+        const int32_t iter_num = 3;
+        const auto start = std::chrono::steady_clock::now();
+        FOR_RANGE(int32_t, i, 0, iter_num) {
+          ConvCpuKernelUtil<float>::Forward(algo, p, in.data(), weight.data(), nullptr,
+                                            out.data(), workspace.data());
+        }
+        const double ms = std::chrono::duration<double, std::milli>(
+                              std::chrono::steady_clock::now() - start)
+                              .count()
+                          / iter_num;
+        oss << " algo " << static_cast<int>(algo) << " " << ms << " ms";
+      }
+      LOG(INFO) << oss.str();
+    }
+  }
+}
+
+}  // namespace test
+
+}  // namespace oneflow
@@ -17,6 +17,7 @@ limitations under the License.
 #include "oneflow/user/ops/nn_util.h"
 #include "oneflow/core/kernel/new_kernel_util.h"
 #include "oneflow/core/kernel/kernel_util.h"
+#include "oneflow/user/kernels/conv_cpu_kernel_util.h"
 
 namespace oneflow {
 
@@ -291,6 +292,83 @@ struct ConvKernelUtil final {
   }
 };
 
+Shape Gen5DShape(const Shape& shape, int32_t idx_offset) {
+  DimVector ret_vec(shape.dim_vec());
+  int32_t ndims = ret_vec.size() - 2;
+  ret_vec.insert(ret_vec.begin() + idx_offset, 3 - ndims, 1);
+  return Shape(ret_vec);
+}
+
+std::vector<int32_t> Gen3DVec(const std::vector<int32_t>& origin_vec) {
+  std::vector<int32_t> ret_vec = origin_vec;
+  ret_vec.insert(ret_vec.begin(), 3 - ret_vec.size(), 1);
+  return ret_vec;
+}
+
+std::vector<int32_t> GenPadding3DVec(const std::vector<int32_t>& padding_before) {
+  std::vector<int32_t> ret_vec;
+  FOR_RANGE(uint8_t, dim, 0, 3) {
+    int64_t index = static_cast<int64_t>(dim) - (3 - padding_before.size());
+    if (index < 0) {
+      ret_vec.push_back(0);
+    } else {
+      ret_vec.push_back(padding_before.at(index));
+    }
+  }
+  return ret_vec;
+}
+
+// Fills params and returns true when the conv has no depth, as conv1d and conv2d do
+bool GetConv2dCpuParams(const Shape& in_5d_shape, const Shape& out_5d_shape,
+                        const Shape& weight_5d_shape, int32_t idx_offset,
+                        const std::vector<int32_t>& strides_3d,
+                        const std::vector<int32_t>& dilation_rate_3d,
+                        const std::vector<int32_t>& padding_before_3d, Conv2dCpuParams* params) {
+  if (in_5d_shape.At(idx_offset) != 1 || out_5d_shape.At(idx_offset) != 1
+      || weight_5d_shape.At(idx_offset) != 1 || padding_before_3d.at(0) != 0) {
+    return false;
+  }
+  const bool channels_last = idx_offset == 1;
+  const int32_t channel_idx = channels_last ? 4 : 1;
+  params->batch_num = in_5d_shape.At(0);
+  params->in_channels = in_5d_shape.At(channel_idx);
+  params->in_height = in_5d_shape.At(idx_offset + 1);
+  params->in_width = in_5d_shape.At(idx_offset + 2);
+  params->out_channels = out_5d_shape.At(channel_idx);
+  params->out_height = out_5d_shape.At(idx_offset + 1);
+  params->out_width = out_5d_shape.At(idx_offset + 2);
+  params->kernel_height = weight_5d_shape.At(idx_offset + 1);
+  params->kernel_width = weight_5d_shape.At(idx_offset + 2);
+  params->stride_height = strides_3d.at(1);
+  params->stride_width = strides_3d.at(2);
+  params->dilation_height = dilation_rate_3d.at(1);
+  params->dilation_width = dilation_rate_3d.at(2);
+  params->pad_height = padding_before_3d.at(1);
+  params->pad_width = padding_before_3d.at(2);
+  params->channels_last = channels_last;
+  return true;
+}
+
+template<typename T>
+size_t InferConv2dCpuWorkspaceSize(user_op::InferContext* ctx) {
+  const int32_t idx_offset = IdxOffset(ctx->Attr<std::string>("data_format"));
+  const Shape in_5d_shape =
+      Gen5DShape(ctx->TensorDesc4ArgNameAndIndex("in", 0)->shape(), idx_offset);
+  const Shape out_5d_shape =
+      Gen5DShape(ctx->TensorDesc4ArgNameAndIndex("out", 0)->shape(), idx_offset);
+  const Shape weight_5d_shape =
+      Gen5DShape(ctx->TensorDesc4ArgNameAndIndex("weight", 0)->shape(), idx_offset);
+  Conv2dCpuParams params{};
+  if (!GetConv2dCpuParams(in_5d_shape, out_5d_shape, weight_5d_shape, idx_offset,
+                          Gen3DVec(ctx->Attr<std::vector<int32_t>>("strides")),
+                          Gen3DVec(ctx->Attr<std::vector<int32_t>>("dilation_rate")),
+                          GenPadding3DVec(ctx->Attr<std::vector<int32_t>>("padding_before")),
+                          &params)) {
+    return 0;
+  }
+  return ConvCpuKernelUtil<T>::GetMaxWorkspaceSize(params);
+}
+
 template<typename T>
 struct ConvOpKernelState final : public user_op::OpKernelState {
   Im2ColFunc<T> im2col_func_;
@@ -309,6 +387,9 @@ struct ConvOpKernelState final : public user_op::OpKernelState {
   int32_t idx_offset_;
   bool is_dynamic_;
 
+  // The CPU conv algorithm of each input shape, chosen on its first run
+  HashMap<Shape, ConvCpuAlgo> algo_cache_;
+
   void Update(const ShapeView& x_shape, const ShapeView& out_shape) {
     auto Gen5DShape = [](const ShapeView& shape, int32_t idx_offset) -> Shape {
       DimVector ret_vec;
@@ -347,12 +428,6 @@ std::shared_ptr<user_op::OpKernelState> CreateConvOpKernelState(user_op::KernelI
     state->idx_offset_ = 1;
   }
 
-  auto Gen5DShape = [](const Shape& shape, int32_t idx_offset) -> Shape {
-    DimVector ret_vec(shape.dim_vec());
-    int32_t ndims = ret_vec.size() - 2;
-    ret_vec.insert(ret_vec.begin() + idx_offset, 3 - ndims, 1);
-    return Shape(ret_vec);
-  };
   state->in_5d_shape_ =
       Gen5DShape(ctx->TensorDesc4ArgNameAndIndex(in_name, 0)->shape(), state->idx_offset_);
   state->out_5d_shape_ =
@@ -360,23 +435,10 @@ std::shared_ptr<user_op::OpKernelState> CreateConvOpKernelState(user_op::KernelI
   state->weight_5d_shape_ =
       Gen5DShape(ctx->TensorDesc4ArgNameAndIndex(weight_name, 0)->shape(), state->idx_offset_);
 
-  auto Gen3DVec = [](const std::vector<int32_t>& origin_vec) -> std::vector<int32_t> {
-    std::vector<int32_t> ret_vec = origin_vec;
-    ret_vec.insert(ret_vec.begin(), 3 - ret_vec.size(), 1);
-    return ret_vec;
-  };
   state->strides_3d_ = Gen3DVec(ctx->Attr<std::vector<int32_t>>("strides"));
   state->dilation_rate_3d_ = Gen3DVec(ctx->Attr<std::vector<int32_t>>("dilation_rate"));
   state->is_dynamic_ = ctx->TensorDesc4ArgNameAndIndex(in_name, 0)->is_dynamic();
-  const auto& padding_before = ctx->Attr<std::vector<int32_t>>("padding_before");
-  FOR_RANGE(uint8_t, dim, 0, 3) {
-    int64_t index = static_cast<int64_t>(dim) - (3 - padding_before.size());
-    if (index < 0) {
-      state->padding_before_3d_.push_back(0);
-    } else {
-      state->padding_before_3d_.push_back(padding_before.at(index));
-    }
-  }
+  state->padding_before_3d_ = GenPadding3DVec(ctx->Attr<std::vector<int32_t>>("padding_before"));
 
   return std::move(state);
 }
@@ -411,6 +473,28 @@ class ConvCpuKernel final : public user_op::OpKernel {
     auto* conv_state = dynamic_cast<ConvOpKernelState<T>*>(state);
     conv_state->Update(in->shape(), out->shape());
     CHECK_NOTNULL(conv_state);
+    const user_op::Tensor* bias = ctx->Tensor4ArgNameAndIndex("bias", 0);
+    const T* bias_dptr = bias == nullptr ? nullptr : bias->dptr<T>();
+
+    Conv2dCpuParams params{};
+    if (GetConv2dCpuParams(conv_state->in_5d_shape_, conv_state->out_5d_shape_,
+                           conv_state->weight_5d_shape_, conv_state->idx_offset_,
+                           conv_state->strides_3d_, conv_state->dilation_rate_3d_,
+                           conv_state->padding_before_3d_, &params)) {
+      const size_t workspace_size = tmp_buffer->shape().elem_cnt();
+      auto it = conv_state->algo_cache_.find(conv_state->in_5d_shape_);
+      if (it == conv_state->algo_cache_.end()) {
+        const ConvCpuAlgo algo = ConvCpuKernelUtil<T>::SearchAlgo(
+            params, workspace_size, in->dptr<T>(), weight->dptr<T>(), bias_dptr,
+            out->mut_dptr<T>(), tmp_buffer->mut_dptr());
+        it = conv_state->algo_cache_.emplace(conv_state->in_5d_shape_, algo).first;
+      }
+      CHECK_LE(ConvCpuKernelUtil<T>::GetWorkspaceSize(it->second, params), workspace_size);
+      ConvCpuKernelUtil<T>::Forward(it->second, params, in->dptr<T>(), weight->dptr<T>(),
+                                    bias_dptr, out->mut_dptr<T>(), tmp_buffer->mut_dptr());
+      return;
+    }
+
     bool is_bias_mul_inited = false;
     for (int64_t i = 0; i < in->shape().At(0); ++i) {
       conv_state->im2col_func_(GetImgDptr<T>(in, i), ShapeView(conv_state->in_5d_shape_),
@@ -430,12 +514,12 @@ class ConvCpuKernel final : public user_op::OpKernel {
           static_cast<T>(1), weight->dptr<T>(), col_buf_dptr, static_cast<T>(0),
           GetImgMutDptr<T>(out, i));
 
-      const user_op::Tensor* bias = ctx->Tensor4ArgNameAndIndex("bias", 0);
       if (bias != nullptr) {
         int64_t num_of_col_buf = CalcElemNumOfColBuf(out->shape(), weight->shape(), idx_offset);
-        int64_t num_of_bias_mul = tmp_buffer->shape().elem_cnt() - num_of_col_buf;
-        CHECK_GT(num_of_bias_mul, 0);
-        T* bias_mul_dptr = col_buf_dptr + num_of_col_buf * sizeof(T);
+        int64_t num_of_bias_mul = conv_state->out_5d_shape_.Count(idx_offset, idx_offset + 3);
+        CHECK_GE(tmp_buffer->shape().elem_cnt(),
+                 static_cast<int64_t>((num_of_col_buf + num_of_bias_mul) * sizeof(T)));
+        T* bias_mul_dptr = col_buf_dptr + num_of_col_buf;
         if (!is_bias_mul_inited) {
           InitBiasMulBuf(bias_mul_dptr, num_of_bias_mul);
           is_bias_mul_inited = true;
@@ -476,7 +560,7 @@ class ConvCpuKernel final : public user_op::OpKernel {
           for (int i = 0; i < ndims; ++i) { bias_mul_cnt *= out_shape.At(idx_offset + i); } \
           tmp_buffer_size += bias_mul_cnt * sizeof(dtype);                                  \
         }                                                                                   \
-        return tmp_buffer_size;                                                             \
+        return std::max(tmp_buffer_size, InferConv2dCpuWorkspaceSize<dtype>(ctx));          \
       })
 
 REGISTER_CONV_KERNEL(conv1d, float, 1);
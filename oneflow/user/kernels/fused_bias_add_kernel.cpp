@@ -0,0 +1,223 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/thread/thread_pool.h"
+
+namespace oneflow {
+
+namespace {
+
+// Elements handled by a task
+constexpr int64_t kTaskElemNum = 1 << 15;
+
+template<typename T>
+struct GeluFunctor {
+  T Compute(T x, int64_t i) const {
+    return static_cast<T>(0.5) * x
+           * (static_cast<T>(1.0) + std::erf(static_cast<T>(M_SQRT1_2) * x));
+  }
+};
+
+template<typename T>
+struct MaskAndScaleFunctor {
+  MaskAndScaleFunctor(const int8_t* mask, float scale) : mask(mask), scale(scale) {}
+  T Compute(T x, int64_t i) const { return x * static_cast<T>(mask[i]) * scale; }
+  const int8_t* mask;
+  float scale;
+};
+
+template<typename T>
+struct MaskAndScaleAddFunctor {
+  MaskAndScaleAddFunctor(const int8_t* mask, const T* addend, float scale)
+      : mask(mask), addend(addend), scale(scale) {}
+  T Compute(T x, int64_t i) const { return x * static_cast<T>(mask[i]) * scale + addend[i]; }
+  const int8_t* mask;
+  const T* addend;
+  float scale;
+};
+
+template<typename T>
+struct GeluGradFunctor {
+  const T coef = std::sqrt(static_cast<T>(2.0) / std::acos(static_cast<T>(-1.0)));
+  T Compute(T x, T dy, int64_t i) const {
+    return static_cast<T>(0.5)
+           * (static_cast<T>(1.0) + std::erf(static_cast<T>(M_SQRT1_2) * x)
+              + x * coef * std::exp(static_cast<T>(-0.5) * x * x))
+           * dy;
+  }
+};
+
+// Runs DoRow(bias_begin, bias_step, offset, n) over the rows of x, element j of a row being
+// x[offset + j] and its bias bias[bias_begin + j * bias_step]. With inner_size 1 a row spans the
+// whole bias, otherwise it is inner_size elements sharing one bias element.
+void ParallelForRows(int64_t outer_size, int64_t bias_size, int64_t inner_size,
+                     const std::function<void(int64_t, int64_t, int64_t, int64_t)>& DoRow) {
+  const bool is_row = inner_size == 1;
+  const int64_t row_num = is_row ? outer_size : outer_size * bias_size;
+  const int64_t row_size = is_row ? bias_size : inner_size;
+  const auto DoRange = [&](int64_t begin, int64_t end) {
+    FOR_RANGE(int64_t, row, begin, end) {
+      if (is_row) {
+        DoRow(0, 1, row * row_size, row_size);
+      } else {
+        DoRow(row % bias_size, 0, row * row_size, row_size);
+      }
+    }
+  };
+  const int64_t grain = std::max<int64_t>(kTaskElemNum / std::max<int64_t>(row_size, 1), 1);
+  ThreadPool* thread_pool = Global<ThreadPool>::Get();
+  if (thread_pool == nullptr || row_num <= grain) {
+    DoRange(0, row_num);
+    return;
+  }
+  thread_pool->ParallelFor(0, row_num, grain, DoRange);
+}
+
+// y = functor(x + bias) in one pass, without materializing x + bias
+template<typename FUNCTOR, typename T>
+void FusedBiasAddForwardImpl(FUNCTOR functor, int64_t outer_size, int64_t bias_size,
+                             int64_t inner_size, const T* x, const T* bias, T* y) {
+  ParallelForRows(outer_size, bias_size, inner_size,
+                  [&](int64_t bias_begin, int64_t bias_step, int64_t offset, int64_t n) {
+                    FOR_RANGE(int64_t, j, 0, n) {
+                      const int64_t i = offset + j;
+                      y[i] = functor.Compute(x[i] + bias[bias_begin + j * bias_step], i);
+                    }
+                  });
+}
+
+template<typename FUNCTOR, typename T>
+void FusedBiasAddGradImpl(FUNCTOR grad_functor, int64_t outer_size, int64_t bias_size,
+                          int64_t inner_size, const T* x, const T* bias, const T* dy, T* dx) {
+  ParallelForRows(outer_size, bias_size, inner_size,
+                  [&](int64_t bias_begin, int64_t bias_step, int64_t offset, int64_t n) {
+                    FOR_RANGE(int64_t, j, 0, n) {
+                      const int64_t i = offset + j;
+                      dx[i] = grad_functor.Compute(x[i] + bias[bias_begin + j * bias_step], dy[i],
+                                                   i);
+                    }
+                  });
+}
+
+}  // namespace
+
+template<typename T>
+class FusedBiasAddGeluCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedBiasAddGeluCpuKernel() = default;
+  ~FusedBiasAddGeluCpuKernel() override = default;
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const auto* a_tensor = ctx->Tensor4ArgNameAndIndex("a", 0);
+    const auto* b_tensor = ctx->Tensor4ArgNameAndIndex("b", 0);
+    auto* out_tensor = ctx->Tensor4ArgNameAndIndex("out", 0);
+    const int32_t bias_add_axis = ctx->Attr<int32_t>("axis");
+    const int64_t outer_size = a_tensor->shape().Count(0, bias_add_axis);
+    const int64_t bias_size = a_tensor->shape().At(bias_add_axis);
+    const int64_t inner_size = a_tensor->shape().Count(bias_add_axis + 1);
+    FusedBiasAddForwardImpl(GeluFunctor<T>(), outer_size, bias_size, inner_size,
+                            a_tensor->dptr<T>(), b_tensor->dptr<T>(), out_tensor->mut_dptr<T>());
+  };
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_FUSED_BIAS_ADD_GELU_CPU_KERNEL(dtype)    \
+  REGISTER_USER_KERNEL("fused_bias_add_gelu")             \
+      .SetCreateFn<FusedBiasAddGeluCpuKernel<dtype>>()    \
+      .SetIsMatchedHob((user_op::HobDeviceTag() == "cpu") \
+                       & (user_op::HobDataType("out", 0) == GetDataType<dtype>::value));
+
+REGISTER_FUSED_BIAS_ADD_GELU_CPU_KERNEL(float)
+REGISTER_FUSED_BIAS_ADD_GELU_CPU_KERNEL(double)
+
+template<typename T>
+class FusedBiasAddMaskScaleCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedBiasAddMaskScaleCpuKernel() = default;
+  ~FusedBiasAddMaskScaleCpuKernel() override = default;
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const auto* a_tensor = ctx->Tensor4ArgNameAndIndex("a", 0);
+    const auto* b_tensor = ctx->Tensor4ArgNameAndIndex("b", 0);
+    const auto* mask_tensor = ctx->Tensor4ArgNameAndIndex("mask", 0);
+    auto* out_tensor = ctx->Tensor4ArgNameAndIndex("out", 0);
+    const int32_t bias_add_axis = ctx->Attr<int32_t>("axis");
+    const float scale = ctx->Attr<float>("scale");
+    const int64_t outer_size = a_tensor->shape().Count(0, bias_add_axis);
+    const int64_t bias_size = a_tensor->shape().At(bias_add_axis);
+    const int64_t inner_size = a_tensor->shape().Count(bias_add_axis + 1);
+    if (ctx->has_input("_add_to_output", 0)) {
+      const user_op::Tensor* addend = ctx->Tensor4ArgNameAndIndex("_add_to_output", 0);
+      FusedBiasAddForwardImpl(
+          MaskAndScaleAddFunctor<T>(mask_tensor->dptr<int8_t>(), addend->dptr<T>(), scale),
+          outer_size, bias_size, inner_size, a_tensor->dptr<T>(), b_tensor->dptr<T>(),
+          out_tensor->mut_dptr<T>());
+    } else {
+      FusedBiasAddForwardImpl(MaskAndScaleFunctor<T>(mask_tensor->dptr<int8_t>(), scale),
+                              outer_size, bias_size, inner_size, a_tensor->dptr<T>(),
+                              b_tensor->dptr<T>(), out_tensor->mut_dptr<T>());
+    }
+  };
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_FUSED_BIAS_ADD_MASK_SCALE_CPU_KERNEL(dtype) \
+  REGISTER_USER_KERNEL("fused_bias_add_mask_scale")          \
+      .SetCreateFn<FusedBiasAddMaskScaleCpuKernel<dtype>>()  \
+      .SetIsMatchedHob((user_op::HobDeviceTag() == "cpu")    \
+                       & (user_op::HobDataType("out", 0) == GetDataType<dtype>::value));
+
+REGISTER_FUSED_BIAS_ADD_MASK_SCALE_CPU_KERNEL(float)
+REGISTER_FUSED_BIAS_ADD_MASK_SCALE_CPU_KERNEL(double)
+
+template<typename T>
+class FusedBiasAddGeluGradCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedBiasAddGeluGradCpuKernel() = default;
+  ~FusedBiasAddGeluGradCpuKernel() override = default;
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const auto* a_tensor = ctx->Tensor4ArgNameAndIndex("a", 0);
+    const auto* b_tensor = ctx->Tensor4ArgNameAndIndex("b", 0);
+    const auto* dy_tensor = ctx->Tensor4ArgNameAndIndex("dy", 0);
+    auto* dx_tensor = ctx->Tensor4ArgNameAndIndex("dx", 0);
+    const int32_t bias_add_axis = ctx->Attr<int32_t>("axis");
+    const int64_t outer_size = a_tensor->shape().Count(0, bias_add_axis);
+    const int64_t bias_size = a_tensor->shape().At(bias_add_axis);
+    const int64_t inner_size = a_tensor->shape().Count(bias_add_axis + 1);
+    FusedBiasAddGradImpl(GeluGradFunctor<T>(), outer_size, bias_size, inner_size,
+                         a_tensor->dptr<T>(), b_tensor->dptr<T>(), dy_tensor->dptr<T>(),
+                         dx_tensor->mut_dptr<T>());
+  };
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_FUSED_BIAS_ADD_GELU_GRAD_CPU_KERNEL(dtype)  \
+  REGISTER_USER_KERNEL("fused_bias_add_gelu_grad")           \
+      .SetCreateFn<FusedBiasAddGeluGradCpuKernel<dtype>>()   \
+      .SetIsMatchedHob((user_op::HobDeviceTag() == "cpu")    \
+                       & (user_op::HobDataType("dx", 0) == GetDataType<dtype>::value));
+
+REGISTER_FUSED_BIAS_ADD_GELU_GRAD_CPU_KERNEL(float)
+REGISTER_FUSED_BIAS_ADD_GELU_GRAD_CPU_KERNEL(double)
+
+}  // namespace oneflow
@@ -0,0 +1,168 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/common/blas.h"
+#include "oneflow/core/thread/thread_pool.h"
+
+namespace oneflow {
+
+namespace {
+
+// Multiply-adds a task does at least
+constexpr int64_t kTaskFlops = 1 << 18;
+
+// hidden_states is (seq_len, batch_size, num_heads, 3, head_size). Each (batch, head) pair is a
+// task that reads its own query, key and value and writes its own slices, so that nothing is
+// sliced or transposed through a tmp buffer.
+struct SelfAttentionParams final {
+  int64_t seq_len;
+  int64_t batch_size;
+  int64_t num_heads;
+  int64_t head_size;
+
+  int64_t pair_num() const { return batch_size * num_heads; }
+  // Elements between two sequence positions of hidden_states
+  int64_t ld() const { return pair_num() * 3 * head_size; }
+  // Offset of the query of a (batch, head) pair, its key and value follow it
+  int64_t query_offset(int64_t pair) const { return pair * 3 * head_size; }
+};
+
+template<typename T>
+void Gemm(enum CBLAS_TRANSPOSE trans_a, enum CBLAS_TRANSPOSE trans_b, int64_t m, int64_t n,
+          int64_t k, T alpha, const T* a, int64_t lda, const T* b, int64_t ldb, T* c,
+          int64_t ldc) {
+  cblas_gemm<T>(CblasRowMajor, trans_a, trans_b, static_cast<int>(m), static_cast<int>(n),
+                static_cast<int>(k), alpha, a, static_cast<int>(lda), b, static_cast<int>(ldb),
+                static_cast<T>(0), c, static_cast<int>(ldc));
+}
+
+void ParallelForPairs(const SelfAttentionParams& p, int64_t pair_flops,
+                      const std::function<void(int64_t)>& DoPair) {
+  const auto DoRange = [&](int64_t begin, int64_t end) {
+    FOR_RANGE(int64_t, pair, begin, end) { DoPair(pair); }
+  };
+  const int64_t grain = std::max<int64_t>(kTaskFlops / std::max<int64_t>(pair_flops, 1), 1);
+  ThreadPool* thread_pool = Global<ThreadPool>::Get();
+  if (thread_pool == nullptr || p.pair_num() <= grain) {
+    DoRange(0, p.pair_num());
+    return;
+  }
+  thread_pool->ParallelFor(0, p.pair_num(), grain, DoRange);
+}
+
+// query_mul_key = alpha * q * k^T of shape (b, n, s, s), value of shape (b, n, s, h)
+template<typename T>
+void SelfAttentionForward(const SelfAttentionParams& p, T alpha, const T* hidden_states,
+                          T* query_mul_key, T* value) {
+  const int64_t s = p.seq_len;
+  const int64_t h = p.head_size;
+  ParallelForPairs(p, s * s * h, [&](int64_t pair) {
+    const T* q = hidden_states + p.query_offset(pair);
+    Gemm<T>(CblasNoTrans, CblasTrans, s, s, h, alpha, q, p.ld(), q + h, p.ld(),
+            query_mul_key + pair * s * s, s);
+    T* value_pair = value + pair * s * h;
+    FOR_RANGE(int64_t, i, 0, s) { std::copy_n(q + i * p.ld() + 2 * h, h, value_pair + i * h); }
+  });
+}
+
+// grad_q = alpha * grad_qmk * k, grad_k = alpha * grad_qmk^T * q and grad_v = value_grad, each
+// written into its slice of hidden_states_grad
+template<typename T>
+void SelfAttentionBackward(const SelfAttentionParams& p, T alpha, const T* query_mul_key_grad,
+                           const T* value_grad, const T* hidden_states, T* hidden_states_grad) {
+  const int64_t s = p.seq_len;
+  const int64_t h = p.head_size;
+  ParallelForPairs(p, 2 * s * s * h, [&](int64_t pair) {
+    const T* q = hidden_states + p.query_offset(pair);
+    const T* qmk_grad = query_mul_key_grad + pair * s * s;
+    T* q_grad = hidden_states_grad + p.query_offset(pair);
+    Gemm<T>(CblasNoTrans, CblasNoTrans, s, h, s, alpha, qmk_grad, s, q + h, p.ld(), q_grad,
+            p.ld());
+    Gemm<T>(CblasTrans, CblasNoTrans, s, h, s, alpha, qmk_grad, s, q, p.ld(), q_grad + h, p.ld());
+    const T* value_grad_pair = value_grad + pair * s * h;
+    FOR_RANGE(int64_t, i, 0, s) {
+      std::copy_n(value_grad_pair + i * h, h, q_grad + i * p.ld() + 2 * h);
+    }
+  });
+}
+
+}  // namespace
+
+template<typename T>
+class FusedSelfAttentionQueryMulKeyAndValueCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedSelfAttentionQueryMulKeyAndValueCpuKernel() = default;
+  ~FusedSelfAttentionQueryMulKeyAndValueCpuKernel() override = default;
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* h_tensor = ctx->Tensor4ArgNameAndIndex("hidden_states", 0);
+    user_op::Tensor* qmk_tensor = ctx->Tensor4ArgNameAndIndex("query_mul_key", 0);
+    user_op::Tensor* v_tensor = ctx->Tensor4ArgNameAndIndex("value", 0);
+    SelfAttentionParams params{};
+    params.seq_len = h_tensor->shape().At(0);
+    params.batch_size = h_tensor->shape().At(1);
+    params.head_size = ctx->Attr<int64_t>("head_size");
+    params.num_heads = h_tensor->shape().At(2) / (3 * params.head_size);
+    SelfAttentionForward<T>(params, static_cast<T>(ctx->Attr<float>("alpha")), h_tensor->dptr<T>(),
+                            qmk_tensor->mut_dptr<T>(), v_tensor->mut_dptr<T>());
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+template<typename T>
+class FusedSelfAttentionQueryMulKeyAndValueGradCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedSelfAttentionQueryMulKeyAndValueGradCpuKernel() = default;
+  ~FusedSelfAttentionQueryMulKeyAndValueGradCpuKernel() override = default;
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* v_grad_tensor = ctx->Tensor4ArgNameAndIndex("value_grad", 0);
+    const user_op::Tensor* qmk_grad_tensor = ctx->Tensor4ArgNameAndIndex("query_mul_key_grad", 0);
+    const user_op::Tensor* h_tensor = ctx->Tensor4ArgNameAndIndex("hidden_states", 0);
+    user_op::Tensor* h_grad_tensor = ctx->Tensor4ArgNameAndIndex("hidden_states_grad", 0);
+    SelfAttentionParams params{};
+    params.seq_len = h_grad_tensor->shape().At(0);
+    params.batch_size = h_grad_tensor->shape().At(1);
+    params.num_heads = v_grad_tensor->shape().At(1);
+    params.head_size = v_grad_tensor->shape().At(3);
+    CHECK_EQ(h_grad_tensor->shape().At(2), params.num_heads * 3 * params.head_size);
+    SelfAttentionBackward<T>(params, static_cast<T>(ctx->Attr<float>("alpha")),
+                             qmk_grad_tensor->dptr<T>(), v_grad_tensor->dptr<T>(),
+                             h_tensor->dptr<T>(), h_grad_tensor->mut_dptr<T>());
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_FUSED_SELF_ATTENTION_QUERY_MUL_KEY_AND_VALUE_CPU_KERNEL(dtype) \
+  REGISTER_USER_KERNEL("fused_self_attention_query_mul_key_and_value")          \
+      .SetCreateFn<FusedSelfAttentionQueryMulKeyAndValueCpuKernel<dtype>>()     \
+      .SetIsMatchedHob((user_op::HobDeviceTag() == DeviceType::kCPU)            \
+                       & (user_op::HobDataType("hidden_states", 0) == GetDataType<dtype>::value));
+
+#define REGISTER_FUSED_SELF_ATTENTION_QUERY_MUL_KEY_AND_VALUE_GRAD_CPU_KERNEL(dtype) \
+  REGISTER_USER_KERNEL("fused_self_attention_query_mul_key_and_value_grad")          \
+      .SetCreateFn<FusedSelfAttentionQueryMulKeyAndValueGradCpuKernel<dtype>>()      \
+      .SetIsMatchedHob((user_op::HobDeviceTag() == DeviceType::kCPU)                 \
+                       & (user_op::HobDataType("hidden_states", 0) == GetDataType<dtype>::value));
+
+REGISTER_FUSED_SELF_ATTENTION_QUERY_MUL_KEY_AND_VALUE_CPU_KERNEL(float)
+REGISTER_FUSED_SELF_ATTENTION_QUERY_MUL_KEY_AND_VALUE_CPU_KERNEL(double)
+REGISTER_FUSED_SELF_ATTENTION_QUERY_MUL_KEY_AND_VALUE_GRAD_CPU_KERNEL(float)
+REGISTER_FUSED_SELF_ATTENTION_QUERY_MUL_KEY_AND_VALUE_GRAD_CPU_KERNEL(double)
+
+}  // namespace oneflow
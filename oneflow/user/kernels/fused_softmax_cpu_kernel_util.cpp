@@ -0,0 +1,189 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/fused_softmax_cpu_kernel_util.h"
+#include "oneflow/core/common/cpu_isa.h"
+#include "oneflow/core/thread/thread_pool.h"
+
+namespace oneflow {
+
+namespace {
+
+// Elements handled by a task
+constexpr int64_t kTaskElemNum = 1 << 15;
+
+// exp by 2^n * p(r), with x = n * ln2 + r, |r| <= ln2 / 2 and the polynomial of Cephes expf.
+// Branch free so that the loops calling it vectorize, 0 below the smallest normal result.
+ALWAYS_INLINE inline float VecExp(float x) {
+  constexpr float kMin = -87.33654f;
+  constexpr float kMax = 88.72283f;
+  const float clamped = std::min(std::max(x, kMin), kMax);
+  // Adding and subtracting 1.5 * 2^23 rounds to the nearest integer
+  const float n = (clamped * 1.44269504f + 12582912.f) - 12582912.f;
+  const float r = clamped - n * 0.693359375f + n * 2.12194440e-4f;
+  float p = 1.9875691500e-4f;
+  p = p * r + 1.3981999507e-3f;
+  p = p * r + 8.3334519073e-3f;
+  p = p * r + 4.1665795894e-2f;
+  p = p * r + 1.6666665459e-1f;
+  p = p * r + 5.0000001201e-1f;
+  p = p * r * r + r + 1.f;
+  const int32_t bits = (static_cast<int32_t>(n) + 127) << 23;
+  float pow2n;
+  std::memcpy(&pow2n, &bits, sizeof(float));
+  return x < kMin ? 0.f : p * pow2n;
+}
+
+ALWAYS_INLINE inline double VecExp(double x) { return std::exp(x); }
+
+// softmax_y and y of a row whose columns from valid_cols on are the fill value
+template<typename T>
+ALWAYS_INLINE inline void ForwardRow(const T* x, const int8_t* mask, int64_t cols,
+                                     int64_t valid_cols, T fill, T tril_scale, T mask_scale, T* y,
+                                     T* softmax_y) {
+  T max = valid_cols < cols ? fill : -std::numeric_limits<T>::infinity();
+  for (int64_t i = 0; i < valid_cols; ++i) { max = std::max(max, x[i] * tril_scale); }
+  T sum = 0;
+  for (int64_t i = 0; i < valid_cols; ++i) {
+    const T e = VecExp(x[i] * tril_scale - max);
+    softmax_y[i] = e;
+    sum += e;
+  }
+  // Also 0 for a fill of -inf
+  const T fill_exp = std::exp(fill - max);
+  sum += fill_exp * (cols - valid_cols);
+  const T inv_sum = static_cast<T>(1) / sum;
+  for (int64_t i = 0; i < valid_cols; ++i) {
+    const T p = softmax_y[i] * inv_sum;
+    softmax_y[i] = p;
+    y[i] = p * mask[i] * mask_scale;
+  }
+  const T fill_p = fill_exp * inv_sum;
+  for (int64_t i = valid_cols; i < cols; ++i) {
+    softmax_y[i] = fill_p;
+    y[i] = fill_p * mask[i] * mask_scale;
+  }
+}
+
+template<typename T>
+ALWAYS_INLINE inline void BackwardRow(const T* softmax_y, const T* dy, const int8_t* mask,
+                                      int64_t cols, int64_t valid_cols, T tril_scale,
+                                      T mask_scale, T* dx) {
+  T dot = 0;
+  for (int64_t i = 0; i < cols; ++i) { dot += dy[i] * mask[i] * softmax_y[i]; }
+  dot *= mask_scale;
+  for (int64_t i = 0; i < valid_cols; ++i) {
+    dx[i] = tril_scale * softmax_y[i] * (dy[i] * mask[i] * mask_scale - dot);
+  }
+  std::fill(dx + valid_cols, dx + cols, static_cast<T>(0));
+}
+
+#define DEFINE_FUSED_SOFTMAX_ISA_KERNELS(suffix, target)                                        \
+  template<typename T>                                                                          \
+  target void ForwardRow##suffix(const T* x, const int8_t* mask, int64_t cols,                  \
+                                 int64_t valid_cols, T fill, T tril_scale, T mask_scale, T* y,  \
+                                 T* softmax_y) {                                                \
+    ForwardRow<T>(x, mask, cols, valid_cols, fill, tril_scale, mask_scale, y, softmax_y);       \
+  }                                                                                             \
+  template<typename T>                                                                          \
+  target void BackwardRow##suffix(const T* softmax_y, const T* dy, const int8_t* mask,          \
+                                  int64_t cols, int64_t valid_cols, T tril_scale,               \
+                                  T mask_scale, T* dx) {                                        \
+    BackwardRow<T>(softmax_y, dy, mask, cols, valid_cols, tril_scale, mask_scale, dx);          \
+  }
+DEFINE_FUSED_SOFTMAX_ISA_KERNELS(Default, )
+#ifdef OF_CPU_ISA_DISPATCH_ENABLED
+DEFINE_FUSED_SOFTMAX_ISA_KERNELS(Avx2, OF_CPU_TARGET_AVX2)
+DEFINE_FUSED_SOFTMAX_ISA_KERNELS(Avx512, OF_CPU_TARGET_AVX512)
+#endif
+#undef DEFINE_FUSED_SOFTMAX_ISA_KERNELS
+
+#ifdef OF_CPU_ISA_DISPATCH_ENABLED
+#define OF_FUSED_SOFTMAX_ISA_CASES(func)         \
+  case CpuIsa::kAvx512: return &func##Avx512<T>; \
+  case CpuIsa::kAvx2: return &func##Avx2<T>;
+#else
+#define OF_FUSED_SOFTMAX_ISA_CASES(func)
+#endif
+#define DEFINE_FUSED_SOFTMAX_ISA_GETTER(func)  \
+  template<typename T>                         \
+  decltype(&func##Default<T>) Get##func() {    \
+    switch (GetCpuIsa()) {                     \
+      OF_FUSED_SOFTMAX_ISA_CASES(func)         \
+      default: return &func##Default<T>;       \
+    }                                          \
+  }
+DEFINE_FUSED_SOFTMAX_ISA_GETTER(ForwardRow)
+DEFINE_FUSED_SOFTMAX_ISA_GETTER(BackwardRow)
+#undef DEFINE_FUSED_SOFTMAX_ISA_GETTER
+#undef OF_FUSED_SOFTMAX_ISA_CASES
+
+// Columns of row that are at or below the diagonal
+int64_t GetValidCols(int64_t row, int64_t cols, int64_t tril_num_rows, int64_t diagonal) {
+  return std::min(std::max<int64_t>(row % tril_num_rows + diagonal + 1, 0), cols);
+}
+
+// Runs DoEachRange over [0, rows) in ranges of about kTaskElemNum elements
+void ParallelForRows(int64_t rows, int64_t cols,
+                     const std::function<void(int64_t, int64_t)>& DoEachRange) {
+  const int64_t grain = std::max<int64_t>(kTaskElemNum / std::max<int64_t>(cols, 1), 1);
+  ThreadPool* thread_pool = Global<ThreadPool>::Get();
+  if (thread_pool == nullptr || rows <= grain) {
+    DoEachRange(0, rows);
+    return;
+  }
+  thread_pool->ParallelFor(0, rows, grain, DoEachRange);
+}
+
+}  // namespace
+
+template<typename T>
+void TrilScaleSoftmaxMaskScaleCpuKernelUtil<T>::Forward(int64_t rows, int64_t cols,
+                                                        int64_t tril_num_rows, int64_t diagonal,
+                                                        T fill, T tril_scale, T mask_scale,
+                                                        const T* x, const int8_t* mask, T* y,
+                                                        T* softmax_y) {
+  const auto forward_row = GetForwardRow<T>();
+  ParallelForRows(rows, cols, [&](int64_t begin, int64_t end) {
+    FOR_RANGE(int64_t, row, begin, end) {
+      const int64_t offset = row * cols;
+      forward_row(x + offset, mask + offset, cols,
+                  GetValidCols(row, cols, tril_num_rows, diagonal), fill, tril_scale, mask_scale,
+                  y + offset, softmax_y + offset);
+    }
+  });
+}
+
+template<typename T>
+void TrilScaleSoftmaxMaskScaleCpuKernelUtil<T>::Backward(int64_t rows, int64_t cols,
+                                                         int64_t tril_num_rows, int64_t diagonal,
+                                                         T tril_scale, T mask_scale,
+                                                         const T* softmax_y, const T* dy,
+                                                         const int8_t* mask, T* dx) {
+  const auto backward_row = GetBackwardRow<T>();
+  ParallelForRows(rows, cols, [&](int64_t begin, int64_t end) {
+    FOR_RANGE(int64_t, row, begin, end) {
+      const int64_t offset = row * cols;
+      backward_row(softmax_y + offset, dy + offset, mask + offset, cols,
+                   GetValidCols(row, cols, tril_num_rows, diagonal), tril_scale, mask_scale,
+                   dx + offset);
+    }
+  });
+}
+
+template struct TrilScaleSoftmaxMaskScaleCpuKernelUtil<float>;
+template struct TrilScaleSoftmaxMaskScaleCpuKernelUtil<double>;
+
+}  // namespace oneflow
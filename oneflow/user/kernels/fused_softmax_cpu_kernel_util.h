@@ -0,0 +1,40 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_FUSED_SOFTMAX_CPU_KERNEL_UTIL_H_
+#define ONEFLOW_USER_KERNELS_FUSED_SOFTMAX_CPU_KERNEL_UTIL_H_
+
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+// Softmax over rows of cols elements where the columns above the diagonal of each
+// (tril_num_rows, cols) matrix are replaced by fill and the rest are scaled by tril_scale,
+// followed by y = softmax_y * mask * mask_scale. Each row is done in one go while it is in cache.
+template<typename T>
+struct TrilScaleSoftmaxMaskScaleCpuKernelUtil final {
+  static void Forward(int64_t rows, int64_t cols, int64_t tril_num_rows, int64_t diagonal,
+                      T fill, T tril_scale, T mask_scale, const T* x, const int8_t* mask, T* y,
+                      T* softmax_y);
+  // dx = tril_scale * softmax_y * (dy' - sum(dy' * softmax_y)) below the diagonal and 0 above,
+  // with dy' = dy * mask * mask_scale
+  static void Backward(int64_t rows, int64_t cols, int64_t tril_num_rows, int64_t diagonal,
+                       T tril_scale, T mask_scale, const T* softmax_y, const T* dy,
+                       const int8_t* mask, T* dx);
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_FUSED_SOFTMAX_CPU_KERNEL_UTIL_H_
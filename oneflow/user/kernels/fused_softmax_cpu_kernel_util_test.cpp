@@ -0,0 +1,188 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/fused_softmax_cpu_kernel_util.h"
+#include "oneflow/core/kernel/cpu_kernel_test_util.h"
+#include <gtest/gtest.h>
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+std::vector<int8_t> RandomMask(int64_t elem_num, int64_t seed) {
+  std::mt19937 gen(seed);
+  std::vector<int8_t> mask(elem_num);
+  for (int8_t& m : mask) { m = gen() % 4 != 0; }
+  return mask;
+}
+
+// tril, scale, softmax and mask scale one after another, as the unfused ops do
+struct Reference final {
+  Reference(int64_t rows, int64_t cols, int64_t tril_num_rows, int64_t diagonal, float fill,
+            float tril_scale, float mask_scale, const std::vector<float>& x,
+            const std::vector<int8_t>& mask)
+      : y(rows * cols), softmax_y(rows * cols) {
+    std::vector<double> tril(rows * cols);
+    FOR_RANGE(int64_t, row, 0, rows) {
+      FOR_RANGE(int64_t, col, 0, cols) {
+        const int64_t i = row * cols + col;
+        tril.at(i) = col > row % tril_num_rows + diagonal ? fill : x.at(i) * tril_scale;
+      }
+    }
+    FOR_RANGE(int64_t, row, 0, rows) {
+      const double* tril_row = tril.data() + row * cols;
+      const double max = *std::max_element(tril_row, tril_row + cols);
+      double sum = 0;
+      FOR_RANGE(int64_t, col, 0, cols) { sum += std::exp(tril_row[col] - max); }
+      FOR_RANGE(int64_t, col, 0, cols) {
+        const int64_t i = row * cols + col;
+        softmax_y.at(i) = std::exp(tril_row[col] - max) / sum;
+        y.at(i) = softmax_y.at(i) * mask.at(i) * mask_scale;
+      }
+    }
+  }
+
+  std::vector<double> y;
+  std::vector<double> softmax_y;
+};
+
+}  // namespace
+
+TEST(TrilScaleSoftmaxMaskScaleCpuKernelUtil, match_reference) {
+  ScopedGlobalThreadPool thread_pool;
+  using Util = TrilScaleSoftmaxMaskScaleCpuKernelUtil<float>;
+  // batch, tril rows, cols
+  const std::vector<std::array<int64_t, 3>> shapes = {
+      {1, 1, 1}, {2, 7, 7}, {3, 16, 16}, {2, 33, 33}, {4, 8, 100}, {8, 128, 128}};
+  for (const auto& shape : shapes) {
+    for (const int64_t diagonal : {-1, 0, 2}) {
+      for (const float fill : {-10000.f, 0.f}) {
+        const int64_t rows = shape[0] * shape[1];
+        const int64_t cols = shape[2];
+        const float tril_scale = 0.125;
+        const float mask_scale = 2;
+        const std::vector<float> x = RandomFloats(rows * cols, 1, -4, 4);
+        const std::vector<int8_t> mask = RandomMask(rows * cols, 2);
+        const Reference ref(rows, cols, shape[1], diagonal, fill, tril_scale, mask_scale, x, mask);
+        std::vector<float> y(rows * cols);
+        std::vector<float> softmax_y(rows * cols);
+        Util::Forward(rows, cols, shape[1], diagonal, fill, tril_scale, mask_scale, x.data(),
+                      mask.data(), y.data(), softmax_y.data());
+        FOR_RANGE(int64_t, i, 0, rows * cols) {
+          ASSERT_NEAR(softmax_y.at(i), ref.softmax_y.at(i), 1e-6 + 1e-5 * ref.softmax_y.at(i));
+          ASSERT_NEAR(y.at(i), ref.y.at(i), 2e-6 + 1e-5 * ref.y.at(i));
+        }
+
+        // dx against the softmax backward of the reference, masked and scaled
+        const std::vector<float> dy = RandomFloats(rows * cols, 3, -4, 4);
+        std::vector<float> dx(rows * cols);
+        Util::Backward(rows, cols, shape[1], diagonal, tril_scale, mask_scale, softmax_y.data(),
+                       dy.data(), mask.data(), dx.data());
+        FOR_RANGE(int64_t, row, 0, rows) {
+          double dot = 0;
+          FOR_RANGE(int64_t, col, 0, cols) {
+            const int64_t i = row * cols + col;
+            dot += static_cast<double>(dy.at(i)) * mask.at(i) * mask_scale * softmax_y.at(i);
+          }
+          FOR_RANGE(int64_t, col, 0, cols) {
+            const int64_t i = row * cols + col;
+            const double expected =
+                col > row % shape[1] + diagonal
+                    ? 0
+                    : tril_scale * softmax_y.at(i) * (dy.at(i) * mask.at(i) * mask_scale - dot);
+            ASSERT_NEAR(dx.at(i), expected, 1e-5 * (1 + std::abs(expected)));
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(TrilScaleSoftmaxMaskScaleCpuKernelUtil, whole_row_filled_with_negative_infinity) {
+  // The first row of diagonal -1 is all fill, and as on GPU its softmax is NaN
+  std::vector<float> x = RandomFloats(4 * 4, 1, -4, 4);
+  std::vector<int8_t> mask(4 * 4, 1);
+  std::vector<float> y(4 * 4);
+  std::vector<float> softmax_y(4 * 4);
+  TrilScaleSoftmaxMaskScaleCpuKernelUtil<float>::Forward(
+      4, 4, 4, -1, -std::numeric_limits<float>::infinity(), 1, 1, x.data(), mask.data(), y.data(),
+      softmax_y.data());
+  ASSERT_TRUE(std::isnan(softmax_y.at(0)));
+  FOR_RANGE(int64_t, row, 1, 4) {
+    float sum = 0;
+    FOR_RANGE(int64_t, col, 0, 4) {
+      if (col >= row) { ASSERT_EQ(softmax_y.at(row * 4 + col), 0); }
+      sum += softmax_y.at(row * 4 + col);
+    }
+    ASSERT_NEAR(sum, 1, 1e-6);
+  }
+}
+
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST(TrilScaleSoftmaxMaskScaleCpuKernelUtil, DISABLED_benchmark_gpt_shapes) {
+  ScopedGlobalThreadPool thread_pool(0);
+  // batch * heads, seq_len
+  for (const auto& shape : std::vector<std::array<int64_t, 2>>{{48, 128}, {48, 512}, {16, 1024}}) {
+    const int64_t rows = shape[0] * shape[1];
+    const int64_t cols = shape[1];
+    const std::vector<float> x = RandomFloats(rows * cols, 1, -4, 4);
+    const std::vector<int8_t> mask = RandomMask(rows * cols, 2);
+    std::vector<float> y(rows * cols);
+    std::vector<float> softmax_y(rows * cols);
+    std::vector<float> tmp(rows * cols);
+    const int32_t iter_num = 5;
+    const auto Time = [&](const std::function<void()>& Run) {
+      const auto start = std::chrono::steady_clock::now();
+      FOR_RANGE(int32_t, i, 0, iter_num) { Run(); }
+      return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+                 .count()
+             / iter_num;
+    };
+    // Separate tril + scale, softmax and mask + scale passes with std::exp
+    const double unfused_ms = Time([&]() {
+      FOR_RANGE(int64_t, row, 0, rows) {
+        FOR_RANGE(int64_t, col, 0, cols) {
+          const int64_t i = row * cols + col;
+          tmp[i] = col > row % shape[1] ? -10000.f : x[i] * 0.125f;
+        }
+      }
+      FOR_RANGE(int64_t, row, 0, rows) {
+        const float* in = tmp.data() + row * cols;
+        float* out = softmax_y.data() + row * cols;
+        const float max = *std::max_element(in, in + cols);
+        float sum = 0;
+        FOR_RANGE(int64_t, col, 0, cols) {
+          out[col] = std::exp(in[col] - max);
+          sum += out[col];
+        }
+        FOR_RANGE(int64_t, col, 0, cols) { out[col] /= sum; }
+      }
+      FOR_RANGE(int64_t, i, 0, rows * cols) { y[i] = softmax_y[i] * mask[i] * 2.f; }
+    });
+    const double fused_ms = Time([&]() {
+      TrilScaleSoftmaxMaskScaleCpuKernelUtil<float>::Forward(rows, cols, shape[1], 0, -10000.f,
+                                                             0.125f, 2.f, x.data(), mask.data(),
+                                                             y.data(), softmax_y.data());
+    });
+    LOG(INFO) << shape[0] << "x" << shape[1] << "x" << cols << ": unfused " << unfused_ms
+              << " ms, fused " << fused_ms << " ms";
+  }
+}
+
+}  // namespace test
+
+}  // namespace oneflow
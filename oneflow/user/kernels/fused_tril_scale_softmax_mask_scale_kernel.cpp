@@ -0,0 +1,92 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/user/kernels/fused_softmax_cpu_kernel_util.h"
+
+namespace oneflow {
+
+template<typename T>
+class FusedTrilScaleSoftmaxMaskScaleCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedTrilScaleSoftmaxMaskScaleCpuKernel() = default;
+  ~FusedTrilScaleSoftmaxMaskScaleCpuKernel() override = default;
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    const user_op::Tensor* mask = ctx->Tensor4ArgNameAndIndex("mask", 0);
+    user_op::Tensor* y = ctx->Tensor4ArgNameAndIndex("y", 0);
+    user_op::Tensor* softmax_y = ctx->Tensor4ArgNameAndIndex("softmax_y", 0);
+    const ShapeView& x_shape = x->shape();
+    CHECK_GE(x_shape.NumAxes(), 2);
+    const int64_t cols = x_shape.At(x_shape.NumAxes() - 1);
+    const int64_t rows = x_shape.Count(0, x_shape.NumAxes() - 1);
+    const int64_t tril_num_rows = x_shape.At(x_shape.NumAxes() - 2);
+    TrilScaleSoftmaxMaskScaleCpuKernelUtil<T>::Forward(
+        rows, cols, tril_num_rows, ctx->Attr<int64_t>("diagonal"),
+        ctx->Attr<float>("tril_fill_value"), ctx->Attr<float>("tril_scale_value"),
+        ctx->Attr<float>("mask_scale_value"), x->dptr<T>(), mask->dptr<int8_t>(),
+        y->mut_dptr<T>(), softmax_y->mut_dptr<T>());
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_FUSED_TRIL_SCALE_SOFTMAX_MASK_SCALE_CPU_KERNEL(dtype) \
+  REGISTER_USER_KERNEL("fused_tril_scale_softmax_mask_scale")          \
+      .SetCreateFn<FusedTrilScaleSoftmaxMaskScaleCpuKernel<dtype>>()   \
+      .SetIsMatchedHob((user_op::HobDeviceTag() == DeviceType::kCPU)   \
+                       & (user_op::HobDataType("y", 0) == GetDataType<dtype>::value));
+
+REGISTER_FUSED_TRIL_SCALE_SOFTMAX_MASK_SCALE_CPU_KERNEL(float)
+REGISTER_FUSED_TRIL_SCALE_SOFTMAX_MASK_SCALE_CPU_KERNEL(double)
+#undef REGISTER_FUSED_TRIL_SCALE_SOFTMAX_MASK_SCALE_CPU_KERNEL
+
+template<typename T>
+class FusedTrilScaleSoftmaxMaskScaleGradCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedTrilScaleSoftmaxMaskScaleGradCpuKernel() = default;
+  ~FusedTrilScaleSoftmaxMaskScaleGradCpuKernel() override = default;
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* softmax_y = ctx->Tensor4ArgNameAndIndex("softmax_y", 0);
+    const user_op::Tensor* dy = ctx->Tensor4ArgNameAndIndex("dy", 0);
+    const user_op::Tensor* mask = ctx->Tensor4ArgNameAndIndex("mask", 0);
+    user_op::Tensor* dx = ctx->Tensor4ArgNameAndIndex("dx", 0);
+    const ShapeView& dy_shape = dy->shape();
+    CHECK_GE(dy_shape.NumAxes(), 2);
+    const int64_t cols = dy_shape.At(dy_shape.NumAxes() - 1);
+    const int64_t rows = dy_shape.Count(0, dy_shape.NumAxes() - 1);
+    const int64_t tril_num_rows = dy_shape.At(dy_shape.NumAxes() - 2);
+    TrilScaleSoftmaxMaskScaleCpuKernelUtil<T>::Backward(
+        rows, cols, tril_num_rows, ctx->Attr<int64_t>("diagonal"),
+        ctx->Attr<float>("tril_scale_value"), ctx->Attr<float>("mask_scale_value"),
+        softmax_y->dptr<T>(), dy->dptr<T>(), mask->dptr<int8_t>(), dx->mut_dptr<T>());
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_FUSED_TRIL_SCALE_SOFTMAX_MASK_SCALE_GRAD_CPU_KERNEL(dtype) \
+  REGISTER_USER_KERNEL("fused_tril_scale_softmax_mask_scale_grad")          \
+      .SetCreateFn<FusedTrilScaleSoftmaxMaskScaleGradCpuKernel<dtype>>()    \
+      .SetIsMatchedHob((user_op::HobDeviceTag() == DeviceType::kCPU)        \
+                       & (user_op::HobDataType("dx", 0) == GetDataType<dtype>::value));
+
+REGISTER_FUSED_TRIL_SCALE_SOFTMAX_MASK_SCALE_GRAD_CPU_KERNEL(float)
+REGISTER_FUSED_TRIL_SCALE_SOFTMAX_MASK_SCALE_GRAD_CPU_KERNEL(double)
+#undef REGISTER_FUSED_TRIL_SCALE_SOFTMAX_MASK_SCALE_GRAD_CPU_KERNEL
+
+}  // namespace oneflow
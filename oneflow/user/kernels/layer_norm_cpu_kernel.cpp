@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/framework/framework.h"
+#include "oneflow/user/kernels/layer_norm_cpu_kernel_util.h"
 
 namespace oneflow {
 
@@ -25,7 +26,40 @@ class LayerNormCpuKernel final : public user_op::OpKernel {
 
  private:
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
-  void Compute(user_op::KernelComputeContext* ctx) const override { TODO(); };
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    user_op::Tensor* y = ctx->Tensor4ArgNameAndIndex("y", 0);
+    user_op::Tensor* mean = ctx->Tensor4ArgNameAndIndex("mean", 0);
+    user_op::Tensor* inv_variance = ctx->Tensor4ArgNameAndIndex("inv_variance", 0);
+    const bool scale = ctx->Attr<bool>("scale");
+    const bool center = ctx->Attr<bool>("center");
+    user_op::Tensor* normalized = scale ? ctx->Tensor4ArgNameAndIndex("normalized", 0) : y;
+    const double epsilon = ctx->Attr<double>("epsilon");
+    const int64_t num_instances = mean->shape().elem_cnt();
+    const int64_t norm_size = x->shape().elem_cnt() / num_instances;
+    int64_t param_size = norm_size;
+    const T* gamma_ptr = nullptr;
+    const T* beta_ptr = nullptr;
+    if (scale) {
+      const user_op::Tensor* gamma = ctx->Tensor4ArgNameAndIndex("gamma", 0);
+      param_size = gamma->shape().elem_cnt();
+      gamma_ptr = gamma->dptr<T>();
+    }
+    if (center) {
+      const user_op::Tensor* beta = ctx->Tensor4ArgNameAndIndex("beta", 0);
+      if (gamma_ptr) {
+        CHECK_EQ(beta->shape().elem_cnt(), param_size);
+      } else {
+        param_size = beta->shape().elem_cnt();
+      }
+      beta_ptr = beta->dptr<T>();
+    }
+    CHECK_EQ(y->shape().elem_cnt() % param_size, 0);
+    LayerNormCpuKernelUtil<T>::Forward(num_instances, norm_size, param_size, epsilon,
+                                       x->dptr<T>(), gamma_ptr, beta_ptr, normalized->mut_dptr<T>(),
+                                       y->mut_dptr<T>(), mean->mut_dptr<T>(),
+                                       inv_variance->mut_dptr<T>());
+  };
 };
 
 #define REGISTER_LAYER_NORM_CPU_KERNEL(dtype)             \
@@ -45,14 +79,39 @@ class LayerNormGradCpuKernel final : public user_op::OpKernel {
 
  private:
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
-  void Compute(user_op::KernelComputeContext* ctx) const override { TODO(); };
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* dy = ctx->Tensor4ArgNameAndIndex("dy", 0);
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    const user_op::Tensor* mean = ctx->Tensor4ArgNameAndIndex("mean", 0);
+    const user_op::Tensor* inv_variance = ctx->Tensor4ArgNameAndIndex("inv_variance", 0);
+    user_op::Tensor* dx = ctx->Tensor4ArgNameAndIndex("dx", 0);
+    const T* add_to_output_ptr = nullptr;
+    if (ctx->has_input("_add_to_output", 0)) {
+      const user_op::Tensor* add_to_output = ctx->Tensor4ArgNameAndIndex("_add_to_output", 0);
+      CHECK_EQ(add_to_output->data_type(), dx->data_type());
+      CHECK_EQ(add_to_output->shape(), dx->shape());
+      add_to_output_ptr = add_to_output->dptr<T>();
+    }
+    const int64_t num_instances = mean->shape().elem_cnt();
+    const int64_t norm_size = x->shape().elem_cnt() / num_instances;
+    LayerNormCpuKernelUtil<T>::Backward(num_instances, norm_size, dy->dptr<T>(), x->dptr<T>(),
+                                        mean->dptr<T>(), inv_variance->dptr<T>(),
+                                        add_to_output_ptr, dx->mut_dptr<T>());
+  };
 };
 
-#define REGISTER_LAYER_NORM_GRAD_CPU_KERNEL(dtype)        \
-  REGISTER_USER_KERNEL("layer_norm_grad")                 \
-      .SetCreateFn<LayerNormGradCpuKernel<dtype>>()       \
-      .SetIsMatchedHob((user_op::HobDeviceTag() == "cpu") \
-                       & (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value));
+#define REGISTER_LAYER_NORM_GRAD_CPU_KERNEL(dtype)                                              \
+  REGISTER_USER_KERNEL("layer_norm_grad")                                                       \
+      .SetCreateFn<LayerNormGradCpuKernel<dtype>>()                                             \
+      .SetIsMatchedHob((user_op::HobDeviceTag() == "cpu")                                       \
+                       & (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value))          \
+      .SetInplaceProposalFn([](const user_op::InferContext& ctx,                                \
+                               user_op::AddInplaceArgPair AddInplaceArgPairFn) -> Maybe<void> { \
+        if (ctx.has_input("_add_to_output", 0)) {                                               \
+          OF_RETURN_IF_ERROR(AddInplaceArgPairFn("dx", 0, "_add_to_output", 0, true));          \
+        }                                                                                       \
+        return Maybe<void>::Ok();                                                               \
+      });
 
 REGISTER_LAYER_NORM_GRAD_CPU_KERNEL(float)
 REGISTER_LAYER_NORM_GRAD_CPU_KERNEL(double)
@@ -65,7 +124,28 @@ class LayerNormParamGradCpuKernel final : public user_op::OpKernel {
 
  private:
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
-  void Compute(user_op::KernelComputeContext* ctx) const override { TODO(); };
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* dy = ctx->Tensor4ArgNameAndIndex("dy", 0);
+    user_op::Tensor* beta_diff = ctx->Tensor4ArgNameAndIndex("beta_diff", 0);
+    user_op::Tensor* gamma_diff = ctx->Tensor4ArgNameAndIndex("gamma_diff", 0);
+    user_op::Tensor* normalized_diff = ctx->Tensor4ArgNameAndIndex("normalized_diff", 0);
+    const user_op::Tensor* gamma = ctx->Tensor4ArgNameAndIndex("gamma", 0);
+    const int64_t begin_params_axis = ctx->Attr<int64_t>("begin_params_axis");
+    const int64_t m = dy->shape().Count(begin_params_axis);
+    const T* normalized_ptr = nullptr;
+    if (beta_diff != nullptr) { CHECK_EQ(m, beta_diff->shape().elem_cnt()); }
+    if (gamma_diff != nullptr) {
+      CHECK_EQ(m, gamma_diff->shape().elem_cnt());
+      normalized_ptr = ctx->Tensor4ArgNameAndIndex("normalized", 0)->dptr<T>();
+    }
+    if (gamma != nullptr) { CHECK_EQ(m, gamma->shape().elem_cnt()); }
+    LayerNormCpuKernelUtil<T>::ParamGrad(
+        dy->shape().elem_cnt(), m, dy->dptr<T>(), normalized_ptr,
+        gamma == nullptr ? nullptr : gamma->dptr<T>(),
+        gamma_diff == nullptr ? nullptr : gamma_diff->mut_dptr<T>(),
+        beta_diff == nullptr ? nullptr : beta_diff->mut_dptr<T>(),
+        normalized_diff == nullptr ? nullptr : normalized_diff->mut_dptr<T>());
+  };
 };
 
 #define REGISTER_LAYER_NORM_PARAM_GRAD_CPU_KERNEL(dtype)  \
@@ -0,0 +1,311 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/layer_norm_cpu_kernel_util.h"
+#include "oneflow/core/ndarray/cpu_reduce_core.h"
+#include "oneflow/core/ndarray/cpu_welford.h"
+
+namespace oneflow {
+
+namespace {
+
+// Independent accumulators of an instance, they are what gets vectorized
+constexpr int64_t kLaneNum = cpu_welford::kLaneNum;
+// Elements handled by a task
+constexpr int64_t kTaskElemNum = 1 << 15;
+// Columns of param grad accumulated together
+constexpr int64_t kColBlockSize = 256;
+
+template<typename T>
+ALWAYS_INLINE inline void NormalizeRow(const T* x, int64_t n, T mean, T inv_variance,
+                                       T* normalized) {
+  for (int64_t i = 0; i < n; ++i) { normalized[i] = (x[i] - mean) * inv_variance; }
+}
+
+template<typename T>
+ALWAYS_INLINE inline void ScaleCenterRow(const T* normalized, int64_t n, const T* gamma,
+                                         const T* beta, T* y) {
+  if (gamma != nullptr && beta != nullptr) {
+    for (int64_t i = 0; i < n; ++i) { y[i] = normalized[i] * gamma[i] + beta[i]; }
+  } else if (gamma != nullptr) {
+    for (int64_t i = 0; i < n; ++i) { y[i] = normalized[i] * gamma[i]; }
+  } else if (beta != nullptr) {
+    for (int64_t i = 0; i < n; ++i) { y[i] = normalized[i] + beta[i]; }
+  }
+}
+
+// Sums of dy and of dy * x_hat over an instance
+template<typename T>
+ALWAYS_INLINE inline void BackwardRowSums(const T* dy, const T* x, int64_t n, T mean,
+                                          T inv_variance, T* sum_dy, T* sum_dy_x_hat) {
+  T lane_dy[kLaneNum] = {};
+  T lane_dy_x_hat[kLaneNum] = {};
+  const int64_t step_num = n / kLaneNum;
+  FOR_RANGE(int64_t, s, 0, step_num) {
+    const T* dy_step = dy + s * kLaneNum;
+    const T* x_step = x + s * kLaneNum;
+    // Kept as a loop, otherwise gcc vectorizes across the steps with shuffles
+#pragma GCC unroll 1
+    for (int64_t j = 0; j < kLaneNum; ++j) {
+      lane_dy[j] += dy_step[j];
+      lane_dy_x_hat[j] += dy_step[j] * (x_step[j] - mean) * inv_variance;
+    }
+  }
+  FOR_RANGE(int64_t, i, step_num * kLaneNum, n) {
+    lane_dy[0] += dy[i];
+    lane_dy_x_hat[0] += dy[i] * (x[i] - mean) * inv_variance;
+  }
+  for (int64_t width = kLaneNum / 2; width > 0; width /= 2) {
+    for (int64_t j = 0; j < width; ++j) {
+      lane_dy[j] += lane_dy[j + width];
+      lane_dy_x_hat[j] += lane_dy_x_hat[j + width];
+    }
+  }
+  *sum_dy = lane_dy[0];
+  *sum_dy_x_hat = lane_dy_x_hat[0];
+}
+
+template<typename T>
+ALWAYS_INLINE inline void BackwardRow(const T* dy, const T* x, int64_t n, T mean, T inv_variance,
+                                      T mean_dy, T mean_dy_x_hat, const T* add_to_output, T* dx) {
+  if (add_to_output != nullptr) {
+    for (int64_t i = 0; i < n; ++i) {
+      const T x_hat = (x[i] - mean) * inv_variance;
+      dx[i] = inv_variance * (dy[i] - mean_dy - x_hat * mean_dy_x_hat) + add_to_output[i];
+    }
+  } else {
+    for (int64_t i = 0; i < n; ++i) {
+      const T x_hat = (x[i] - mean) * inv_variance;
+      dx[i] = inv_variance * (dy[i] - mean_dy - x_hat * mean_dy_x_hat);
+    }
+  }
+}
+
+// Accumulates the rows of a column block of at most kColBlockSize columns into gamma_sum and
+// beta_sum, and writes normalized_diff
+template<typename T>
+ALWAYS_INLINE inline void ParamGradBlock(const T* dy, const T* normalized, const T* gamma,
+                                         int64_t rows, int64_t cols, int64_t row_stride,
+                                         T* gamma_sum, T* beta_sum, T* normalized_diff) {
+  for (int64_t r = 0; r < rows; ++r) {
+    const T* dy_row = dy + r * row_stride;
+    if (gamma_sum != nullptr) {
+      const T* normalized_row = normalized + r * row_stride;
+      for (int64_t c = 0; c < cols; ++c) { gamma_sum[c] += dy_row[c] * normalized_row[c]; }
+    }
+    if (beta_sum != nullptr) {
+      for (int64_t c = 0; c < cols; ++c) { beta_sum[c] += dy_row[c]; }
+    }
+    if (normalized_diff != nullptr) {
+      T* normalized_diff_row = normalized_diff + r * row_stride;
+      if (gamma != nullptr) {
+        for (int64_t c = 0; c < cols; ++c) { normalized_diff_row[c] = dy_row[c] * gamma[c]; }
+      } else {
+        for (int64_t c = 0; c < cols; ++c) { normalized_diff_row[c] = dy_row[c]; }
+      }
+    }
+  }
+}
+
+#define DEFINE_LAYER_NORM_ISA_KERNELS(suffix, target)                                           \
+  template<typename T>                                                                          \
+  target void WelfordRow##suffix(const T* x, int64_t n, T* mean, T* m2) {                       \
+    cpu_welford::Row<T>(x, n, mean, m2);                                                        \
+  }                                                                                             \
+  template<typename T>                                                                          \
+  target void NormalizeRow##suffix(const T* x, int64_t n, T mean, T inv_variance,               \
+                                   T* normalized) {                                             \
+    NormalizeRow<T>(x, n, mean, inv_variance, normalized);                                      \
+  }                                                                                             \
+  template<typename T>                                                                          \
+  target void ScaleCenterRow##suffix(const T* normalized, int64_t n, const T* gamma,            \
+                                     const T* beta, T* y) {                                     \
+    ScaleCenterRow<T>(normalized, n, gamma, beta, y);                                           \
+  }                                                                                             \
+  template<typename T>                                                                          \
+  target void BackwardRowSums##suffix(const T* dy, const T* x, int64_t n, T mean,               \
+                                      T inv_variance, T* sum_dy, T* sum_dy_x_hat) {             \
+    BackwardRowSums<T>(dy, x, n, mean, inv_variance, sum_dy, sum_dy_x_hat);                     \
+  }                                                                                             \
+  template<typename T>                                                                          \
+  target void BackwardRow##suffix(const T* dy, const T* x, int64_t n, T mean, T inv_variance,   \
+                                  T mean_dy, T mean_dy_x_hat, const T* add_to_output, T* dx) {  \
+    BackwardRow<T>(dy, x, n, mean, inv_variance, mean_dy, mean_dy_x_hat, add_to_output, dx);    \
+  }                                                                                             \
+  template<typename T>                                                                          \
+  target void ParamGradBlock##suffix(const T* dy, const T* normalized, const T* gamma,          \
+                                     int64_t rows, int64_t cols, int64_t row_stride,            \
+                                     T* gamma_sum, T* beta_sum, T* normalized_diff) {           \
+    ParamGradBlock<T>(dy, normalized, gamma, rows, cols, row_stride, gamma_sum, beta_sum,       \
+                      normalized_diff);                                                         \
+  }
+DEFINE_LAYER_NORM_ISA_KERNELS(Default, )
+#ifdef OF_CPU_ISA_DISPATCH_ENABLED
+DEFINE_LAYER_NORM_ISA_KERNELS(Avx2, OF_CPU_TARGET_AVX2)
+DEFINE_LAYER_NORM_ISA_KERNELS(Avx512, OF_CPU_TARGET_AVX512)
+#endif
+#undef DEFINE_LAYER_NORM_ISA_KERNELS
+
+#ifdef OF_CPU_ISA_DISPATCH_ENABLED
+#define OF_LAYER_NORM_ISA_CASES(func)                     \
+  case CpuIsa::kAvx512: return &func##Avx512<T>;          \
+  case CpuIsa::kAvx2: return &func##Avx2<T>;
+#else
+#define OF_LAYER_NORM_ISA_CASES(func)
+#endif
+#define DEFINE_LAYER_NORM_ISA_GETTER(func)                \
+  template<typename T>                                    \
+  decltype(&func##Default<T>) Get##func() {               \
+    switch (GetCpuIsa()) {                                \
+      OF_LAYER_NORM_ISA_CASES(func)                       \
+      default: return &func##Default<T>;                  \
+    }                                                     \
+  }
+DEFINE_LAYER_NORM_ISA_GETTER(WelfordRow)
+DEFINE_LAYER_NORM_ISA_GETTER(NormalizeRow)
+DEFINE_LAYER_NORM_ISA_GETTER(ScaleCenterRow)
+DEFINE_LAYER_NORM_ISA_GETTER(BackwardRowSums)
+DEFINE_LAYER_NORM_ISA_GETTER(BackwardRow)
+DEFINE_LAYER_NORM_ISA_GETTER(ParamGradBlock)
+#undef DEFINE_LAYER_NORM_ISA_GETTER
+#undef OF_LAYER_NORM_ISA_CASES
+
+int64_t RoundUpDiv(int64_t n, int64_t d) { return (n + d - 1) / d; }
+
+// Runs DoEachRange over [0, n) in ranges of about kTaskElemNum elements of elem_size each
+void ParallelForElems(int64_t n, int64_t elem_size,
+                      const std::function<void(int64_t, int64_t)>& DoEachRange) {
+  const int64_t grain = std::max<int64_t>(kTaskElemNum / std::max<int64_t>(elem_size, 1), 1);
+  ThreadPool* thread_pool = Global<ThreadPool>::Get();
+  if (thread_pool == nullptr || n <= grain) {
+    DoEachRange(0, n);
+    return;
+  }
+  thread_pool->ParallelFor(0, n, grain, DoEachRange);
+}
+
+}  // namespace
+
+template<typename T>
+void LayerNormCpuKernelUtil<T>::Forward(int64_t num_instances, int64_t norm_size,
+                                        int64_t param_size, double epsilon, const T* x,
+                                        const T* gamma, const T* beta, T* normalized, T* y,
+                                        T* mean, T* inv_variance) {
+  const auto Welford = GetWelfordRow<T>();
+  const auto Normalize = GetNormalizeRow<T>();
+  const auto ScaleCenter = GetScaleCenterRow<T>();
+  const bool has_param = gamma != nullptr || beta != nullptr;
+  // Params covering exactly an instance are applied while the instance is still in cache
+  const bool fuse_param = has_param && param_size == norm_size;
+  ParallelForElems(num_instances, norm_size, [&](int64_t begin, int64_t end) {
+    FOR_RANGE(int64_t, i, begin, end) {
+      const T* x_i = x + i * norm_size;
+      T m2 = 0;
+      Welford(x_i, norm_size, mean + i, &m2);
+      inv_variance[i] = static_cast<T>(
+          1.0 / std::sqrt(static_cast<double>(m2) / norm_size + epsilon));
+      Normalize(x_i, norm_size, mean[i], inv_variance[i], normalized + i * norm_size);
+      if (fuse_param) {
+        ScaleCenter(normalized + i * norm_size, norm_size, gamma, beta, y + i * norm_size);
+      }
+    }
+  });
+  if (has_param && !fuse_param) {
+    const int64_t elem_cnt = num_instances * norm_size;
+    CHECK_EQ(elem_cnt % param_size, 0);
+    ParallelForElems(elem_cnt / param_size, param_size, [&](int64_t begin, int64_t end) {
+      FOR_RANGE(int64_t, r, begin, end) {
+        ScaleCenter(normalized + r * param_size, param_size, gamma, beta, y + r * param_size);
+      }
+    });
+  }
+}
+
+template<typename T>
+void LayerNormCpuKernelUtil<T>::Backward(int64_t num_instances, int64_t norm_size, const T* dy,
+                                         const T* x, const T* mean, const T* inv_variance,
+                                         const T* add_to_output, T* dx) {
+  const auto RowSums = GetBackwardRowSums<T>();
+  const auto Row = GetBackwardRow<T>();
+  ParallelForElems(num_instances, norm_size, [&](int64_t begin, int64_t end) {
+    FOR_RANGE(int64_t, i, begin, end) {
+      const int64_t offset = i * norm_size;
+      T sum_dy = 0;
+      T sum_dy_x_hat = 0;
+      RowSums(dy + offset, x + offset, norm_size, mean[i], inv_variance[i], &sum_dy,
+              &sum_dy_x_hat);
+      Row(dy + offset, x + offset, norm_size, mean[i], inv_variance[i], sum_dy / norm_size,
+          sum_dy_x_hat / norm_size, add_to_output == nullptr ? nullptr : add_to_output + offset,
+          dx + offset);
+    }
+  });
+}
+
+template<typename T>
+void LayerNormCpuKernelUtil<T>::ParamGrad(int64_t elem_cnt, int64_t param_size, const T* dy,
+                                          const T* normalized, const T* gamma, T* gamma_diff,
+                                          T* beta_diff, T* normalized_diff) {
+  CHECK_EQ(elem_cnt % param_size, 0);
+  const auto Block = GetParamGradBlock<T>();
+  const int64_t rows = elem_cnt / param_size;
+  // The chunks only depend on the shape, so results do not depend on the number of threads
+  const int64_t rows_per_chunk = std::max<int64_t>(kTaskElemNum / param_size, 1);
+  const int64_t chunk_num = RoundUpDiv(rows, rows_per_chunk);
+  const int64_t col_block_num = RoundUpDiv(param_size, kColBlockSize);
+  // Per chunk sums, reduced over the chunks at the end
+  std::vector<T> gamma_partials;
+  std::vector<T> beta_partials;
+  T* gamma_sum = gamma_diff;
+  T* beta_sum = beta_diff;
+  if (chunk_num > 1 && gamma_diff != nullptr) {
+    gamma_partials.resize(chunk_num * param_size);
+    gamma_sum = gamma_partials.data();
+  }
+  if (chunk_num > 1 && beta_diff != nullptr) {
+    beta_partials.resize(chunk_num * param_size);
+    beta_sum = beta_partials.data();
+  }
+  const auto DoTask = [&](int64_t task) {
+    const int64_t chunk = task / col_block_num;
+    const int64_t col_begin = (task % col_block_num) * kColBlockSize;
+    const int64_t cols = std::min(param_size - col_begin, kColBlockSize);
+    const int64_t row_begin = chunk * rows_per_chunk;
+    const int64_t row_num = std::min(rows - row_begin, rows_per_chunk);
+    const int64_t offset = row_begin * param_size + col_begin;
+    const int64_t sum_offset = chunk * param_size + col_begin;
+    if (gamma_sum != nullptr) { std::fill_n(gamma_sum + sum_offset, cols, 0); }
+    if (beta_sum != nullptr) { std::fill_n(beta_sum + sum_offset, cols, 0); }
+    Block(dy + offset, normalized == nullptr ? nullptr : normalized + offset,
+          gamma == nullptr ? nullptr : gamma + col_begin, row_num, cols, param_size,
+          gamma_sum == nullptr ? nullptr : gamma_sum + sum_offset,
+          beta_sum == nullptr ? nullptr : beta_sum + sum_offset,
+          normalized_diff == nullptr ? nullptr : normalized_diff + offset);
+  };
+  ParallelForElems(chunk_num * col_block_num, kColBlockSize * rows_per_chunk,
+                   [&](int64_t begin, int64_t end) {
+                     FOR_RANGE(int64_t, task, begin, end) { DoTask(task); }
+                   });
+  if (!gamma_partials.empty()) {
+    CpuReduceCore<T, BinaryFuncAdd>::ColReduce(gamma_diff, gamma_sum, 1, chunk_num, param_size);
+  }
+  if (!beta_partials.empty()) {
+    CpuReduceCore<T, BinaryFuncAdd>::ColReduce(beta_diff, beta_sum, 1, chunk_num, param_size);
+  }
+}
+
+template struct LayerNormCpuKernelUtil<float>;
+template struct LayerNormCpuKernelUtil<double>;
+
+}  // namespace oneflow
@@ -0,0 +1,44 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_LAYER_NORM_CPU_KERNEL_UTIL_H_
+#define ONEFLOW_USER_KERNELS_LAYER_NORM_CPU_KERNEL_UTIL_H_
+
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+// Layer norm of num_instances contiguous instances of norm_size elements. gamma and beta have
+// param_size elements and repeat along the flattened x, either of them may be null.
+template<typename T>
+struct LayerNormCpuKernelUtil final {
+  // mean and inv_variance come from a single Welford pass over each instance. normalized may
+  // alias y.
+  static void Forward(int64_t num_instances, int64_t norm_size, int64_t param_size,
+                      double epsilon, const T* x, const T* gamma, const T* beta, T* normalized,
+                      T* y, T* mean, T* inv_variance);
+  // dx = inv_variance * (dy - mean(dy) - x_hat * mean(dy * x_hat)), plus add_to_output when it
+  // is not null. add_to_output may alias dx.
+  static void Backward(int64_t num_instances, int64_t norm_size, const T* dy, const T* x,
+                       const T* mean, const T* inv_variance, const T* add_to_output, T* dx);
+  // gamma_diff and beta_diff sum dy * normalized and dy over the rows of param_size elements,
+  // normalized_diff = dy * gamma, or dy when gamma is null. Null outputs are skipped.
+  static void ParamGrad(int64_t elem_cnt, int64_t param_size, const T* dy, const T* normalized,
+                        const T* gamma, T* gamma_diff, T* beta_diff, T* normalized_diff);
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_LAYER_NORM_CPU_KERNEL_UTIL_H_
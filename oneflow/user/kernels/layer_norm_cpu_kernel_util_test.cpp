@@ -0,0 +1,226 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/layer_norm_cpu_kernel_util.h"
+#include "oneflow/core/kernel/cpu_kernel_test_util.h"
+#include <gtest/gtest.h>
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+// Two passes in double, as the reference of the float results
+void ReferenceForward(int64_t num_instances, int64_t norm_size, double epsilon,
+                      const std::vector<float>& x, std::vector<double>* mean,
+                      std::vector<double>* inv_variance, std::vector<double>* normalized) {
+  FOR_RANGE(int64_t, i, 0, num_instances) {
+    double sum = 0;
+    FOR_RANGE(int64_t, j, 0, norm_size) { sum += x.at(i * norm_size + j); }
+    const double m = sum / norm_size;
+    double sq_sum = 0;
+    FOR_RANGE(int64_t, j, 0, norm_size) {
+      const double d = x.at(i * norm_size + j) - m;
+      sq_sum += d * d;
+    }
+    mean->at(i) = m;
+    inv_variance->at(i) = 1.0 / std::sqrt(sq_sum / norm_size + epsilon);
+    FOR_RANGE(int64_t, j, 0, norm_size) {
+      normalized->at(i * norm_size + j) = (x.at(i * norm_size + j) - m) * inv_variance->at(i);
+    }
+  }
+}
+
+void ExpectNear(const std::vector<float>& actual, const std::vector<double>& expected,
+                double tolerance) {
+  ASSERT_EQ(actual.size(), expected.size());
+  FOR_RANGE(size_t, i, 0, actual.size()) {
+    ASSERT_NEAR(actual.at(i), expected.at(i), tolerance * std::max(1.0, std::abs(expected.at(i))))
+        << "at " << i;
+  }
+}
+
+}  // namespace
+
+TEST(LayerNormCpuKernelUtil, forward_match_reference) {
+  ScopedGlobalThreadPool thread_pool;
+  const double epsilon = 1e-5;
+  // Params over the normalized axes, over a suffix of them, and no params
+  for (int64_t norm_size : {1, 7, 16, 100, 1024, 40000}) {
+    const int64_t suffix_size = norm_size % 4 == 0 ? norm_size / 4 : norm_size;
+    for (int64_t param_size : {norm_size, suffix_size, int64_t{0}}) {
+      const int64_t num_instances = 37;
+      const int64_t elem_cnt = num_instances * norm_size;
+      // The offset makes E[x^2] - mean^2 lose precision, which Welford does not
+      const std::vector<float> x = RandomFloats(elem_cnt, 1, 99, 101);
+      const std::vector<float> gamma = RandomFloats(param_size, 2, 0, 2);
+      const std::vector<float> beta = RandomFloats(param_size, 3);
+      std::vector<float> normalized(elem_cnt);
+      std::vector<float> y(elem_cnt);
+      std::vector<float> mean(num_instances);
+      std::vector<float> inv_variance(num_instances);
+      LayerNormCpuKernelUtil<float>::Forward(
+          num_instances, norm_size, param_size == 0 ? norm_size : param_size, epsilon, x.data(),
+          param_size == 0 ? nullptr : gamma.data(), param_size == 0 ? nullptr : beta.data(),
+          normalized.data(), param_size == 0 ? normalized.data() : y.data(), mean.data(),
+          inv_variance.data());
+      std::vector<double> expected_mean(num_instances);
+      std::vector<double> expected_inv_variance(num_instances);
+      std::vector<double> expected_normalized(elem_cnt);
+      ReferenceForward(num_instances, norm_size, epsilon, x, &expected_mean,
+                       &expected_inv_variance, &expected_normalized);
+      ExpectNear(mean, expected_mean, 1e-5);
+      ExpectNear(inv_variance, expected_inv_variance, 1e-3);
+      ExpectNear(normalized, expected_normalized, 1e-3);
+      if (param_size == 0) { continue; }
+      std::vector<double> expected_y(elem_cnt);
+      FOR_RANGE(int64_t, i, 0, elem_cnt) {
+        expected_y.at(i) = expected_normalized.at(i) * gamma.at(i % param_size)
+                           + beta.at(i % param_size);
+      }
+      ExpectNear(y, expected_y, 1e-3);
+    }
+  }
+}
+
+TEST(LayerNormCpuKernelUtil, backward_match_reference) {
+  ScopedGlobalThreadPool thread_pool;
+  for (int64_t norm_size : {1, 7, 100, 1024, 40000}) {
+    const int64_t num_instances = 37;
+    const int64_t elem_cnt = num_instances * norm_size;
+    const std::vector<float> x = RandomFloats(elem_cnt, 4, 2, 4);
+    const std::vector<float> dy = RandomFloats(elem_cnt + 1, 5, -0.5, 1.5);
+    const std::vector<float> add_to_output = RandomFloats(elem_cnt + 2, 6);
+    std::vector<double> mean(num_instances);
+    std::vector<double> inv_variance(num_instances);
+    std::vector<double> x_hat(elem_cnt);
+    ReferenceForward(num_instances, norm_size, 1e-5, x, &mean, &inv_variance, &x_hat);
+    std::vector<double> expected_dx(elem_cnt);
+    FOR_RANGE(int64_t, i, 0, num_instances) {
+      double sum_dy = 0;
+      double sum_dy_x_hat = 0;
+      FOR_RANGE(int64_t, j, 0, norm_size) {
+        sum_dy += dy.at(i * norm_size + j);
+        sum_dy_x_hat += dy.at(i * norm_size + j) * x_hat.at(i * norm_size + j);
+      }
+      FOR_RANGE(int64_t, j, 0, norm_size) {
+        const int64_t k = i * norm_size + j;
+        expected_dx.at(k) = inv_variance.at(i)
+                                * (dy.at(k) - sum_dy / norm_size
+                                   - x_hat.at(k) * sum_dy_x_hat / norm_size)
+                            + add_to_output.at(k);
+      }
+    }
+    const std::vector<float> float_mean(mean.begin(), mean.end());
+    const std::vector<float> float_inv_variance(inv_variance.begin(), inv_variance.end());
+    // dx is added in place to the output as with _add_to_output
+    std::vector<float> dx(add_to_output.begin(), add_to_output.begin() + elem_cnt);
+    LayerNormCpuKernelUtil<float>::Backward(num_instances, norm_size, dy.data(), x.data(),
+                                            float_mean.data(), float_inv_variance.data(),
+                                            dx.data(), dx.data());
+    ExpectNear(dx, expected_dx, 1e-3);
+  }
+}
+
+TEST(LayerNormCpuKernelUtil, param_grad_match_reference) {
+  ScopedGlobalThreadPool thread_pool;
+  for (int64_t param_size : {1, 7, 300, 4096}) {
+    for (int64_t rows : {1, 5, 300}) {
+      const int64_t elem_cnt = rows * param_size;
+      const std::vector<float> dy = RandomFloats(elem_cnt, 7);
+      const std::vector<float> normalized = RandomFloats(elem_cnt + 1, 8);
+      const std::vector<float> gamma = RandomFloats(param_size, 9, 0, 2);
+      std::vector<float> gamma_diff(param_size);
+      std::vector<float> beta_diff(param_size);
+      std::vector<float> normalized_diff(elem_cnt);
+      LayerNormCpuKernelUtil<float>::ParamGrad(elem_cnt, param_size, dy.data(),
+                                               normalized.data(), gamma.data(), gamma_diff.data(),
+                                               beta_diff.data(), normalized_diff.data());
+      std::vector<double> expected_gamma_diff(param_size, 0);
+      std::vector<double> expected_beta_diff(param_size, 0);
+      std::vector<double> expected_normalized_diff(elem_cnt);
+      FOR_RANGE(int64_t, i, 0, elem_cnt) {
+        const int64_t c = i % param_size;
+        expected_gamma_diff.at(c) += dy.at(i) * normalized.at(i);
+        expected_beta_diff.at(c) += dy.at(i);
+        expected_normalized_diff.at(i) = dy.at(i) * gamma.at(c);
+      }
+      const double tolerance = 1e-5 * std::sqrt(static_cast<double>(rows));
+      ExpectNear(gamma_diff, expected_gamma_diff, tolerance);
+      ExpectNear(beta_diff, expected_beta_diff, tolerance);
+      ExpectNear(normalized_diff, expected_normalized_diff, 1e-6);
+      // Without gamma, normalized_diff is dy
+      LayerNormCpuKernelUtil<float>::ParamGrad(elem_cnt, param_size, dy.data(), nullptr, nullptr,
+                                               nullptr, nullptr, normalized_diff.data());
+      ASSERT_EQ(normalized_diff, dy);
+    }
+  }
+}
+
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST(LayerNormCpuKernelUtil, DISABLED_benchmark_hidden_sizes) {
+  ScopedGlobalThreadPool thread_pool(0);
+  const int32_t iter_num = 10;
+  for (int64_t hidden_size : {256, 512, 768, 1024, 2048, 4096}) {
+    const int64_t num_instances = (1 << 23) / hidden_size;
+    const int64_t elem_cnt = num_instances * hidden_size;
+    const std::vector<float> x = RandomFloats(elem_cnt, 10);
+    const std::vector<float> dy = RandomFloats(elem_cnt + 1, 11);
+    const std::vector<float> gamma = RandomFloats(hidden_size, 12, 0, 2);
+    const std::vector<float> beta = RandomFloats(hidden_size, 13);
+    std::vector<float> normalized(elem_cnt);
+    std::vector<float> y(elem_cnt);
+    std::vector<float> dx(elem_cnt);
+    std::vector<float> mean(num_instances);
+    std::vector<float> inv_variance(num_instances);
+    std::vector<float> gamma_diff(hidden_size);
+    std::vector<float> beta_diff(hidden_size);
+    const auto Seconds = [&](const std::function<void()>& Run) {
+      Run();
+      const auto start = std::chrono::steady_clock::now();
+      FOR_RANGE(int32_t, i, 0, iter_num) { Run(); }
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()
+             / iter_num;
+    };
+    // Reads x, writes normalized and y
+    const double forward = Seconds([&]() {
+      LayerNormCpuKernelUtil<float>::Forward(num_instances, hidden_size, hidden_size, 1e-5,
+                                             x.data(), gamma.data(), beta.data(),
+                                             normalized.data(), y.data(), mean.data(),
+                                             inv_variance.data());
+    });
+    // Reads dy and x, writes dx
+    const double backward = Seconds([&]() {
+      LayerNormCpuKernelUtil<float>::Backward(num_instances, hidden_size, dy.data(), x.data(),
+                                              mean.data(), inv_variance.data(), nullptr,
+                                              dx.data());
+    });
+    // Reads dy and normalized, writes normalized_diff
+    const double param_grad = Seconds([&]() {
+      LayerNormCpuKernelUtil<float>::ParamGrad(elem_cnt, hidden_size, dy.data(),
+                                               normalized.data(), gamma.data(), gamma_diff.data(),
+                                               beta_diff.data(), dx.data());
+    });
+    const double bytes = 3.0 * elem_cnt * sizeof(float);
+    LOG(INFO) << "layer_norm hidden_size " << hidden_size << ": forward " << bytes / forward / 1e9
+              << " GB/s, backward " << bytes / backward / 1e9 << " GB/s, param_grad "
+              << bytes / param_grad / 1e9 << " GB/s";
+  }
+}
+
+}  // namespace test
+
+}  // namespace oneflow
@@ -0,0 +1,298 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/user/kernels/normalization_cpu_kernel_util.h"
+
+namespace oneflow {
+
+namespace {
+
+// x viewed as (outer, channels, inner) around the normalized axis
+void InferOuterChannelsInner(const ShapeView& x_shape, const int32_t axis, int64_t* outer,
+                             int64_t* channels, int64_t* inner) {
+  CHECK_GE(axis, 0);
+  CHECK_LT(axis, x_shape.NumAxes());
+  *outer = x_shape.Count(0, axis);
+  *channels = x_shape.At(axis);
+  *inner = x_shape.Count(axis + 1);
+}
+
+void CheckParamTensor(const user_op::Tensor* tensor, int64_t channels) {
+  CHECK_EQ(tensor->shape().NumAxes(), 1);
+  CHECK_EQ(tensor->shape().At(0), channels);
+}
+
+const user_op::Tensor* GetAddToOutput(user_op::KernelComputeContext* ctx,
+                                      const user_op::Tensor* y) {
+  if (!ctx->has_input("_add_to_output", 0)) { return nullptr; }
+  const user_op::Tensor* add_to_output = ctx->Tensor4ArgNameAndIndex("_add_to_output", 0);
+  CHECK_EQ(add_to_output->data_type(), y->data_type());
+  CHECK_EQ(add_to_output->shape(), y->shape());
+  return add_to_output;
+}
+
+}  // namespace
+
+template<typename T>
+class NormalizationInferenceCpuKernel final : public user_op::OpKernel {
+ public:
+  NormalizationInferenceCpuKernel() = default;
+  ~NormalizationInferenceCpuKernel() override = default;
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    CHECK(!ctx->Attr<bool>("training"));
+    const auto* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    auto* y = ctx->Tensor4ArgNameAndIndex("y", 0);
+    const auto* gamma = ctx->Tensor4ArgNameAndIndex("gamma", 0);
+    const auto* beta = ctx->Tensor4ArgNameAndIndex("beta", 0);
+    const auto* moving_mean = ctx->Tensor4ArgNameAndIndex("moving_mean", 0);
+    const auto* moving_variance = ctx->Tensor4ArgNameAndIndex("moving_variance", 0);
+    const auto epsilon = ctx->Attr<float>("epsilon");
+    CHECK_EQ(x->shape(), y->shape());
+    int64_t outer = 0;
+    int64_t channels = 0;
+    int64_t inner = 0;
+    InferOuterChannelsInner(x->shape(), ctx->Attr<int32_t>("axis"), &outer, &channels, &inner);
+    CheckParamTensor(gamma, channels);
+    CheckParamTensor(beta, channels);
+    CheckParamTensor(moving_mean, channels);
+    CheckParamTensor(moving_variance, channels);
+    // The moving statistics fold into one scale and shift per channel
+    std::vector<T> scale(channels);
+    std::vector<T> shift(channels);
+    FOR_RANGE(int64_t, c, 0, channels) {
+      scale.at(c) = gamma->dptr<T>()[c]
+                    / std::sqrt(moving_variance->dptr<T>()[c] + static_cast<T>(epsilon));
+      shift.at(c) = beta->dptr<T>()[c] - moving_mean->dptr<T>()[c] * scale.at(c);
+    }
+    const user_op::Tensor* add_to_output = GetAddToOutput(ctx, y);
+    NormalizationCpuKernelUtil<T>::ScaleShift(
+        outer, channels, inner, x->dptr<T>(), scale.data(), shift.data(),
+        add_to_output == nullptr ? nullptr : add_to_output->dptr<T>(), y->mut_dptr<T>(), nullptr);
+  }
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_BN_INFERENCE_CPU_KERNEL(dtype)                                                 \
+  REGISTER_USER_KERNEL("normalization")                                                         \
+      .SetCreateFn<NormalizationInferenceCpuKernel<dtype>>()                                    \
+      .SetIsMatchedHob((user_op::HobDeviceTag() == "cpu")                                       \
+                       & (user_op::HobDataType("y", 0) == GetDataType<dtype>::value)            \
+                       & (user_op::HobAttr<bool>("training") == false))                         \
+      .SetInplaceProposalFn([](const user_op::InferContext& ctx,                                \
+                               user_op::AddInplaceArgPair AddInplaceArgPairFn) -> Maybe<void> { \
+        if (ctx.has_input("_add_to_output", 0)) {                                               \
+          OF_RETURN_IF_ERROR(AddInplaceArgPairFn("y", 0, "_add_to_output", 0, true));           \
+        }                                                                                       \
+        return Maybe<void>::Ok();                                                               \
+      });
+
+REGISTER_BN_INFERENCE_CPU_KERNEL(float)
+REGISTER_BN_INFERENCE_CPU_KERNEL(double)
+
+#undef REGISTER_BN_INFERENCE_CPU_KERNEL
+
+template<typename T>
+class NormalizationTrainCpuKernel final : public user_op::OpKernel {
+ public:
+  NormalizationTrainCpuKernel() = default;
+  ~NormalizationTrainCpuKernel() override = default;
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const bool add_relu = ctx->op_type_name() == "normalization_add_relu";
+    if (!add_relu) { CHECK(ctx->Attr<bool>("training")); }
+    const auto* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    auto* y = ctx->Tensor4ArgNameAndIndex("y", 0);
+    const auto* gamma = ctx->Tensor4ArgNameAndIndex("gamma", 0);
+    const auto* beta = ctx->Tensor4ArgNameAndIndex("beta", 0);
+    auto* moving_mean = ctx->Tensor4ArgNameAndIndex("moving_mean", 0);
+    auto* moving_variance = ctx->Tensor4ArgNameAndIndex("moving_variance", 0);
+    const auto epsilon = ctx->Attr<float>("epsilon");
+    const auto momentum = ctx->Attr<float>("momentum");
+    CHECK_EQ(x->shape(), y->shape());
+    int64_t outer = 0;
+    int64_t channels = 0;
+    int64_t inner = 0;
+    InferOuterChannelsInner(x->shape(), ctx->Attr<int32_t>("axis"), &outer, &channels, &inner);
+    CheckParamTensor(gamma, channels);
+    CheckParamTensor(beta, channels);
+    CheckParamTensor(moving_mean, channels);
+    CheckParamTensor(moving_variance, channels);
+    // mean and inv_variance are only outputs when a grad needs them
+    std::vector<T> mean_buf;
+    std::vector<T> inv_variance_buf;
+    T* mean_ptr = nullptr;
+    T* inv_variance_ptr = nullptr;
+    if (ctx->has_output("mean", 0)) {
+      auto* mean = ctx->Tensor4ArgNameAndIndex("mean", 0);
+      CheckParamTensor(mean, channels);
+      mean_ptr = mean->mut_dptr<T>();
+    } else {
+      mean_buf.resize(channels);
+      mean_ptr = mean_buf.data();
+    }
+    if (ctx->has_output("inv_variance", 0)) {
+      auto* inv_variance = ctx->Tensor4ArgNameAndIndex("inv_variance", 0);
+      CheckParamTensor(inv_variance, channels);
+      inv_variance_ptr = inv_variance->mut_dptr<T>();
+    } else {
+      inv_variance_buf.resize(channels);
+      inv_variance_ptr = inv_variance_buf.data();
+    }
+    NormalizationCpuKernelUtil<T>::ComputeStatistics(
+        outer, channels, inner, epsilon, momentum, x->dptr<T>(), mean_ptr, inv_variance_ptr,
+        moving_mean->mut_dptr<T>(), moving_variance->mut_dptr<T>());
+    std::vector<T> scale(channels);
+    std::vector<T> shift(channels);
+    FOR_RANGE(int64_t, c, 0, channels) {
+      scale.at(c) = gamma->dptr<T>()[c] * inv_variance_ptr[c];
+      shift.at(c) = beta->dptr<T>()[c] - mean_ptr[c] * scale.at(c);
+    }
+    const T* addend_ptr = nullptr;
+    int32_t* mask_ptr = nullptr;
+    if (add_relu) {
+      CHECK(!ctx->has_input("_add_to_output", 0));
+      if (ctx->has_input("addend", 0)) {
+        addend_ptr = ctx->Tensor4ArgNameAndIndex("addend", 0)->dptr<T>();
+      }
+      mask_ptr = ctx->Tensor4ArgNameAndIndex("reserve_space", 0)->mut_dptr<int32_t>();
+    } else {
+      const user_op::Tensor* add_to_output = GetAddToOutput(ctx, y);
+      if (add_to_output != nullptr) { addend_ptr = add_to_output->dptr<T>(); }
+    }
+    NormalizationCpuKernelUtil<T>::ScaleShift(outer, channels, inner, x->dptr<T>(),
+                                              scale.data(), shift.data(), addend_ptr,
+                                              y->mut_dptr<T>(), mask_ptr);
+  }
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_BN_TRAIN_CPU_KERNEL(dtype)                                                     \
+  REGISTER_USER_KERNEL("normalization")                                                         \
+      .SetCreateFn<NormalizationTrainCpuKernel<dtype>>()                                        \
+      .SetIsMatchedHob((user_op::HobDeviceTag() == "cpu")                                       \
+                       & (user_op::HobDataType("y", 0) == GetDataType<dtype>::value)            \
+                       & (user_op::HobAttr<bool>("training") == true))                          \
+      .SetInplaceProposalFn([](const user_op::InferContext& ctx,                                \
+                               user_op::AddInplaceArgPair AddInplaceArgPairFn) -> Maybe<void> { \
+        if (ctx.has_input("_add_to_output", 0)) {                                               \
+          OF_RETURN_IF_ERROR(AddInplaceArgPairFn("y", 0, "_add_to_output", 0, true));           \
+        }                                                                                       \
+        return Maybe<void>::Ok();                                                               \
+      });
+
+REGISTER_BN_TRAIN_CPU_KERNEL(float)
+REGISTER_BN_TRAIN_CPU_KERNEL(double)
+
+#undef REGISTER_BN_TRAIN_CPU_KERNEL
+
+#define REGISTER_BN_ADD_RELU_CPU_KERNEL(dtype)           \
+  REGISTER_USER_KERNEL("normalization_add_relu")         \
+      .SetCreateFn<NormalizationTrainCpuKernel<dtype>>() \
+      .SetIsMatchedHob((user_op::HobDeviceTag() == "cpu") \
+                       & (user_op::HobDataType("y", 0) == GetDataType<dtype>::value));
+
+REGISTER_BN_ADD_RELU_CPU_KERNEL(float)
+REGISTER_BN_ADD_RELU_CPU_KERNEL(double)
+
+#undef REGISTER_BN_ADD_RELU_CPU_KERNEL
+
+template<typename T>
+class NormalizationGradCpuKernel final : public user_op::OpKernel {
+ public:
+  NormalizationGradCpuKernel() = default;
+  ~NormalizationGradCpuKernel() override = default;
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const auto* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    auto* dx = ctx->Tensor4ArgNameAndIndex("dx", 0);
+    const auto* dy = ctx->Tensor4ArgNameAndIndex("dy", 0);
+    const auto* gamma = ctx->Tensor4ArgNameAndIndex("gamma", 0);
+    auto* gamma_diff = ctx->Tensor4ArgNameAndIndex("gamma_diff", 0);
+    auto* beta_diff = ctx->Tensor4ArgNameAndIndex("beta_diff", 0);
+    const auto* mean = ctx->Tensor4ArgNameAndIndex("mean", 0);
+    const auto* inv_variance = ctx->Tensor4ArgNameAndIndex("inv_variance", 0);
+    CHECK_EQ(dy->shape(), x->shape());
+    CHECK_EQ(dx->shape(), x->shape());
+    int64_t outer = 0;
+    int64_t channels = 0;
+    int64_t inner = 0;
+    InferOuterChannelsInner(x->shape(), ctx->Attr<int32_t>("axis"), &outer, &channels, &inner);
+    CheckParamTensor(gamma, channels);
+    CheckParamTensor(gamma_diff, channels);
+    CheckParamTensor(beta_diff, channels);
+    CheckParamTensor(mean, channels);
+    CheckParamTensor(inv_variance, channels);
+
+    const T* bn_dy_ptr = dy->dptr<T>();
+    if (ctx->op_type_name() == "normalization_add_relu_grad") {
+      // The relu grad is also the grad of the addend
+      T* relu_dx_ptr = nullptr;
+      if (ctx->has_output("addend_diff", 0)) {
+        relu_dx_ptr = ctx->Tensor4ArgNameAndIndex("addend_diff", 0)->mut_dptr<T>();
+      } else {
+        user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
+        CHECK_GE(tmp_buffer->shape().elem_cnt(), dy->shape().elem_cnt() * sizeof(T));
+        relu_dx_ptr = tmp_buffer->mut_dptr<T>();
+      }
+      const auto* mask = ctx->Tensor4ArgNameAndIndex("reserve_space", 0);
+      NormalizationCpuKernelUtil<T>::ReluBackward(dy->shape().elem_cnt(), mask->dptr<int32_t>(),
+                                                  dy->dptr<T>(), relu_dx_ptr);
+      bn_dy_ptr = relu_dx_ptr;
+    } else {
+      CHECK_EQ(ctx->op_type_name(), "normalization_grad");
+    }
+    NormalizationCpuKernelUtil<T>::Backward(
+        outer, channels, inner, x->dptr<T>(), bn_dy_ptr, mean->dptr<T>(),
+        inv_variance->dptr<T>(), gamma->dptr<T>(), gamma_diff->mut_dptr<T>(),
+        beta_diff->mut_dptr<T>(), dx->mut_dptr<T>());
+  }
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+namespace {
+
+size_t InferGradCpuTmpSize(user_op::InferContext* ctx) {
+  if (ctx->op_type_name() == "normalization_add_relu_grad" && !ctx->has_output("addend_diff", 0)) {
+    const auto* dy = ctx->TensorDesc4ArgNameAndIndex("dy", 0);
+    return dy->shape().elem_cnt() * GetSizeOfDataType(dy->data_type());
+  }
+  return 0;
+}
+
+}  // namespace
+
+#define REGISTER_BN_GRAD_CPU_KERNEL(op_type_name, dtype)                               \
+  REGISTER_USER_KERNEL(op_type_name)                                                   \
+      .SetCreateFn<NormalizationGradCpuKernel<dtype>>()                                \
+      .SetIsMatchedHob((user_op::HobDeviceTag() == "cpu")                              \
+                       & (user_op::HobDataType("dx", 0) == GetDataType<dtype>::value)) \
+      .SetInferTmpSizeFn(InferGradCpuTmpSize);
+
+REGISTER_BN_GRAD_CPU_KERNEL("normalization_grad", float)
+REGISTER_BN_GRAD_CPU_KERNEL("normalization_grad", double)
+REGISTER_BN_GRAD_CPU_KERNEL("normalization_add_relu_grad", float)
+REGISTER_BN_GRAD_CPU_KERNEL("normalization_add_relu_grad", double)
+
+#undef REGISTER_BN_GRAD_CPU_KERNEL
+
+}  // namespace oneflow
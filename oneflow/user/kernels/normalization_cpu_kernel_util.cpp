@@ -0,0 +1,456 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/normalization_cpu_kernel_util.h"
+#include "oneflow/core/ndarray/cpu_reduce_core.h"
+#include "oneflow/core/ndarray/cpu_welford.h"
+
+namespace oneflow {
+
+namespace {
+
+constexpr int64_t kLaneNum = cpu_welford::kLaneNum;
+// Elements handled by a task, a multiple of the 32 elements of a relu mask word
+constexpr int64_t kTaskElemNum = 1 << 15;
+// Channels of NHWC statistics accumulated together
+constexpr int64_t kColBlockSize = 256;
+constexpr int64_t kMaskWordBits = 32;
+
+// y = x * scale + shift (+ addend) (relu), where the params are per element (step 1) or one value
+// for the whole row (step 0)
+template<typename T, int64_t step>
+ALWAYS_INLINE inline void ScaleShiftRow(const T* x, int64_t n, const T* scale, const T* shift,
+                                        const T* addend, bool relu, T* y) {
+  if (addend == nullptr && !relu) {
+    for (int64_t i = 0; i < n; ++i) { y[i] = x[i] * scale[i * step] + shift[i * step]; }
+  } else if (addend == nullptr) {
+    for (int64_t i = 0; i < n; ++i) {
+      const T val = x[i] * scale[i * step] + shift[i * step];
+      y[i] = val > 0 ? val : 0;
+    }
+  } else if (!relu) {
+    for (int64_t i = 0; i < n; ++i) {
+      y[i] = x[i] * scale[i * step] + shift[i * step] + addend[i];
+    }
+  } else {
+    for (int64_t i = 0; i < n; ++i) {
+      const T val = x[i] * scale[i * step] + shift[i * step] + addend[i];
+      y[i] = val > 0 ? val : 0;
+    }
+  }
+}
+
+// Packs y > 0 of word_num * 32 elements into mask words
+template<typename T>
+ALWAYS_INLINE inline void ReluMaskWords(const T* y, int64_t word_num, int32_t* mask) {
+  for (int64_t w = 0; w < word_num; ++w) {
+    const T* y_word = y + w * kMaskWordBits;
+    uint32_t bits = 0;
+    for (int64_t b = 0; b < kMaskWordBits; ++b) {
+      bits |= static_cast<uint32_t>(y_word[b] > 0) << b;
+    }
+    mask[w] = static_cast<int32_t>(bits);
+  }
+}
+
+template<typename T>
+ALWAYS_INLINE inline void ReluBackwardWords(const int32_t* mask, int64_t word_num, const T* dy,
+                                            T* masked_dy) {
+  for (int64_t w = 0; w < word_num; ++w) {
+    const uint32_t bits = static_cast<uint32_t>(mask[w]);
+    const T* dy_word = dy + w * kMaskWordBits;
+    T* masked_dy_word = masked_dy + w * kMaskWordBits;
+    for (int64_t b = 0; b < kMaskWordBits; ++b) {
+      masked_dy_word[b] = ((bits >> b) & 1U) ? dy_word[b] : 0;
+    }
+  }
+}
+
+// Sums of dy and of dy * (x - mean) over a row of one channel
+template<typename T>
+ALWAYS_INLINE inline void GradSumsRow(const T* dy, const T* x, int64_t n, T mean, T* sum_dy,
+                                      T* sum_dy_x_centered) {
+  T lane_dy[kLaneNum] = {};
+  T lane_dy_x_centered[kLaneNum] = {};
+  const int64_t step_num = n / kLaneNum;
+  FOR_RANGE(int64_t, s, 0, step_num) {
+    const T* dy_step = dy + s * kLaneNum;
+    const T* x_step = x + s * kLaneNum;
+    // Kept as a loop, otherwise gcc vectorizes across the steps with shuffles
+#pragma GCC unroll 1
+    for (int64_t j = 0; j < kLaneNum; ++j) {
+      lane_dy[j] += dy_step[j];
+      lane_dy_x_centered[j] += dy_step[j] * (x_step[j] - mean);
+    }
+  }
+  FOR_RANGE(int64_t, i, step_num * kLaneNum, n) {
+    lane_dy[0] += dy[i];
+    lane_dy_x_centered[0] += dy[i] * (x[i] - mean);
+  }
+  for (int64_t width = kLaneNum / 2; width > 0; width /= 2) {
+    for (int64_t j = 0; j < width; ++j) {
+      lane_dy[j] += lane_dy[j + width];
+      lane_dy_x_centered[j] += lane_dy_x_centered[j + width];
+    }
+  }
+  *sum_dy += lane_dy[0];
+  *sum_dy_x_centered += lane_dy_x_centered[0];
+}
+
+// The sums of GradSumsRow for each column of a rows x cols block of NHWC
+template<typename T>
+ALWAYS_INLINE inline void GradSumsCols(const T* dy, const T* x, int64_t rows, int64_t cols,
+                                       int64_t row_stride, const T* mean, T* sum_dy,
+                                       T* sum_dy_x_centered) {
+  std::fill_n(sum_dy, cols, 0);
+  std::fill_n(sum_dy_x_centered, cols, 0);
+  for (int64_t r = 0; r < rows; ++r) {
+    const T* dy_row = dy + r * row_stride;
+    const T* x_row = x + r * row_stride;
+    for (int64_t c = 0; c < cols; ++c) {
+      sum_dy[c] += dy_row[c];
+      sum_dy_x_centered[c] += dy_row[c] * (x_row[c] - mean[c]);
+    }
+  }
+}
+
+// dx = dy * a + (x - mean) * b + c
+template<typename T, int64_t step>
+ALWAYS_INLINE inline void GradRow(const T* dy, const T* x, int64_t n, const T* a, const T* b,
+                                  const T* c, const T* mean, T* dx) {
+  for (int64_t i = 0; i < n; ++i) {
+    dx[i] = dy[i] * a[i * step] + (x[i] - mean[i * step]) * b[i * step] + c[i * step];
+  }
+}
+
+#define DEFINE_NORMALIZATION_ISA_KERNELS(suffix, target)                                        \
+  template<typename T>                                                                          \
+  target void WelfordRow##suffix(const T* x, int64_t n, T* mean, T* m2) {                       \
+    cpu_welford::Row<T>(x, n, mean, m2);                                                        \
+  }                                                                                             \
+  template<typename T>                                                                          \
+  target void WelfordCols##suffix(const T* x, int64_t rows, int64_t cols, int64_t row_stride,   \
+                                  T* mean, T* m2) {                                             \
+    cpu_welford::Cols<T>(x, rows, cols, row_stride, mean, m2);                                  \
+  }                                                                                             \
+  template<typename T>                                                                          \
+  target void ScaleShiftRow##suffix(const T* x, int64_t n, const T* scale, const T* shift,      \
+                                    const T* addend, bool relu, bool param_per_elem, T* y) {    \
+    if (param_per_elem) {                                                                       \
+      ScaleShiftRow<T, 1>(x, n, scale, shift, addend, relu, y);                                 \
+    } else {                                                                                    \
+      ScaleShiftRow<T, 0>(x, n, scale, shift, addend, relu, y);                                 \
+    }                                                                                           \
+  }                                                                                             \
+  template<typename T>                                                                          \
+  target void ReluMaskWords##suffix(const T* y, int64_t word_num, int32_t* mask) {              \
+    ReluMaskWords<T>(y, word_num, mask);                                                        \
+  }                                                                                             \
+  template<typename T>                                                                          \
+  target void ReluBackwardWords##suffix(const int32_t* mask, int64_t word_num, const T* dy,     \
+                                        T* masked_dy) {                                         \
+    ReluBackwardWords<T>(mask, word_num, dy, masked_dy);                                        \
+  }                                                                                             \
+  template<typename T>                                                                          \
+  target void GradSumsRow##suffix(const T* dy, const T* x, int64_t n, T mean, T* sum_dy,        \
+                                  T* sum_dy_x_centered) {                                       \
+    GradSumsRow<T>(dy, x, n, mean, sum_dy, sum_dy_x_centered);                                  \
+  }                                                                                             \
+  template<typename T>                                                                          \
+  target void GradSumsCols##suffix(const T* dy, const T* x, int64_t rows, int64_t cols,         \
+                                   int64_t row_stride, const T* mean, T* sum_dy,                \
+                                   T* sum_dy_x_centered) {                                      \
+    GradSumsCols<T>(dy, x, rows, cols, row_stride, mean, sum_dy, sum_dy_x_centered);            \
+  }                                                                                             \
+  template<typename T>                                                                          \
+  target void GradRow##suffix(const T* dy, const T* x, int64_t n, const T* a, const T* b,       \
+                              const T* c, const T* mean, bool param_per_elem, T* dx) {          \
+    if (param_per_elem) {                                                                       \
+      GradRow<T, 1>(dy, x, n, a, b, c, mean, dx);                                               \
+    } else {                                                                                    \
+      GradRow<T, 0>(dy, x, n, a, b, c, mean, dx);                                               \
+    }                                                                                           \
+  }
+DEFINE_NORMALIZATION_ISA_KERNELS(Default, )
+#ifdef OF_CPU_ISA_DISPATCH_ENABLED
+DEFINE_NORMALIZATION_ISA_KERNELS(Avx2, OF_CPU_TARGET_AVX2)
+DEFINE_NORMALIZATION_ISA_KERNELS(Avx512, OF_CPU_TARGET_AVX512)
+#endif
+#undef DEFINE_NORMALIZATION_ISA_KERNELS
+
+#ifdef OF_CPU_ISA_DISPATCH_ENABLED
+#define OF_NORMALIZATION_ISA_CASES(func)         \
+  case CpuIsa::kAvx512: return &func##Avx512<T>; \
+  case CpuIsa::kAvx2: return &func##Avx2<T>;
+#else
+#define OF_NORMALIZATION_ISA_CASES(func)
+#endif
+#define DEFINE_NORMALIZATION_ISA_GETTER(func) \
+  template<typename T>                        \
+  decltype(&func##Default<T>) Get##func() {   \
+    switch (GetCpuIsa()) {                    \
+      OF_NORMALIZATION_ISA_CASES(func)        \
+      default: return &func##Default<T>;      \
+    }                                         \
+  }
+DEFINE_NORMALIZATION_ISA_GETTER(WelfordRow)
+DEFINE_NORMALIZATION_ISA_GETTER(WelfordCols)
+DEFINE_NORMALIZATION_ISA_GETTER(ScaleShiftRow)
+DEFINE_NORMALIZATION_ISA_GETTER(ReluMaskWords)
+DEFINE_NORMALIZATION_ISA_GETTER(ReluBackwardWords)
+DEFINE_NORMALIZATION_ISA_GETTER(GradSumsRow)
+DEFINE_NORMALIZATION_ISA_GETTER(GradSumsCols)
+DEFINE_NORMALIZATION_ISA_GETTER(GradRow)
+#undef DEFINE_NORMALIZATION_ISA_GETTER
+#undef OF_NORMALIZATION_ISA_CASES
+
+int64_t RoundUpDiv(int64_t n, int64_t d) { return (n + d - 1) / d; }
+
+void ParallelForTasks(int64_t task_num, const std::function<void(int64_t)>& DoTask) {
+  ThreadPool* thread_pool = Global<ThreadPool>::Get();
+  if (task_num == 1 || thread_pool == nullptr || thread_pool->thread_num() <= 1) {
+    FOR_RANGE(int64_t, task, 0, task_num) { DoTask(task); }
+    return;
+  }
+  thread_pool->ParallelFor(0, task_num, 1, [&](int64_t begin, int64_t end) {
+    FOR_RANGE(int64_t, task, begin, end) { DoTask(task); }
+  });
+}
+
+// Runs DoRange over ranges of kTaskElemNum elements, so that every range but the last one starts
+// and ends on a relu mask word
+void ParallelForElemRanges(int64_t elem_cnt,
+                           const std::function<void(int64_t, int64_t)>& DoRange) {
+  ParallelForTasks(RoundUpDiv(elem_cnt, kTaskElemNum), [&](int64_t task) {
+    DoRange(task * kTaskElemNum, std::min(elem_cnt, (task + 1) * kTaskElemNum));
+  });
+}
+
+// Splits [begin, end) where the channel changes. NHWC segments are rows of channels with per
+// element params, NCHW segments belong to a single channel.
+template<typename F>
+void ForEachSegment(int64_t begin, int64_t end, int64_t channels, int64_t inner,
+                    const F& DoSegment) {
+  int64_t i = begin;
+  while (i < end) {
+    if (inner == 1) {
+      const int64_t channel = i % channels;
+      const int64_t n = std::min(end - i, channels - channel);
+      DoSegment(i, n, channel, true);
+      i += n;
+    } else {
+      const int64_t channel = (i / inner) % channels;
+      const int64_t n = std::min(end - i, inner - i % inner);
+      DoSegment(i, n, channel, false);
+      i += n;
+    }
+  }
+}
+
+// Chunks of NHWC rows, they only depend on the shape so results do not depend on the number of
+// threads
+struct ColChunks final {
+  ColChunks(int64_t rows, int64_t cols)
+      : rows(rows),
+        cols(cols),
+        rows_per_chunk(std::max<int64_t>(kTaskElemNum / cols, 1)),
+        chunk_num(RoundUpDiv(rows, rows_per_chunk)),
+        col_block_num(RoundUpDiv(cols, kColBlockSize)) {}
+
+  // Calls DoBlock(chunk, row_begin, row_num, col_begin, col_num) for every block in parallel
+  void ParallelForEachBlock(
+      const std::function<void(int64_t, int64_t, int64_t, int64_t, int64_t)>& DoBlock) const {
+    ParallelForTasks(chunk_num * col_block_num, [&](int64_t task) {
+      const int64_t chunk = task / col_block_num;
+      const int64_t row_begin = chunk * rows_per_chunk;
+      const int64_t col_begin = (task % col_block_num) * kColBlockSize;
+      DoBlock(chunk, row_begin, std::min(rows - row_begin, rows_per_chunk), col_begin,
+              std::min(cols - col_begin, kColBlockSize));
+    });
+  }
+
+  int64_t rows;
+  int64_t cols;
+  int64_t rows_per_chunk;
+  int64_t chunk_num;
+  int64_t col_block_num;
+};
+
+}  // namespace
+
+template<typename T>
+void NormalizationCpuKernelUtil<T>::ComputeStatistics(int64_t outer, int64_t channels,
+                                                      int64_t inner, float epsilon,
+                                                      float momentum, const T* x, T* mean,
+                                                      T* inv_variance, T* moving_mean,
+                                                      T* moving_variance) {
+  const int64_t count = outer * inner;
+  CHECK_GT(count, 0);
+  const auto Finish = [&](int64_t c, T channel_mean, T channel_m2) {
+    const T variance = channel_m2 / count;
+    mean[c] = channel_mean;
+    inv_variance[c] = static_cast<T>(1) / std::sqrt(variance + static_cast<T>(epsilon));
+    if (moving_mean != nullptr) {
+      moving_mean[c] = moving_mean[c] * momentum + channel_mean * (1 - momentum);
+    }
+    if (moving_variance != nullptr) {
+      const T unbiased_variance = channel_m2 / std::max<int64_t>(count - 1, 1);
+      moving_variance[c] = moving_variance[c] * momentum + unbiased_variance * (1 - momentum);
+    }
+  };
+  if (inner == 1) {
+    const auto Cols = GetWelfordCols<T>();
+    const ColChunks chunks(outer, channels);
+    std::vector<T> chunk_mean(chunks.chunk_num * channels);
+    std::vector<T> chunk_m2(chunks.chunk_num * channels);
+    chunks.ParallelForEachBlock([&](int64_t chunk, int64_t row_begin, int64_t row_num,
+                                    int64_t col_begin, int64_t col_num) {
+      const int64_t offset = chunk * channels + col_begin;
+      Cols(x + row_begin * channels + col_begin, row_num, col_num, channels,
+           chunk_mean.data() + offset, chunk_m2.data() + offset);
+    });
+    FOR_RANGE(int64_t, c, 0, channels) {
+      T channel_mean = chunk_mean.at(c);
+      T channel_m2 = chunk_m2.at(c);
+      FOR_RANGE(int64_t, chunk, 1, chunks.chunk_num) {
+        const int64_t row_num = std::min(outer - chunk * chunks.rows_per_chunk,
+                                         chunks.rows_per_chunk);
+        cpu_welford::Combine<T>(chunk * chunks.rows_per_chunk, &channel_mean, &channel_m2,
+                                row_num, chunk_mean.at(chunk * channels + c),
+                                chunk_m2.at(chunk * channels + c));
+      }
+      Finish(c, channel_mean, channel_m2);
+    }
+  } else {
+    const auto Row = GetWelfordRow<T>();
+    ParallelForTasks(channels, [&](int64_t c) {
+      T channel_mean = 0;
+      T channel_m2 = 0;
+      FOR_RANGE(int64_t, o, 0, outer) {
+        T row_mean = 0;
+        T row_m2 = 0;
+        Row(x + (o * channels + c) * inner, inner, &row_mean, &row_m2);
+        cpu_welford::Combine<T>(o * inner, &channel_mean, &channel_m2, inner, row_mean, row_m2);
+      }
+      Finish(c, channel_mean, channel_m2);
+    });
+  }
+}
+
+template<typename T>
+void NormalizationCpuKernelUtil<T>::ScaleShift(int64_t outer, int64_t channels, int64_t inner,
+                                               const T* x, const T* scale, const T* shift,
+                                               const T* addend, T* y, int32_t* relu_mask) {
+  const auto Row = GetScaleShiftRow<T>();
+  const auto MaskWords = GetReluMaskWords<T>();
+  const bool relu = relu_mask != nullptr;
+  const int64_t elem_cnt = outer * channels * inner;
+  ParallelForElemRanges(elem_cnt, [&](int64_t begin, int64_t end) {
+    ForEachSegment(begin, end, channels, inner,
+                   [&](int64_t offset, int64_t n, int64_t channel, bool param_per_elem) {
+                     Row(x + offset, n, scale + channel, shift + channel,
+                         addend == nullptr ? nullptr : addend + offset, relu, param_per_elem,
+                         y + offset);
+                   });
+    if (!relu) { return; }
+    const int64_t word_begin = begin / kMaskWordBits;
+    const int64_t full_word_end = end / kMaskWordBits;
+    MaskWords(y + begin, full_word_end - word_begin, relu_mask + word_begin);
+    if (full_word_end * kMaskWordBits < end) {
+      uint32_t bits = 0;
+      FOR_RANGE(int64_t, i, full_word_end * kMaskWordBits, end) {
+        bits |= static_cast<uint32_t>(y[i] > 0) << (i % kMaskWordBits);
+      }
+      relu_mask[full_word_end] = static_cast<int32_t>(bits);
+    }
+  });
+}
+
+template<typename T>
+void NormalizationCpuKernelUtil<T>::ReluBackward(int64_t elem_cnt, const int32_t* relu_mask,
+                                                 const T* dy, T* masked_dy) {
+  const auto Words = GetReluBackwardWords<T>();
+  ParallelForElemRanges(elem_cnt, [&](int64_t begin, int64_t end) {
+    const int64_t word_begin = begin / kMaskWordBits;
+    const int64_t full_word_end = end / kMaskWordBits;
+    Words(relu_mask + word_begin, full_word_end - word_begin, dy + begin, masked_dy + begin);
+    FOR_RANGE(int64_t, i, full_word_end * kMaskWordBits, end) {
+      const uint32_t bits = static_cast<uint32_t>(relu_mask[full_word_end]);
+      masked_dy[i] = ((bits >> (i % kMaskWordBits)) & 1U) ? dy[i] : 0;
+    }
+  });
+}
+
+template<typename T>
+void NormalizationCpuKernelUtil<T>::Backward(int64_t outer, int64_t channels, int64_t inner,
+                                             const T* x, const T* dy, const T* mean,
+                                             const T* inv_variance, const T* gamma, T* gamma_diff,
+                                             T* beta_diff, T* dx) {
+  const int64_t count = outer * inner;
+  // Sums of dy and dy * (x - mean) of each channel
+  std::vector<T> sum_dy(channels);
+  std::vector<T> sum_dy_x_centered(channels);
+  if (inner == 1) {
+    const auto SumsCols = GetGradSumsCols<T>();
+    const ColChunks chunks(outer, channels);
+    std::vector<T> chunk_sum_dy(chunks.chunk_num * channels);
+    std::vector<T> chunk_sum_dy_x_centered(chunks.chunk_num * channels);
+    chunks.ParallelForEachBlock([&](int64_t chunk, int64_t row_begin, int64_t row_num,
+                                    int64_t col_begin, int64_t col_num) {
+      const int64_t x_offset = row_begin * channels + col_begin;
+      const int64_t offset = chunk * channels + col_begin;
+      SumsCols(dy + x_offset, x + x_offset, row_num, col_num, channels, mean + col_begin,
+               chunk_sum_dy.data() + offset, chunk_sum_dy_x_centered.data() + offset);
+    });
+    CpuReduceCore<T, BinaryFuncAdd>::ColReduce(sum_dy.data(), chunk_sum_dy.data(), 1,
+                                               chunks.chunk_num, channels);
+    CpuReduceCore<T, BinaryFuncAdd>::ColReduce(sum_dy_x_centered.data(),
+                                               chunk_sum_dy_x_centered.data(), 1,
+                                               chunks.chunk_num, channels);
+  } else {
+    const auto SumsRow = GetGradSumsRow<T>();
+    ParallelForTasks(channels, [&](int64_t c) {
+      FOR_RANGE(int64_t, o, 0, outer) {
+        const int64_t offset = (o * channels + c) * inner;
+        SumsRow(dy + offset, x + offset, inner, mean[c], &sum_dy.at(c),
+                &sum_dy_x_centered.at(c));
+      }
+    });
+  }
+  // dx = dy * a + (x - mean) * b + c
+  std::vector<T> a(channels);
+  std::vector<T> b(channels);
+  std::vector<T> c(channels);
+  FOR_RANGE(int64_t, ch, 0, channels) {
+    gamma_diff[ch] = sum_dy_x_centered.at(ch) * inv_variance[ch];
+    beta_diff[ch] = sum_dy.at(ch);
+    a.at(ch) = gamma[ch] * inv_variance[ch];
+    b.at(ch) = -a.at(ch) * inv_variance[ch] * gamma_diff[ch] / count;
+    c.at(ch) = -a.at(ch) * beta_diff[ch] / count;
+  }
+  const auto Row = GetGradRow<T>();
+  ParallelForElemRanges(outer * channels * inner, [&](int64_t begin, int64_t end) {
+    ForEachSegment(begin, end, channels, inner,
+                   [&](int64_t offset, int64_t n, int64_t channel, bool param_per_elem) {
+                     Row(dy + offset, x + offset, n, a.data() + channel, b.data() + channel,
+                         c.data() + channel, mean + channel, param_per_elem, dx + offset);
+                   });
+  });
+}
+
+template struct NormalizationCpuKernelUtil<float>;
+template struct NormalizationCpuKernelUtil<double>;
+
+}  // namespace oneflow
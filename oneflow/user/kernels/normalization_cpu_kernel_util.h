@@ -0,0 +1,48 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_NORMALIZATION_CPU_KERNEL_UTIL_H_
+#define ONEFLOW_USER_KERNELS_NORMALIZATION_CPU_KERNEL_UTIL_H_
+
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+// Batch norm of x viewed as (outer, channels, inner), so inner is 1 for NHWC and H * W for NCHW.
+// Each channel is normalized over outer * inner elements.
+template<typename T>
+struct NormalizationCpuKernelUtil final {
+  // mean and inv_variance of each channel in a single Welford pass. The moving statistics, when
+  // not null, become moving * momentum + batch * (1 - momentum), with the unbiased variance.
+  static void ComputeStatistics(int64_t outer, int64_t channels, int64_t inner, float epsilon,
+                                float momentum, const T* x, T* mean, T* inv_variance,
+                                T* moving_mean, T* moving_variance);
+  // y = x * scale[c] + shift[c] + addend. With relu_mask, y is then passed through a relu and
+  // bit i % 32 of relu_mask[i / 32] tells whether y[i] is positive. addend may be null or alias y.
+  static void ScaleShift(int64_t outer, int64_t channels, int64_t inner, const T* x,
+                         const T* scale, const T* shift, const T* addend, T* y,
+                         int32_t* relu_mask);
+  // masked_dy[i] = dy[i] where the relu of the forward was positive, 0 elsewhere
+  static void ReluBackward(int64_t elem_cnt, const int32_t* relu_mask, const T* dy, T* masked_dy);
+  // gamma_diff = sum(dy * x_hat), beta_diff = sum(dy) and
+  // dx = gamma * inv_variance * (dy - beta_diff / n - x_hat * gamma_diff / n) for each channel
+  static void Backward(int64_t outer, int64_t channels, int64_t inner, const T* x, const T* dy,
+                       const T* mean, const T* inv_variance, const T* gamma, T* gamma_diff,
+                       T* beta_diff, T* dx);
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_NORMALIZATION_CPU_KERNEL_UTIL_H_
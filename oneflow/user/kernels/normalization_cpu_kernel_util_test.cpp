@@ -0,0 +1,257 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/normalization_cpu_kernel_util.h"
+#include "oneflow/core/kernel/cpu_kernel_test_util.h"
+#include <gtest/gtest.h>
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+int64_t ChannelOf(int64_t i, int64_t channels, int64_t inner) { return (i / inner) % channels; }
+
+// Two passes in double over (outer, channels, inner), as the reference of the float results
+void ReferenceStatistics(int64_t outer, int64_t channels, int64_t inner,
+                         const std::vector<float>& x, std::vector<double>* mean,
+                         std::vector<double>* variance) {
+  const int64_t count = outer * inner;
+  std::vector<double> sum(channels, 0);
+  FOR_RANGE(size_t, i, 0, x.size()) { sum.at(ChannelOf(i, channels, inner)) += x.at(i); }
+  FOR_RANGE(int64_t, c, 0, channels) { mean->at(c) = sum.at(c) / count; }
+  std::vector<double> sq_sum(channels, 0);
+  FOR_RANGE(size_t, i, 0, x.size()) {
+    const int64_t c = ChannelOf(i, channels, inner);
+    sq_sum.at(c) += (x.at(i) - mean->at(c)) * (x.at(i) - mean->at(c));
+  }
+  FOR_RANGE(int64_t, c, 0, channels) { variance->at(c) = sq_sum.at(c) / count; }
+}
+
+void ExpectNear(const std::vector<float>& actual, const std::vector<double>& expected,
+                double tolerance) {
+  ASSERT_EQ(actual.size(), expected.size());
+  FOR_RANGE(size_t, i, 0, actual.size()) {
+    ASSERT_NEAR(actual.at(i), expected.at(i), tolerance * std::max(1.0, std::abs(expected.at(i))))
+        << "at " << i;
+  }
+}
+
+// (outer, channels, inner) of NCHW and NHWC shapes, with sizes around the task boundaries
+std::vector<std::array<int64_t, 3>> TestShapes() {
+  return {{1, 1, 1},   {3, 5, 1},   {2, 3, 49},   {7, 64, 1},  {4, 16, 196},
+          {33, 1, 1001}, {1001, 33, 1}, {2, 300, 1}, {256, 300, 1}, {8, 3, 5000}};
+}
+
+}  // namespace
+
+TEST(NormalizationCpuKernelUtil, statistics_match_reference) {
+  ScopedGlobalThreadPool thread_pool;
+  const float epsilon = 1e-5;
+  const float momentum = 0.9;
+  for (const auto& shape : TestShapes()) {
+    const int64_t outer = shape.at(0);
+    const int64_t channels = shape.at(1);
+    const int64_t inner = shape.at(2);
+    const int64_t count = outer * inner;
+    // The offset makes E[x^2] - mean^2 lose precision, which Welford does not
+    const std::vector<float> x = RandomFloats(outer * channels * inner, 1, 99, 101);
+    std::vector<float> mean(channels);
+    std::vector<float> inv_variance(channels);
+    std::vector<float> moving_mean = RandomFloats(channels, 2);
+    std::vector<float> moving_variance = RandomFloats(channels, 3, 1, 3);
+    std::vector<double> expected_mean(channels);
+    std::vector<double> expected_variance(channels);
+    ReferenceStatistics(outer, channels, inner, x, &expected_mean, &expected_variance);
+    std::vector<double> expected_inv_variance(channels);
+    std::vector<double> expected_moving_mean(channels);
+    std::vector<double> expected_moving_variance(channels);
+    FOR_RANGE(int64_t, c, 0, channels) {
+      expected_inv_variance.at(c) = 1.0 / std::sqrt(expected_variance.at(c) + epsilon);
+      expected_moving_mean.at(c) =
+          moving_mean.at(c) * momentum + expected_mean.at(c) * (1 - momentum);
+      const double unbiased = expected_variance.at(c) * count / std::max<int64_t>(count - 1, 1);
+      expected_moving_variance.at(c) = moving_variance.at(c) * momentum + unbiased * (1 - momentum);
+    }
+    NormalizationCpuKernelUtil<float>::ComputeStatistics(
+        outer, channels, inner, epsilon, momentum, x.data(), mean.data(), inv_variance.data(),
+        moving_mean.data(), moving_variance.data());
+    ExpectNear(mean, expected_mean, 1e-5);
+    ExpectNear(inv_variance, expected_inv_variance, 1e-3);
+    ExpectNear(moving_mean, expected_moving_mean, 1e-5);
+    ExpectNear(moving_variance, expected_moving_variance, 1e-4);
+  }
+}
+
+TEST(NormalizationCpuKernelUtil, scale_shift_add_relu) {
+  ScopedGlobalThreadPool thread_pool;
+  for (const auto& shape : TestShapes()) {
+    const int64_t outer = shape.at(0);
+    const int64_t channels = shape.at(1);
+    const int64_t inner = shape.at(2);
+    const int64_t elem_cnt = outer * channels * inner;
+    const std::vector<float> x = RandomFloats(elem_cnt, 4);
+    const std::vector<float> addend = RandomFloats(elem_cnt + 1, 5);
+    const std::vector<float> scale = RandomFloats(channels, 6, 0, 2);
+    const std::vector<float> shift = RandomFloats(channels, 7);
+    std::vector<double> expected_y(elem_cnt);
+    FOR_RANGE(int64_t, i, 0, elem_cnt) {
+      const int64_t c = ChannelOf(i, channels, inner);
+      expected_y.at(i) = x.at(i) * scale.at(c) + shift.at(c);
+    }
+    std::vector<float> y(elem_cnt);
+    NormalizationCpuKernelUtil<float>::ScaleShift(outer, channels, inner, x.data(), scale.data(),
+                                                  shift.data(), nullptr, y.data(), nullptr);
+    ExpectNear(y, expected_y, 1e-6);
+
+    // The addend is added in place as with _add_to_output, then a relu records its mask
+    FOR_RANGE(int64_t, i, 0, elem_cnt) {
+      expected_y.at(i) = std::max(expected_y.at(i) + addend.at(i), 0.0);
+    }
+    const int64_t word_num = (elem_cnt + 31) / 32;
+    std::vector<int32_t> mask(word_num, -1);
+    y.assign(addend.begin(), addend.begin() + elem_cnt);
+    NormalizationCpuKernelUtil<float>::ScaleShift(outer, channels, inner, x.data(), scale.data(),
+                                                  shift.data(), y.data(), y.data(), mask.data());
+    ExpectNear(y, expected_y, 1e-6);
+    FOR_RANGE(int64_t, i, 0, word_num * 32) {
+      const bool bit = (static_cast<uint32_t>(mask.at(i / 32)) >> (i % 32)) & 1U;
+      ASSERT_EQ(bit, i < elem_cnt && y.at(i) > 0) << "at " << i;
+    }
+
+    const std::vector<float> dy = RandomFloats(elem_cnt + 2, 8);
+    std::vector<float> masked_dy(elem_cnt);
+    NormalizationCpuKernelUtil<float>::ReluBackward(elem_cnt, mask.data(), dy.data(),
+                                                    masked_dy.data());
+    FOR_RANGE(int64_t, i, 0, elem_cnt) {
+      ASSERT_EQ(masked_dy.at(i), y.at(i) > 0 ? dy.at(i) : 0) << "at " << i;
+    }
+  }
+}
+
+TEST(NormalizationCpuKernelUtil, backward_match_reference) {
+  ScopedGlobalThreadPool thread_pool;
+  for (const auto& shape : TestShapes()) {
+    const int64_t outer = shape.at(0);
+    const int64_t channels = shape.at(1);
+    const int64_t inner = shape.at(2);
+    const int64_t count = outer * inner;
+    const int64_t elem_cnt = outer * channels * inner;
+    const std::vector<float> x = RandomFloats(elem_cnt, 9, 2, 4);
+    const std::vector<float> dy = RandomFloats(elem_cnt + 1, 10, -0.5, 1.5);
+    const std::vector<float> gamma = RandomFloats(channels, 11, 0, 2);
+    std::vector<double> mean(channels);
+    std::vector<double> variance(channels);
+    ReferenceStatistics(outer, channels, inner, x, &mean, &variance);
+    // The reference takes the same float statistics as the kernel
+    std::vector<float> float_mean(channels);
+    std::vector<float> float_inv_variance(channels);
+    FOR_RANGE(int64_t, c, 0, channels) {
+      float_mean.at(c) = mean.at(c);
+      float_inv_variance.at(c) = 1.0 / std::sqrt(variance.at(c) + 1e-5);
+    }
+    std::vector<double> expected_gamma_diff(channels, 0);
+    std::vector<double> expected_beta_diff(channels, 0);
+    FOR_RANGE(int64_t, i, 0, elem_cnt) {
+      const int64_t c = ChannelOf(i, channels, inner);
+      const double x_hat = (x.at(i) - float_mean.at(c)) * float_inv_variance.at(c);
+      expected_gamma_diff.at(c) += dy.at(i) * x_hat;
+      expected_beta_diff.at(c) += dy.at(i);
+    }
+    std::vector<double> expected_dx(elem_cnt);
+    FOR_RANGE(int64_t, i, 0, elem_cnt) {
+      const int64_t c = ChannelOf(i, channels, inner);
+      const double x_hat = (x.at(i) - float_mean.at(c)) * float_inv_variance.at(c);
+      expected_dx.at(i) = gamma.at(c) * float_inv_variance.at(c)
+                          * (dy.at(i) - expected_beta_diff.at(c) / count
+                             - x_hat * expected_gamma_diff.at(c) / count);
+    }
+    std::vector<float> gamma_diff(channels);
+    std::vector<float> beta_diff(channels);
+    std::vector<float> dx(elem_cnt);
+    NormalizationCpuKernelUtil<float>::Backward(
+        outer, channels, inner, x.data(), dy.data(), float_mean.data(),
+        float_inv_variance.data(), gamma.data(), gamma_diff.data(), beta_diff.data(), dx.data());
+    const double tolerance = 1e-5 * std::sqrt(static_cast<double>(count));
+    ExpectNear(gamma_diff, expected_gamma_diff, tolerance);
+    ExpectNear(beta_diff, expected_beta_diff, tolerance);
+    ExpectNear(dx, expected_dx, 1e-3);
+  }
+}
+
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST(NormalizationCpuKernelUtil, DISABLED_benchmark_resnet_shapes) {
+  ScopedGlobalThreadPool thread_pool(0);
+  const int32_t iter_num = 10;
+  // Batch 32 activations of ResNet-50 stages
+  for (const auto& hwc : std::vector<std::array<int64_t, 2>>{{56 * 56, 256},
+                                                              {28 * 28, 512},
+                                                              {14 * 14, 1024},
+                                                              {7 * 7, 2048}}) {
+    const int64_t batch = 32;
+    const int64_t spatial = hwc.at(0);
+    const int64_t channels = hwc.at(1);
+    const int64_t elem_cnt = batch * spatial * channels;
+    const std::vector<float> x = RandomFloats(elem_cnt, 12);
+    const std::vector<float> dy = RandomFloats(elem_cnt + 1, 13);
+    const std::vector<float> gamma = RandomFloats(channels, 14, 0, 2);
+    std::vector<float> y(elem_cnt);
+    std::vector<float> dx(elem_cnt);
+    std::vector<float> mean(channels);
+    std::vector<float> inv_variance(channels);
+    std::vector<float> moving_mean(channels, 0);
+    std::vector<float> moving_variance(channels, 1);
+    std::vector<float> gamma_diff(channels);
+    std::vector<float> beta_diff(channels);
+    std::vector<int32_t> mask((elem_cnt + 31) / 32);
+    const auto Seconds = [&](const std::function<void()>& Run) {
+      Run();
+      const auto start = std::chrono::steady_clock::now();
+      FOR_RANGE(int32_t, i, 0, iter_num) { Run(); }
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()
+             / iter_num;
+    };
+    for (const bool nhwc : {false, true}) {
+      const int64_t outer = nhwc ? batch * spatial : batch;
+      const int64_t inner = nhwc ? 1 : spatial;
+      // Reads x twice, writes y
+      const double forward = Seconds([&]() {
+        NormalizationCpuKernelUtil<float>::ComputeStatistics(
+            outer, channels, inner, 1e-5, 0.9, x.data(), mean.data(), inv_variance.data(),
+            moving_mean.data(), moving_variance.data());
+        NormalizationCpuKernelUtil<float>::ScaleShift(outer, channels, inner, x.data(),
+                                                      inv_variance.data(), mean.data(), dy.data(),
+                                                      y.data(), mask.data());
+      });
+      // Reads dy and x twice, writes dx
+      const double backward = Seconds([&]() {
+        NormalizationCpuKernelUtil<float>::Backward(
+            outer, channels, inner, x.data(), dy.data(), mean.data(), inv_variance.data(),
+            gamma.data(), gamma_diff.data(), beta_diff.data(), dx.data());
+      });
+      const double forward_bytes = 4.0 * elem_cnt * sizeof(float);
+      const double backward_bytes = 5.0 * elem_cnt * sizeof(float);
+      LOG(INFO) << "normalization " << (nhwc ? "NHWC" : "NCHW") << " spatial " << spatial
+                << " channels " << channels << ": forward add relu "
+                << forward_bytes / forward / 1e9 << " GB/s, backward "
+                << backward_bytes / backward / 1e9 << " GB/s";
+    }
+  }
+}
+
+}  // namespace test
+
+}  // namespace oneflow
@@ -15,6 +15,7 @@ limitations under the License.
 */
 #include "oneflow/core/framework/framework.h"
 #include "oneflow/user/kernels/op_kernel_state_wrapper.h"
+#include "oneflow/user/kernels/pool_cpu_kernel_util.h"
 #include "oneflow/user/utils/pool_util.h"
 #include "oneflow/core/common/eigen_util.h"
 
@@ -33,6 +34,31 @@ struct PoolOpKernelState final : public user_op::OpKernelState {
   }
 };
 
+// Pooling whose depth is trivial, which covers every 1d and 2d pooling, runs as a 2d one
+bool GetPool2dParams(const Params3D& params_3d, Pool2dCpuParams* params) {
+  const Shape& in = params_3d.GetXShape5D();
+  const Shape& out = params_3d.GetYShape5D();
+  const std::vector<int32_t>& pool_size = params_3d.pool_size_3d();
+  const std::vector<int32_t>& strides = params_3d.strides_3d();
+  const std::vector<int32_t>& padding_before = params_3d.padding_before_3d();
+  if (in.At(2) != 1 || out.At(2) != 1 || pool_size.at(0) != 1 || padding_before.at(0) != 0) {
+    return false;
+  }
+  params->batch_num = in.At(0);
+  params->channel_num = in.At(1);
+  params->in_height = in.At(3);
+  params->in_width = in.At(4);
+  params->out_height = out.At(3);
+  params->out_width = out.At(4);
+  params->pool_height = pool_size.at(1);
+  params->pool_width = pool_size.at(2);
+  params->stride_height = strides.at(1);
+  params->stride_width = strides.at(2);
+  params->pad_height = padding_before.at(1);
+  params->pad_width = padding_before.at(2);
+  return true;
+}
+
 template<typename T>
 struct PoolCpuKernelUtil {
  public:
@@ -245,6 +271,12 @@ struct PoolCpuKernelUtil {
     CHECK(pool_state != nullptr);
     pool_state->Update(x->shape());
     const std::string& data_format = ctx->Attr<std::string>("data_format");
+    Pool2dCpuParams params_2d{};
+    if (GetPool2dParams(pool_state->GetParams3D(), &params_2d)) {
+      Pool2dCpuKernelUtil<T>::AvgForward(params_2d, data_format == "channels_last", x->dptr<T>(),
+                                         y->mut_dptr<T>());
+      return;
+    }
     if (data_format == "channels_first") {
       CFirstForward(
           pool_state->GetParams3D(), x, y, GetZeroVal<T>, [](const T& lhs, T& rhs) { rhs += lhs; },
@@ -271,6 +303,12 @@ struct PoolCpuKernelUtil {
     CHECK(pool_state != nullptr);
     pool_state->Update(x->shape());
     const std::string& data_format = ctx->Attr<std::string>("data_format");
+    Pool2dCpuParams params_2d{};
+    if (GetPool2dParams(pool_state->GetParams3D(), &params_2d)) {
+      Pool2dCpuKernelUtil<T>::AvgBackward(params_2d, data_format == "channels_last", dy->dptr<T>(),
+                                          dx->mut_dptr<T>());
+      return;
+    }
     if (data_format == "channels_first") {
       CFirstBackward(pool_state->GetParams3D(), dy, y, x, dx,
                      [](const T& in, const T& out, const T& out_diff, const int64_t size,
@@ -294,6 +332,12 @@ struct PoolCpuKernelUtil {
     CHECK(pool_state != nullptr);
     pool_state->Update(x->shape());
     const std::string& data_format = ctx->Attr<std::string>("data_format");
+    Pool2dCpuParams params_2d{};
+    if (GetPool2dParams(pool_state->GetParams3D(), &params_2d)) {
+      Pool2dCpuKernelUtil<T>::MaxForward(params_2d, data_format == "channels_last", x->dptr<T>(),
+                                         y->mut_dptr<T>());
+      return;
+    }
     if (data_format == "channels_first") {
       CFirstForward(
           pool_state->GetParams3D(), x, y, GetMinVal<T>,
@@ -323,6 +367,12 @@ struct PoolCpuKernelUtil {
     CHECK(pool_state != nullptr);
     pool_state->Update(x->shape());
     const std::string& data_format = ctx->Attr<std::string>("data_format");
+    Pool2dCpuParams params_2d{};
+    if (GetPool2dParams(pool_state->GetParams3D(), &params_2d)) {
+      Pool2dCpuKernelUtil<T>::MaxBackward(params_2d, data_format == "channels_last", x->dptr<T>(),
+                                          y->dptr<T>(), dy->dptr<T>(), dx->mut_dptr<T>());
+      return;
+    }
     if (data_format == "channels_first") {
       CFirstBackward(
           pool_state->GetParams3D(), dy, y, x, dx,
@@ -0,0 +1,417 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/pool_cpu_kernel_util.h"
+#include "oneflow/core/common/cpu_isa.h"
+#include "oneflow/core/thread/thread_pool.h"
+
+namespace oneflow {
+
+namespace {
+
+// Elements of x handled by a task
+constexpr int64_t kTaskElemNum = 1 << 15;
+// Channels of an NHWC grad task
+constexpr int64_t kChannelBlockSize = 256;
+
+struct Window final {
+  int64_t begin;
+  int64_t end;
+};
+
+ALWAYS_INLINE inline Window GetWindow(int64_t out_index, int64_t stride, int64_t pad,
+                                      int64_t pool, int64_t in) {
+  const int64_t start = out_index * stride - pad;
+  return Window{std::max<int64_t>(start, 0), std::min(start + pool, in)};
+}
+
+template<typename T, bool is_max>
+ALWAYS_INLINE inline T InitVal() {
+  return is_max ? std::numeric_limits<T>::lowest() : static_cast<T>(0);
+}
+
+// Written as a select so that max maps to the vector max instruction
+template<typename T, bool is_max>
+ALWAYS_INLINE inline T Accumulate(T acc, T val) {
+  return is_max ? (val > acc ? val : acc) : acc + val;
+}
+
+// The output at (oh, ow) of an NCHW plane, for the windows crossing the border
+template<typename T, bool is_max>
+ALWAYS_INLINE inline T ForwardWindow(const Pool2dCpuParams& p, const Window& hw, int64_t ow,
+                                     const T* x) {
+  const Window ww = GetWindow(ow, p.stride_width, p.pad_width, p.pool_width, p.in_width);
+  T res = InitVal<T, is_max>();
+  FOR_RANGE(int64_t, h, hw.begin, hw.end) {
+    FOR_RANGE(int64_t, w, ww.begin, ww.end) {
+      res = Accumulate<T, is_max>(res, x[h * p.in_width + w]);
+    }
+  }
+  if (!is_max) { res /= (hw.end - hw.begin) * (ww.end - ww.begin); }
+  return res;
+}
+
+// An NCHW plane. The outputs in [ow_begin, ow_end) have their windows inside x along the width,
+// so each tap of the window is a strided sweep over the output row which gets vectorized.
+// stride is the width stride when known at compile time, 0 otherwise.
+template<typename T, bool is_max, int64_t stride>
+ALWAYS_INLINE inline void ForwardPlane(const Pool2dCpuParams& p, int64_t ow_begin,
+                                       int64_t ow_end, const T* x, T* y) {
+  const int64_t sw = stride > 0 ? stride : p.stride_width;
+  const int64_t n = ow_end - ow_begin;
+  FOR_RANGE(int64_t, oh, 0, p.out_height) {
+    const Window hw = GetWindow(oh, p.stride_height, p.pad_height, p.pool_height, p.in_height);
+    T* y_row = y + oh * p.out_width;
+    FOR_RANGE(int64_t, ow, 0, ow_begin) { y_row[ow] = ForwardWindow<T, is_max>(p, hw, ow, x); }
+    FOR_RANGE(int64_t, ow, ow_end, p.out_width) {
+      y_row[ow] = ForwardWindow<T, is_max>(p, hw, ow, x);
+    }
+    T* acc = y_row + ow_begin;
+    std::fill_n(acc, n, InitVal<T, is_max>());
+    FOR_RANGE(int64_t, h, hw.begin, hw.end) {
+      FOR_RANGE(int64_t, kw, 0, p.pool_width) {
+        const T* x_tap = x + h * p.in_width + ow_begin * sw - p.pad_width + kw;
+        for (int64_t i = 0; i < n; ++i) { acc[i] = Accumulate<T, is_max>(acc[i], x_tap[i * sw]); }
+      }
+    }
+    if (!is_max) {
+      const T size = (hw.end - hw.begin) * p.pool_width;
+      for (int64_t i = 0; i < n; ++i) { acc[i] /= size; }
+    }
+  }
+}
+
+// The output row oh of an NHWC image, vectorized over the channels
+template<typename T, bool is_max>
+ALWAYS_INLINE inline void ForwardRowNhwc(const Pool2dCpuParams& p, int64_t oh, const T* x,
+                                         T* y_row) {
+  const int64_t channel_num = p.channel_num;
+  const Window hw = GetWindow(oh, p.stride_height, p.pad_height, p.pool_height, p.in_height);
+  FOR_RANGE(int64_t, ow, 0, p.out_width) {
+    const Window ww = GetWindow(ow, p.stride_width, p.pad_width, p.pool_width, p.in_width);
+    T* y_pixel = y_row + ow * channel_num;
+    std::fill_n(y_pixel, channel_num, InitVal<T, is_max>());
+    FOR_RANGE(int64_t, h, hw.begin, hw.end) {
+      FOR_RANGE(int64_t, w, ww.begin, ww.end) {
+        const T* x_pixel = x + (h * p.in_width + w) * channel_num;
+        for (int64_t c = 0; c < channel_num; ++c) {
+          y_pixel[c] = Accumulate<T, is_max>(y_pixel[c], x_pixel[c]);
+        }
+      }
+    }
+    if (!is_max) {
+      const T size = (hw.end - hw.begin) * (ww.end - ww.begin);
+      for (int64_t c = 0; c < channel_num; ++c) { y_pixel[c] /= size; }
+    }
+  }
+}
+
+// Scatters the grad of output (oh, ow) of an NCHW plane, for the windows crossing the border.
+// Avg pooling has no x and y.
+template<typename T, bool is_max>
+ALWAYS_INLINE inline void BackwardWindow(const Pool2dCpuParams& p, const Window& hw, int64_t ow,
+                                         const T* x, const T* y, T dy, T* dx) {
+  const Window ww = GetWindow(ow, p.stride_width, p.pad_width, p.pool_width, p.in_width);
+  const T size = (hw.end - hw.begin) * (ww.end - ww.begin);
+  FOR_RANGE(int64_t, h, hw.begin, hw.end) {
+    FOR_RANGE(int64_t, w, ww.begin, ww.end) {
+      const int64_t index = h * p.in_width + w;
+      if (is_max) {
+        if (x[index] == *y) { dx[index] += dy; }
+      } else {
+        dx[index] += dy / size;
+      }
+    }
+  }
+}
+
+// The grad of an NCHW plane, tap by tap as ForwardPlane. The outputs of a sweep hit distinct
+// elements of dx, so the sweep has no dependence. scaled_dy has out_width elements. Avg pooling
+// has no x and y.
+template<typename T, bool is_max, int64_t stride>
+ALWAYS_INLINE inline void BackwardPlane(const Pool2dCpuParams& p, int64_t ow_begin,
+                                        int64_t ow_end, const T* x, const T* y, const T* dy,
+                                        T* scaled_dy, T* dx) {
+  const int64_t sw = stride > 0 ? stride : p.stride_width;
+  const int64_t n = ow_end - ow_begin;
+  std::fill_n(dx, p.in_height * p.in_width, static_cast<T>(0));
+  FOR_RANGE(int64_t, oh, 0, p.out_height) {
+    const Window hw = GetWindow(oh, p.stride_height, p.pad_height, p.pool_height, p.in_height);
+    const int64_t row_offset = oh * p.out_width;
+    const T* y_row = is_max ? y + row_offset : nullptr;
+    const T* dy_row = dy + row_offset;
+    FOR_RANGE(int64_t, ow, 0, ow_begin) {
+      BackwardWindow<T, is_max>(p, hw, ow, x, y_row + ow, dy_row[ow], dx);
+    }
+    FOR_RANGE(int64_t, ow, ow_end, p.out_width) {
+      BackwardWindow<T, is_max>(p, hw, ow, x, y_row + ow, dy_row[ow], dx);
+    }
+    const T* dy_sweep = dy_row + ow_begin;
+    if (!is_max) {
+      const T size = (hw.end - hw.begin) * p.pool_width;
+      for (int64_t i = 0; i < n; ++i) { scaled_dy[i] = dy_sweep[i] / size; }
+      dy_sweep = scaled_dy;
+    }
+    FOR_RANGE(int64_t, h, hw.begin, hw.end) {
+      FOR_RANGE(int64_t, kw, 0, p.pool_width) {
+        const int64_t offset = h * p.in_width + ow_begin * sw - p.pad_width + kw;
+        T* dx_tap = dx + offset;
+        if (is_max) {
+          const T* x_tap = x + offset;
+          const T* y_sweep = y_row + ow_begin;
+          for (int64_t i = 0; i < n; ++i) {
+            dx_tap[i * sw] += x_tap[i * sw] == y_sweep[i] ? dy_sweep[i] : static_cast<T>(0);
+          }
+        } else {
+          for (int64_t i = 0; i < n; ++i) { dx_tap[i * sw] += dy_sweep[i]; }
+        }
+      }
+    }
+  }
+}
+
+// The grad of channels [c, c + channel_num) of an NHWC image, x, y, dy and dx pointing at c.
+// scaled_dy has channel_num elements. Avg pooling has no x and y.
+template<typename T, bool is_max>
+ALWAYS_INLINE inline void BackwardBlockNhwc(const Pool2dCpuParams& p, int64_t channel_num,
+                                            const T* x, const T* y, const T* dy, T* scaled_dy,
+                                            T* dx) {
+  const int64_t pixel_stride = p.channel_num;
+  FOR_RANGE(int64_t, i, 0, p.in_height * p.in_width) {
+    std::fill_n(dx + i * pixel_stride, channel_num, static_cast<T>(0));
+  }
+  FOR_RANGE(int64_t, oh, 0, p.out_height) {
+    const Window hw = GetWindow(oh, p.stride_height, p.pad_height, p.pool_height, p.in_height);
+    FOR_RANGE(int64_t, ow, 0, p.out_width) {
+      const Window ww = GetWindow(ow, p.stride_width, p.pad_width, p.pool_width, p.in_width);
+      const int64_t out_offset = (oh * p.out_width + ow) * pixel_stride;
+      const T* dy_pixel = dy + out_offset;
+      if (!is_max) {
+        const T size = (hw.end - hw.begin) * (ww.end - ww.begin);
+        for (int64_t c = 0; c < channel_num; ++c) { scaled_dy[c] = dy_pixel[c] / size; }
+        dy_pixel = scaled_dy;
+      }
+      FOR_RANGE(int64_t, h, hw.begin, hw.end) {
+        FOR_RANGE(int64_t, w, ww.begin, ww.end) {
+          const int64_t in_offset = (h * p.in_width + w) * pixel_stride;
+          T* dx_pixel = dx + in_offset;
+          if (is_max) {
+            const T* x_pixel = x + in_offset;
+            const T* y_pixel = y + out_offset;
+            for (int64_t c = 0; c < channel_num; ++c) {
+              dx_pixel[c] += x_pixel[c] == y_pixel[c] ? dy_pixel[c] : static_cast<T>(0);
+            }
+          } else {
+            for (int64_t c = 0; c < channel_num; ++c) { dx_pixel[c] += dy_pixel[c]; }
+          }
+        }
+      }
+    }
+  }
+}
+
+#define DEFINE_POOL_ISA_KERNELS(suffix, target)                                                 \
+  template<typename T, bool is_max>                                                             \
+  target void ForwardPlane##suffix(const Pool2dCpuParams& p, int64_t ow_begin, int64_t ow_end,  \
+                                   const T* x, T* y) {                                          \
+    if (p.stride_width == 1) {                                                                  \
+      ForwardPlane<T, is_max, 1>(p, ow_begin, ow_end, x, y);                                    \
+    } else if (p.stride_width == 2) {                                                           \
+      ForwardPlane<T, is_max, 2>(p, ow_begin, ow_end, x, y);                                    \
+    } else {                                                                                    \
+      ForwardPlane<T, is_max, 0>(p, ow_begin, ow_end, x, y);                                    \
+    }                                                                                           \
+  }                                                                                             \
+  template<typename T, bool is_max>                                                             \
+  target void ForwardRowNhwc##suffix(const Pool2dCpuParams& p, int64_t oh, const T* x,          \
+                                     T* y_row) {                                                \
+    ForwardRowNhwc<T, is_max>(p, oh, x, y_row);                                                 \
+  }                                                                                             \
+  template<typename T, bool is_max>                                                             \
+  target void BackwardPlane##suffix(const Pool2dCpuParams& p, int64_t ow_begin, int64_t ow_end, \
+                                    const T* x, const T* y, const T* dy, T* scaled_dy, T* dx) { \
+    if (p.stride_width == 1) {                                                                  \
+      BackwardPlane<T, is_max, 1>(p, ow_begin, ow_end, x, y, dy, scaled_dy, dx);                \
+    } else if (p.stride_width == 2) {                                                           \
+      BackwardPlane<T, is_max, 2>(p, ow_begin, ow_end, x, y, dy, scaled_dy, dx);                \
+    } else {                                                                                    \
+      BackwardPlane<T, is_max, 0>(p, ow_begin, ow_end, x, y, dy, scaled_dy, dx);                \
+    }                                                                                           \
+  }                                                                                             \
+  template<typename T, bool is_max>                                                             \
+  target void BackwardBlockNhwc##suffix(const Pool2dCpuParams& p, int64_t channel_num,          \
+                                        const T* x, const T* y, const T* dy, T* scaled_dy,      \
+                                        T* dx) {                                                \
+    BackwardBlockNhwc<T, is_max>(p, channel_num, x, y, dy, scaled_dy, dx);                      \
+  }
+DEFINE_POOL_ISA_KERNELS(Default, )
+#ifdef OF_CPU_ISA_DISPATCH_ENABLED
+DEFINE_POOL_ISA_KERNELS(Avx2, OF_CPU_TARGET_AVX2)
+DEFINE_POOL_ISA_KERNELS(Avx512, OF_CPU_TARGET_AVX512)
+#endif
+#undef DEFINE_POOL_ISA_KERNELS
+
+#ifdef OF_CPU_ISA_DISPATCH_ENABLED
+#define OF_POOL_ISA_CASES(func)                          \
+  case CpuIsa::kAvx512: return &func##Avx512<T, is_max>; \
+  case CpuIsa::kAvx2: return &func##Avx2<T, is_max>;
+#else
+#define OF_POOL_ISA_CASES(func)
+#endif
+#define DEFINE_POOL_ISA_GETTER(func)                \
+  template<typename T, bool is_max>                 \
+  decltype(&func##Default<T, is_max>) Get##func() { \
+    switch (GetCpuIsa()) {                          \
+      OF_POOL_ISA_CASES(func)                       \
+      default: return &func##Default<T, is_max>;    \
+    }                                               \
+  }
+DEFINE_POOL_ISA_GETTER(ForwardPlane)
+DEFINE_POOL_ISA_GETTER(ForwardRowNhwc)
+DEFINE_POOL_ISA_GETTER(BackwardPlane)
+DEFINE_POOL_ISA_GETTER(BackwardBlockNhwc)
+#undef DEFINE_POOL_ISA_GETTER
+#undef OF_POOL_ISA_CASES
+
+// Runs DoRange over ranges of tasks of about task_elem_cnt elements each
+void ParallelForTaskRanges(int64_t task_num, int64_t task_elem_cnt,
+                           const std::function<void(int64_t, int64_t)>& DoRange) {
+  const int64_t grain = std::max<int64_t>(kTaskElemNum / std::max<int64_t>(task_elem_cnt, 1), 1);
+  ThreadPool* thread_pool = Global<ThreadPool>::Get();
+  if (task_num <= grain || thread_pool == nullptr || thread_pool->thread_num() <= 1) {
+    DoRange(0, task_num);
+    return;
+  }
+  thread_pool->ParallelFor(0, task_num, grain, DoRange);
+}
+
+// [ow_begin, ow_end) of the outputs whose windows lie inside x along the width
+void GetInteriorRange(const Pool2dCpuParams& p, int64_t* ow_begin, int64_t* ow_end) {
+  *ow_begin = 0;
+  while (*ow_begin < p.out_width && *ow_begin * p.stride_width - p.pad_width < 0) {
+    *ow_begin += 1;
+  }
+  *ow_end = *ow_begin;
+  while (*ow_end < p.out_width
+         && *ow_end * p.stride_width - p.pad_width + p.pool_width <= p.in_width) {
+    *ow_end += 1;
+  }
+}
+
+template<typename T, bool is_max>
+void Forward(const Pool2dCpuParams& p, bool channels_last, const T* x, T* y) {
+  const int64_t in_plane_size = p.in_height * p.in_width;
+  const int64_t out_plane_size = p.out_height * p.out_width;
+  if (channels_last) {
+    // Tasks over N x OH
+    const auto Row = GetForwardRowNhwc<T, is_max>();
+    const int64_t row_size = p.out_width * p.channel_num;
+    ParallelForTaskRanges(p.batch_num * p.out_height, p.pool_height * p.in_width * p.channel_num,
+                          [&](int64_t begin, int64_t end) {
+                            FOR_RANGE(int64_t, task, begin, end) {
+                              const int64_t n = task / p.out_height;
+                              Row(p, task % p.out_height, x + n * in_plane_size * p.channel_num,
+                                  y + task * row_size);
+                            }
+                          });
+  } else {
+    // Tasks over N x C
+    int64_t ow_begin = 0;
+    int64_t ow_end = 0;
+    GetInteriorRange(p, &ow_begin, &ow_end);
+    const auto Plane = GetForwardPlane<T, is_max>();
+    ParallelForTaskRanges(p.batch_num * p.channel_num, in_plane_size,
+                          [&](int64_t begin, int64_t end) {
+                            FOR_RANGE(int64_t, plane, begin, end) {
+                              Plane(p, ow_begin, ow_end, x + plane * in_plane_size,
+                                    y + plane * out_plane_size);
+                            }
+                          });
+  }
+}
+
+template<typename T, bool is_max>
+void Backward(const Pool2dCpuParams& p, bool channels_last, const T* x, const T* y, const T* dy,
+              T* dx) {
+  const int64_t in_plane_size = p.in_height * p.in_width;
+  const int64_t out_plane_size = p.out_height * p.out_width;
+  if (channels_last) {
+    // Tasks over N x blocks of C, the windows of an image overlap in dx
+    const auto Block = GetBackwardBlockNhwc<T, is_max>();
+    const int64_t block_num = RoundUp(p.channel_num, kChannelBlockSize) / kChannelBlockSize;
+    ParallelForTaskRanges(
+        p.batch_num * block_num, in_plane_size * std::min(p.channel_num, kChannelBlockSize),
+        [&](int64_t begin, int64_t end) {
+          std::vector<T> scaled_dy(kChannelBlockSize);
+          FOR_RANGE(int64_t, task, begin, end) {
+            const int64_t n = task / block_num;
+            const int64_t c = (task % block_num) * kChannelBlockSize;
+            const int64_t in_offset = n * in_plane_size * p.channel_num + c;
+            const int64_t out_offset = n * out_plane_size * p.channel_num + c;
+            Block(p, std::min(p.channel_num - c, kChannelBlockSize),
+                  x == nullptr ? nullptr : x + in_offset, y == nullptr ? nullptr : y + out_offset,
+                  dy + out_offset, scaled_dy.data(), dx + in_offset);
+          }
+        });
+  } else {
+    // Tasks over N x C
+    int64_t ow_begin = 0;
+    int64_t ow_end = 0;
+    GetInteriorRange(p, &ow_begin, &ow_end);
+    const auto Plane = GetBackwardPlane<T, is_max>();
+    ParallelForTaskRanges(p.batch_num * p.channel_num, in_plane_size,
+                          [&](int64_t begin, int64_t end) {
+                            std::vector<T> scaled_dy(p.out_width);
+                            FOR_RANGE(int64_t, plane, begin, end) {
+                              const int64_t in_offset = plane * in_plane_size;
+                              const int64_t out_offset = plane * out_plane_size;
+                              Plane(p, ow_begin, ow_end, x == nullptr ? nullptr : x + in_offset,
+                                    y == nullptr ? nullptr : y + out_offset, dy + out_offset,
+                                    scaled_dy.data(), dx + in_offset);
+                            }
+                          });
+  }
+}
+
+}  // namespace
+
+template<typename T>
+void Pool2dCpuKernelUtil<T>::MaxForward(const Pool2dCpuParams& params, bool channels_last,
+                                        const T* x, T* y) {
+  Forward<T, true>(params, channels_last, x, y);
+}
+
+template<typename T>
+void Pool2dCpuKernelUtil<T>::AvgForward(const Pool2dCpuParams& params, bool channels_last,
+                                        const T* x, T* y) {
+  Forward<T, false>(params, channels_last, x, y);
+}
+
+template<typename T>
+void Pool2dCpuKernelUtil<T>::MaxBackward(const Pool2dCpuParams& params, bool channels_last,
+                                         const T* x, const T* y, const T* dy, T* dx) {
+  Backward<T, true>(params, channels_last, x, y, dy, dx);
+}
+
+template<typename T>
+void Pool2dCpuKernelUtil<T>::AvgBackward(const Pool2dCpuParams& params, bool channels_last,
+                                         const T* dy, T* dx) {
+  Backward<T, false>(params, channels_last, nullptr, nullptr, dy, dx);
+}
+
+template struct Pool2dCpuKernelUtil<float>;
+template struct Pool2dCpuKernelUtil<double>;
+
+}  // namespace oneflow
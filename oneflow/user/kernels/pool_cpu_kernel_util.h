@@ -0,0 +1,53 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_POOL_CPU_KERNEL_UTIL_H_
+#define ONEFLOW_USER_KERNELS_POOL_CPU_KERNEL_UTIL_H_
+
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+// The geometry of a 2d pooling, the 1d one being the case of in_height == out_height == 1.
+// A window spans [max(o * stride - pad, 0), min(o * stride - pad + pool, in)) on each axis.
+struct Pool2dCpuParams final {
+  int64_t batch_num;
+  int64_t channel_num;
+  int64_t in_height;
+  int64_t in_width;
+  int64_t out_height;
+  int64_t out_width;
+  int64_t pool_height;
+  int64_t pool_width;
+  int64_t stride_height;
+  int64_t stride_width;
+  int64_t pad_height;
+  int64_t pad_width;
+};
+
+// Pooling of NCHW (channels_last false) or NHWC tensors. The averages are over the part of the
+// window inside x, and the max grad goes to every element of the window equal to y.
+template<typename T>
+struct Pool2dCpuKernelUtil final {
+  static void MaxForward(const Pool2dCpuParams& params, bool channels_last, const T* x, T* y);
+  static void AvgForward(const Pool2dCpuParams& params, bool channels_last, const T* x, T* y);
+  static void MaxBackward(const Pool2dCpuParams& params, bool channels_last, const T* x,
+                          const T* y, const T* dy, T* dx);
+  static void AvgBackward(const Pool2dCpuParams& params, bool channels_last, const T* dy, T* dx);
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_POOL_CPU_KERNEL_UTIL_H_
@@ -0,0 +1,186 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/pool_cpu_kernel_util.h"
+#include "oneflow/core/kernel/cpu_kernel_test_util.h"
+#include <gtest/gtest.h>
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+Pool2dCpuParams MakeParams(int64_t batch_num, int64_t channel_num, int64_t in_height,
+                           int64_t in_width, int64_t pool, int64_t stride, int64_t pad) {
+  Pool2dCpuParams p{};
+  p.batch_num = batch_num;
+  p.channel_num = channel_num;
+  p.in_height = in_height;
+  p.in_width = in_width;
+  p.pool_height = pool;
+  p.pool_width = pool;
+  p.stride_height = stride;
+  p.stride_width = stride;
+  p.pad_height = pad;
+  p.pad_width = pad;
+  // As with ceil_mode, the last window may start in the padding
+  p.out_height = (in_height + 2 * pad - pool + stride - 1) / stride + 1;
+  p.out_width = (in_width + 2 * pad - pool + stride - 1) / stride + 1;
+  return p;
+}
+
+int64_t Index(const Pool2dCpuParams& p, bool channels_last, int64_t n, int64_t c, int64_t h,
+              int64_t w, int64_t height, int64_t width) {
+  return channels_last ? ((n * height + h) * width + w) * p.channel_num + c
+                       : ((n * p.channel_num + c) * height + h) * width + w;
+}
+
+// The loop nest the CPU pool kernels used before, as the reference
+void NaivePool(const Pool2dCpuParams& p, bool channels_last, bool is_max, bool backward,
+               const std::vector<float>& x, const std::vector<float>& y,
+               const std::vector<float>& dy, std::vector<float>* out) {
+  if (backward) { std::fill(out->begin(), out->end(), 0); }
+  FOR_RANGE(int64_t, n, 0, p.batch_num) {
+    FOR_RANGE(int64_t, c, 0, p.channel_num) {
+      FOR_RANGE(int64_t, oh, 0, p.out_height) {
+        int64_t hstart = oh * p.stride_height - p.pad_height;
+        const int64_t hend = std::min(hstart + p.pool_height, p.in_height);
+        hstart = std::max<int64_t>(hstart, 0);
+        FOR_RANGE(int64_t, ow, 0, p.out_width) {
+          int64_t wstart = ow * p.stride_width - p.pad_width;
+          const int64_t wend = std::min(wstart + p.pool_width, p.in_width);
+          wstart = std::max<int64_t>(wstart, 0);
+          const int64_t size = (hend - hstart) * (wend - wstart);
+          const int64_t out_index =
+              Index(p, channels_last, n, c, oh, ow, p.out_height, p.out_width);
+          float res = is_max ? std::numeric_limits<float>::lowest() : 0;
+          FOR_RANGE(int64_t, h, hstart, hend) {
+            FOR_RANGE(int64_t, w, wstart, wend) {
+              const int64_t in_index = Index(p, channels_last, n, c, h, w, p.in_height,
+                                             p.in_width);
+              if (backward && is_max) {
+                if (x.at(in_index) == y.at(out_index)) { out->at(in_index) += dy.at(out_index); }
+              } else if (backward) {
+                out->at(in_index) += dy.at(out_index) / size;
+              } else if (is_max) {
+                if (x.at(in_index) > res) { res = x.at(in_index); }
+              } else {
+                res += x.at(in_index);
+              }
+            }
+          }
+          if (!backward) { out->at(out_index) = is_max ? res : res / size; }
+        }
+      }
+    }
+  }
+}
+
+void RunPool(const Pool2dCpuParams& p, bool channels_last, bool is_max, bool backward,
+             const std::vector<float>& x, const std::vector<float>& y,
+             const std::vector<float>& dy, std::vector<float>* out) {
+  if (backward && is_max) {
+    Pool2dCpuKernelUtil<float>::MaxBackward(p, channels_last, x.data(), y.data(), dy.data(),
+                                            out->data());
+  } else if (backward) {
+    Pool2dCpuKernelUtil<float>::AvgBackward(p, channels_last, dy.data(), out->data());
+  } else if (is_max) {
+    Pool2dCpuKernelUtil<float>::MaxForward(p, channels_last, x.data(), out->data());
+  } else {
+    Pool2dCpuKernelUtil<float>::AvgForward(p, channels_last, x.data(), out->data());
+  }
+}
+
+}  // namespace
+
+TEST(Pool2dCpuKernelUtil, match_naive) {
+  ScopedGlobalThreadPool thread_pool;
+  // {batch, channels, height, width, pool, stride, pad}, with 1d pooling as height 1
+  const std::vector<std::array<int64_t, 7>> cases = {
+      {2, 3, 8, 8, 2, 2, 0},  {2, 5, 9, 11, 3, 2, 1}, {1, 4, 7, 7, 3, 1, 1}, {3, 2, 13, 6, 5, 3, 2},
+      {2, 3, 1, 20, 1, 1, 0}, {1, 7, 6, 17, 4, 4, 0}, {2, 300, 9, 9, 3, 2, 1}};
+  for (const auto& shape : cases) {
+    Pool2dCpuParams p = MakeParams(shape.at(0), shape.at(1), shape.at(2), shape.at(3),
+                                   shape.at(4), shape.at(5), shape.at(6));
+    if (p.in_height == 1) {
+      p.pool_height = 1;
+      p.stride_height = 1;
+      p.pad_height = 0;
+      p.out_height = 1;
+    }
+    const int64_t in_cnt = p.batch_num * p.channel_num * p.in_height * p.in_width;
+    const int64_t out_cnt = p.batch_num * p.channel_num * p.out_height * p.out_width;
+    // Few distinct values so that the max windows have ties
+    std::vector<float> x = RandomFloats(in_cnt, 1);
+    for (float& val : x) { val = std::round(val * 4); }
+    const std::vector<float> dy = RandomFloats(out_cnt, 2);
+    for (const bool channels_last : {false, true}) {
+      for (const bool is_max : {false, true}) {
+        std::vector<float> expected_y(out_cnt);
+        std::vector<float> y(out_cnt);
+        NaivePool(p, channels_last, is_max, false, x, {}, {}, &expected_y);
+        RunPool(p, channels_last, is_max, false, x, {}, {}, &y);
+        ASSERT_EQ(y, expected_y);
+        std::vector<float> expected_dx(in_cnt);
+        std::vector<float> dx(in_cnt, 7);
+        NaivePool(p, channels_last, is_max, true, x, y, dy, &expected_dx);
+        RunPool(p, channels_last, is_max, true, x, y, dy, &dx);
+        FOR_RANGE(int64_t, i, 0, in_cnt) { ASSERT_NEAR(dx.at(i), expected_dx.at(i), 1e-5); }
+      }
+    }
+  }
+}
+
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST(Pool2dCpuKernelUtil, DISABLED_benchmark_resnet_shapes) {
+  ScopedGlobalThreadPool thread_pool(0);
+  // The max pooling after the stem of ResNet-50 and an avg pooling of the same input
+  const Pool2dCpuParams p = MakeParams(32, 64, 112, 112, 3, 2, 1);
+  const int64_t in_cnt = p.batch_num * p.channel_num * p.in_height * p.in_width;
+  const int64_t out_cnt = p.batch_num * p.channel_num * p.out_height * p.out_width;
+  const std::vector<float> x = RandomFloats(in_cnt, 3);
+  const std::vector<float> dy = RandomFloats(out_cnt, 4);
+  std::vector<float> y(out_cnt);
+  std::vector<float> dx(in_cnt);
+  const auto Seconds = [](int32_t iter_num, const std::function<void()>& Run) {
+    Run();
+    const auto start = std::chrono::steady_clock::now();
+    FOR_RANGE(int32_t, i, 0, iter_num) { Run(); }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()
+           / iter_num;
+  };
+  for (const bool channels_last : {false, true}) {
+    for (const bool is_max : {true, false}) {
+      for (const bool backward : {false, true}) {
+        std::vector<float>* out = backward ? &dx : &y;
+        if (backward) { RunPool(p, channels_last, is_max, false, x, {}, {}, &y); }
+        const double naive = Seconds(1, [&]() {
+          NaivePool(p, channels_last, is_max, backward, x, y, dy, out);
+        });
+        const double blocked = Seconds(10, [&]() {
+          RunPool(p, channels_last, is_max, backward, x, y, dy, out);
+        });
+        LOG(INFO) << (is_max ? "max" : "avg") << "_pool_2d" << (backward ? "_grad " : " ")
+                  << (channels_last ? "NHWC" : "NCHW") << " 3x3/2 on 32x64x112x112: naive "
+                  << naive * 1e3 << " ms, blocked " << blocked * 1e3 << " ms";
+      }
+    }
+  }
+}
+
+}  // namespace test
+
+}  // namespace oneflow
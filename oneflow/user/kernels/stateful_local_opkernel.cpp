@@ -362,6 +362,7 @@ Maybe<void> InitTensorTupleIndexes4Bns(const std::shared_ptr<const OperatorConf>
   opkernel->op_infer_ctx_for_main_thread_.reset(
       new LocalUserOpInferContext(user_op_conf, opkernel->composed_attrs_for_main_thread_.get(),
                                   input_arg_tuple, output_arg_tuple));
+  opkernel->infer_cache_for_main_thread_.reset(new LocalOpKernelInferCache());
   opkernel->compute_ctx_.reset(new LocalUserKernelComputeContext(
       nullptr, device_tag, user_op_conf, opkernel->composed_attrs_for_scheduler_thread_.get(),
       input_arg_tuple, output_arg_tuple, opkernel->mut_temp_blob_object()));
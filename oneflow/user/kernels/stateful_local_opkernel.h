@@ -22,6 +22,7 @@ limitations under the License.
 #include "oneflow/core/framework/device.h"
 #include "oneflow/core/framework/user_op_kernel_registry.h"
 #include "oneflow/core/framework/arg_tuple.h"
+#include "oneflow/core/framework/local_op_kernel_infer_cache.h"
 
 namespace oneflow {
 
@@ -302,6 +303,10 @@ class StatefulLocalOpKernel final {
     return op_infer_ctx_for_main_thread_.get();
   }
 
+  LocalOpKernelInferCache* mut_infer_cache_for_main_thread() const {
+    return infer_cache_for_main_thread_.get();
+  }
+
   void set_need_check_mem_case(bool value) { need_check_mem_case_ = value; }
 
  private:
@@ -340,6 +345,7 @@ class StatefulLocalOpKernel final {
   std::unique_ptr<LocalUserKernelCreateContext> create_ctx_;
   std::unique_ptr<LocalUserOpInferContext> op_infer_ctx_for_scheduler_thread_;
   std::unique_ptr<LocalUserOpInferContext> op_infer_ctx_for_main_thread_;
+  std::unique_ptr<LocalOpKernelInferCache> infer_cache_for_main_thread_;
   std::unique_ptr<LocalUserKernelComputeContext> compute_ctx_;
   std::shared_ptr<const ArgTuple> input_arg_tuple_;
   std::shared_ptr<const ArgTuple> output_arg_tuple_;
@@ -15,7 +15,7 @@ limitations under the License.
 */
 #include "oneflow/core/framework/framework.h"
 #include "oneflow/core/thread/thread_manager.h"
-#include "oneflow/core/common/balanced_splitter.h"
+#include "oneflow/core/common/range.h"
 
 namespace oneflow {
 
@@ -55,21 +55,17 @@ void ComputeTopK(const T* in_ptr, int32_t* indices_ptr, const Range& range, int3
 template<typename T>
 void CpuTopK(DeviceCtx* ctx, const T* in_ptr, int32_t* indices_ptr, int32_t instance_num,
              int32_t instance_size, int32_t k, bool sorted, int32_t* out_ptr) {
-  const int32_t num_thread = std::min(instance_num, Global<ThreadPool>::Get()->thread_num());
-  const BalancedSplitter bs(instance_num, num_thread);
-  BlockingCounter bc(num_thread);
-  FOR_RANGE(int32_t, thread_id, 0, num_thread) {
-    const Range range = bs.At(thread_id);
-    Global<ThreadPool>::Get()->AddWork([=, &bc]() {
-      if (k == 1) {
-        ComputeTopOne(in_ptr, range, instance_size, out_ptr);
-      } else {
-        ComputeTopK(in_ptr, indices_ptr, range, instance_size, k, sorted, out_ptr);
-      }
-      bc.Decrease();
-    });
-  }
-  bc.WaitUntilCntEqualZero();
+  ThreadPool* thread_pool = Global<ThreadPool>::Get();
+  const int64_t grain =
+      std::max<int64_t>(instance_num / std::max<int64_t>(thread_pool->thread_num(), 1), 1);
+  thread_pool->ParallelFor(0, instance_num, grain, [&](int64_t begin, int64_t end) {
+    const Range range(begin, end);
+    if (k == 1) {
+      ComputeTopOne(in_ptr, range, instance_size, out_ptr);
+    } else {
+      ComputeTopK(in_ptr, indices_ptr, range, instance_size, k, sorted, out_ptr);
+    }
+  });
 }
 
 }  // namespace
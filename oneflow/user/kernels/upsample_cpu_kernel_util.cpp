@@ -0,0 +1,348 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/upsample_cpu_kernel_util.h"
+#include "oneflow/core/common/cpu_isa.h"
+#include "oneflow/core/thread/thread_pool.h"
+
+namespace oneflow {
+
+namespace {
+
+// Elements handled by a task
+constexpr int64_t kTaskElemNum = 1 << 15;
+// Backward splits dy rows into parts until there are about this many independent tasks
+constexpr int64_t kMinBackwardTaskNum = 16;
+constexpr int64_t kMaxBackwardPartNum = 8;
+
+// A NCHW plane is handled as a NHWC sample of one channel, so every kernel below works on rows of
+// out_w pixels with channels interleaved. The channels == 1 branches keep the planar case a plain
+// gather and the other branches vectorize across the channels.
+
+template<typename T>
+ALWAYS_INLINE inline void NearestRow(const T* x_row, const int64_t* w_index, int64_t out_w,
+                                     int64_t channels, T* y_row) {
+  if (channels == 1) {
+    for (int64_t ow = 0; ow < out_w; ++ow) { y_row[ow] = x_row[w_index[ow]]; }
+    return;
+  }
+  for (int64_t ow = 0; ow < out_w; ++ow) {
+    const T* x = x_row + w_index[ow] * channels;
+    T* y = y_row + ow * channels;
+    for (int64_t c = 0; c < channels; ++c) { y[c] = x[c]; }
+  }
+}
+
+template<typename T>
+ALWAYS_INLINE inline void BilinearRow(const T* top_row, const T* bottom_row, const int64_t* left,
+                                      const int64_t* right, const T* w_lerp, T h_lerp,
+                                      int64_t out_w, int64_t channels, T* y_row) {
+  if (channels == 1) {
+    for (int64_t ow = 0; ow < out_w; ++ow) {
+      const T top = top_row[left[ow]] + (top_row[right[ow]] - top_row[left[ow]]) * w_lerp[ow];
+      const T bottom =
+          bottom_row[left[ow]] + (bottom_row[right[ow]] - bottom_row[left[ow]]) * w_lerp[ow];
+      y_row[ow] = top + (bottom - top) * h_lerp;
+    }
+    return;
+  }
+  for (int64_t ow = 0; ow < out_w; ++ow) {
+    const T* top_left = top_row + left[ow] * channels;
+    const T* top_right = top_row + right[ow] * channels;
+    const T* bottom_left = bottom_row + left[ow] * channels;
+    const T* bottom_right = bottom_row + right[ow] * channels;
+    const T lerp = w_lerp[ow];
+    T* y = y_row + ow * channels;
+    for (int64_t c = 0; c < channels; ++c) {
+      const T top = top_left[c] + (top_right[c] - top_left[c]) * lerp;
+      const T bottom = bottom_left[c] + (bottom_right[c] - bottom_left[c]) * lerp;
+      y[c] = top + (bottom - top) * h_lerp;
+    }
+  }
+}
+
+template<typename T>
+ALWAYS_INLINE inline void NearestGradRow(const T* dy_row, const int64_t* w_index, int64_t out_w,
+                                         int64_t channels, T* dx_row) {
+  if (channels == 1) {
+    for (int64_t ow = 0; ow < out_w; ++ow) { dx_row[w_index[ow]] += dy_row[ow]; }
+    return;
+  }
+  for (int64_t ow = 0; ow < out_w; ++ow) {
+    const T* dy = dy_row + ow * channels;
+    T* dx = dx_row + w_index[ow] * channels;
+    for (int64_t c = 0; c < channels; ++c) { dx[c] += dy[c]; }
+  }
+}
+
+// dx_top_row and dx_bottom_row may be the same row
+template<typename T>
+ALWAYS_INLINE inline void BilinearGradRow(const T* dy_row, const int64_t* left,
+                                          const int64_t* right, const T* w_lerp, T h_lerp,
+                                          int64_t out_w, int64_t channels, T* dx_top_row,
+                                          T* dx_bottom_row) {
+  const T top_weight = 1 - h_lerp;
+  if (channels == 1) {
+    for (int64_t ow = 0; ow < out_w; ++ow) {
+      const T dtop = top_weight * dy_row[ow];
+      const T dbottom = h_lerp * dy_row[ow];
+      dx_top_row[left[ow]] += (1 - w_lerp[ow]) * dtop;
+      dx_top_row[right[ow]] += w_lerp[ow] * dtop;
+      dx_bottom_row[left[ow]] += (1 - w_lerp[ow]) * dbottom;
+      dx_bottom_row[right[ow]] += w_lerp[ow] * dbottom;
+    }
+    return;
+  }
+  for (int64_t ow = 0; ow < out_w; ++ow) {
+    const T* dy = dy_row + ow * channels;
+    T* top_left = dx_top_row + left[ow] * channels;
+    T* top_right = dx_top_row + right[ow] * channels;
+    T* bottom_left = dx_bottom_row + left[ow] * channels;
+    T* bottom_right = dx_bottom_row + right[ow] * channels;
+    const T right_weight = w_lerp[ow];
+    const T left_weight = 1 - right_weight;
+    for (int64_t c = 0; c < channels; ++c) { top_left[c] += left_weight * top_weight * dy[c]; }
+    for (int64_t c = 0; c < channels; ++c) { top_right[c] += right_weight * top_weight * dy[c]; }
+    for (int64_t c = 0; c < channels; ++c) { bottom_left[c] += left_weight * h_lerp * dy[c]; }
+    for (int64_t c = 0; c < channels; ++c) { bottom_right[c] += right_weight * h_lerp * dy[c]; }
+  }
+}
+
+#define DEFINE_UPSAMPLE_ISA_KERNELS(suffix, target)                                             \
+  template<typename T>                                                                          \
+  target void NearestRow##suffix(const T* x_row, const int64_t* w_index, int64_t out_w,         \
+                                 int64_t channels, T* y_row) {                                  \
+    NearestRow<T>(x_row, w_index, out_w, channels, y_row);                                      \
+  }                                                                                             \
+  template<typename T>                                                                          \
+  target void BilinearRow##suffix(const T* top_row, const T* bottom_row, const int64_t* left,   \
+                                  const int64_t* right, const T* w_lerp, T h_lerp,              \
+                                  int64_t out_w, int64_t channels, T* y_row) {                  \
+    BilinearRow<T>(top_row, bottom_row, left, right, w_lerp, h_lerp, out_w, channels, y_row);   \
+  }                                                                                             \
+  template<typename T>                                                                          \
+  target void NearestGradRow##suffix(const T* dy_row, const int64_t* w_index, int64_t out_w,    \
+                                     int64_t channels, T* dx_row) {                             \
+    NearestGradRow<T>(dy_row, w_index, out_w, channels, dx_row);                                \
+  }                                                                                             \
+  template<typename T>                                                                          \
+  target void BilinearGradRow##suffix(const T* dy_row, const int64_t* left,                     \
+                                      const int64_t* right, const T* w_lerp, T h_lerp,          \
+                                      int64_t out_w, int64_t channels, T* dx_top_row,           \
+                                      T* dx_bottom_row) {                                       \
+    BilinearGradRow<T>(dy_row, left, right, w_lerp, h_lerp, out_w, channels, dx_top_row,        \
+                       dx_bottom_row);                                                          \
+  }
+DEFINE_UPSAMPLE_ISA_KERNELS(Default, )
+#ifdef OF_CPU_ISA_DISPATCH_ENABLED
+DEFINE_UPSAMPLE_ISA_KERNELS(Avx2, OF_CPU_TARGET_AVX2)
+DEFINE_UPSAMPLE_ISA_KERNELS(Avx512, OF_CPU_TARGET_AVX512)
+#endif
+#undef DEFINE_UPSAMPLE_ISA_KERNELS
+
+#ifdef OF_CPU_ISA_DISPATCH_ENABLED
+#define OF_UPSAMPLE_ISA_CASES(func)              \
+  case CpuIsa::kAvx512: return &func##Avx512<T>; \
+  case CpuIsa::kAvx2: return &func##Avx2<T>;
+#else
+#define OF_UPSAMPLE_ISA_CASES(func)
+#endif
+#define DEFINE_UPSAMPLE_ISA_GETTER(func)    \
+  template<typename T>                      \
+  decltype(&func##Default<T>) Get##func() { \
+    switch (GetCpuIsa()) {                  \
+      OF_UPSAMPLE_ISA_CASES(func)           \
+      default: return &func##Default<T>;    \
+    }                                       \
+  }
+DEFINE_UPSAMPLE_ISA_GETTER(NearestRow)
+DEFINE_UPSAMPLE_ISA_GETTER(BilinearRow)
+DEFINE_UPSAMPLE_ISA_GETTER(NearestGradRow)
+DEFINE_UPSAMPLE_ISA_GETTER(BilinearGradRow)
+#undef DEFINE_UPSAMPLE_ISA_GETTER
+#undef OF_UPSAMPLE_ISA_CASES
+
+// Runs DoEachRange over [0, n) in ranges of about kTaskElemNum elements
+void ParallelFor(int64_t n, int64_t elem_num_per_index,
+                 const std::function<void(int64_t, int64_t)>& DoEachRange) {
+  const int64_t grain =
+      std::max<int64_t>(kTaskElemNum / std::max<int64_t>(elem_num_per_index, 1), 1);
+  ThreadPool* thread_pool = Global<ThreadPool>::Get();
+  if (thread_pool == nullptr || n <= grain) {
+    DoEachRange(0, n);
+    return;
+  }
+  thread_pool->ParallelFor(0, n, grain, DoEachRange);
+}
+
+// Independent units of the scatter: samples of NHWC, planes of NCHW
+int64_t GetUnitNum(const Upsample2dCpuParams& params) {
+  return params.channels_last ? params.batch_num : params.batch_num * params.channel_num;
+}
+
+int64_t GetUnitChannels(const Upsample2dCpuParams& params) {
+  return params.channels_last ? params.channel_num : 1;
+}
+
+int64_t GetBackwardPartNum(const Upsample2dCpuParams& params) {
+  const int64_t unit_num = std::max<int64_t>(GetUnitNum(params), 1);
+  if (unit_num >= kMinBackwardTaskNum) { return 1; }
+  const int64_t part_num = std::min((kMinBackwardTaskNum + unit_num - 1) / unit_num,
+                                    std::min(kMaxBackwardPartNum, params.out_height));
+  return std::max<int64_t>(part_num, 1);
+}
+
+}  // namespace
+
+template<typename T>
+void UpsampleCpuKernelUtil<T>::InitNearestTable(int64_t in_size, int64_t out_size, float scale,
+                                                UpsampleAxisTable<T>* table) {
+  const float inv_scale = 1.f / scale;
+  table->index0.resize(out_size);
+  table->index1.clear();
+  table->lerp.clear();
+  FOR_RANGE(int64_t, i, 0, out_size) {
+    const int64_t index =
+        static_cast<int64_t>(std::floor((static_cast<float>(i) + 0.5f) * inv_scale));
+    table->index0[i] = std::max<int64_t>(std::min(index, in_size - 1), 0);
+  }
+}
+
+template<typename T>
+void UpsampleCpuKernelUtil<T>::InitBilinearTable(int64_t in_size, int64_t out_size, float scale,
+                                                 bool align_corners,
+                                                 UpsampleAxisTable<T>* table) {
+  T src_scale = 0;
+  if (align_corners) {
+    if (out_size > 1) { src_scale = static_cast<T>(in_size - 1) / (out_size - 1); }
+  } else {
+    src_scale = scale > 0 ? static_cast<T>(1.0 / static_cast<T>(scale))
+                          : static_cast<T>(in_size) / out_size;
+  }
+  table->index0.resize(out_size);
+  table->index1.resize(out_size);
+  table->lerp.resize(out_size);
+  FOR_RANGE(int64_t, i, 0, out_size) {
+    T src = 0;
+    if (align_corners) {
+      src = src_scale * static_cast<T>(i);
+    } else {
+      src = std::max<T>((static_cast<T>(i) + static_cast<T>(0.5)) * src_scale
+                            - static_cast<T>(0.5),
+                        0);
+    }
+    const T src_floor = std::floor(src);
+    table->index0[i] = src > 0 ? static_cast<int64_t>(src_floor) : 0;
+    table->index1[i] = src < in_size - 1 ? static_cast<int64_t>(std::ceil(src)) : in_size - 1;
+    table->lerp[i] = src - src_floor;
+  }
+}
+
+template<typename T>
+void UpsampleCpuKernelUtil<T>::Forward(const Upsample2dCpuParams& params, bool bilinear,
+                                       const UpsampleAxisTable<T>& h_table,
+                                       const UpsampleAxisTable<T>& w_table, const T* x, T* y) {
+  const int64_t channels = GetUnitChannels(params);
+  const int64_t in_row_size = params.in_width * channels;
+  const int64_t in_unit_size = params.in_height * in_row_size;
+  const int64_t out_row_size = params.out_width * channels;
+  const int64_t out_h = params.out_height;
+  const int64_t row_num = GetUnitNum(params) * out_h;
+  if (bilinear) {
+    const auto bilinear_row = GetBilinearRow<T>();
+    ParallelFor(row_num, out_row_size, [&](int64_t begin, int64_t end) {
+      FOR_RANGE(int64_t, row, begin, end) {
+        const int64_t oh = row % out_h;
+        const T* x_unit = x + (row / out_h) * in_unit_size;
+        bilinear_row(x_unit + h_table.index0[oh] * in_row_size,
+                     x_unit + h_table.index1[oh] * in_row_size, w_table.index0.data(),
+                     w_table.index1.data(), w_table.lerp.data(), h_table.lerp[oh],
+                     params.out_width, channels, y + row * out_row_size);
+      }
+    });
+  } else {
+    const auto nearest_row = GetNearestRow<T>();
+    ParallelFor(row_num, out_row_size, [&](int64_t begin, int64_t end) {
+      FOR_RANGE(int64_t, row, begin, end) {
+        const int64_t oh = row % out_h;
+        const T* x_unit = x + (row / out_h) * in_unit_size;
+        nearest_row(x_unit + h_table.index0[oh] * in_row_size, w_table.index0.data(),
+                    params.out_width, channels, y + row * out_row_size);
+      }
+    });
+  }
+}
+
+template<typename T>
+size_t UpsampleCpuKernelUtil<T>::GetBackwardTmpSize(const Upsample2dCpuParams& params) {
+  const int64_t dx_elem_cnt =
+      params.batch_num * params.channel_num * params.in_height * params.in_width;
+  return (GetBackwardPartNum(params) - 1) * dx_elem_cnt * sizeof(T);
+}
+
+template<typename T>
+void UpsampleCpuKernelUtil<T>::Backward(const Upsample2dCpuParams& params, bool bilinear,
+                                        const UpsampleAxisTable<T>& h_table,
+                                        const UpsampleAxisTable<T>& w_table, const T* dy, T* dx,
+                                        void* tmp) {
+  const int64_t channels = GetUnitChannels(params);
+  const int64_t in_row_size = params.in_width * channels;
+  const int64_t in_unit_size = params.in_height * in_row_size;
+  const int64_t out_row_size = params.out_width * channels;
+  const int64_t out_h = params.out_height;
+  const int64_t unit_num = GetUnitNum(params);
+  const int64_t dx_elem_cnt = unit_num * in_unit_size;
+  const int64_t part_num = GetBackwardPartNum(params);
+  // Part 0 scatters into dx itself, part p > 0 into the p - 1 th copy in tmp
+  auto PartDx = [&](int64_t part) -> T* {
+    return part == 0 ? dx : static_cast<T*>(tmp) + (part - 1) * dx_elem_cnt;
+  };
+  const auto nearest_grad_row = GetNearestGradRow<T>();
+  const auto bilinear_grad_row = GetBilinearGradRow<T>();
+  // A task is a (unit, part) pair and owns its unit of its part's dx
+  const int64_t task_elem_num = (out_h + part_num - 1) / part_num * out_row_size;
+  ParallelFor(unit_num * part_num, task_elem_num, [&](int64_t begin, int64_t end) {
+    FOR_RANGE(int64_t, task, begin, end) {
+      const int64_t unit = task / part_num;
+      const int64_t part = task % part_num;
+      T* dx_unit = PartDx(part) + unit * in_unit_size;
+      std::fill(dx_unit, dx_unit + in_unit_size, static_cast<T>(0));
+      const T* dy_unit = dy + unit * out_h * out_row_size;
+      FOR_RANGE(int64_t, oh, out_h * part / part_num, out_h * (part + 1) / part_num) {
+        if (bilinear) {
+          bilinear_grad_row(dy_unit + oh * out_row_size, w_table.index0.data(),
+                            w_table.index1.data(), w_table.lerp.data(), h_table.lerp[oh],
+                            params.out_width, channels, dx_unit + h_table.index0[oh] * in_row_size,
+                            dx_unit + h_table.index1[oh] * in_row_size);
+        } else {
+          nearest_grad_row(dy_unit + oh * out_row_size, w_table.index0.data(), params.out_width,
+                           channels, dx_unit + h_table.index0[oh] * in_row_size);
+        }
+      }
+    }
+  });
+  if (part_num == 1) { return; }
+  ParallelFor(dx_elem_cnt, part_num, [&](int64_t begin, int64_t end) {
+    FOR_RANGE(int64_t, part, 1, part_num) {
+      const T* part_dx = PartDx(part);
+      FOR_RANGE(int64_t, i, begin, end) { dx[i] += part_dx[i]; }
+    }
+  });
+}
+
+template struct UpsampleCpuKernelUtil<float>;
+template struct UpsampleCpuKernelUtil<double>;
+
+}  // namespace oneflow
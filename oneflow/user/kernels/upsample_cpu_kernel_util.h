@@ -0,0 +1,64 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_UPSAMPLE_CPU_KERNEL_UTIL_H_
+#define ONEFLOW_USER_KERNELS_UPSAMPLE_CPU_KERNEL_UTIL_H_
+
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+struct Upsample2dCpuParams final {
+  int64_t batch_num;
+  int64_t channel_num;
+  int64_t in_height;
+  int64_t in_width;
+  int64_t out_height;
+  int64_t out_width;
+  bool channels_last;
+};
+
+// The sources of each output row or column. Nearest only uses index0, bilinear interpolates
+// between index0 and index1 with weight lerp on index1.
+template<typename T>
+struct UpsampleAxisTable final {
+  std::vector<int64_t> index0;
+  std::vector<int64_t> index1;
+  std::vector<T> lerp;
+};
+
+template<typename T>
+struct UpsampleCpuKernelUtil final {
+  // scale is the height_scale or width_scale attr, out = in * scale
+  static void InitNearestTable(int64_t in_size, int64_t out_size, float scale,
+                               UpsampleAxisTable<T>* table);
+  static void InitBilinearTable(int64_t in_size, int64_t out_size, float scale,
+                                bool align_corners, UpsampleAxisTable<T>* table);
+  static void Forward(const Upsample2dCpuParams& params, bool bilinear,
+                      const UpsampleAxisTable<T>& h_table, const UpsampleAxisTable<T>& w_table,
+                      const T* x, T* y);
+  // Bytes of the per-part dx buffers of Backward
+  static size_t GetBackwardTmpSize(const Upsample2dCpuParams& params);
+  // dx is written, not accumulated into. When there are too few samples (NHWC) or planes (NCHW)
+  // to keep the threads busy, the rows of dy are split into parts that scatter into their own
+  // copies of dx in tmp and are summed at the end, so no two tasks add to the same element.
+  static void Backward(const Upsample2dCpuParams& params, bool bilinear,
+                       const UpsampleAxisTable<T>& h_table, const UpsampleAxisTable<T>& w_table,
+                       const T* dy, T* dx, void* tmp);
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_UPSAMPLE_CPU_KERNEL_UTIL_H_
@@ -0,0 +1,286 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/upsample_cpu_kernel_util.h"
+#include "oneflow/core/kernel/cpu_kernel_test_util.h"
+#include <gtest/gtest.h>
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+// NCHW <-> NHWC of a n, c, h, w tensor
+std::vector<float> Transpose(const std::vector<float>& in, int64_t n, int64_t c, int64_t h,
+                             int64_t w, bool to_channels_last) {
+  std::vector<float> out(in.size());
+  FOR_RANGE(int64_t, ni, 0, n) {
+    FOR_RANGE(int64_t, ci, 0, c) {
+      FOR_RANGE(int64_t, hw, 0, h * w) {
+        const int64_t nchw = (ni * c + ci) * h * w + hw;
+        const int64_t nhwc = (ni * h * w + hw) * c + ci;
+        if (to_channels_last) {
+          out.at(nhwc) = in.at(nchw);
+        } else {
+          out.at(nchw) = in.at(nhwc);
+        }
+      }
+    }
+  }
+  return out;
+}
+
+// Per output element NCHW upsample, as the GPU kernels compute it
+struct Reference final {
+  Reference(const Upsample2dCpuParams& p, float height_scale, float width_scale,
+            bool align_corners, bool bilinear, const std::vector<float>& x,
+            const std::vector<float>& dy)
+      : y(p.batch_num * p.channel_num * p.out_height * p.out_width),
+        dx(p.batch_num * p.channel_num * p.in_height * p.in_width) {
+    FOR_RANGE(int64_t, plane, 0, p.batch_num * p.channel_num) {
+      FOR_RANGE(int64_t, oh, 0, p.out_height) {
+        FOR_RANGE(int64_t, ow, 0, p.out_width) {
+          int64_t hs[2];
+          int64_t ws[2];
+          double h_lerp = 0;
+          double w_lerp = 0;
+          if (bilinear) {
+            Bilinear(p.in_height, p.out_height, height_scale, align_corners, oh, hs, &h_lerp);
+            Bilinear(p.in_width, p.out_width, width_scale, align_corners, ow, ws, &w_lerp);
+          } else {
+            hs[0] = hs[1] = Nearest(p.in_height, height_scale, oh);
+            ws[0] = ws[1] = Nearest(p.in_width, width_scale, ow);
+          }
+          const int64_t out_i = (plane * p.out_height + oh) * p.out_width + ow;
+          FOR_RANGE(int64_t, i, 0, 2) {
+            FOR_RANGE(int64_t, j, 0, 2) {
+              const double weight = (i == 0 ? 1 - h_lerp : h_lerp) * (j == 0 ? 1 - w_lerp : w_lerp);
+              const int64_t in_i = (plane * p.in_height + hs[i]) * p.in_width + ws[j];
+              y.at(out_i) += weight * x.at(in_i);
+              dx.at(in_i) += weight * dy.at(out_i);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  static int64_t Nearest(int64_t in_size, float scale, int64_t i) {
+    const int64_t index = static_cast<int64_t>(std::floor((i + 0.5f) * (1.f / scale)));
+    return std::max<int64_t>(std::min(index, in_size - 1), 0);
+  }
+
+  static void Bilinear(int64_t in_size, int64_t out_size, float scale, bool align_corners,
+                       int64_t i, int64_t* index, double* lerp) {
+    double src = 0;
+    if (align_corners) {
+      src = out_size > 1 ? static_cast<double>(in_size - 1) / (out_size - 1) * i : 0;
+    } else {
+      src = std::max((i + 0.5) / scale - 0.5, 0.0);
+    }
+    index[0] = static_cast<int64_t>(std::floor(src));
+    index[1] = std::min<int64_t>(static_cast<int64_t>(std::ceil(src)), in_size - 1);
+    *lerp = src - std::floor(src);
+  }
+
+  std::vector<double> y;
+  std::vector<double> dx;
+};
+
+struct Tables final {
+  Tables(const Upsample2dCpuParams& p, float height_scale, float width_scale, bool align_corners,
+         bool bilinear) {
+    using Util = UpsampleCpuKernelUtil<float>;
+    if (bilinear) {
+      Util::InitBilinearTable(p.in_height, p.out_height, height_scale, align_corners, &h);
+      Util::InitBilinearTable(p.in_width, p.out_width, width_scale, align_corners, &w);
+    } else {
+      Util::InitNearestTable(p.in_height, p.out_height, height_scale, &h);
+      Util::InitNearestTable(p.in_width, p.out_width, width_scale, &w);
+    }
+  }
+
+  UpsampleAxisTable<float> h;
+  UpsampleAxisTable<float> w;
+};
+
+}  // namespace
+
+TEST(UpsampleCpuKernelUtil, match_reference) {
+  ScopedGlobalThreadPool thread_pool;
+  using Util = UpsampleCpuKernelUtil<float>;
+  // n, c, h, w, height scale, width scale
+  const std::vector<std::array<float, 6>> cases = {
+      {1, 1, 1, 1, 2, 2},  {2, 3, 5, 7, 2, 2},     {1, 2, 4, 4, 3, 1.5},
+      {4, 8, 6, 5, 2, 3},  {1, 64, 12, 12, 2, 2},  {32, 4, 9, 9, 2, 2},
+      {1, 1, 64, 80, 2, 2}};
+  for (const auto& c : cases) {
+    for (const bool bilinear : {false, true}) {
+      for (const bool align_corners : {false, true}) {
+        if (!bilinear && align_corners) { continue; }
+        for (const bool channels_last : {false, true}) {
+          Upsample2dCpuParams p{};
+          p.batch_num = static_cast<int64_t>(c[0]);
+          p.channel_num = static_cast<int64_t>(c[1]);
+          p.in_height = static_cast<int64_t>(c[2]);
+          p.in_width = static_cast<int64_t>(c[3]);
+          p.out_height = static_cast<int64_t>(c[4] * p.in_height);
+          p.out_width = static_cast<int64_t>(c[5] * p.in_width);
+          p.channels_last = channels_last;
+          const int64_t planes = p.batch_num * p.channel_num;
+          const std::vector<float> x = RandomFloats(planes * p.in_height * p.in_width, 1);
+          const std::vector<float> dy = RandomFloats(planes * p.out_height * p.out_width, 2);
+          const Reference ref(p, c[4], c[5], align_corners, bilinear, x, dy);
+          const Tables tables(p, c[4], c[5], align_corners, bilinear);
+
+          std::vector<float> y(dy.size());
+          // Stale values in dx must be overwritten
+          std::vector<float> dx(x.size(), 7.f);
+          std::vector<char> tmp(Util::GetBackwardTmpSize(p), 1);
+          if (channels_last) {
+            const std::vector<float> x_nhwc =
+                Transpose(x, p.batch_num, p.channel_num, p.in_height, p.in_width, true);
+            const std::vector<float> dy_nhwc =
+                Transpose(dy, p.batch_num, p.channel_num, p.out_height, p.out_width, true);
+            Util::Forward(p, bilinear, tables.h, tables.w, x_nhwc.data(), y.data());
+            Util::Backward(p, bilinear, tables.h, tables.w, dy_nhwc.data(), dx.data(),
+                           tmp.data());
+            y = Transpose(y, p.batch_num, p.channel_num, p.out_height, p.out_width, false);
+            dx = Transpose(dx, p.batch_num, p.channel_num, p.in_height, p.in_width, false);
+          } else {
+            Util::Forward(p, bilinear, tables.h, tables.w, x.data(), y.data());
+            Util::Backward(p, bilinear, tables.h, tables.w, dy.data(), dx.data(), tmp.data());
+          }
+          FOR_RANGE(size_t, i, 0, y.size()) { ASSERT_NEAR(y.at(i), ref.y.at(i), 1e-5); }
+          FOR_RANGE(size_t, i, 0, dx.size()) { ASSERT_NEAR(dx.at(i), ref.dx.at(i), 1e-4); }
+        }
+      }
+    }
+  }
+}
+
+TEST(UpsampleCpuKernelUtil, backward_tmp_size) {
+  using Util = UpsampleCpuKernelUtil<float>;
+  Upsample2dCpuParams p{};
+  p.batch_num = 32;
+  p.channel_num = 16;
+  p.in_height = p.in_width = 8;
+  p.out_height = p.out_width = 16;
+  p.channels_last = false;
+  // Enough planes to keep the threads busy, no partial buffers
+  ASSERT_EQ(Util::GetBackwardTmpSize(p), 0);
+  // Two samples of NHWC are split into 8 parts each, 7 of them scatter into tmp
+  p.channels_last = true;
+  p.batch_num = 2;
+  ASSERT_EQ(Util::GetBackwardTmpSize(p), 7 * 2 * 16 * 8 * 8 * sizeof(float));
+  // No more parts than rows of dy
+  p.batch_num = 1;
+  p.out_height = 1;
+  ASSERT_EQ(Util::GetBackwardTmpSize(p), 0);
+}
+
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST(UpsampleCpuKernelUtil, DISABLED_benchmark_vs_per_element) {
+  ScopedGlobalThreadPool thread_pool(0);
+  using Util = UpsampleCpuKernelUtil<float>;
+  const int32_t iter_num = 10;
+  // n, c, h, w of x, upsampled by 2, as in the FPN and UNet decoders
+  const std::vector<std::array<int64_t, 4>> shapes = {{8, 256, 32, 32}, {2, 64, 128, 128}};
+  for (const auto& shape : shapes) {
+    for (const bool bilinear : {false, true}) {
+      for (const bool channels_last : {false, true}) {
+        Upsample2dCpuParams p{};
+        p.batch_num = shape[0];
+        p.channel_num = shape[1];
+        p.in_height = shape[2];
+        p.in_width = shape[3];
+        p.out_height = shape[2] * 2;
+        p.out_width = shape[3] * 2;
+        p.channels_last = channels_last;
+        const int64_t planes = p.batch_num * p.channel_num;
+        const std::vector<float> x = RandomFloats(planes * p.in_height * p.in_width, 1);
+        const std::vector<float> dy = RandomFloats(planes * p.out_height * p.out_width, 2);
+        std::vector<float> y(dy.size());
+        std::vector<float> dx(x.size());
+        std::vector<char> tmp(Util::GetBackwardTmpSize(p));
+
+        // Indices and weights recomputed for every element, the way the GPU kernels do
+        auto start = std::chrono::steady_clock::now();
+        FOR_RANGE(int32_t, iter, 0, iter_num) {
+          const float scale = 0.5f;
+          const int64_t c_num = p.channel_num;
+          FOR_RANGE(int64_t, i, 0, static_cast<int64_t>(y.size())) {
+            const int64_t ow = channels_last ? i / c_num % p.out_width : i % p.out_width;
+            const int64_t oh = channels_last ? i / c_num / p.out_width % p.out_height
+                                             : i / p.out_width % p.out_height;
+            const int64_t n = i / (y.size() / p.batch_num);
+            const int64_t ci = channels_last ? i % c_num : i / (p.out_width * p.out_height) % c_num;
+            auto At = [&](int64_t h, int64_t w) {
+              return channels_last ? x[((n * p.in_height + h) * p.in_width + w) * c_num + ci]
+                                   : x[((n * c_num + ci) * p.in_height + h) * p.in_width + w];
+            };
+            if (bilinear) {
+              const float src_h = std::max((oh + 0.5f) * scale - 0.5f, 0.f);
+              const float src_w = std::max((ow + 0.5f) * scale - 0.5f, 0.f);
+              const int64_t h0 = static_cast<int64_t>(src_h);
+              const int64_t w0 = static_cast<int64_t>(src_w);
+              const int64_t h1 = std::min<int64_t>(h0 + 1, p.in_height - 1);
+              const int64_t w1 = std::min<int64_t>(w0 + 1, p.in_width - 1);
+              const float h_lerp = src_h - h0;
+              const float w_lerp = src_w - w0;
+              const float top = At(h0, w0) + (At(h0, w1) - At(h0, w0)) * w_lerp;
+              const float bottom = At(h1, w0) + (At(h1, w1) - At(h1, w0)) * w_lerp;
+              y[i] = top + (bottom - top) * h_lerp;
+            } else {
+              y[i] = At(static_cast<int64_t>((oh + 0.5f) * scale),
+                        static_cast<int64_t>((ow + 0.5f) * scale));
+            }
+          }
+        }
+        const double per_element_ms = std::chrono::duration<double, std::milli>(
+                                          std::chrono::steady_clock::now() - start)
+                                          .count()
+                                      / iter_num;
+
+        const Tables tables(p, 2, 2, false, bilinear);
+        start = std::chrono::steady_clock::now();
+        FOR_RANGE(int32_t, iter, 0, iter_num) {
+          Util::Forward(p, bilinear, tables.h, tables.w, x.data(), y.data());
+        }
+        const double forward_ms = std::chrono::duration<double, std::milli>(
+                                      std::chrono::steady_clock::now() - start)
+                                      .count()
+                                  / iter_num;
+        start = std::chrono::steady_clock::now();
+        FOR_RANGE(int32_t, iter, 0, iter_num) {
+          Util::Backward(p, bilinear, tables.h, tables.w, dy.data(), dx.data(), tmp.data());
+        }
+        const double backward_ms = std::chrono::duration<double, std::milli>(
+                                       std::chrono::steady_clock::now() - start)
+                                       .count()
+                                   / iter_num;
+        LOG(INFO) << (bilinear ? "bilinear " : "nearest ") << (channels_last ? "NHWC " : "NCHW ")
+                  << shape[0] << "x" << shape[1] << "x" << shape[2] << "x" << shape[3]
+                  << ", per element forward " << per_element_ms << " ms, forward " << forward_ms
+                  << " ms, backward " << backward_ms << " ms";
+      }
+    }
+  }
+}
+
+}  // namespace test
+
+}  // namespace oneflow
@@ -0,0 +1,177 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/user/kernels/upsample_cpu_kernel_util.h"
+
+namespace oneflow {
+
+namespace {
+
+template<typename ShapeType>
+Upsample2dCpuParams GetUpsample2dCpuParams(const ShapeType& in_shape, const ShapeType& out_shape,
+                                           const std::string& data_format) {
+  CHECK_EQ(in_shape.NumAxes(), 4);
+  CHECK_EQ(out_shape.NumAxes(), 4);
+  const bool channels_last = data_format == "channels_last";
+  const int32_t channel_axis = channels_last ? 3 : 1;
+  const int32_t height_axis = channels_last ? 1 : 2;
+  Upsample2dCpuParams params{};
+  params.batch_num = in_shape.At(0);
+  params.channel_num = in_shape.At(channel_axis);
+  params.in_height = in_shape.At(height_axis);
+  params.in_width = in_shape.At(height_axis + 1);
+  params.out_height = out_shape.At(height_axis);
+  params.out_width = out_shape.At(height_axis + 1);
+  params.channels_last = channels_last;
+  return params;
+}
+
+// The index and lerp tables of the output rows and columns, rebuilt only when the spatial sizes
+// change
+template<typename T>
+class UpsampleCpuKernelState final : public user_op::OpKernelState {
+ public:
+  explicit UpsampleCpuKernelState(user_op::KernelInitContext* ctx)
+      : height_scale_(ctx->Attr<float>("height_scale")),
+        width_scale_(ctx->Attr<float>("width_scale")),
+        align_corners_(ctx->Attr<bool>("align_corners")),
+        bilinear_(ctx->Attr<std::string>("interpolation") == "bilinear"),
+        sizes_{-1, -1, -1, -1} {}
+  ~UpsampleCpuKernelState() override = default;
+
+  bool bilinear() const { return bilinear_; }
+  const UpsampleAxisTable<T>& h_table() const { return h_table_; }
+  const UpsampleAxisTable<T>& w_table() const { return w_table_; }
+
+  void Update(const Upsample2dCpuParams& params) {
+    const std::array<int64_t, 4> sizes{params.in_height, params.in_width, params.out_height,
+                                       params.out_width};
+    if (sizes == sizes_) { return; }
+    using Util = UpsampleCpuKernelUtil<T>;
+    if (bilinear_) {
+      Util::InitBilinearTable(params.in_height, params.out_height, height_scale_, align_corners_,
+                              &h_table_);
+      Util::InitBilinearTable(params.in_width, params.out_width, width_scale_, align_corners_,
+                              &w_table_);
+    } else {
+      Util::InitNearestTable(params.in_height, params.out_height, height_scale_, &h_table_);
+      Util::InitNearestTable(params.in_width, params.out_width, width_scale_, &w_table_);
+    }
+    sizes_ = sizes;
+  }
+
+ private:
+  float height_scale_;
+  float width_scale_;
+  bool align_corners_;
+  bool bilinear_;
+  std::array<int64_t, 4> sizes_;
+  UpsampleAxisTable<T> h_table_;
+  UpsampleAxisTable<T> w_table_;
+};
+
+}  // namespace
+
+template<typename T>
+class UpsampleCpuKernel final : public user_op::OpKernel {
+ public:
+  UpsampleCpuKernel() = default;
+  ~UpsampleCpuKernel() = default;
+
+  std::shared_ptr<user_op::OpKernelState> CreateOpKernelState(
+      user_op::KernelInitContext* ctx) const override {
+    return std::make_shared<UpsampleCpuKernelState<T>>(ctx);
+  }
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx, user_op::OpKernelState* state) const override {
+    const user_op::Tensor* x_blob = ctx->Tensor4ArgNameAndIndex("x", 0);
+    user_op::Tensor* y_blob = ctx->Tensor4ArgNameAndIndex("y", 0);
+    auto* upsample_state = dynamic_cast<UpsampleCpuKernelState<T>*>(state);
+    CHECK_NOTNULL(upsample_state);
+    const Upsample2dCpuParams params = GetUpsample2dCpuParams(
+        x_blob->shape(), y_blob->shape(), ctx->Attr<std::string>("data_format"));
+    upsample_state->Update(params);
+    UpsampleCpuKernelUtil<T>::Forward(params, upsample_state->bilinear(),
+                                      upsample_state->h_table(), upsample_state->w_table(),
+                                      x_blob->dptr<T>(), y_blob->mut_dptr<T>());
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+template<typename T>
+class UpsampleGradCpuKernel final : public user_op::OpKernel {
+ public:
+  UpsampleGradCpuKernel() = default;
+  ~UpsampleGradCpuKernel() = default;
+
+  std::shared_ptr<user_op::OpKernelState> CreateOpKernelState(
+      user_op::KernelInitContext* ctx) const override {
+    return std::make_shared<UpsampleCpuKernelState<T>>(ctx);
+  }
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx, user_op::OpKernelState* state) const override {
+    user_op::Tensor* dx_blob = ctx->Tensor4ArgNameAndIndex("dx", 0);
+    if (dx_blob == nullptr) { return; }
+    const user_op::Tensor* dy_blob = ctx->Tensor4ArgNameAndIndex("dy", 0);
+    user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
+    auto* upsample_state = dynamic_cast<UpsampleCpuKernelState<T>*>(state);
+    CHECK_NOTNULL(upsample_state);
+    const Upsample2dCpuParams params = GetUpsample2dCpuParams(
+        dx_blob->shape(), dy_blob->shape(), ctx->Attr<std::string>("data_format"));
+    const size_t tmp_size = UpsampleCpuKernelUtil<T>::GetBackwardTmpSize(params);
+    void* tmp_dptr = nullptr;
+    if (tmp_size > 0) {
+      CHECK_NOTNULL(tmp_buffer);
+      CHECK_GE(tmp_buffer->shape().elem_cnt(), tmp_size);
+      tmp_dptr = tmp_buffer->mut_dptr();
+    }
+    upsample_state->Update(params);
+    UpsampleCpuKernelUtil<T>::Backward(params, upsample_state->bilinear(),
+                                       upsample_state->h_table(), upsample_state->w_table(),
+                                       dy_blob->dptr<T>(), dx_blob->mut_dptr<T>(), tmp_dptr);
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_UPSAMPLE_CPU_KERNEL(dtype)                                                   \
+  REGISTER_USER_KERNEL("upsample")                                                            \
+      .SetCreateFn<UpsampleCpuKernel<dtype>>()                                                \
+      .SetIsMatchedHob(                                                                       \
+          (user_op::HobDeviceTag() == "cpu")                                                  \
+          & (user_op::HobDataType("y", 0) == GetDataType<dtype>::value)                       \
+          & ((user_op::HobAttr<std::string>("interpolation") == std::string("nearest"))       \
+             | (user_op::HobAttr<std::string>("interpolation") == std::string("bilinear")))); \
+  REGISTER_USER_KERNEL("upsample_grad")                                                       \
+      .SetCreateFn<UpsampleGradCpuKernel<dtype>>()                                            \
+      .SetIsMatchedHob(                                                                       \
+          (user_op::HobDeviceTag() == "cpu")                                                  \
+          & (user_op::HobDataType("dx", 0) == GetDataType<dtype>::value)                      \
+          & ((user_op::HobAttr<std::string>("interpolation") == std::string("nearest"))       \
+             | (user_op::HobAttr<std::string>("interpolation") == std::string("bilinear"))))  \
+      .SetInferTmpSizeFn([](user_op::InferContext* ctx) -> size_t {                           \
+        const Upsample2dCpuParams params =                                                    \
+            GetUpsample2dCpuParams(ctx->TensorDesc4ArgNameAndIndex("dx", 0)->shape(),         \
+                                   ctx->TensorDesc4ArgNameAndIndex("dy", 0)->shape(),         \
+                                   ctx->Attr<std::string>("data_format"));                    \
+        return UpsampleCpuKernelUtil<dtype>::GetBackwardTmpSize(params);                      \
+      });
+
+REGISTER_UPSAMPLE_CPU_KERNEL(float)
+REGISTER_UPSAMPLE_CPU_KERNEL(double)
+
+}  // namespace oneflow